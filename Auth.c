@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Auth.h"
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+static uint64_t now_ns( void )
+{
+   struct timespec t;
+   clock_gettime( CLOCK_MONOTONIC, &t );
+   return ( uint64_t ) t.tv_sec * 1000000000u + ( uint64_t ) t.tv_nsec;
+}
+
+/**
+ * @brief Cubeta del histograma de una latencia: 8 cubetas por cada potencia de 2, así que
+ * el error relativo es de a lo más 12.5%.
+ */
+static size_t hist_bucket( uint64_t ns )
+{
+   if( ns < 8 ) return ( size_t ) ns;
+
+   unsigned e = 63 - __builtin_clzll( ns );
+   return ( size_t )( e - 2 ) * 8 + ( ( ns >> ( e - 3 ) ) & 7 );
+}
+
+/**
+ * @brief Límite inferior de las latencias de una cubeta (inversa de hist_bucket()).
+ */
+static uint64_t hist_value( size_t bucket )
+{
+   if( bucket < 8 ) return bucket;
+
+   unsigned e = ( unsigned )( bucket / 8 ) + 2;
+   return ( uint64_t )( 8 + bucket % 8 ) << ( e - 3 );
+}
+
+/**
+ * @brief Hilo del grupo: toma solicitudes de la cola hasta que el grupo se destruye y la
+ * cola queda vacía.
+ */
+static void* worker_main( void* arg )
+{
+   Auth_pool* pool = ( Auth_pool* ) arg;
+
+   pthread_mutex_lock( &pool->lock );
+   for( ;; )
+   {
+      while( pool->running && pool->count == 0 ) pthread_cond_wait( &pool->not_empty, &pool->lock );
+      if( pool->count == 0 ) break;
+
+      Auth_job* job = pool->queue[ pool->head ];
+      pool->head = ( pool->head + 1 ) % pool->cap;
+      --pool->count;
+      unsigned log_n = pool->log_n;
+      pthread_cond_signal( &pool->not_full );
+      pthread_mutex_unlock( &pool->lock );
+
+      if( job->op == eAuth_VERIFY ) job->result = Kdf_Verify( &job->hash, job->password );
+      else job->result = Kdf_Hash( &job->hash, job->password, log_n );
+
+      // el texto de la contraseña no debe sobrevivir a la operación
+      memset( job->password, 0, sizeof( job->password ) );
+      __asm__ __volatile__( "" : : "r"( job->password ) : "memory" );
+
+      uint64_t latency = now_ns() - job->submitted_ns;
+
+      pthread_mutex_lock( &pool->lock );
+      if( job->op == eAuth_VERIFY )
+      {
+         ++pool->hist[ hist_bucket( latency ) ];
+         ++pool->samples;
+      }
+      job->done = true;
+      pthread_cond_signal( &job->cond );
+   }
+   pthread_mutex_unlock( &pool->lock );
+
+   return NULL;
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Crea el grupo de hilos de verificación.
+ *
+ * @param workers Número de hilos; 0 para usar uno por procesador.
+ * @param queue Solicitudes que pueden esperar en la cola (p. ej. AUTH_QUEUE).
+ * @param log_n Costo de las contraseñas nuevas (@see Kdf_Scrypt); KDF_LOG_N por defecto.
+ * Cada hilo conserva 128 * KDF_R * 2^log_n bytes de memoria de trabajo.
+ *
+ * @return Una referencia al grupo, o NULL si no se pudo crear.
+ */
+Auth_pool* Auth_New( unsigned workers, size_t queue, unsigned log_n )
+{
+   assert( queue > 0 );
+
+   if( workers == 0 )
+   {
+      long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+      workers = cpus > 0 ? ( unsigned ) cpus : 1;
+   }
+
+   Auth_pool* pool = ( Auth_pool* ) calloc( 1, sizeof( Auth_pool ) );
+   if( NULL == pool ) return NULL;
+
+   pool->queue = ( Auth_job** ) malloc( queue * sizeof( Auth_job* ) );
+   pool->workers = ( pthread_t* ) malloc( workers * sizeof( pthread_t ) );
+   if( NULL == pool->queue || NULL == pool->workers )
+   {
+      free( pool->queue );
+      free( pool->workers );
+      free( pool );
+      return NULL;
+   }
+
+   pool->cap = queue;
+   pool->running = true;
+   pool->log_n = log_n;
+   pthread_mutex_init( &pool->lock, NULL );
+   pthread_cond_init( &pool->not_empty, NULL );
+   pthread_cond_init( &pool->not_full, NULL );
+
+   for( ; pool->n_workers < workers; ++pool->n_workers )
+   {
+      if( pthread_create( &pool->workers[ pool->n_workers ], NULL, worker_main, pool ) != 0 ) break;
+   }
+   if( pool->n_workers == 0 )
+   {
+      Auth_Delete( &pool );
+      return NULL;
+   }
+
+   return pool;
+}
+
+/**
+ * @brief Termina las solicitudes pendientes, detiene los hilos y destruye el grupo.
+ *
+ * @param pool La dirección de una referencia al grupo.
+ */
+void Auth_Delete( Auth_pool** pool )
+{
+   assert( pool && *pool );
+   Auth_pool* p = *pool;
+
+   pthread_mutex_lock( &p->lock );
+   p->running = false;
+   pthread_cond_broadcast( &p->not_empty );
+   pthread_cond_broadcast( &p->not_full );
+   pthread_mutex_unlock( &p->lock );
+
+   for( unsigned i = 0; i < p->n_workers; ++i ) pthread_join( p->workers[ i ], NULL );
+
+   pthread_mutex_destroy( &p->lock );
+   pthread_cond_destroy( &p->not_empty );
+   pthread_cond_destroy( &p->not_full );
+   free( p->queue );
+   free( p->workers );
+   free( p );
+   *pool = NULL;
+}
+
+/**
+ * @brief Cambia el costo con el que se derivan las contraseñas nuevas. Las guardadas se
+ * siguen verificando con el costo con el que se derivaron.
+ *
+ * @param pool Referencia al grupo.
+ * @param log_n N = 2^log_n (@see Kdf_Scrypt).
+ */
+void Auth_SetCost( Auth_pool* pool, unsigned log_n )
+{
+   assert( pool );
+
+   pthread_mutex_lock( &pool->lock );
+   pool->log_n = log_n;
+   pthread_mutex_unlock( &pool->lock );
+}
+
+/**
+ * @brief Encola una solicitud sin esperar a que se procese. Si la cola está llena, espera
+ * a que haya lugar.
+ *
+ * @param pool Referencia al grupo.
+ * @param job La solicitud, con |op|, |password| y (para verificar) |hash| llenos.
+ *
+ * @return true si se encoló; false si el grupo se está destruyendo.
+ */
+bool Auth_Submit( Auth_pool* pool, Auth_job* job )
+{
+   assert( pool && job );
+
+   job->done = false;
+   job->result = false;
+   pthread_cond_init( &job->cond, NULL );
+
+   pthread_mutex_lock( &pool->lock );
+   while( pool->running && pool->count == pool->cap ) pthread_cond_wait( &pool->not_full, &pool->lock );
+   if( !pool->running )
+   {
+      pthread_mutex_unlock( &pool->lock );
+      pthread_cond_destroy( &job->cond );
+      return false;
+   }
+
+   job->submitted_ns = now_ns();
+   pool->queue[ ( pool->head + pool->count ) % pool->cap ] = job;
+   ++pool->count;
+   pthread_cond_signal( &pool->not_empty );
+   pthread_mutex_unlock( &pool->lock );
+
+   return true;
+}
+
+/**
+ * @brief Espera a que una solicitud encolada con @see Auth_Submit termine.
+ *
+ * @return El resultado de la solicitud (|job->result|).
+ */
+bool Auth_Wait( Auth_pool* pool, Auth_job* job )
+{
+   assert( pool && job );
+
+   pthread_mutex_lock( &pool->lock );
+   while( !job->done ) pthread_cond_wait( &job->cond, &pool->lock );
+   pthread_mutex_unlock( &pool->lock );
+
+   pthread_cond_destroy( &job->cond );
+   return job->result;
+}
+
+/**
+ * @brief Verifica una contraseña en el grupo y espera el resultado.
+ *
+ * @param pool Referencia al grupo.
+ * @param hash La llave guardada del usuario.
+ * @param password La contraseña en texto.
+ *
+ * @return true si la contraseña es correcta; false en caso contrario.
+ */
+bool Auth_Verify( Auth_pool* pool, const Kdf_hash* hash, const char* password )
+{
+   Auth_job job;
+   job.op = eAuth_VERIFY;
+   job.hash = *hash;
+   strncpy( job.password, password, AUTH_PW_MAX - 1 );
+   job.password[ AUTH_PW_MAX - 1 ] = '\0';
+
+   return Auth_Submit( pool, &job ) && Auth_Wait( pool, &job );
+}
+
+/**
+ * @brief Deriva la llave de una contraseña nueva en el grupo y espera el resultado.
+ *
+ * @param pool Referencia al grupo.
+ * @param hash Destino de la llave.
+ * @param password La contraseña en texto.
+ *
+ * @return true si la llave se derivó; false en caso contrario.
+ */
+bool Auth_Hash( Auth_pool* pool, Kdf_hash* hash, const char* password )
+{
+   Auth_job job;
+   job.op = eAuth_HASH;
+   strncpy( job.password, password, AUTH_PW_MAX - 1 );
+   job.password[ AUTH_PW_MAX - 1 ] = '\0';
+
+   bool ok = Auth_Submit( pool, &job ) && Auth_Wait( pool, &job );
+   if( ok ) *hash = job.hash;
+   return ok;
+}
+
+/**
+ * @brief Percentiles de la latencia de las verificaciones (desde que se envían hasta que
+ * terminan, incluyendo la espera en la cola).
+ *
+ * @param pool Referencia al grupo.
+ * @param p50_ms Devuelve la mediana en milisegundos.
+ * @param p99_ms Devuelve el percentil 99 en milisegundos.
+ * @param count Devuelve el número de verificaciones medidas; puede ser NULL.
+ */
+void Auth_Latency( Auth_pool* pool, double* p50_ms, double* p99_ms, uint64_t* count )
+{
+   assert( pool && p50_ms && p99_ms );
+
+   pthread_mutex_lock( &pool->lock );
+   uint64_t total = pool->samples;
+   uint64_t p50 = 0, p99 = 0, seen = 0;
+   for( size_t b = 0; b < AUTH_HIST_BUCKETS && total > 0; ++b )
+   {
+      seen += pool->hist[ b ];
+      if( p50 == 0 && seen * 100 >= total * 50 ) p50 = hist_value( b );
+      if( seen * 100 >= total * 99 )
+      {
+         p99 = hist_value( b );
+         break;
+      }
+   }
+   pthread_mutex_unlock( &pool->lock );
+
+   *p50_ms = p50 / 1e6;
+   *p99_ms = p99 / 1e6;
+   if( count ) *count = total;
+}
+
+/**
+ * @brief Imprime un renglón con las latencias de inicio de sesión.
+ */
+void Auth_Report( Auth_pool* pool, FILE* out )
+{
+   double p50, p99;
+   uint64_t count;
+   Auth_Latency( pool, &p50, &p99, &count );
+
+   fprintf( out, "logins: %llu  p50 %.1f ms  p99 %.1f ms  (%u workers, cost 2^%u)\n",
+            ( unsigned long long ) count, p50, p99, pool->n_workers, pool->log_n );
+}
@@ -0,0 +1,73 @@
+#ifndef  AUTH_INC
+#define  AUTH_INC
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "Kdf.h"
+
+#define AUTH_QUEUE 64           ///< Solicitudes que pueden esperar en la cola antes de bloquear a quien envía
+#define AUTH_PW_MAX 64          ///< Bytes máximos de una contraseña en texto (con el fin de cadena)
+#define AUTH_HIST_BUCKETS 512   ///< Cubetas del histograma de latencias (8 por potencia de 2)
+
+/**
+ * @brief Operaciones que puede hacer el grupo de hilos.
+ */
+typedef enum
+{
+  eAuth_VERIFY,   ///< Verificar |password| contra |hash|
+  eAuth_HASH,     ///< Derivar |hash| a partir de |password| con el costo actual
+} eAuthOp;
+
+/**
+ * @brief Una solicitud al grupo de hilos. La memoria es de quien la envía y debe seguir
+ * viva hasta @see Auth_Wait.
+ */
+typedef struct
+{
+  eAuthOp  op;
+  Kdf_hash hash;                    ///< Llave guardada (VERIFY) o resultado (HASH)
+  char     password[ AUTH_PW_MAX ]; ///< Se borra en cuanto se procesa
+  bool     result;                  ///< Contraseña correcta (VERIFY) o llave derivada (HASH)
+
+  bool     done;
+  uint64_t submitted_ns;
+  pthread_cond_t cond;              ///< Avisa a quien espera la solicitud
+} Auth_job;
+
+/**
+ * @brief Grupo de hilos que verifican y derivan contraseñas. Cada operación de la KDF es
+ * cara a propósito, así que se hace fuera del hilo que atiende al usuario y en paralelo
+ * con las de otros usuarios; la cola es acotada para que una avalancha de inicios de
+ * sesión frene a quien los envía en lugar de acumular memoria.
+ */
+typedef struct
+{
+  pthread_mutex_t lock;     ///< Protege todo lo que sigue
+  pthread_cond_t  not_empty;
+  pthread_cond_t  not_full;
+  Auth_job**      queue;    ///< Cola circular de solicitudes pendientes
+  size_t          cap;
+  size_t          head;
+  size_t          count;
+  bool            running;  ///< false para pedirle a los hilos que terminen
+  unsigned        log_n;    ///< Costo con el que se derivan las contraseñas nuevas
+
+  uint64_t        hist[ AUTH_HIST_BUCKETS ]; ///< Latencias de las verificaciones, de envío a respuesta
+  uint64_t        samples;
+
+  pthread_t*      workers;
+  unsigned        n_workers;
+} Auth_pool;
+
+Auth_pool* Auth_New( unsigned workers, size_t queue, unsigned log_n );
+void Auth_Delete( Auth_pool** pool );
+void Auth_SetCost( Auth_pool* pool, unsigned log_n );
+bool Auth_Submit( Auth_pool* pool, Auth_job* job );
+bool Auth_Wait( Auth_pool* pool, Auth_job* job );
+bool Auth_Verify( Auth_pool* pool, const Kdf_hash* hash, const char* password );
+bool Auth_Hash( Auth_pool* pool, Kdf_hash* hash, const char* password );
+void Auth_Latency( Auth_pool* pool, double* p50_ms, double* p99_ms, uint64_t* count );
+void Auth_Report( Auth_pool* pool, FILE* out );
+
+#endif   /* ----- #ifndef AUTH_INC  ----- */
@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+
+#include "Batch.h"
+
+/**
+ * Comandos, uno por línea; los campos se separan con espacios. Las líneas vacías y las que
+ * empiezan con # se ignoran. Cada comando escribe una línea que empieza con "ok <comando>"
+ * o con "err <comando> <motivo>" (@see Service_Error):
+ *
+ *   signup <nombre> <correo> <contraseña> <tarjeta>   -> ok signup
+ *   login <nombre> <contraseña>                        -> ok login
+ *   logout <nombre>                                    -> ok logout
+ *   quote <IATA> <IATA> [hora]                         -> ok quote <km> <minutos> <precio> <libres>
+ *   book <nombre> <IATA> <IATA> <pasajeros> [window|aisle|any] [hora]
+ *                                                      -> ok book <precio> <boleto>:<asiento> ...
+ *   cancel <nombre> <boleto>                           -> ok cancel
+ *
+ * Los clientes se nombran por su usuario: la corrida guarda la ficha que devolvió su login.
+ * La hora es un time_t; si no se da se usa la del reloj.
+ */
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Estado de una corrida.
+ */
+typedef struct
+{
+   Service*      svc;
+   FILE*         out;
+   Batch_session sessions[ BATCH_SESSIONS ];  ///< Tabla de dispersión con sondeo lineal
+   size_t        len;                         ///< Sesiones abiertas
+} Batch;
+
+/**
+ * @brief FNV-1a de 32 bits de un nombre, reducido a la tabla de sesiones.
+ */
+static size_t home_of( const char* name )
+{
+   uint32_t h = 2166136261u;
+   for( const unsigned char* p = ( const unsigned char* ) name; *p; ++p )
+   {
+      h ^= *p;
+      h *= 16777619u;
+   }
+   return h & ( BATCH_SESSIONS - 1 );
+}
+
+/**
+ * @brief Busca a |name| en las sesiones.
+ *
+ * @return Su lugar, o el lugar vacío donde iría.
+ */
+static size_t slot_of( const Batch* b, const char* name )
+{
+   size_t i = home_of( name );
+   while( b->sessions[ i ].name[ 0 ] != '\0' && strcmp( b->sessions[ i ].name, name ) != 0 )
+   {
+      i = ( i + 1 ) & ( BATCH_SESSIONS - 1 );
+   }
+   return i;
+}
+
+/**
+ * @brief Quita la sesión del lugar |i| y recorre hacia atrás las que quedaron lejos de su
+ * lugar de origen, para no dejar huecos en sus recorridos.
+ */
+static void forget( Batch* b, size_t i )
+{
+   size_t mask = BATCH_SESSIONS - 1;
+   for( size_t j = ( i + 1 ) & mask; b->sessions[ j ].name[ 0 ] != '\0'; j = ( j + 1 ) & mask )
+   {
+      size_t home = home_of( b->sessions[ j ].name );
+      // se mueve si su origen no está en el tramo circular ( i, j ]
+      if( ( ( j - home ) & mask ) >= ( ( j - i ) & mask ) )
+      {
+         b->sessions[ i ] = b->sessions[ j ];
+         i = j;
+      }
+   }
+   b->sessions[ i ].name[ 0 ] = '\0';
+   --b->len;
+}
+
+/**
+ * @brief La ficha del cliente |name|, o NULL si no tiene sesión en esta corrida.
+ */
+static const Session_token* token_of( const Batch* b, const char* name )
+{
+   if( NULL == name ) return NULL;
+   const Batch_session* s = &b->sessions[ slot_of( b, name ) ];
+   return s->name[ 0 ] != '\0' ? &s->token : NULL;
+}
+
+/**
+ * @brief La hora de un campo opcional: un time_t, o la del reloj si no se da.
+ */
+static time_t when_of( const char* field )
+{
+   return field ? ( time_t ) strtoll( field, NULL, 10 ) : time( NULL );
+}
+
+/**
+ * @brief Escribe la respuesta de un comando que no tiene más datos que su resultado.
+ *
+ * @return true si el resultado es eService_OK.
+ */
+static bool reply( Batch* b, const char* cmd, eServiceResult r )
+{
+   if( r == eService_OK ) fprintf( b->out, "ok %s\n", cmd );
+   else fprintf( b->out, "err %s %s\n", cmd, Service_Error( r ) );
+   return r == eService_OK;
+}
+
+static bool sign_up( Batch* b, char* f[] )
+{
+   if( !f[ 1 ] || !f[ 2 ] || !f[ 3 ] || !f[ 4 ] ) return reply( b, "signup", eService_BAD_REQUEST );
+   return reply( b, "signup", Service_SignUp( b->svc, f[ 1 ], f[ 2 ], f[ 3 ], strtol( f[ 4 ], NULL, 10 ) ) );
+}
+
+static bool log_in( Batch* b, char* f[] )
+{
+   if( !f[ 1 ] || !f[ 2 ] || strlen( f[ 1 ] ) >= HT_NAME_MAX ) return reply( b, "login", eService_BAD_REQUEST );
+
+   size_t i = slot_of( b, f[ 1 ] );
+   Batch_session* s = &b->sessions[ i ];
+   if( s->name[ 0 ] == '\0' && ( b->len + 1 ) * 10 > BATCH_SESSIONS * 7 ) return reply( b, "login", eService_NO_MEMORY );
+
+   Session_token token;
+   eServiceResult r = Service_LogIn( b->svc, f[ 1 ], f[ 2 ], &token );
+   if( r == eService_OK )
+   {
+      // un segundo login del mismo cliente reemplaza su sesión anterior
+      if( s->name[ 0 ] != '\0' ) Service_LogOut( b->svc, &s->token );
+      else ++b->len;
+      snprintf( s->name, sizeof( s->name ), "%s", f[ 1 ] );
+      s->token = token;
+   }
+   return reply( b, "login", r );
+}
+
+static bool log_out( Batch* b, char* f[] )
+{
+   const Session_token* token = token_of( b, f[ 1 ] );
+   if( NULL == token ) return reply( b, "logout", eService_DENIED );
+
+   eServiceResult r = Service_LogOut( b->svc, token );
+   forget( b, slot_of( b, f[ 1 ] ) );
+   return reply( b, "logout", r );
+}
+
+static bool quote( Batch* b, char* f[] )
+{
+   if( !f[ 1 ] || !f[ 2 ] ) return reply( b, "quote", eService_BAD_REQUEST );
+
+   Service_quote q;
+   eServiceResult r = Service_Quote( b->svc, f[ 1 ], f[ 2 ], when_of( f[ 3 ] ), &q );
+   if( r != eService_OK ) return reply( b, "quote", r );
+   fprintf( b->out, "ok quote %d %d %d %d\n", q.distance, q.minutes, q.price, q.available );
+   return true;
+}
+
+static bool book( Batch* b, char* f[] )
+{
+   if( !f[ 1 ] || !f[ 2 ] || !f[ 3 ] || !f[ 4 ] ) return reply( b, "book", eService_BAD_REQUEST );
+   const Session_token* token = token_of( b, f[ 1 ] );
+   Wallet* wallet = token ? Service_Acquire( b->svc, token ) : NULL;
+   if( NULL == wallet ) return reply( b, "book", eService_DENIED );
+
+   const Seat_layout* layout = &b->svc->seats->layout;
+   uint16_t pref = !f[ 5 ] ? 0 : strcmp( f[ 5 ], "window" ) == 0 ? layout->window :
+                   strcmp( f[ 5 ], "aisle" ) == 0 ? layout->aisle : 0;
+   time_t when = when_of( f[ 5 ] ? f[ 6 ] : NULL );
+   int pax = atoi( f[ 4 ] );
+
+   Service_quote q;
+   uint32_t handles[ SEATS_MAX_WIDTH ];
+   Seat_pos seats[ SEATS_MAX_WIDTH ];
+   eServiceResult r = Service_Quote( b->svc, f[ 2 ], f[ 3 ], when, &q );
+   if( r == eService_OK ) r = Service_Book( b->svc, wallet, &q, pax, pref, when, handles, seats );
+   if( r == eService_OK )
+   {
+      fprintf( b->out, "ok book %d", q.price );
+      for( int i = 0; i < pax; ++i )
+      {
+         fprintf( b->out, " %u:%u%c", ( unsigned ) handles[ i ], ( unsigned ) seats[ i ].row + 1, 'A' + seats[ i ].col );
+      }
+      fputc( '\n', b->out );
+   }
+   else reply( b, "book", r );
+   Service_Release( b->svc, wallet );
+   return r == eService_OK;
+}
+
+static bool cancel( Batch* b, char* f[] )
+{
+   if( !f[ 1 ] || !f[ 2 ] ) return reply( b, "cancel", eService_BAD_REQUEST );
+   const Session_token* token = token_of( b, f[ 1 ] );
+   Wallet* wallet = token ? Service_Acquire( b->svc, token ) : NULL;
+   if( NULL == wallet ) return reply( b, "cancel", eService_DENIED );
+
+   eServiceResult r = Service_Cancel( b->svc, wallet, ( uint32_t ) strtoul( f[ 2 ], NULL, 10 ), time( NULL ) );
+   Service_Release( b->svc, wallet );
+   return reply( b, "cancel", r );
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Ejecuta los comandos de |in| en orden (ver arriba) y escribe una respuesta por
+ * comando en |out|, sin pantallas ni preguntas; sirve para repetir bitácoras y medir
+ * cuántas operaciones se atienden por segundo. Las sesiones abiertas se cierran al final.
+ *
+ * @param svc El servicio.
+ * @param in Los comandos.
+ * @param out Las respuestas; conviene que tenga búfer completo (@see BATCH_BUFFER).
+ * @param stats Si no es NULL, recibe las cuentas de la corrida.
+ *
+ * @return false si no hubo memoria para la corrida o falló la escritura de |out|.
+ */
+bool Batch_Run( Service* svc, FILE* in, FILE* out, Batch_stats* stats )
+{
+   assert( svc && in && out );
+
+   Batch* b = ( Batch* ) calloc( 1, sizeof( Batch ) );
+   if( NULL == b ) return false;
+   b->svc = svc;
+   b->out = out;
+
+   struct timespec t0, t1;
+   clock_gettime( CLOCK_MONOTONIC, &t0 );
+   uint64_t commands = 0, failed = 0;
+   char line[ BATCH_LINE_MAX ];
+   while( fgets( line, sizeof( line ), in ) )
+   {
+      bool whole = strchr( line, '\n' ) || feof( in );
+      if( !whole )
+      {
+         // el resto de una línea demasiado larga no es otro comando
+         int c;
+         while( ( c = fgetc( in ) ) != EOF && c != '\n' );
+      }
+
+      char* f[ 8 ] = { NULL };
+      char* save = NULL;
+      size_t n = 0;
+      for( char* tok = strtok_r( line, " \t\r\n", &save ); tok && n < 8; tok = strtok_r( NULL, " \t\r\n", &save ) )
+      {
+         f[ n++ ] = tok;
+      }
+      if( n == 0 || f[ 0 ][ 0 ] == '#' ) continue;
+
+      ++commands;
+      bool ok;
+      if( !whole ) ok = reply( b, f[ 0 ], eService_BAD_REQUEST );
+      else if( strcmp( f[ 0 ], "signup" ) == 0 ) ok = sign_up( b, f );
+      else if( strcmp( f[ 0 ], "login" ) == 0 ) ok = log_in( b, f );
+      else if( strcmp( f[ 0 ], "logout" ) == 0 ) ok = log_out( b, f );
+      else if( strcmp( f[ 0 ], "quote" ) == 0 ) ok = quote( b, f );
+      else if( strcmp( f[ 0 ], "book" ) == 0 ) ok = book( b, f );
+      else if( strcmp( f[ 0 ], "cancel" ) == 0 ) ok = cancel( b, f );
+      else ok = reply( b, f[ 0 ], eService_BAD_REQUEST );
+      if( !ok ) ++failed;
+   }
+   clock_gettime( CLOCK_MONOTONIC, &t1 );
+
+   for( size_t i = 0; i < BATCH_SESSIONS; ++i )
+   {
+      if( b->sessions[ i ].name[ 0 ] != '\0' ) Service_LogOut( svc, &b->sessions[ i ].token );
+   }
+   free( b );
+
+   if( stats )
+   {
+      stats->commands = commands;
+      stats->failed = failed;
+      stats->seconds = ( t1.tv_sec - t0.tv_sec ) + ( t1.tv_nsec - t0.tv_nsec ) / 1e9;
+   }
+   return fflush( out ) == 0 && !ferror( out );
+}
@@ -0,0 +1,35 @@
+#ifndef  BATCH_INC
+#define  BATCH_INC
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "Service.h"
+
+#define BATCH_LINE_MAX 512        ///< Bytes máximos de un comando, con el salto de línea
+#define BATCH_SESSIONS 4096       ///< Clientes con sesión abierta a la vez (potencia de 2)
+#define BATCH_BUFFER ( 1 << 16 )  ///< Bytes del búfer de la salida
+
+/**
+ * @brief Sesión abierta por un comando login: el nombre del cliente y su ficha.
+ */
+typedef struct
+{
+  char          name[ HT_NAME_MAX ];  ///< "" si el lugar está vacío
+  Session_token token;
+} Batch_session;
+
+/**
+ * @brief Cuentas de una corrida.
+ */
+typedef struct
+{
+  uint64_t commands;    ///< Comandos leídos (sin líneas vacías ni comentarios)
+  uint64_t failed;      ///< Comandos que respondieron err
+  double   seconds;     ///< Tiempo de pared de la corrida
+} Batch_stats;
+
+bool Batch_Run( Service* svc, FILE* in, FILE* out, Batch_stats* stats );
+
+#endif   /* ----- #ifndef BATCH_INC  ----- */
@@ -1,79 +1,13 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <assert.h>
+#include <time.h>
 
 #include "Boleto.h"
 #include "Graph.h"
 #define INFINITE 99999
 
-/**
- * @brief La función "New_Ticket" crea un nuevo objeto de billete con el precio, la distancia, el 
- * tiempo, el aeropuerto de inicio y el aeropuerto de destino dados.
- * 
- * @param price El precio del billete.
- * @param distance El parámetro de distancia representa la distancia entre los aeropuertos de inicio y
- * fin en el billete.
- * @param time El parámetro "tiempo" representa la duración del vuelo en minutos.
- * @param start El aeropuerto de partida del billete. Es de tipo Aeropuerto* y contiene información
- * como el ID del aeropuerto, el código IATA, la ciudad, el nombre y la hora UTC.
- * @param end El parámetro "fin" es un puntero a una estructura de aeropuerto que representa el
- * aeropuerto de destino del billete.
- * 
- * @return un puntero a una estructura de Ticket.
- */
-Ticket* New_Ticket(int price, int distance, int time, Airport* start, Airport* end){
-  Ticket* tck = (Ticket*) malloc( sizeof(Ticket) );
-  if( tck )
-  {
-    Airport* start_copy = (Airport*) malloc( sizeof(Airport) );
-    if(start){
-      Airport* end_copy = (Airport*) malloc( sizeof(Airport) );
-      if(end){
-        end_copy->id = end->id;
-        strcpy(end_copy->iata_code, end->iata_code);
-        strcpy(end_copy->city, end->city);
-        strcpy(end_copy->name, end->name);
-        end_copy->utc_time = end->utc_time;
-
-        start_copy->id = start->id;
-        strcpy(start_copy->iata_code, start->iata_code);
-        strcpy(start_copy->city, start->city);
-        strcpy(start_copy->name, start->name);
-        end_copy->utc_time = start->utc_time;
-
-        tck->price = price;  
-        tck->distance = distance;
-        tck->time = time;
-      }
-      else{
-        free(start_copy);
-        free(tck);
-        tck = NULL;
-      }
-    }
-    else{
-      free(tck);
-      tck = NULL;
-    }
-  }
-  return tck;
-}
-
-/**
- * @brief La función "Delete_Ticket" libera la memoria asignada para un objeto de ticket y establece el
- * puntero del ticket en NULL.
- * 
- * @param ticket Un puntero a un objeto Ticket que debe eliminarse.
- */
-void Delete_Ticket( Ticket* ticket )
-{
-  assert( ticket );
-  free(ticket->start);
-  free(ticket->end);
-  free(ticket);
-  ticket = NULL;
-}
-
 /**
  * @brief La función "swapTickets" intercambia dos elementos en una matriz de punteros de Ticket.
  * 
@@ -91,35 +25,62 @@ void swapTickets(Ticket* tickets[], int index1, int index2) {
  * @brief La función TicketPrint imprime información sobre un billete, incluida la información del 
  * aeropuerto de salida y llegada, el tiempo del vuelo y el precio del billete.
  * 
+ * @param g El grafo de aeropuertos al que se refieren los índices del billete.
  * @param ticket Puntero a una estructura de ticket.
  */
-void TicketPrint(Ticket* ticket){
+void TicketPrint(const Graph* g, Ticket* ticket){
   if(ticket){
+    Airport* start = Graph_GetDataByIndex(g, ticket->start);
+    Airport* end = Graph_GetDataByIndex(g, ticket->end);
     printf("Departure airport information: \n");
-    printf("    - IATA: %s. Name: %s\n",ticket->start->iata_code,ticket->start->name);
+    printf("    - IATA: %s. Name: %s\n",start->iata_code,start->name);
     printf("Arrival airport: information\n");
-    printf("    - IATA: %s. Name: %s\n",ticket->end->iata_code,ticket->end->name);
+    printf("    - IATA: %s. Name: %s\n",end->iata_code,end->name);
+    if(ticket->seat.row != SEATS_NO_ROW){
+      printf("Seat: %u%c\n", (unsigned) ticket->seat.row + 1, 'A' + ticket->seat.col);
+    }
+    if(ticket->departure){
+      time_t salida = (time_t) ticket->departure;
+      char fecha[32];
+      strftime(fecha, sizeof(fecha), "%Y-%m-%d %H:%M", localtime(&salida));
+      printf("Departure: %s\n", fecha);
+    }
     printf("Flight time: %d minutes\n", ticket->time);
     printf("Ticket price: %d.00 MXN\n", ticket->price);
   }
 }
 
 /**
- * @brief La función "Wallet_New" crea una nueva billetera con una capacidad determinada.
- * 
- * @param capacity El parámetro de capacidad representa la cantidad máxima de boletos que puede
- * contener la billetera.
- * 
+ * @brief La función "Wallet_New" crea una nueva billetera con una capacidad inicial determinada.
+ * La billetera crece sola cuando se llena.
+ *
+ * @param capacity El parámetro de capacidad representa la cantidad de boletos para los que se
+ * reserva memoria al inicio.
+ *
  * @return un puntero a una estructura de Wallet recién creada.
  */
-Wallet* Wallet_New(int capacity){
-    Wallet* new = (Wallet*)malloc(sizeof(Wallet));
+Wallet* Wallet_New(size_t capacity){
+  Wallet* new = (Wallet*)malloc(sizeof(Wallet));
   if(new){
+    if(capacity == 0) capacity = 1;
     new->len = 0;
     new->capacity = capacity;
+    new->n_handles = 0;
+    new->free_head = WALLET_NO_TICKET;
+    new->owner[0] = '\0';
+    new->waits = NULL;
+    new->n_waits = 0;
+    new->cap_waits = 0;
     new->boletos = (Ticket*)malloc(capacity * sizeof(Ticket));
-    if(!new->boletos){
-      free(new);
+    new->handle_of = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    new->slot_of = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    bool ok = new->boletos && new->handle_of && new->slot_of;
+    for(int by = 0; by < WALLET_INDEXES; ++by){
+      new->index[by] = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+      ok = ok && new->index[by];
+    }
+    if(!ok){
+      Wallet_Delete(new);
       new = NULL;
     }
   }
@@ -127,71 +88,303 @@ Wallet* Wallet_New(int capacity){
 }
 
 /**
- * @brief La función Wallet_Delete libera la memoria asignada para una estructura Wallet y establece el
- * puntero en NULL.
- * 
+ * @brief La función Wallet_Delete libera la memoria asignada para una estructura Wallet y sus
+ * boletos.
+ *
  * @param wallet Un puntero a una estructura de Wallet.
  */
 void Wallet_Delete(Wallet* wallet){
   if(wallet){
     free(wallet->boletos);
+    free(wallet->handle_of);
+    free(wallet->slot_of);
+    for(int by = 0; by < WALLET_INDEXES; ++by) free(wallet->index[by]);
+    free(wallet->waits);
     free(wallet);
     wallet = NULL;
   }
 }
 
 /**
- * @brief  función Wallet_insert inserta un nuevo ticket en una billetera si no está llena.
- * 
+ * @brief Duplica la capacidad de la billetera. Los arreglos que ya crecieron se quedan
+ * con su nuevo tamaño aunque otro falle; la capacidad sólo cambia si crecieron todos.
+ *
+ * @return true si hubo memoria.
+ */
+static bool wallet_grow( Wallet* wallet )
+{
+  size_t capacity = wallet->capacity * 2;
+  if( capacity > WALLET_NO_TICKET ) capacity = WALLET_NO_TICKET;
+  if( capacity == wallet->capacity ) return false;
+
+  Ticket* boletos = (Ticket*) realloc( wallet->boletos, capacity * sizeof(Ticket) );
+  if( !boletos ) return false;
+  wallet->boletos = boletos;
+
+  uint32_t* handle_of = (uint32_t*) realloc( wallet->handle_of, capacity * sizeof(uint32_t) );
+  if( !handle_of ) return false;
+  wallet->handle_of = handle_of;
+
+  // Nunca hay más identificadores repartidos que boletos cabían, así que |slot_of|
+  // crece junto con los demás
+  uint32_t* slot_of = (uint32_t*) realloc( wallet->slot_of, capacity * sizeof(uint32_t) );
+  if( !slot_of ) return false;
+  wallet->slot_of = slot_of;
+
+  for(int by = 0; by < WALLET_INDEXES; ++by){
+    uint32_t* index = (uint32_t*) realloc( wallet->index[by], capacity * sizeof(uint32_t) );
+    if( !index ) return false;
+    wallet->index[by] = index;
+  }
+
+  wallet->capacity = capacity;
+  return true;
+}
+
+/**
+ * @brief La llave del boleto en el índice |by|.
+ */
+static int64_t ticket_key( const Ticket* tck, eWalletIndex by )
+{
+  switch( by ){
+    case eWalletBy_START:     return tck->start;
+    case eWalletBy_END:       return tck->end;
+    case eWalletBy_PRICE:     return tck->price;
+    case eWalletBy_DEPARTURE:
+    default:                  return tck->departure;
+  }
+}
+
+/**
+ * @brief Primera posición de los |n| elementos del índice |by| cuyo par (llave,
+ * identificador) no es menor que (|key|, |handle|).
+ */
+static size_t index_lower( const Wallet* wallet, eWalletIndex by, size_t n, int64_t key, uint32_t handle )
+{
+  const uint32_t* index = wallet->index[by];
+  size_t lo = 0, hi = n;
+  while( lo < hi ){
+    size_t mid = lo + ( hi - lo ) / 2;
+    uint32_t h = index[mid];
+    int64_t k = ticket_key( &wallet->boletos[ wallet->slot_of[h] ], by );
+    if( k < key || ( k == key && h < handle ) ) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * @brief Agrega el boleto |handle| a todos los índices, que tienen |n| elementos.
+ */
+static void index_insert( Wallet* wallet, uint32_t handle, const Ticket* tck, size_t n )
+{
+  for( int by = 0; by < WALLET_INDEXES; ++by ){
+    uint32_t* index = wallet->index[by];
+    size_t pos = index_lower( wallet, (eWalletIndex) by, n, ticket_key( tck, (eWalletIndex) by ), handle );
+    memmove( &index[pos + 1], &index[pos], ( n - pos ) * sizeof(uint32_t) );
+    index[pos] = handle;
+  }
+}
+
+/**
+ * @brief Quita el boleto |handle| de todos los índices, que tienen |n| elementos.
+ */
+static void index_remove( Wallet* wallet, uint32_t handle, const Ticket* tck, size_t n )
+{
+  for( int by = 0; by < WALLET_INDEXES; ++by ){
+    uint32_t* index = wallet->index[by];
+    size_t pos = index_lower( wallet, (eWalletIndex) by, n, ticket_key( tck, (eWalletIndex) by ), handle );
+    assert( pos < n && index[pos] == handle );
+    memmove( &index[pos], &index[pos + 1], ( n - pos - 1 ) * sizeof(uint32_t) );
+  }
+}
+
+/**
+ * @brief  función Wallet_insert agrega un nuevo ticket a la billetera; si está llena, la hace
+ * crecer al doble.
+ *
  * @param wallet Puntero a una estructura de Wallet.
  * @param price El precio del billete.
  * @param distance El parámetro de distancia representa la distancia del vuelo en kilómetros.
  * @param time El parámetro "tiempo" representa la duración del vuelo en minutos.
- * @param start El parámetro "inicio" es un puntero a un objeto Aeropuerto que representa el aeropuerto
- * inicial del billete.
- * @param end El parámetro "fin" es un puntero a un objeto Aeropuerto, que representa el aeropuerto de
- * destino del billete.
+ * @param start Índice en el grafo del vértice del aeropuerto inicial del billete.
+ * @param end Índice en el grafo del vértice del aeropuerto de destino del billete.
+ * @param seat Asiento del boleto; su fila es SEATS_NO_ROW si no tiene asiento asignado.
+ * @param departure Hora de salida (time_t).
+ *
+ * @return el identificador del boleto, que no cambia mientras el boleto exista, o
+ * WALLET_NO_TICKET si no hubo memoria.
  */
-void Wallet_insert(Wallet* wallet, int price, int distance, int time, Airport* start, Airport* end){
-  if(wallet){
-    if(!Wallet_IsFull(wallet)){
-      wallet->boletos[wallet->len] = *New_Ticket(price, distance, time, start, end);
-      wallet->len++;
-    }
+uint32_t Wallet_insert(Wallet* wallet, int price, int distance, int time, uint32_t start, uint32_t end, Seat_pos seat,
+                       int64_t departure){
+  assert( wallet );
+
+  if(Wallet_IsFull(wallet) && !wallet_grow(wallet)){
+    return WALLET_NO_TICKET;
+  }
+  size_t slot = wallet->len;
+  Ticket* tck = &wallet->boletos[slot];
+  tck->price = price;
+  tck->distance = distance;
+  tck->time = time;
+  tck->start = start;
+  tck->end = end;
+  tck->seat = seat;
+  tck->departure = departure;
+
+  uint32_t handle = wallet->free_head;
+  if(handle != WALLET_NO_TICKET){
+    wallet->free_head = wallet->slot_of[handle];
   }
+  else{
+    handle = wallet->n_handles++;
+  }
+  wallet->slot_of[handle] = slot;
+  wallet->handle_of[slot] = handle;
+  index_insert(wallet, handle, tck, wallet->len);
+  wallet->len++;
+  return handle;
 }
 
 /**
- * @brief La función Wallet_Pop elimina un boleto de una billetera y desplaza los boletos restantes para
- * llenar el espacio vacío.
- * 
+ * @brief La función Wallet_Pop elimina el boleto en la posición |index| de una billetera en
+ * tiempo constante: el último boleto pasa a ocupar su lugar, así que el orden de los boletos
+ * restantes puede cambiar. Los índices se actualizan en O(log n) comparaciones más el
+ * corrimiento de sus arreglos.
+ *
  * @param wallet Puntero a una estructura de Wallet.
  * @param index El parámetro de índice representa la posición del ticket en la billetera que debe
  * eliminarse.
  */
-void Wallet_Pop(Wallet* wallet, int index){
-  if(wallet){
-    if(Wallet_Len(wallet) > 0){
-      Ticket tmp = wallet->boletos[index];
-      //Recorrer los elementos para evitar espacios vacios entre boletos
-      for(size_t i = index; i < wallet->len; i++){
-        swapTickets(&wallet->boletos, i, i+1);
-      }
-        wallet->len--;
+void Wallet_Pop(Wallet* wallet, size_t index){
+  if(wallet && index < wallet->len){
+    uint32_t handle = wallet->handle_of[index];
+    index_remove(wallet, handle, &wallet->boletos[index], wallet->len);
+    size_t last = --wallet->len;
+    if(index != last){
+      wallet->boletos[index] = wallet->boletos[last];
+      wallet->handle_of[index] = wallet->handle_of[last];
+      wallet->slot_of[wallet->handle_of[index]] = index;
+    }
+    wallet->slot_of[handle] = wallet->free_head;
+    wallet->free_head = handle;
+  }
+}
+
+/**
+ * @brief Busca la posición actual del boleto con el identificador dado.
+ *
+ * @return la posición, o wallet->len si el identificador no corresponde a un boleto vigente.
+ */
+static size_t wallet_slot( Wallet* wallet, uint32_t handle )
+{
+  // Un identificador libre guarda en |slot_of| el siguiente libre; esa posición, si
+  // existe, tiene otro identificador en |handle_of|, así que no se confunde con uno vigente
+  if( handle < wallet->n_handles ){
+    size_t slot = wallet->slot_of[ handle ];
+    if( slot < wallet->len && wallet->handle_of[ slot ] == handle ) return slot;
+  }
+  return wallet->len;
+}
+
+/**
+ * @brief Cancela el boleto con el identificador dado (@see Wallet_Pop).
+ *
+ * @param wallet La billetera.
+ * @param handle El identificador que devolvió Wallet_insert.
+ *
+ * @return true si el boleto existía.
+ */
+bool Wallet_Remove(Wallet* wallet, uint32_t handle){
+  assert( wallet );
+
+  size_t slot = wallet_slot( wallet, handle );
+  if( slot == wallet->len ) return false;
+  Wallet_Pop( wallet, slot );
+  return true;
+}
+
+/**
+ * @brief Devuelve el boleto con el identificador dado.
+ *
+ * @param wallet La billetera.
+ * @param handle El identificador que devolvió Wallet_insert.
+ *
+ * @return el boleto, o NULL si ya no existe. El apuntador deja de ser válido al insertar
+ * o cancelar boletos.
+ */
+Ticket* Wallet_Get(Wallet* wallet, uint32_t handle){
+  assert( wallet );
+
+  size_t slot = wallet_slot( wallet, handle );
+  return slot < wallet->len ? &wallet->boletos[slot] : NULL;
+}
+
+/**
+ * @brief Anota que un pasajero de la billetera quedó en una lista de espera.
+ *
+ * @param wallet La billetera.
+ * @param place El lugar que devolvió Waitlist_Add.
+ * @param ticket El boleto que se le emitirá.
+ *
+ * @return false si no hubo memoria.
+ */
+bool Wallet_AddWait(Wallet* wallet, Waitlist_handle place, const Ticket* ticket){
+  assert( wallet && ticket );
+
+  if( wallet->n_waits == wallet->cap_waits ){
+    uint32_t capacity = wallet->cap_waits ? wallet->cap_waits * 2 : 4;
+    Wallet_wait* waits = (Wallet_wait*) realloc( wallet->waits, capacity * sizeof(Wallet_wait) );
+    if( !waits ) return false;
+    wallet->waits = waits;
+    wallet->cap_waits = capacity;
+  }
+  wallet->waits[ wallet->n_waits ].place = place;
+  wallet->waits[ wallet->n_waits ].ticket = *ticket;
+  wallet->n_waits++;
+  return true;
+}
+
+/**
+ * @brief Olvida un lugar en lista de espera de la billetera; el último ocupa su posición.
+ *
+ * @return true si la billetera lo tenía.
+ */
+bool Wallet_DropWait(Wallet* wallet, Waitlist_handle place){
+  assert( wallet );
+
+  for( uint32_t i = 0; i < wallet->n_waits; ++i ){
+    const Waitlist_handle* w = &wallet->waits[i].place;
+    if( w->flight == place.flight && w->slot == place.slot && w->gen == place.gen ){
+      wallet->waits[i] = wallet->waits[ --wallet->n_waits ];
+      return true;
     }
   }
+  return false;
+}
+
+/**
+ * @brief Devuelve el identificador del boleto en la posición |index|.
+ *
+ * @return el identificador, o WALLET_NO_TICKET si la posición está fuera de la billetera.
+ */
+uint32_t Wallet_Handle(Wallet* wallet, size_t index){
+  assert( wallet );
+
+  return index < wallet->len ? wallet->handle_of[index] : WALLET_NO_TICKET;
 }
 
 /**
  * @brief La función Wallet_Print imprime los detalles de los tickets almacenados en una billetera.
  * 
+ * @param g El grafo de aeropuertos de los boletos.
  * @param wallet Un puntero a una estructura de Wallet.
  */
-void Wallet_Print(Wallet* wallet){
+void Wallet_Print(const Graph* g, Wallet* wallet){
   if(Wallet_Len(wallet) > 0){
     for(size_t i = 0; i < Wallet_Len(wallet); i++){
-      printf("Ticket #1: \n");
-      TicketPrint(&wallet->boletos[i]);
+      printf("Ticket #%u: \n", (unsigned) wallet->handle_of[i]);
+      TicketPrint(g, &wallet->boletos[i]);
       printf("\n");
     }
     printf("-------------------------------------\n");
@@ -201,6 +394,64 @@ void Wallet_Print(Wallet* wallet){
   }
 }
 
+/**
+ * @brief Imprime los boletos de la billetera en el orden del índice |by| (p. ej. del más
+ * barato al más caro).
+ *
+ * @param g El grafo de aeropuertos de los boletos.
+ * @param wallet La billetera.
+ * @param by El índice que da el orden.
+ */
+void Wallet_PrintBy(const Graph* g, Wallet* wallet, eWalletIndex by){
+  const uint32_t* orden = Wallet_Sorted(wallet, by);
+  if(Wallet_Len(wallet) > 0){
+    for(size_t i = 0; i < Wallet_Len(wallet); i++){
+      printf("Ticket #%u: \n", (unsigned) orden[i]);
+      TicketPrint(g, Wallet_Get(wallet, orden[i]));
+      printf("\n");
+    }
+    printf("-------------------------------------\n");
+  }
+  else{
+    printf("Your wallet does not have yet a booked flight\n");
+  }
+}
+
+/**
+ * @brief Los identificadores de todos los boletos ordenados por la llave |by|.
+ *
+ * @return Wallet_Len( wallet ) identificadores; el arreglo deja de ser válido al insertar
+ * o cancelar boletos.
+ */
+const uint32_t* Wallet_Sorted(Wallet* wallet, eWalletIndex by){
+  assert( wallet );
+  assert( 0 <= by && by < WALLET_INDEXES );
+
+  return wallet->index[by];
+}
+
+/**
+ * @brief Busca en el índice |by| los boletos con llave entre |lo| y |hi| (ambas incluidas);
+ * p. ej. los que salen de un aeropuerto con lo = hi = su índice.
+ *
+ * @param wallet La billetera.
+ * @param by El índice.
+ * @param lo Llave mínima.
+ * @param hi Llave máxima.
+ * @param first Recibe la posición en Wallet_Sorted( wallet, by ) del primer boleto.
+ *
+ * @return El número de boletos, contiguos en Wallet_Sorted( wallet, by ) a partir de |first|.
+ */
+size_t Wallet_Range(Wallet* wallet, eWalletIndex by, int64_t lo, int64_t hi, size_t* first){
+  assert( wallet && first );
+  assert( 0 <= by && by < WALLET_INDEXES );
+
+  *first = index_lower( wallet, by, wallet->len, lo, 0 );
+  if( hi < lo ) return 0;
+  size_t end = index_lower( wallet, by, wallet->len, hi, WALLET_NO_TICKET );
+  return end - *first;
+}
+
 /**
  * @brief La función comprueba si una billetera está llena comparando su longitud con su capacidad.
  * 
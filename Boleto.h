@@ -1,34 +1,106 @@
 #ifndef  BOLETO_INC
 #define  BOLETO_INC
 #define TAM_MAX 16
+#define WALLET_NO_TICKET UINT32_MAX   ///< Identificador que no corresponde a ningún boleto
+#define WALLET_OWNER_MAX 64           ///< Bytes del nombre del dueño, con el fin de cadena (igual a HT_NAME_MAX)
+
+#include <stdint.h>
 
 #include "List.h"
 #include "Graph.h"
+#include "Seats.h"
 
+/**
+ * @brief Un boleto. Los aeropuertos se guardan como índices de vértice del grafo y se
+ * consultan en él sólo al imprimir.
+ */
 typedef struct{
   int price;
   int distance;
   int time;
-  Airport* start;
-  Airport* end;
+  uint32_t start;   ///< Índice del vértice del aeropuerto de salida
+  uint32_t end;     ///< Índice del vértice del aeropuerto de llegada
+  Seat_pos seat;    ///< Asiento asignado
+  int64_t departure;  ///< Hora de salida (time_t)
 } Ticket;
 
+/**
+ * @brief Identifica un lugar en la lista de espera de un vuelo (@see Waitlist_Add). Deja de
+ * ser válido cuando el cliente recibe su asiento o cancela; un identificador viejo nunca
+ * cancela a otro cliente. Se declara aquí porque cada billetera guarda los suyos.
+ */
+typedef struct{
+  int32_t  flight;
+  uint32_t slot;
+  uint32_t gen;
+} Waitlist_handle;
+
+/**
+ * @brief Un pasajero de la billetera que espera asiento: su lugar en la lista y el boleto
+ * que se le emitirá.
+ */
+typedef struct{
+  Waitlist_handle place;
+  Ticket ticket;      ///< Sin asiento todavía
+} Wallet_wait;
+
+/**
+ * @brief Índices secundarios de la billetera: cada uno guarda los identificadores de los
+ * boletos ordenados por una llave (y por identificador cuando la llave empata).
+ */
+typedef enum{
+  eWalletBy_START,       ///< Aeropuerto de salida (índice del vértice)
+  eWalletBy_END,         ///< Aeropuerto de llegada (índice del vértice)
+  eWalletBy_PRICE,       ///< Precio
+  eWalletBy_DEPARTURE,   ///< Hora de salida
+  WALLET_INDEXES
+} eWalletIndex;
+
+/**
+ * @brief Billetera de boletos que crece al doble cuando se llena. Los boletos se guardan
+ * contiguos en |boletos|; al cancelar uno, el último ocupa su lugar. Cada boleto tiene un
+ * identificador estable (su posición puede cambiar, el identificador no) y |slot_of|
+ * traduce identificadores a posiciones. Los identificadores libres se encadenan en
+ * |slot_of| a partir de |free_head| y se reutilizan.
+ *
+ * |index| mantiene, al insertar y cancelar, un arreglo ordenado de identificadores por cada
+ * eWalletIndex, para buscar por aeropuerto o recorrer por precio sin ordenar cada vez.
+ *
+ * |waits| guarda los lugares de la billetera en listas de espera, para poder dejarlas
+ * (@see Service_LeaveWaitlist); la lista quita el suyo cuando el pasajero recibe asiento.
+ */
 typedef struct{
-  int len;
-  int capacity;
+  size_t len;
+  size_t capacity;
   Ticket* boletos;
+  uint32_t* handle_of;  ///< Identificador del boleto en cada posición
+  uint32_t* slot_of;    ///< Posición de cada identificador, o el siguiente identificador libre
+  uint32_t n_handles;   ///< Identificadores repartidos alguna vez
+  uint32_t free_head;   ///< Primer identificador libre, o WALLET_NO_TICKET
+  uint32_t* index[ WALLET_INDEXES ];  ///< Identificadores ordenados por cada llave; |len| cada uno
+  char owner[ WALLET_OWNER_MAX ];  ///< Nombre del cliente dueño; "" si no tiene
+  Wallet_wait* waits;   ///< Pasajeros en listas de espera
+  uint32_t n_waits;
+  uint32_t cap_waits;
 } Wallet;
 
-Ticket* New_Ticket(int price, int distance, int time, Airport* start, Airport* end);
-void Delete_Ticket( Ticket* ticket );
 void swapTickets(Ticket* tickets[], int index1, int index2);
-void TicketPrint(Ticket* ticket);
+void TicketPrint(const Graph* g, Ticket* ticket);
 
-Wallet* Wallet_New(int capacity);
+Wallet* Wallet_New(size_t capacity);
 void Wallet_Delete(Wallet* wallet);
-void Wallet_insert(Wallet* wallet, int price, int distance, int time, Airport* start, Airport* end);
-void Wallet_Pop(Wallet* wallet, int index);
-void Wallet_Print(Wallet* wallet);
+uint32_t Wallet_insert(Wallet* wallet, int price, int distance, int time, uint32_t start, uint32_t end, Seat_pos seat,
+                       int64_t departure);
+void Wallet_Pop(Wallet* wallet, size_t index);
+bool Wallet_Remove(Wallet* wallet, uint32_t handle);
+Ticket* Wallet_Get(Wallet* wallet, uint32_t handle);
+uint32_t Wallet_Handle(Wallet* wallet, size_t index);
+void Wallet_Print(const Graph* g, Wallet* wallet);
+void Wallet_PrintBy(const Graph* g, Wallet* wallet, eWalletIndex by);
+const uint32_t* Wallet_Sorted(Wallet* wallet, eWalletIndex by);
+size_t Wallet_Range(Wallet* wallet, eWalletIndex by, int64_t lo, int64_t hi, size_t* first);
+bool Wallet_AddWait(Wallet* wallet, Waitlist_handle place, const Ticket* ticket);
+bool Wallet_DropWait(Wallet* wallet, Waitlist_handle place);
 bool Wallet_IsFull( Wallet* wallet );
 bool Wallet_IsEmpty( Wallet* wallet );
 size_t Wallet_Len( Wallet* wallet );
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "Bookings.h"
+#include "HT_Users.h"
+
+_Static_assert( WALLET_OWNER_MAX == HT_NAME_MAX, "el dueño de una billetera es un nombre de usuario" );
+_Static_assert( sizeof( Booking_record ) == WALLET_OWNER_MAX + 40, "Booking_record no debe tener relleno" );
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Lo que recibe replay(): la función del usuario y su argumento.
+ */
+typedef struct
+{
+   Booking_fn fn;
+   void*      ctx;
+} Replay_ctx;
+
+/**
+ * @brief Entrega a la función del usuario cada registro del diario durante la recuperación.
+ */
+static void replay( uint32_t type, uint64_t lsn, const void* payload, void* ctx )
+{
+   Replay_ctx* r = ( Replay_ctx* ) ctx;
+   if( !r->fn ) return;
+
+   Booking_record rec;
+   memcpy( &rec, payload, sizeof( rec ) );
+   rec.owner[ WALLET_OWNER_MAX - 1 ] = '\0';
+   r->fn( type, lsn, &rec, r->ctx );
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Abre el diario de boletos del directorio |dir| (lo crea si no existe) y entrega a
+ * |fn|, en orden, cada venta y cancelación registrada, para que quien lo abre reconstruya
+ * billeteras e inventario (@see Bookings_Restore).
+ *
+ * @param dir Directorio de los datos.
+ * @param fn Función que aplica cada registro; puede ser NULL.
+ * @param ctx Argumento de |fn|.
+ *
+ * @return Una referencia al diario, o NULL si no se pudo abrir.
+ */
+Booking_log* Bookings_Open( const char* dir, Booking_fn fn, void* ctx )
+{
+   assert( dir );
+   if( mkdir( dir, 0755 ) != 0 && errno != EEXIST ) return NULL;
+
+   Booking_log* bl = ( Booking_log* ) calloc( 1, sizeof( Booking_log ) );
+   if( NULL == bl ) return NULL;
+   bl->fd = -1;
+
+   size_t len = strlen( dir ) + sizeof( BOOKINGS_FILE ) + 1;
+   bl->log_path = ( char* ) malloc( len );
+   if( bl->log_path )
+   {
+      snprintf( bl->log_path, len, "%s/%s", dir, BOOKINGS_FILE );
+      // aun sin |fn| hay que recorrer el diario para seguir con su último LSN
+      Replay_ctx r = { .fn = fn, .ctx = ctx };
+      uint64_t end = Journal_Replay( bl->log_path, sizeof( Booking_record ), 0, replay, &r );
+      bl->log = Journal_Open( bl->log_path, sizeof( Booking_record ), end );
+      if( bl->log ) bl->fd = open( bl->log_path, O_RDONLY );
+   }
+
+   if( NULL == bl->log || bl->fd < 0 )
+   {
+      if( bl->log ) Journal_Close( &bl->log );
+      free( bl->log_path );
+      free( bl );
+      return NULL;
+   }
+   return bl;
+}
+
+/**
+ * @brief Espera a que todo lo anexado esté en disco y cierra el diario.
+ *
+ * @param bl La dirección de una referencia al diario; queda en NULL.
+ */
+void Bookings_Close( Booking_log** bl )
+{
+   assert( bl && *bl );
+   Booking_log* b = *bl;
+
+   Journal_Close( &b->log );
+   close( b->fd );
+   free( b->log_path );
+   free( b );
+   *bl = NULL;
+}
+
+/**
+ * @brief Anexa una venta o una cancelación. No espera a que llegue a disco: quien confirma
+ * varias operaciones a la vez anexa todas y espera sólo la última (@see Bookings_Wait).
+ *
+ * @param bl El diario.
+ * @param type BOOKING_SELL o BOOKING_CANCEL.
+ * @param owner Dueño de la billetera.
+ * @param ticket El boleto.
+ * @param handle Su identificador en la billetera.
+ * @param when Hora de la operación.
+ *
+ * @return El LSN del registro.
+ */
+uint64_t Bookings_Append( Booking_log* bl, uint32_t type, const char* owner, const Ticket* ticket,
+                          uint32_t handle, time_t when )
+{
+   assert( bl && owner && ticket );
+   assert( type == BOOKING_SELL || type == BOOKING_CANCEL );
+
+   Booking_record rec;
+   memset( &rec, 0, sizeof( rec ) );
+   strncpy( rec.owner, owner, WALLET_OWNER_MAX - 1 );
+   rec.stamp = ( int64_t ) when;
+   rec.price = ticket->price;
+   rec.distance = ticket->distance;
+   rec.minutes = ticket->time;
+   rec.start = ticket->start;
+   rec.end = ticket->end;
+   rec.handle = handle;
+   rec.row = ticket->seat.row;
+   rec.col = ticket->seat.col;
+   int64_t departure = ticket->departure - rec.stamp;
+   rec.departure = departure < INT32_MIN ? INT32_MIN : departure > INT32_MAX ? INT32_MAX : ( int32_t ) departure;
+   return Journal_Append( bl->log, type, &rec );
+}
+
+/**
+ * @brief Espera a que el registro |lsn| y todos los anteriores estén en disco.
+ *
+ * @return true si lo están; false si hubo un error de escritura.
+ */
+bool Bookings_Wait( Booking_log* bl, uint64_t lsn )
+{
+   assert( bl );
+
+   if( Journal_Wait( bl->log, lsn ) ) return true;
+   if( !bl->failed )
+   {
+      bl->failed = true;
+      fprintf( stderr, "%s: write failed, bookings are no longer durable\n", bl->log_path );
+   }
+   return false;
+}
+
+/**
+ * @brief Lee del disco un registro anexado antes; si aún no es durable, primero lo espera.
+ *
+ * @param bl El diario.
+ * @param lsn El LSN que devolvió Bookings_Append (o que se entregó al recuperar).
+ * @param type Recibe el tipo del registro.
+ * @param rec Recibe el registro.
+ *
+ * @return false si no se pudo leer o el registro no es válido.
+ */
+bool Bookings_Read( Booking_log* bl, uint64_t lsn, uint32_t* type, Booking_record* rec )
+{
+   assert( bl && type && rec );
+
+   if( !Journal_Wait( bl->log, lsn ) ) return false;
+
+   struct
+   {
+      Journal_header h;
+      Booking_record rec;
+   } buf;
+   _Static_assert( sizeof( buf ) == sizeof( Journal_header ) + sizeof( Booking_record ), "registro sin relleno" );
+
+   off_t at = ( off_t )( lsn * sizeof( buf ) );
+   if( pread( bl->fd, &buf, sizeof( buf ), at ) != ( ssize_t ) sizeof( buf ) ) return false;
+   uint32_t crc = Journal_Crc32c( 0, ( const char* ) &buf + sizeof( buf.h.crc ), sizeof( buf ) - sizeof( buf.h.crc ) );
+   if( crc != buf.h.crc || buf.h.lsn != lsn ) return false;
+
+   *type = buf.h.type;
+   *rec = buf.rec;
+   rec->owner[ WALLET_OWNER_MAX - 1 ] = '\0';
+   return true;
+}
+
+/**
+ * @brief Repite un registro sobre el inventario de asientos y, si se da, sobre la billetera
+ * de su dueño. Repetir los registros en orden deja ambos como estaban: una billetera que
+ * recibe las mismas altas y bajas reparte los mismos identificadores.
+ *
+ * @param type BOOKING_SELL o BOOKING_CANCEL.
+ * @param rec El registro.
+ * @param inv El inventario de asientos; puede ser NULL.
+ * @param wallet La billetera del dueño; puede ser NULL.
+ *
+ * @return false si el registro no concuerda con el estado (vuelo inexistente, asiento ya
+ * ocupado, identificador distinto); lo que sí pudo aplicarse queda aplicado.
+ */
+bool Bookings_Restore( uint32_t type, const Booking_record* rec, Seat_inventory* inv, Wallet* wallet )
+{
+   assert( rec );
+
+   int32_t flight = inv ? Seats_Flight( inv, ( int ) rec->start, ( int ) rec->end ) : 0;
+   if( flight < 0 ) return false;
+
+   Seat_pos seat = { .row = rec->row, .col = rec->col };
+   bool seated = rec->row != SEATS_NO_ROW;
+   bool ok = true;
+   if( type == BOOKING_SELL )
+   {
+      if( inv ) ok = Seats_Reserve( inv, flight, 1 );
+      if( inv && ok && seated ) ok = Seats_Take( inv, flight, &seat, 1 );
+      if( wallet )
+      {
+         uint32_t handle = Wallet_insert( wallet, rec->price, rec->distance, rec->minutes, rec->start, rec->end, seat,
+                                           rec->stamp + rec->departure );
+         ok = ok && handle == rec->handle;
+      }
+   }
+   else if( type == BOOKING_CANCEL )
+   {
+      if( wallet ) ok = Wallet_Remove( wallet, rec->handle );
+      if( inv && seated ) Seats_Unassign( inv, flight, &seat, 1 );
+      if( inv ) Seats_Release( inv, flight, 1 );
+   }
+   else ok = false;
+   return ok;
+}
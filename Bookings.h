@@ -0,0 +1,71 @@
+#ifndef  BOOKINGS_INC
+#define  BOOKINGS_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "Boleto.h"
+#include "Seats.h"
+#include "Journal.h"
+
+#define BOOKINGS_FILE "bookings.log"   ///< Nombre del diario dentro del directorio de datos
+
+/**
+ * @brief Tipos de registro del diario de boletos.
+ */
+enum
+{
+   BOOKING_SELL = 1,     ///< Se emitió un boleto
+   BOOKING_CANCEL = 2,   ///< Se canceló un boleto
+};
+
+/**
+ * @brief Un boleto tal como se guarda en el diario, sin relleno que dependa del compilador.
+ */
+typedef struct
+{
+  char     owner[ WALLET_OWNER_MAX ];  ///< Dueño de la billetera
+  int64_t  stamp;       ///< Hora de la operación (time_t)
+  int32_t  price;
+  int32_t  distance;
+  int32_t  minutes;
+  uint32_t start;       ///< Índice del vértice de salida
+  uint32_t end;         ///< Índice del vértice de llegada
+  uint32_t handle;      ///< Identificador del boleto en la billetera (@see Wallet_insert)
+  uint16_t row;         ///< Asiento; SEATS_NO_ROW si no tiene
+  uint16_t col;
+  int32_t  departure;   ///< Hora de salida menos |stamp|, en segundos; 0 en registros viejos
+} Booking_record;
+
+/**
+ * @brief Función que recibe cada registro durante la recuperación.
+ */
+typedef void (*Booking_fn)( uint32_t type, uint64_t lsn, const Booking_record* rec, void* ctx );
+
+/**
+ * @brief Diario de ventas y cancelaciones. Cada operación se anexa y se espera a que sea
+ * durable antes de confirmársela al cliente; los fsync se comparten entre todos los
+ * clientes que escriben a la vez (@see Journal).
+ *
+ * El diario nunca se vacía, así que el registro con LSN n está en el byte
+ * n * ( sizeof( Journal_header ) + sizeof( Booking_record ) ) del archivo.
+ */
+typedef struct
+{
+  Journal* log;         ///< Diario de boletos
+  char*    log_path;    ///< Ruta del diario
+  int      fd;          ///< Descriptor de sólo lectura para leer registros sueltos
+  bool     failed;      ///< Hubo un error de E/S; las operaciones ya no son durables
+} Booking_log;
+
+Booking_log* Bookings_Open( const char* dir, Booking_fn fn, void* ctx );
+void Bookings_Close( Booking_log** bl );
+uint64_t Bookings_Append( Booking_log* bl, uint32_t type, const char* owner, const Ticket* ticket,
+                          uint32_t handle, time_t when );
+bool Bookings_Wait( Booking_log* bl, uint64_t lsn );
+bool Bookings_Read( Booking_log* bl, uint64_t lsn, uint32_t* type, Booking_record* rec );
+bool Bookings_Restore( uint32_t type, const Booking_record* rec, Seat_inventory* inv, Wallet* wallet );
+
+#endif   /* ----- #ifndef BOOKINGS_INC  ----- */
@@ -0,0 +1,1054 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "CHT_Users.h"
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+static _Atomic bool slot_taken[ CHT_MAX_THREADS ];
+static pthread_key_t slot_key;
+static pthread_once_t slot_once = PTHREAD_ONCE_INIT;
+static _Thread_local int reader_slot = -1;   ///< -1: sin pedir; -2: no había ranuras libres
+
+/**
+ * @brief Devuelve la ranura de un hilo que termina (destructor de |slot_key|, que guarda
+ * la ranura más 1). Cuando el hilo termina ya no está leyendo: su época es 0 en todos
+ * los almacenes y la ranura se puede dar a otro hilo.
+ */
+static void release_slot( void* value )
+{
+   atomic_store( &slot_taken[ ( intptr_t ) value - 1 ], false );
+}
+
+static void create_slot_key( void )
+{
+   pthread_key_create( &slot_key, release_slot );
+}
+
+/**
+ * @brief Asigna (la primera vez) la ranura de época del hilo que llama. Las ranuras son
+ * las mismas para todos los almacenes y vuelven a estar libres cuando su hilo termina.
+ *
+ * @return El índice de la ranura, o -1 si hay CHT_MAX_THREADS hilos vivos con ranura.
+ */
+static int get_reader_slot( void )
+{
+   if( reader_slot == -1 )
+   {
+      pthread_once( &slot_once, create_slot_key );
+      reader_slot = -2;
+      for( int i = 0; i < CHT_MAX_THREADS; ++i )
+      {
+         if( !atomic_exchange( &slot_taken[ i ], true ) )
+         {
+            reader_slot = i;
+            pthread_setspecific( slot_key, ( void* )( intptr_t )( i + 1 ) );
+            break;
+         }
+      }
+   }
+   return reader_slot >= 0 ? reader_slot : -1;
+}
+
+/**
+ * @brief Avisa al procesador que estamos esperando activamente.
+ */
+static inline void cpu_relax( void )
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+   __builtin_ia32_pause();
+#endif
+}
+
+/**
+ * @brief Elige la franja de una llave (un nombre, o un correo para su candado de altas).
+ * Usa un hash con semilla propia para que la franja no dependa de los bits que cada
+ * tabla usa internamente.
+ */
+static CHT_Stripe* stripe_of( const Concurrent_table* ct, const char* key, size_t max )
+{
+   uint64_t h = HT_Hash_Wy( key, strnlen( key, max - 1 ), ct->seed );
+   return &ct->stripes[ ( h >> 32 ) & ( ct->n_stripes - 1 ) ];
+}
+
+/**
+ * @brief Libera los arreglos retirados que ningún lector activo puede estar usando: los
+ * desenganchados en una época anterior a la del lector activo más antiguo.
+ *
+ * @pre Se tiene |retire_lock|.
+ */
+static void reclaim( Concurrent_table* ct )
+{
+   uint64_t oldest = UINT64_MAX;
+   for( int i = 0; i < CHT_MAX_THREADS; ++i )
+   {
+      uint64_t e = atomic_load( &ct->readers[ i ].epoch );
+      if( e != 0 && e < oldest ) oldest = e;
+   }
+
+   size_t kept = 0;
+   for( size_t i = 0; i < ct->n_retired; ++i )
+   {
+      if( ct->retired[ i ].epoch < oldest ) free( ct->retired[ i ].block );
+      else ct->retired[ kept++ ] = ct->retired[ i ];
+   }
+   ct->n_retired = kept;
+}
+
+/**
+ * @brief Recibe un arreglo o una arena que una tabla de franja acaba de desenganchar
+ * (@see HT_SetRetire). Se anota con la época actual y la época global avanza; un lector
+ * que anuncie una época posterior ya no puede encontrar el bloque.
+ */
+static void retire( void* block, void* ctx )
+{
+   Concurrent_table* ct = ( Concurrent_table* ) ctx;
+
+   // el desenganche debe ser visible antes de leer las ranuras de los lectores
+   atomic_thread_fence( memory_order_seq_cst );
+   uint64_t epoch = atomic_fetch_add( &ct->epoch, 1 );
+
+   pthread_mutex_lock( &ct->retire_lock );
+   if( ct->n_retired == ct->cap_retired )
+   {
+      size_t cap = ct->cap_retired ? ct->cap_retired * 2 : 8;
+      CHT_Retired* tmp = ( CHT_Retired* ) realloc( ct->retired, cap * sizeof( CHT_Retired ) );
+      if( NULL == tmp )
+      {
+         // sin memoria para anotarlo: es preferible perder el bloque que liberarlo en uso
+         pthread_mutex_unlock( &ct->retire_lock );
+         return;
+      }
+      ct->retired = tmp;
+      ct->cap_retired = cap;
+   }
+   ct->retired[ ct->n_retired ].block = block;
+   ct->retired[ ct->n_retired ].epoch = epoch;
+   ++ct->n_retired;
+
+   reclaim( ct );
+   pthread_mutex_unlock( &ct->retire_lock );
+}
+
+/**
+ * @brief Empieza una escritura en la franja: toma su candado y deja el contador impar.
+ */
+static void write_begin( CHT_Stripe* st )
+{
+   pthread_mutex_lock( &st->lock );
+   unsigned seq = atomic_load_explicit( &st->seq, memory_order_relaxed );
+   atomic_store_explicit( &st->seq, seq + 1, memory_order_relaxed );
+   atomic_thread_fence( memory_order_release );
+}
+
+/**
+ * @brief Termina una escritura: deja el contador par de nuevo y suelta el candado.
+ */
+static void write_end( CHT_Stripe* st )
+{
+   unsigned seq = atomic_load_explicit( &st->seq, memory_order_relaxed );
+   atomic_store_explicit( &st->seq, seq + 1, memory_order_release );
+   pthread_mutex_unlock( &st->lock );
+}
+
+/**
+ * @brief Empieza una lectura sin candados: el hilo anuncia la época actual en su ranura
+ * para que los arreglos que recorra no se liberen.
+ *
+ * @return La ranura del hilo, o NULL si no tiene (entonces lee con los candados).
+ */
+static CHT_Reader* read_begin( Concurrent_table* ct )
+{
+   int slot = get_reader_slot();
+   if( slot < 0 ) return NULL;
+
+   CHT_Reader* reader = &ct->readers[ slot ];
+   atomic_store_explicit( &reader->epoch, atomic_load( &ct->epoch ), memory_order_relaxed );
+   atomic_thread_fence( memory_order_seq_cst );
+   return reader;
+}
+
+static void read_end( CHT_Reader* reader )
+{
+   if( reader ) atomic_store_explicit( &reader->epoch, 0, memory_order_release );
+}
+
+/**
+ * @brief Aplica una búsqueda de HT_* a una franja. Sin candados (|locked| en false) lee
+ * entre dos lecturas del contador de secuencia; si el contador era impar o cambió, la
+ * búsqueda pudo ver un estado a medias y se repite. Se busca sobre una copia para que
+ * |user| sólo reciba datos de una lectura válida (las búsquedas no tocan su llave).
+ *
+ * @param search Una búsqueda que tolere escrituras concurrentes (@see HT_SearchOptimistic).
+ * @param user Llave de búsqueda y, si se encontró, destino de los datos.
+ */
+static bool stripe_read( CHT_Stripe* st, bool locked, bool (*search)( const Hash_table*, Users* ), Users* user )
+{
+   Users copy = *user;
+   bool found;
+   if( locked )
+   {
+      pthread_mutex_lock( &st->lock );
+      found = search( st->ht, &copy );
+      pthread_mutex_unlock( &st->lock );
+   }
+   else
+   {
+      for( ;; )
+      {
+         unsigned seq = atomic_load_explicit( &st->seq, memory_order_acquire );
+         if( seq & 1 )
+         {
+            cpu_relax();
+            continue;
+         }
+
+         found = search( st->ht, &copy );
+
+         atomic_thread_fence( memory_order_acquire );
+         if( atomic_load_explicit( &st->seq, memory_order_relaxed ) == seq ) break;
+      }
+   }
+
+   if( found ) *user = copy;
+   return found;
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Crea un almacén de usuarios concurrente.
+ *
+ * @param capacity Número aproximado de usuarios esperados; se reparte entre las franjas.
+ * Las tablas crecen por sí solas si se rebasa.
+ * @param stripes Número de franjas; se redondea a la siguiente potencia de 2. Más franjas
+ * reducen la contención entre escritores.
+ *
+ * @return Una referencia al almacén, o NULL si no hubo memoria.
+ */
+Concurrent_table* CHT_New( size_t capacity, size_t stripes )
+{
+   size_t n = 1;
+   while( n < stripes ) n *= 2;
+
+   Concurrent_table* ct = ( Concurrent_table* ) calloc( 1, sizeof( Concurrent_table ) );
+   if( NULL == ct ) return NULL;
+
+   ct->stripes = ( CHT_Stripe* ) aligned_alloc( 64, n * sizeof( CHT_Stripe ) );
+   ct->readers = ( CHT_Reader* ) aligned_alloc( 64, CHT_MAX_THREADS * sizeof( CHT_Reader ) );
+   if( NULL == ct->stripes || NULL == ct->readers )
+   {
+      free( ct->stripes );
+      free( ct->readers );
+      free( ct );
+      return NULL;
+   }
+
+   ct->n_stripes = n;
+   ct->seed = HT_Hash_Wy( "cht", 3, ( uint64_t )( uintptr_t ) ct );
+   atomic_init( &ct->epoch, 1 );
+   pthread_mutex_init( &ct->retire_lock, NULL );
+
+   for( int i = 0; i < CHT_MAX_THREADS; ++i ) atomic_init( &ct->readers[ i ].epoch, 0 );
+
+   for( size_t i = 0; i < n; ++i )
+   {
+      CHT_Stripe* st = &ct->stripes[ i ];
+      atomic_init( &st->seq, 0 );
+      pthread_mutex_init( &st->lock, NULL );
+      pthread_mutex_init( &st->mail_lock, NULL );
+      st->ht = HT_New( capacity / n );
+      if( NULL == st->ht )
+      {
+         ct->n_stripes = i;
+         CHT_Delete( &ct );
+         return NULL;
+      }
+      HT_SetRetire( st->ht, retire, ct );
+   }
+
+   return ct;
+}
+
+/**
+ * @brief Destruye el almacén.
+ *
+ * @param ct La dirección de una referencia al almacén.
+ *
+ * @pre Ningún otro hilo está usando el almacén.
+ */
+void CHT_Delete( Concurrent_table** ct )
+{
+   assert( ct && *ct );
+   Concurrent_table* c = *ct;
+
+   for( size_t i = 0; i < c->n_stripes; ++i )
+   {
+      HT_Delete( &c->stripes[ i ].ht );
+      pthread_mutex_destroy( &c->stripes[ i ].lock );
+      pthread_mutex_destroy( &c->stripes[ i ].mail_lock );
+   }
+   for( size_t i = 0; i < c->n_retired; ++i ) free( c->retired[ i ].block );
+
+   pthread_mutex_destroy( &c->retire_lock );
+   free( c->retired );
+   free( c->stripes );
+   free( c->readers );
+   free( c );
+   *ct = NULL;
+}
+
+/**
+ * @brief Registra el escuchador de altas y bajas de todas las franjas (@see HT_SetLogger).
+ * Se llama con el candado de la franja tomado, así que el orden en que recibe los cambios
+ * de una misma franja es el orden en que se hicieron.
+ *
+ * @param ct Referencia al almacén.
+ * @param logger Recibe la operación, la llave y, en las altas, el registro; NULL para no
+ * notificar.
+ * @param ctx Argumento que se le pasa a |logger|.
+ */
+void CHT_SetLogger( Concurrent_table* ct, void (*logger)( int, const char*, const Users*, void* ), void* ctx )
+{
+   assert( ct );
+
+   for( size_t i = 0; i < ct->n_stripes; ++i )
+   {
+      CHT_Stripe* st = &ct->stripes[ i ];
+      pthread_mutex_lock( &st->lock );
+      HT_SetLogger( st->ht, logger, ctx );
+      pthread_mutex_unlock( &st->lock );
+   }
+}
+
+/**
+ * @brief Activa (o desactiva) el filtro de Bloom de todas las franjas (@see HT_SetBloom).
+ *
+ * @param ct Referencia al almacén.
+ * @param fpr Tasa de falsos positivos deseada; 0 para quitar el filtro.
+ *
+ * @return false si alguna franja no pudo cambiar su filtro (se queda como estaba); las
+ * demás sí lo cambian.
+ */
+bool CHT_SetBloom( Concurrent_table* ct, double fpr )
+{
+   assert( ct );
+
+   bool ok = true;
+   for( size_t i = 0; i < ct->n_stripes; ++i )
+   {
+      CHT_Stripe* st = &ct->stripes[ i ];
+      write_begin( st );
+      ok = HT_SetBloom( st->ht, fpr ) && ok;
+      write_end( st );
+   }
+   return ok;
+}
+
+/**
+ * @brief Inserta un usuario si ni su nombre ni su correo están registrados. Sólo bloquea
+ * a los escritores de la misma franja; los lectores de la franja repiten su búsqueda si
+ * coinciden con la escritura.
+ *
+ * El correo puede estar en cualquier franja (la franja la elige el nombre), así que las
+ * altas con el mismo correo se serializan con el |mail_lock| de la franja que elige el
+ * correo; se toma antes que el candado de la franja del nombre, siempre en ese orden.
+ * Las bajas no lo necesitan: a lo más hacen que un alta rechace un correo que se acaba
+ * de liberar.
+ *
+ * @param ct Referencia al almacén.
+ * @param user Usuario a registrar.
+ *
+ * @return true si se insertó; false si el nombre o el correo ya existían o no hubo
+ * memoria.
+ */
+bool CHT_Insert( Concurrent_table* ct, Users* user )
+{
+   assert( ct );
+
+   CHT_Stripe* ms = user->mail[ 0 ] ? stripe_of( ct, user->mail, HT_MAIL_MAX ) : NULL;
+   if( ms ) pthread_mutex_lock( &ms->mail_lock );
+
+   bool ret_val = false;
+   Users other;
+   memcpy( other.mail, user->mail, sizeof( other.mail ) );
+   if( NULL == ms || !CHT_SearchByMail( ct, &other ) )
+   {
+      CHT_Stripe* st = stripe_of( ct, user->name, HT_NAME_MAX );
+      write_begin( st );
+      ret_val = HT_Insert( st->ht, user );
+      write_end( st );
+   }
+
+   if( ms ) pthread_mutex_unlock( &ms->mail_lock );
+   return ret_val;
+}
+
+/**
+ * @brief Elimina un usuario.
+ *
+ * @param ct Referencia al almacén.
+ * @param name La llave del usuario.
+ *
+ * @return true si el usuario existía; false en caso contrario.
+ */
+bool CHT_Remove( Concurrent_table* ct, char* name )
+{
+   assert( ct );
+
+   CHT_Stripe* st = stripe_of( ct, name, HT_NAME_MAX );
+   write_begin( st );
+   bool ret_val = HT_Remove( st->ht, name );
+   write_end( st );
+
+   return ret_val;
+}
+
+/**
+ * @brief Busca un usuario sin tomar candados.
+ *
+ * El hilo anuncia la época en su ranura (para que los arreglos que recorre no se liberen)
+ * y lee la franja entre dos lecturas de su contador de secuencia; si el contador era impar
+ * o cambió, la lectura pudo ver un estado a medias y se repite.
+ *
+ * @param ct Referencia al almacén.
+ * @param user Llave de búsqueda y destino de los datos del usuario.
+ *
+ * @return true si el usuario existe; false en caso contrario.
+ */
+bool CHT_Search( Concurrent_table* ct, Users* user )
+{
+   assert( ct );
+
+   CHT_Stripe* st = stripe_of( ct, user->name, HT_NAME_MAX );
+   CHT_Reader* reader = read_begin( ct );
+   bool found = stripe_read( st, NULL == reader, HT_SearchOptimistic, user );
+   read_end( reader );
+
+   return found;
+}
+
+/**
+ * @brief Busca un usuario por su correo sin tomar candados (@see HT_SearchByMail). El
+ * correo no decide la franja, así que se busca en todas: cuesta una búsqueda por franja y
+ * sólo la usan las altas, no los inicios de sesión.
+ *
+ * @param ct Referencia al almacén.
+ * @param user El campo |mail| es la llave; si hay un usuario con ese correo, el resto de
+ * los campos se llenan con sus datos.
+ *
+ * @return true si algún usuario tiene ese correo; false en caso contrario.
+ */
+bool CHT_SearchByMail( Concurrent_table* ct, Users* user )
+{
+   assert( ct );
+
+   CHT_Reader* reader = read_begin( ct );
+   bool found = false;
+   for( size_t i = 0; i < ct->n_stripes && !found; ++i )
+   {
+      found = stripe_read( &ct->stripes[ i ], NULL == reader, HT_SearchByMail, user );
+   }
+   read_end( reader );
+
+   return found;
+}
+
+/**
+ * @brief Número de usuarios registrados. Con escritores activos el valor es aproximado.
+ *
+ * @param ct Referencia al almacén.
+ *
+ * @return La suma de los elementos de todas las franjas.
+ */
+size_t CHT_Len( Concurrent_table* ct )
+{
+   size_t len = 0;
+   for( size_t i = 0; i < ct->n_stripes; ++i )
+   {
+      len += __atomic_load_n( &ct->stripes[ i ].ht->len, __ATOMIC_RELAXED );
+   }
+   return len;
+}
+
+/**
+ * @brief Recorre las franjas una por una con su candado tomado, así que cada tabla que
+ * recibe |fn| está quieta mientras la recorre (las demás siguen aceptando cambios).
+ *
+ * @param ct Referencia al almacén.
+ * @param fn Recibe la tabla de cada franja; devuelve false para detener el recorrido.
+ * @param ctx Argumento que se le pasa a |fn|.
+ *
+ * @return true si se recorrieron todas las franjas; false si |fn| lo detuvo.
+ */
+bool CHT_Scan( Concurrent_table* ct, bool (*fn)( const Hash_table*, void* ), void* ctx )
+{
+   assert( ct && fn );
+
+   bool ok = true;
+   for( size_t i = 0; i < ct->n_stripes && ok; ++i )
+   {
+      CHT_Stripe* st = &ct->stripes[ i ];
+      pthread_mutex_lock( &st->lock );
+      ok = fn( st->ht, ctx );
+      pthread_mutex_unlock( &st->lock );
+   }
+   return ok;
+}
+
+/**
+ * @brief Trabajo de CHT_BulkInsert: los usuarios agrupados por franja y lo que reparte
+ * las franjas entre los hilos.
+ */
+typedef struct
+{
+   Concurrent_table* ct;
+   Users*   parts;          ///< Los usuarios, agrupados por franja
+   size_t*  begin;          ///< La franja i tiene parts[ begin[ i ] .. begin[ i + 1 ] )
+   size_t*  origin;         ///< parts[ k ] es users[ origin[ k ] ]
+   bool*    dup;            ///< dup[ i ]: users[ i ] no se insertó
+   _Atomic size_t next;     ///< Siguiente franja sin tomar
+   _Atomic size_t inserted;
+} cht_bulk;
+
+static void mark_dup( const Users* user, void* ctx )
+{
+   cht_bulk* job = ( cht_bulk* ) ctx;
+   job->dup[ job->origin[ user - job->parts ] ] = true;
+}
+
+static void* bulk_main( void* arg )
+{
+   cht_bulk* job = ( cht_bulk* ) arg;
+   for( size_t i; ( i = atomic_fetch_add( &job->next, 1 ) ) < job->ct->n_stripes; )
+   {
+      CHT_Stripe* st = &job->ct->stripes[ i ];
+      size_t n = job->begin[ i + 1 ] - job->begin[ i ];
+      if( n == 0 ) continue;
+
+      write_begin( st );
+      size_t k = HT_BulkInsert( st->ht, job->parts + job->begin[ i ], n, 1, mark_dup, job );
+      write_end( st );
+      atomic_fetch_add( &job->inserted, k );
+   }
+   return NULL;
+}
+
+/**
+ * @brief Inserta muchos usuarios a la vez: los agrupa por franja y cada franja se llena
+ * con @see HT_BulkInsert con su candado tomado. Las franjas se reparten entre un hilo por
+ * procesador. No revisa que los correos sean únicos (como HT_BulkInsert); sirve para
+ * cargar usuarios que ya lo cumplen.
+ *
+ * @param ct Referencia al almacén.
+ * @param users Los usuarios.
+ * @param n Número de usuarios.
+ * @param dup Recibe, en el orden de entrada, cada usuario que no se insertó porque su
+ * nombre ya existía; puede ser NULL.
+ * @param ctx Argumento que se le pasa a |dup|.
+ *
+ * @return El número de usuarios insertados.
+ */
+size_t CHT_BulkInsert( Concurrent_table* ct, const Users* users, size_t n,
+                       void (*dup)( const Users*, void* ), void* ctx )
+{
+   assert( ct );
+
+   if( n == 0 ) return 0;
+
+   cht_bulk job = { .ct = ct };
+   job.parts = ( Users* ) malloc( n * sizeof( Users ) );
+   job.begin = ( size_t* ) calloc( ct->n_stripes + 1, sizeof( size_t ) );
+   job.origin = ( size_t* ) malloc( n * sizeof( size_t ) );
+   job.dup = ( bool* ) calloc( n, sizeof( bool ) );
+   uint32_t* stripe = ( uint32_t* ) malloc( n * sizeof( uint32_t ) );
+   size_t* at = ( size_t* ) malloc( ct->n_stripes * sizeof( size_t ) );
+   if( !job.parts || !job.begin || !job.origin || !job.dup || !stripe || !at )
+   {
+      // sin memoria para agruparlos, uno por uno
+      free( job.parts );
+      free( job.begin );
+      free( job.origin );
+      free( job.dup );
+      free( stripe );
+      free( at );
+      size_t inserted = 0;
+      for( size_t i = 0; i < n; ++i )
+      {
+         CHT_Stripe* st = stripe_of( ct, users[ i ].name, HT_NAME_MAX );
+         write_begin( st );
+         bool ok = HT_Insert( st->ht, ( Users* ) &users[ i ] );
+         write_end( st );
+         if( ok ) ++inserted;
+         else if( dup ) dup( &users[ i ], ctx );
+      }
+      return inserted;
+   }
+
+   for( size_t i = 0; i < n; ++i )
+   {
+      stripe[ i ] = ( uint32_t )( stripe_of( ct, users[ i ].name, HT_NAME_MAX ) - ct->stripes );
+      ++job.begin[ stripe[ i ] + 1 ];
+   }
+   for( size_t i = 0; i < ct->n_stripes; ++i ) job.begin[ i + 1 ] += job.begin[ i ];
+   memcpy( at, job.begin, ct->n_stripes * sizeof( size_t ) );
+   for( size_t i = 0; i < n; ++i )
+   {
+      size_t k = at[ stripe[ i ] ]++;
+      job.parts[ k ] = users[ i ];
+      job.origin[ k ] = i;
+   }
+   free( stripe );
+   free( at );
+   atomic_init( &job.next, 0 );
+   atomic_init( &job.inserted, 0 );
+
+   long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+   size_t threads = cpus > 1 ? ( size_t ) cpus : 1;
+   if( threads > ct->n_stripes ) threads = ct->n_stripes;
+
+   pthread_t tid[ threads ];
+   size_t started = 1;
+   while( started < threads && pthread_create( &tid[ started ], NULL, bulk_main, &job ) == 0 ) ++started;
+   bulk_main( &job );
+   for( size_t t = 1; t < started; ++t ) pthread_join( tid[ t ], NULL );
+
+   for( size_t i = 0; dup && i < n; ++i )
+   {
+      if( job.dup[ i ] ) dup( &users[ i ], ctx );
+   }
+
+   free( job.parts );
+   free( job.begin );
+   free( job.origin );
+   free( job.dup );
+   return atomic_load( &job.inserted );
+}
+
+/**
+ * @brief Lee usuarios de un archivo (@see HT_ReadUsers) y los inserta con
+ * @see CHT_BulkInsert.
+ *
+ * @param ct Referencia al almacén.
+ * @param f Archivo abierto para lectura.
+ * @param pool Grupo de hilos que deriva las contraseñas.
+ * @param dup Recibe cada usuario que no se insertó por estar duplicado; puede ser NULL.
+ * @param ctx Argumento que se le pasa a |dup|.
+ * @param read Devuelve el número de usuarios leídos; puede ser NULL.
+ *
+ * @return El número de usuarios insertados.
+ */
+size_t CHT_BulkInsertFile( Concurrent_table* ct, FILE* f, Auth_pool* pool,
+                           void (*dup)( const Users*, void* ), void* ctx, size_t* read )
+{
+   assert( ct && f && pool );
+
+   size_t n;
+   Users* users = HT_ReadUsers( f, pool, &n );
+   size_t inserted = CHT_BulkInsert( ct, users, n, dup, ctx );
+   free( users );
+
+   if( read ) *read = n;
+   return inserted;
+}
+
+
+//----------------------------------------------------------------------
+//                     Prueba de esfuerzo
+//----------------------------------------------------------------------
+
+enum { STRESS_WRITERS = 2 };
+
+/**
+ * @brief Estado compartido de una ronda de CHT_StressReport.
+ */
+typedef struct
+{
+   Concurrent_table* ct;
+   _Atomic bool     stop;
+   _Atomic uint64_t lookups;
+   _Atomic uint64_t writes;
+   _Atomic uint64_t errors;
+   uint64_t         window[ STRESS_WRITERS ];   ///< Usuarios que quedaron de cada escritor
+} stress_round;
+
+typedef struct
+{
+   stress_round* round;
+   unsigned      id;
+} stress_thread;
+
+static void stress_user( Users* user, const char* prefix, unsigned w, uint64_t i )
+{
+   memset( user, 0, sizeof( *user ) );
+   snprintf( user->name, sizeof( user->name ), "%s%u-%llu\n", prefix, w, ( unsigned long long ) i );
+   snprintf( user->mail, sizeof( user->mail ), "%s%u-%llu@skynet.mx\n", prefix, w, ( unsigned long long ) i );
+   user->credit_card = ( long int ) i;
+   user->state = USED_CELL;
+}
+
+/**
+ * @brief Un lector: busca usuarios fijos al azar (y de vez en cuando por su correo) y
+ * revisa que los datos sean los de ese usuario y no los de una lectura a medias.
+ */
+static void* stress_reader( void* arg )
+{
+   stress_thread* t = ( stress_thread* ) arg;
+   stress_round* r = t->round;
+   uint64_t x = 0x9E3779B97F4A7C15ull * ( t->id + 1 ), lookups = 0, errors = 0;
+
+   while( !atomic_load_explicit( &r->stop, memory_order_relaxed ) )
+   {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      uint64_t i = x % CHT_STRESS_USERS;
+
+      Users want, got;
+      stress_user( &want, "s", 0, i );
+      got = want;
+      bool ok;
+      if( ( x >> 40 ) % 64 == 0 )
+      {
+         memset( got.name, 0, sizeof( got.name ) );
+         ok = CHT_SearchByMail( r->ct, &got ) && strcmp( got.name, want.name ) == 0;
+      }
+      else
+      {
+         memset( got.mail, 0, sizeof( got.mail ) );
+         ok = CHT_Search( r->ct, &got ) && strcmp( got.mail, want.mail ) == 0;
+      }
+      if( !ok || got.credit_card != want.credit_card ) ++errors;
+      ++lookups;
+   }
+
+   atomic_fetch_add( &r->lookups, lookups );
+   atomic_fetch_add( &r->errors, errors );
+   return NULL;
+}
+
+/**
+ * @brief Un escritor: da de alta usuarios nuevos y da de baja el que entró
+ * CHT_STRESS_WINDOW altas antes, y revisa que cada cambio se vea en cuanto termina.
+ */
+static void* stress_writer( void* arg )
+{
+   stress_thread* t = ( stress_thread* ) arg;
+   stress_round* r = t->round;
+   uint64_t i = 0, errors = 0;
+
+   for( ; !atomic_load_explicit( &r->stop, memory_order_relaxed ); ++i )
+   {
+      Users user, got;
+      stress_user( &user, "w", t->id, i );
+      got = user;
+      if( !CHT_Insert( r->ct, &user ) || !CHT_Search( r->ct, &got ) || got.credit_card != ( long int ) i ) ++errors;
+
+      if( i >= CHT_STRESS_WINDOW )
+      {
+         stress_user( &user, "w", t->id, i - CHT_STRESS_WINDOW );
+         if( !CHT_Remove( r->ct, user.name ) || CHT_Search( r->ct, &user ) ) ++errors;
+      }
+   }
+
+   r->window[ t->id ] = i < CHT_STRESS_WINDOW ? i : CHT_STRESS_WINDOW;
+   atomic_fetch_add( &r->writes, i + ( i > CHT_STRESS_WINDOW ? i - CHT_STRESS_WINDOW : 0 ) );
+   atomic_fetch_add( &r->errors, errors );
+   return NULL;
+}
+
+/**
+ * @brief Prueba el almacén con lectores y escritores a la vez: por cada número de hilos
+ * lectores (1, 2, 4, ... hasta |max_readers|) llena un almacén con CHT_STRESS_USERS
+ * usuarios fijos y, durante |seconds| segundos, los lectores los buscan mientras dos
+ * escritores dan de alta y de baja otros usuarios en las mismas franjas. Cuenta como
+ * error cualquier búsqueda que no devuelva los datos esperados y, al final, un número de
+ * usuarios distinto del esperado.
+ *
+ * @param max_readers Máximo de hilos lectores.
+ * @param seconds Duración de cada ronda.
+ * @param out Destino del reporte: una línea por ronda con búsquedas y cambios por segundo.
+ *
+ * @return true si ninguna ronda tuvo errores; false si los hubo o no hubo memoria.
+ */
+bool CHT_StressReport( unsigned max_readers, double seconds, FILE* out )
+{
+   assert( out && max_readers > 0 && seconds > 0 );
+
+   Users* fixed = ( Users* ) malloc( CHT_STRESS_USERS * sizeof( Users ) );
+   if( NULL == fixed ) return false;
+   for( uint64_t i = 0; i < CHT_STRESS_USERS; ++i ) stress_user( &fixed[ i ], "s", 0, i );
+
+   fprintf( out, "%8s %14s %12s %8s\n", "readers", "lookups/s", "writes/s", "errors" );
+
+   bool ok = true;
+   for( unsigned readers = 1; readers <= max_readers; readers *= 2 )
+   {
+      stress_round r = { .ct = CHT_New( CHT_STRESS_USERS + STRESS_WRITERS * CHT_STRESS_WINDOW, CHT_STRIPES ) };
+      if( NULL == r.ct || CHT_BulkInsert( r.ct, fixed, CHT_STRESS_USERS, NULL, NULL ) != CHT_STRESS_USERS )
+      {
+         if( r.ct ) CHT_Delete( &r.ct );
+         ok = false;
+         break;
+      }
+
+      unsigned n = readers + STRESS_WRITERS;
+      pthread_t tid[ n ];
+      stress_thread arg[ n ];
+      unsigned started = 0;
+      struct timespec t0, t1;
+      clock_gettime( CLOCK_MONOTONIC, &t0 );
+      for( ; started < n; ++started )
+      {
+         arg[ started ].round = &r;
+         arg[ started ].id = started < STRESS_WRITERS ? started : started - STRESS_WRITERS;
+         if( pthread_create( &tid[ started ], NULL, started < STRESS_WRITERS ? stress_writer : stress_reader,
+                             &arg[ started ] ) != 0 ) break;
+      }
+
+      struct timespec pause = { ( time_t ) seconds, ( long )( ( seconds - ( time_t ) seconds ) * 1e9 ) };
+      if( started == n ) nanosleep( &pause, NULL );
+      atomic_store( &r.stop, true );
+      for( unsigned t = 0; t < started; ++t ) pthread_join( tid[ t ], NULL );
+      clock_gettime( CLOCK_MONOTONIC, &t1 );
+
+      size_t expected = CHT_STRESS_USERS;
+      for( unsigned w = 0; w < STRESS_WRITERS && w < started; ++w ) expected += r.window[ w ];
+      if( CHT_Len( r.ct ) != expected ) atomic_fetch_add( &r.errors, 1 );
+      CHT_Delete( &r.ct );
+
+      double secs = ( t1.tv_sec - t0.tv_sec ) + ( t1.tv_nsec - t0.tv_nsec ) / 1e9;
+      uint64_t errors = atomic_load( &r.errors );
+      fprintf( out, "%8u %14.0f %12.0f %8llu\n", readers, atomic_load( &r.lookups ) / secs,
+               atomic_load( &r.writes ) / secs, ( unsigned long long ) errors );
+      if( started < n || errors > 0 ) ok = false;
+      if( started < n ) break;
+   }
+
+   free( fixed );
+   return ok;
+}
+
+
+//----------------------------------------------------------------------
+//            Funciones de la interfaz de Usuario
+//----------------------------------------------------------------------
+
+static bool show_stripe( const Hash_table* ht, void* ctx )
+{
+   size_t* shown = ( size_t* ) ctx;
+
+   // durante un rehash incremental los usuarios están repartidos en ambas tablas
+   size_t cap = ht->table->capacity;
+   size_t total = cap + ( ht->old_table ? ht->old_table->capacity : 0 );
+   for( size_t i = 0; i < total; ++i )
+   {
+      const HT_Array* a = i < cap ? ht->table : ht->old_table;
+      size_t idx = i < cap ? i : i - cap;
+      if( !( a->ctrl[ idx ] & 0x80 ) )
+      {
+         const HT_Slot* u = &a->slots[ idx ];
+         printf( "\n[%02zu]   Name: %s"
+                 "       Mail: %s"
+                 "   Password: ****\n"
+                 "Credit Card: ************%04ld\n",
+                 ( *shown )++, a->arena->data + u->name.offset, a->arena->data + u->mail.offset,
+                 ( long ) u->credit_card % 10000 );
+      }
+   }
+   return true;
+}
+
+/**
+ * @brief Muestra los usuarios registrados en ese momento.
+ *
+ * @param ct Referencia al almacén de usuarios.
+ */
+void Show_Users( Concurrent_table* ct )
+{
+   assert( ct );
+   if( CHT_Len( ct ) == 0 )
+   {
+      fprintf( stderr, "No registered user." );
+   }
+   else
+   {
+      fprintf( stderr, "\t------- REGISTERED USERS -------" );
+      size_t shown = 0;
+      CHT_Scan( ct, show_stripe, &shown );
+   }
+}
+
+/**
+ * @brief Elimina un usuario.
+ *
+ * @param ct Referencia al almacén de usuarios.
+ */
+void Delete_Account( Concurrent_table* ct )
+{
+   getchar();
+   assert( ct );
+
+   Show_Users( ct );
+   Users user;
+   if( CHT_Len( ct ) == 0 )
+   {
+      fprintf( stderr, "There are no registered users" );
+      return;
+   }
+
+   bool search = false;
+   while( search != true )
+   {
+      fprintf( stderr, "\nEnter the name of the user you want to delete: " );
+      fgets( user.name, sizeof( user.name ), stdin );
+
+      if( !CHT_Search( ct, &user ) )
+      {
+         fprintf( stderr, "The user doesn't exist, enter it again" );
+      }
+      else
+      {
+         search = true;
+         if( CHT_Remove( ct, user.name ) )
+         {
+            fprintf( stderr, "\n\tUser successfully deleted!" );
+         }
+         else
+         {
+            fprintf( stderr, "The user could not be deleted, please try again" );
+         }
+      }
+   }
+}
+
+/**
+ * @brief Verifica al usuario que está iniciando sesion.
+ *
+ * @param ct Referencia al almacén de usuarios.
+ * @param pool Grupo de hilos que verifica la contraseña.
+ * @param name Si no es NULL, devuelve el nombre del usuario que inició sesión (para
+ * abrirle una sesión, @see Session_Create).
+ *
+ * @return true si el usuario y contraseña son correctos; false en caso contrario.
+ */
+bool Log_In( Concurrent_table* ct, Auth_pool* pool, char name[ HT_NAME_MAX ] )
+{
+   getchar();
+   assert( ct );
+
+   Users user;
+   if( CHT_Len( ct ) == 0 )
+   {
+      fprintf( stderr, "There are no registered users" );
+      return false;
+   }
+
+   fprintf( stderr, "\t------- LOGGING IN -------" );
+   bool search = false;
+   while( search != true )
+   {
+      fprintf( stderr, "\nEnter username: " );
+      fgets( user.name, sizeof( user.name ), stdin );
+
+      if( !CHT_Search( ct, &user ) )
+      {
+         fprintf( stderr, "The user doesn't exist, enter it again" );
+      }
+      else
+      {
+         search = true;
+      }
+   }
+
+   char password[ TAM_PSW ];
+   fprintf( stderr, "\nPassword: " );
+   fgets( password, TAM_PSW, stdin );
+   password[ strcspn( password, "\n" ) ] = '\0';
+
+   // la verificación es cara a propósito; la hace el grupo de hilos
+   bool ok = Auth_Verify( pool, &user.password, password );
+   memset( password, 0, sizeof( password ) );
+
+   if( !ok )
+   {
+      fprintf( stderr, "Incorrect password" );
+      return false;
+   }
+   if( name ) memcpy( name, user.name, HT_NAME_MAX );
+   return true;
+}
+
+/**
+ * @brief Reune la información necesaria para registrar a un usuario nuevo.
+ *
+ * @param ct Referencia al almacén de usuarios.
+ * @param pool Grupo de hilos que deriva la llave de la contraseña.
+ */
+void Sing_Up( Concurrent_table* ct, Auth_pool* pool )
+{
+   getchar();
+   Users user;
+
+   fprintf( stderr, "\t-----DATA FOR REGISTRATION-----\n" );
+   fprintf( stderr, "Name: " );
+   fgets( user.name, sizeof( user.name ), stdin );
+
+   fprintf( stderr, "Mail: " );
+   fgets( user.mail, sizeof( user.mail ), stdin );
+
+   Users other;
+   memcpy( other.mail, user.mail, sizeof( other.mail ) );
+   if( CHT_SearchByMail( ct, &other ) )
+   {
+      fprintf( stderr, "That mail is already registered, please log in instead" );
+      return;
+   }
+
+   char pass1[ TAM_PSW ];
+   fprintf( stderr, "Password (4 characters): " );
+   fgets( pass1, TAM_PSW, stdin );
+
+   char pass2[ TAM_PSW ];
+   fprintf( stderr, "Confirm Password: " );
+   fgets( pass2, TAM_PSW, stdin );
+
+   while( strcmp( pass1, pass2 ) )
+   {
+      fprintf( stderr, "Password doesn't match! Enter it again: " );
+      fgets( pass2, TAM_PSW, stdin );
+   }
+   pass2[ strcspn( pass2, "\n" ) ] = '\0';
+
+   // sólo se guarda la llave derivada de la contraseña
+   bool hashed = Auth_Hash( pool, &user.password, pass2 );
+   memset( pass1, 0, sizeof( pass1 ) );
+   memset( pass2, 0, sizeof( pass2 ) );
+   if( !hashed )
+   {
+      fprintf( stderr, "Registration couldn't be successful, please try again" );
+      return;
+   }
+
+   fprintf( stderr, "Credit Card (16 numbers): " );
+   scanf( "%ld", &user.credit_card );
+
+   // CHT_Insert vuelve a revisar el correo: otra alta pudo registrarlo mientras tanto
+   if( CHT_Insert( ct, &user ) )
+   {
+      fprintf( stderr, "\t¡Successful registration!" );
+   }
+   else
+   {
+      fprintf( stderr, "Registration couldn't be successful, please try again" );
+   }
+}
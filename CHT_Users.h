@@ -0,0 +1,91 @@
+#ifndef  CHT_USERS_INC
+#define  CHT_USERS_INC
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "HT_Users.h"
+
+#define CHT_STRIPES 64        ///< Número de franjas por defecto
+#define CHT_MAX_THREADS 256   ///< Hilos vivos que pueden leer sin candado; los demás leen con el candado de la franja
+#define CHT_STRESS_USERS 100000  ///< Usuarios fijos de la prueba de esfuerzo (@see CHT_StressReport)
+#define CHT_STRESS_WINDOW 20000  ///< Usuarios que cada escritor de la prueba mantiene a la vez
+
+/**
+ * @brief Una franja del almacén: una tabla hash independiente con su propio candado para
+ * escritores y un contador de secuencia (seqlock) para lectores.
+ */
+typedef struct
+{
+  _Alignas( 64 ) _Atomic unsigned seq;  ///< Impar mientras un escritor modifica la franja
+  pthread_mutex_t lock;                 ///< Serializa a los escritores de la franja
+  pthread_mutex_t mail_lock;            ///< Serializa las altas cuyo correo cae en esta franja (@see CHT_Insert)
+  Hash_table* ht;                       ///< La tabla de la franja
+} CHT_Stripe;
+
+/**
+ * @brief Ranura de época de un hilo lector. Cada ranura ocupa su propia línea de caché
+ * para que los lectores no compitan entre sí.
+ */
+typedef struct
+{
+  _Alignas( 64 ) _Atomic uint64_t epoch; ///< Época en la que el hilo empezó a leer; 0 si no está leyendo
+} CHT_Reader;
+
+/**
+ * @brief Arreglo (o arena de cadenas) de una tabla que ya no es alcanzable pero que algún
+ * lector puede seguir recorriendo.
+ */
+typedef struct
+{
+  void*     block;
+  uint64_t  epoch;    ///< Época en la que se desenganchó
+} CHT_Retired;
+
+/**
+ * @brief Almacén de usuarios concurrente. Las búsquedas no toman candados: leen la franja
+ * de forma optimista y repiten si un escritor la modificó mientras tanto. Las altas y
+ * bajas toman sólo el candado de su franja (las altas, además, el del correo).
+ *
+ * Es la tabla de usuarios del programa (@see User_store): los inicios de sesión de todos
+ * los hilos buscan a la vez sin detenerse por las altas.
+ */
+typedef struct
+{
+  CHT_Stripe* stripes;       ///< Arreglo de franjas
+  size_t      n_stripes;     ///< Número de franjas; potencia de 2
+  uint64_t    seed;          ///< Semilla del hash que elige la franja
+
+  CHT_Reader* readers;       ///< CHT_MAX_THREADS ranuras de época
+  _Atomic uint64_t epoch;    ///< Época global; avanza cada vez que se retira un arreglo
+
+  pthread_mutex_t retire_lock;  ///< Protege a |retired|
+  CHT_Retired* retired;      ///< Bloques pendientes de liberar
+  size_t      n_retired;
+  size_t      cap_retired;
+} Concurrent_table;
+
+Concurrent_table* CHT_New( size_t capacity, size_t stripes );
+void CHT_Delete( Concurrent_table** ct );
+void CHT_SetLogger( Concurrent_table* ct, void (*logger)( int, const char*, const Users*, void* ), void* ctx );
+bool CHT_SetBloom( Concurrent_table* ct, double fpr );
+bool CHT_Insert( Concurrent_table* ct, Users* user );
+bool CHT_Remove( Concurrent_table* ct, char* name );
+bool CHT_Search( Concurrent_table* ct, Users* user );
+bool CHT_SearchByMail( Concurrent_table* ct, Users* user );
+size_t CHT_Len( Concurrent_table* ct );
+bool CHT_Scan( Concurrent_table* ct, bool (*fn)( const Hash_table*, void* ), void* ctx );
+size_t CHT_BulkInsert( Concurrent_table* ct, const Users* users, size_t n,
+                       void (*dup)( const Users*, void* ), void* ctx );
+size_t CHT_BulkInsertFile( Concurrent_table* ct, FILE* f, Auth_pool* pool,
+                           void (*dup)( const Users*, void* ), void* ctx, size_t* read );
+bool CHT_StressReport( unsigned max_readers, double seconds, FILE* out );
+
+// ----- Funciones Usuario -----
+void Sing_Up( Concurrent_table* ct, Auth_pool* pool );
+void Show_Users( Concurrent_table* ct );
+bool Log_In( Concurrent_table* ct, Auth_pool* pool, char name[ HT_NAME_MAX ] );
+void Delete_Account( Concurrent_table* ct );
+
+#endif   /* ----- #ifndef CHT_USERS_INC  ----- */
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "Fares.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+#define FARES_CHUNK 256   ///< Tramos que Fares_QuoteBatch resuelve antes de multiplicar
+
+/**
+ * @brief Número de vuelo de |start| -> |end| sin revisar los índices.
+ */
+static uint32_t route_of( const Fare_table* ft, uint32_t start, uint32_t end )
+{
+   uint32_t n = ft->routes.vertices;
+   if( start >= n || end >= n ) return UINT32_MAX;
+   if( ft->dense ) return ft->dense[ (size_t) start * n + end ];
+   int32_t r = Graph_CsrFind( &ft->routes, (int) start, (int) end );
+   return r < 0 ? UINT32_MAX : (uint32_t) r;
+}
+
+/**
+ * @brief Multiplica precios por multiplicadores y redondea: price[ i ] = base[ i ] * mult[ i ].
+ */
+static void scale( const float* base, const float* mult, int32_t* price, size_t n )
+{
+   size_t i = 0;
+#ifdef __SSE2__
+   for( ; i + 4 <= n; i += 4 )
+   {
+      __m128 p = _mm_mul_ps( _mm_loadu_ps( base + i ), _mm_loadu_ps( mult + i ) );
+      _mm_storeu_si128( ( __m128i* )( price + i ), _mm_cvtps_epi32( p ) );
+   }
+#endif
+   for( ; i < n; ++i ) price[ i ] = (int32_t) __builtin_lrintf( base[ i ] * mult[ i ] );
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Regla de precios original: 500 MXN más 2 MXN por kilómetro.
+ */
+int32_t Fares_Classic( const Fare_edge* edge, const void* ctx )
+{
+   (void) ctx;
+   return edge->distance * 2 + 500;
+}
+
+/**
+ * @brief Regla de precios por bandas de distancia (@see Fare_bands). Cada kilómetro se
+ * cobra con la tarifa de la banda en la que cae, como un impuesto progresivo; los
+ * kilómetros más allá de la última banda se cobran con la tarifa de la última.
+ *
+ * @param edge El vuelo.
+ * @param ctx Un Fare_bands.
+ */
+int32_t Fares_Banded( const Fare_edge* edge, const void* ctx )
+{
+   const Fare_bands* b = (const Fare_bands*) ctx;
+   assert( b );
+
+   int64_t price = b->base;
+   int32_t from = 0;
+   for( int i = 0; i < FARES_BANDS && from < edge->distance; ++i )
+   {
+      int32_t to = edge->distance < b->band_km[ i ] ? edge->distance : b->band_km[ i ];
+      if( to > from ) price += (int64_t)( to - from ) * b->band_rate[ i ];
+      from = to > from ? to : from;
+   }
+   if( from < edge->distance ) price += (int64_t)( edge->distance - from ) * b->band_rate[ FARES_BANDS - 1 ];
+
+   if( b->hubs )
+   {
+      if( edge->start < b->n_hubs && b->hubs[ edge->start ] ) price += b->hub_surcharge;
+      if( edge->end < b->n_hubs && b->hubs[ edge->end ] ) price += b->hub_surcharge;
+   }
+   return price > INT32_MAX ? INT32_MAX : (int32_t) price;
+}
+
+/**
+ * @brief Calcula las tablas de precios y tiempos de todas las aristas del grafo. Todas las
+ * horas empiezan con multiplicador 1.
+ *
+ * @param g El grafo; el peso de cada arista es su distancia en kilómetros.
+ * @param rule Regla de precios (p. ej. Fares_Classic o Fares_Banded).
+ * @param ctx Parámetros de la regla; sólo se usan aquí.
+ *
+ * @return Las tablas, o NULL si no hubo memoria.
+ */
+Fare_table* Fares_New( const Graph* g, Fare_rule rule, const void* ctx )
+{
+   assert( g && rule );
+
+   Fare_table* ft = (Fare_table*) calloc( 1, sizeof( Fare_table ) );
+   if( !ft ) return NULL;
+   if( !Graph_Csr( g, &ft->routes ) )
+   {
+      free( ft );
+      return NULL;
+   }
+
+   uint32_t edges = ft->routes.edges;
+   uint32_t n = ft->routes.vertices;
+   size_t bytes = ( ( ( edges ? edges : 1 ) * sizeof( int32_t ) ) + 63 ) & ~(size_t) 63;
+   ft->price = (int32_t*) aligned_alloc( 64, bytes );
+   ft->minutes = (int32_t*) aligned_alloc( 64, bytes );
+   if( n <= FARES_DENSE_MAX ) ft->dense = (uint32_t*) malloc( ( n ? (size_t) n * n : 1 ) * sizeof( uint32_t ) );
+   if( !ft->price || !ft->minutes || ( n <= FARES_DENSE_MAX && !ft->dense ) )
+   {
+      Fares_Delete( &ft );
+      return NULL;
+   }
+
+   if( ft->dense )
+   {
+      for( size_t i = 0; i < (size_t) n * n; ++i ) ft->dense[ i ] = UINT32_MAX;
+   }
+   for( uint32_t v = 0; v < n; ++v )
+   {
+      for( uint32_t e = ft->routes.first[ v ]; e < ft->routes.first[ v + 1 ]; ++e )
+      {
+         Fare_edge edge = { .start = v, .end = ft->routes.dest[ e ], .distance = ft->routes.weight[ e ] };
+         ft->price[ e ] = rule( &edge, ctx );
+         ft->minutes[ e ] = edge.distance / FARES_KM_PER_MIN;
+         if( ft->dense ) ft->dense[ (size_t) v * n + edge.end ] = e;
+      }
+   }
+   for( int h = 0; h < FARES_HOURS; ++h ) ft->hour_mult[ h ] = 1.0f;
+   return ft;
+}
+
+/**
+ * @brief Destruye las tablas.
+ *
+ * @param ft Referencia a las tablas; queda en NULL.
+ */
+void Fares_Delete( Fare_table** ft )
+{
+   assert( ft );
+   Fare_table* t = *ft;
+   if( !t ) return;
+
+   free( t->dense );
+   free( t->price );
+   free( t->minutes );
+   Graph_CsrFree( &t->routes );
+   free( t );
+   *ft = NULL;
+}
+
+/**
+ * @brief Cambia los multiplicadores del precio según la hora de salida (p. ej. 1.2 en las
+ * horas pico). No debe llamarse mientras otros hilos cotizan.
+ */
+void Fares_SetHours( Fare_table* ft, const float mult[ FARES_HOURS ] )
+{
+   assert( ft && mult );
+   memcpy( ft->hour_mult, mult, sizeof( ft->hour_mult ) );
+}
+
+/**
+ * @brief Busca el vuelo |start| -> |end|.
+ *
+ * @return El número de vuelo (índice en |price| y |minutes|), o -1 si no hay vuelo.
+ */
+int32_t Fares_Route( const Fare_table* ft, int start, int end )
+{
+   assert( ft );
+   if( start < 0 || end < 0 ) return -1;
+   uint32_t r = route_of( ft, (uint32_t) start, (uint32_t) end );
+   return r == UINT32_MAX ? -1 : (int32_t) r;
+}
+
+/**
+ * @brief Precio de un vuelo saliendo a la hora |hour|.
+ *
+ * @param ft Las tablas.
+ * @param route El vuelo (@see Fares_Route).
+ * @param hour Hora de salida, 0 a 23.
+ */
+int32_t Fares_Quote( const Fare_table* ft, int32_t route, unsigned hour )
+{
+   assert( ft );
+   assert( 0 <= route && (uint32_t) route < ft->routes.edges );
+   assert( hour < FARES_HOURS );
+
+   float base = (float) ft->price[ route ];
+   float mult = ft->hour_mult[ hour ];
+   int32_t price;
+   scale( &base, &mult, &price, 1 );
+   return price;
+}
+
+/**
+ * @brief Cotiza muchos tramos a la vez. Por bloques de FARES_CHUNK tramos, primero resuelve
+ * cada ruta y junta su precio base y el multiplicador de su hora, y después multiplica el
+ * bloque completo con instrucciones vectoriales.
+ *
+ * @param ft Las tablas.
+ * @param n Número de tramos.
+ * @param src Vértice de salida de cada tramo.
+ * @param dst Vértice de llegada de cada tramo.
+ * @param hour Hora de salida de cada tramo (0 a 23); puede ser NULL para usar la hora 0.
+ * @param price Recibe el precio de cada tramo, o FARES_NO_ROUTE si no hay vuelo.
+ * @param minutes Recibe la duración de cada tramo (0 si no hay vuelo); puede ser NULL.
+ *
+ * @return El número de tramos que tienen vuelo.
+ */
+size_t Fares_QuoteBatch( const Fare_table* ft, size_t n, const uint32_t src[], const uint32_t dst[],
+                         const uint8_t hour[], int32_t price[], int32_t minutes[] )
+{
+   assert( ft && ( n == 0 || ( src && dst && price ) ) );
+
+   float base[ FARES_CHUNK ];
+   float mult[ FARES_CHUNK ];
+   size_t found = 0;
+   for( size_t at = 0; at < n; at += FARES_CHUNK )
+   {
+      size_t m = n - at < FARES_CHUNK ? n - at : FARES_CHUNK;
+      for( size_t i = 0; i < m; ++i )
+      {
+         uint32_t r = route_of( ft, src[ at + i ], dst[ at + i ] );
+         unsigned h = hour ? hour[ at + i ] : 0;
+         if( r != UINT32_MAX && h < FARES_HOURS )
+         {
+            base[ i ] = (float) ft->price[ r ];
+            mult[ i ] = ft->hour_mult[ h ];
+            if( minutes ) minutes[ at + i ] = ft->minutes[ r ];
+            ++found;
+         }
+         else
+         {
+            base[ i ] = (float) FARES_NO_ROUTE;
+            mult[ i ] = 1.0f;
+            if( minutes ) minutes[ at + i ] = 0;
+         }
+      }
+      scale( base, mult, price + at, m );
+   }
+   return found;
+}
@@ -0,0 +1,72 @@
+#ifndef  FARES_INC
+#define  FARES_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "Graph.h"
+
+#define FARES_KM_PER_MIN 14     ///< Kilómetros por minuto de vuelo
+#define FARES_HOURS 24          ///< Horas del día con multiplicador propio
+#define FARES_BANDS 4           ///< Bandas de distancia de Fares_Banded
+#define FARES_DENSE_MAX 1024    ///< Con hasta tantos vértices las rutas se buscan en una matriz
+#define FARES_NO_ROUTE -1       ///< Precio de un tramo sin vuelo
+
+/**
+ * @brief Lo que una regla de precios sabe de un vuelo.
+ */
+typedef struct
+{
+  uint32_t start;       ///< Índice del vértice de salida
+  uint32_t end;         ///< Índice del vértice de llegada
+  int32_t  distance;    ///< Kilómetros (el peso de la arista)
+} Fare_edge;
+
+/**
+ * @brief Regla de precios: el precio base (MXN) de un vuelo. Se llama una vez por arista
+ * al crear las tablas.
+ */
+typedef int32_t (*Fare_rule)( const Fare_edge* edge, const void* ctx );
+
+/**
+ * @brief Parámetros de Fares_Banded: un cargo fijo, una tarifa por kilómetro que cambia por
+ * bandas de distancia y un recargo por cada extremo del vuelo que sea un aeropuerto
+ * concentrador.
+ */
+typedef struct
+{
+  int32_t base;                       ///< Cargo fijo
+  int32_t band_km[ FARES_BANDS ];     ///< Límite superior de cada banda, ascendente
+  int32_t band_rate[ FARES_BANDS ];   ///< MXN por kilómetro dentro de cada banda
+  const uint8_t* hubs;                ///< hubs[ v ] != 0 si v es concentrador; puede ser NULL
+  uint32_t n_hubs;                    ///< Elementos de |hubs|
+  int32_t hub_surcharge;              ///< Recargo por extremo concentrador
+} Fare_bands;
+
+/**
+ * @brief Tablas de precios y tiempos de vuelo, una entrada por arista en el orden de
+ * Graph_Csr (el mismo número de vuelo que usa Seat_inventory). Se calculan una sola vez;
+ * cotizar sólo lee las tablas y el multiplicador de la hora.
+ */
+typedef struct
+{
+  Graph_csr routes;     ///< Aristas del grafo; la distancia es el peso
+  int32_t*  price;      ///< Precio base de cada vuelo
+  int32_t*  minutes;    ///< Minutos de cada vuelo
+  uint32_t* dense;      ///< vertices x vertices números de vuelo (UINT32_MAX si no hay); NULL si el grafo es grande
+  float     hour_mult[ FARES_HOURS ];  ///< Multiplicador del precio según la hora de salida
+} Fare_table;
+
+int32_t Fares_Classic( const Fare_edge* edge, const void* ctx );
+int32_t Fares_Banded( const Fare_edge* edge, const void* ctx );
+
+Fare_table* Fares_New( const Graph* g, Fare_rule rule, const void* ctx );
+void Fares_Delete( Fare_table** ft );
+void Fares_SetHours( Fare_table* ft, const float mult[ FARES_HOURS ] );
+int32_t Fares_Route( const Fare_table* ft, int start, int end );
+int32_t Fares_Quote( const Fare_table* ft, int32_t route, unsigned hour );
+size_t Fares_QuoteBatch( const Fare_table* ft, size_t n, const uint32_t src[], const uint32_t dst[],
+                         const uint8_t hour[], int32_t price[], int32_t minutes[] );
+
+#endif   /* ----- #ifndef FARES_INC  ----- */
@@ -523,4 +523,175 @@ int Graph_GetIndexByIATA(Graph* g , char name[]){
     }
   }
   return -1;
-}
\ No newline at end of file
+}
+/**
+ * @brief Ordena por inserción las aristas de un vértice por vértice de llegada; los grados
+ * son pequeños.
+ */
+static void sort_edges( uint32_t* dest, int32_t* weight, size_t n )
+{
+  for( size_t i = 1; i < n; ++i ){
+    uint32_t d = dest[ i ];
+    int32_t w = weight[ i ];
+    size_t j = i;
+    for( ; j > 0 && dest[ j - 1 ] > d; --j ){
+      dest[ j ] = dest[ j - 1 ];
+      weight[ j ] = weight[ j - 1 ];
+    }
+    dest[ j ] = d;
+    weight[ j ] = w;
+  }
+}
+
+/**
+ * @brief Hace una copia compacta de las aristas del grafo (@see Graph_csr). La copia no
+ * cambia si después se agregan aristas al grafo y se puede leer desde varios hilos.
+ *
+ * @param g El grafo.
+ * @param csr Recibe la copia; se libera con Graph_CsrFree.
+ *
+ * @return false si no hubo memoria.
+ */
+bool Graph_Csr( const Graph* g, Graph_csr* csr )
+{
+  assert( g && csr );
+
+  uint32_t n = (uint32_t) g->len;
+  csr->vertices = n;
+  csr->dest = NULL;
+  csr->weight = NULL;
+  csr->first = (uint32_t*) malloc( ( n + 1 ) * sizeof( uint32_t ) );
+  if( !csr->first ) return false;
+
+  // Primera pasada: cuántas aristas salen de cada vértice
+  uint32_t edges = 0;
+  for( uint32_t v = 0; v < n; ++v ){
+    csr->first[ v ] = edges;
+    List* neighbors = g->vertices[ v ].neighbors;
+    for( Node* it = neighbors ? neighbors->first : NULL; it; it = it->next ) ++edges;
+  }
+  csr->first[ n ] = edges;
+  csr->edges = edges;
+
+  csr->dest = (uint32_t*) malloc( ( edges ? edges : 1 ) * sizeof( uint32_t ) );
+  csr->weight = (int32_t*) malloc( ( edges ? edges : 1 ) * sizeof( int32_t ) );
+  if( !csr->dest || !csr->weight ){
+    Graph_CsrFree( csr );
+    return false;
+  }
+
+  // Segunda pasada: llegadas de cada vértice, ordenadas para buscarlas por bisección
+  for( uint32_t v = 0; v < n; ++v ){
+    uint32_t k = csr->first[ v ];
+    List* neighbors = g->vertices[ v ].neighbors;
+    for( Node* it = neighbors ? neighbors->first : NULL; it; it = it->next ){
+      csr->dest[ k ] = (uint32_t) it->data->index;
+      csr->weight[ k ] = it->data->weight;
+      ++k;
+    }
+    sort_edges( &csr->dest[ csr->first[ v ] ], &csr->weight[ csr->first[ v ] ], k - csr->first[ v ] );
+  }
+  return true;
+}
+
+/**
+ * @brief Libera una copia hecha con Graph_Csr.
+ */
+void Graph_CsrFree( Graph_csr* csr )
+{
+  assert( csr );
+  free( csr->first );
+  free( csr->dest );
+  free( csr->weight );
+  csr->first = NULL;
+  csr->dest = NULL;
+  csr->weight = NULL;
+  csr->edges = 0;
+}
+
+/**
+ * @brief Busca la arista |start| -> |end| en una copia compacta.
+ *
+ * @param csr La copia.
+ * @param start Índice del vértice de salida.
+ * @param end Índice del vértice de llegada.
+ *
+ * @return La posición de la arista, o -1 si no existe.
+ */
+int32_t Graph_CsrFind( const Graph_csr* csr, int start, int end )
+{
+  assert( csr );
+  if( start < 0 || end < 0 || (uint32_t) start >= csr->vertices ) return -1;
+
+  uint32_t lo = csr->first[ start ], hi = csr->first[ start + 1 ];
+  while( lo < hi ){
+    uint32_t mid = lo + ( hi - lo ) / 2;
+    if( csr->dest[ mid ] < (uint32_t) end ) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo < csr->first[ start + 1 ] && csr->dest[ lo ] == (uint32_t) end ? (int32_t) lo : -1;
+}
+
+/**
+ * @brief Busca la ruta de menor distancia de |start| a |end| (Dijkstra sobre la copia
+ * compacta). Las redes de aeropuertos tienen pocos vértices, así que en cada paso se busca
+ * el más cercano con un recorrido lineal en lugar de un montículo.
+ *
+ * @param csr La copia.
+ * @param start Índice del vértice de salida.
+ * @param end Índice del vértice de llegada.
+ * @param path Recibe los vértices de la ruta, de |start| a |end|.
+ * @param max Lugares de |path|.
+ * @param total Si no es NULL, recibe la suma de los pesos de la ruta.
+ *
+ * @return El número de vértices de la ruta; 0 si no hay ruta, no cabe en |path| o no hubo
+ * memoria.
+ */
+size_t Graph_CsrPath( const Graph_csr* csr, int start, int end, uint32_t path[], size_t max, int64_t* total )
+{
+  assert( csr && path );
+  uint32_t n = csr->vertices;
+  if( start < 0 || end < 0 || (uint32_t) start >= n || (uint32_t) end >= n ) return 0;
+
+  int64_t* dist = (int64_t*) malloc( n * sizeof( int64_t ) );
+  uint32_t* prev = (uint32_t*) malloc( n * sizeof( uint32_t ) );
+  bool* done = (bool*) calloc( n, sizeof( bool ) );
+  size_t len = 0;
+  if( dist && prev && done ){
+    for( uint32_t v = 0; v < n; ++v ){
+      dist[ v ] = INT64_MAX;
+      prev[ v ] = UINT32_MAX;
+    }
+    dist[ start ] = 0;
+
+    for( ;; ){
+      uint32_t u = UINT32_MAX;
+      for( uint32_t v = 0; v < n; ++v ){
+        if( !done[ v ] && dist[ v ] != INT64_MAX && ( u == UINT32_MAX || dist[ v ] < dist[ u ] ) ) u = v;
+      }
+      if( u == UINT32_MAX || u == (uint32_t) end ) break;
+      done[ u ] = true;
+      for( uint32_t e = csr->first[ u ]; e < csr->first[ u + 1 ]; ++e ){
+        uint32_t v = csr->dest[ e ];
+        if( !done[ v ] && dist[ u ] + csr->weight[ e ] < dist[ v ] ){
+          dist[ v ] = dist[ u ] + csr->weight[ e ];
+          prev[ v ] = u;
+        }
+      }
+    }
+
+    if( dist[ end ] != INT64_MAX ){
+      for( uint32_t v = (uint32_t) end; v != UINT32_MAX; v = prev[ v ] ) ++len;
+      if( len <= max ){
+        size_t i = len;
+        for( uint32_t v = (uint32_t) end; v != UINT32_MAX; v = prev[ v ] ) path[ --i ] = v;
+        if( total ) *total = dist[ end ];
+      }
+      else len = 0;
+    }
+  }
+  free( dist );
+  free( prev );
+  free( done );
+  return len;
+}
@@ -2,6 +2,7 @@
 #define  GRAPH_INC
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
 
@@ -49,6 +50,21 @@ typedef struct
    int len;  
    eGraphType type; ///< tipo del grafo, UNDIRECTED o DIRECTED
 } Graph;
+
+/**
+ * @brief Copia compacta (CSR) de las aristas de un grafo. Las aristas que salen del
+ * vértice v ocupan las posiciones first[ v ] .. first[ v + 1 ] - 1, ordenadas por vértice
+ * de llegada; la posición de una arista sirve de índice en tablas paralelas (asientos,
+ * tarifas) y es la misma para cualquier copia hecha del mismo grafo.
+ */
+typedef struct
+{
+   uint32_t* first;     ///< |vertices| + 1 inicios de las aristas de cada vértice
+   uint32_t* dest;      ///< Vértice de llegada de cada arista
+   int32_t*  weight;    ///< Peso de cada arista
+   uint32_t  vertices;  ///< Vértices del grafo al hacer la copia
+   uint32_t  edges;     ///< Número de aristas
+} Graph_csr;
 //----------------------------------------------------------------------
 //                     Funciones privadas
 //----------------------------------------------------------------------
@@ -83,4 +99,9 @@ bool Graph_IsNeighborOf( Graph* g, Airport* dest, Airport* src );
 void Graph_AirportsPrint( Graph* g );
 int Graph_GetIndexByIATA(Graph* g , char name[]);
 
+bool Graph_Csr( const Graph* g, Graph_csr* csr );
+void Graph_CsrFree( Graph_csr* csr );
+int32_t Graph_CsrFind( const Graph_csr* csr, int start, int end );
+size_t Graph_CsrPath( const Graph_csr* csr, int start, int end, uint32_t path[], size_t max, int64_t* total );
+
 #endif   /* ----- #ifndef GRAPH_INC  ----- */
\ No newline at end of file
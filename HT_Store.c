@@ -0,0 +1,527 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "HT_Store.h"
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+static const char SNAP_MAGIC[ 8 ] = "SKYUSR3";
+
+/**
+ * @brief Une un directorio y un nombre de archivo en una cadena nueva.
+ */
+static char* join_path( const char* dir, const char* file )
+{
+   size_t len = strlen( dir ) + strlen( file ) + 2;
+   char* path = ( char* ) malloc( len );
+   if( path ) snprintf( path, len, "%s/%s", dir, file );
+   return path;
+}
+
+/**
+ * @brief Llena un registro con un nombre y un correo que pueden estar en cualquier lado
+ * (los campos de un Users o la arena de la tabla).
+ *
+ * @return Los bytes que ocupa el registro recortado a su texto.
+ */
+static size_t to_record( Store_record* rec, const char* name, size_t name_len,
+                         const char* mail, size_t mail_len )
+{
+   memset( rec, 0, STORE_RECORD_HEAD );
+   rec->name_len = ( uint16_t ) name_len;
+   rec->mail_len = ( uint16_t ) mail_len;
+   memcpy( rec->text, name, name_len );
+   memcpy( rec->text + name_len, mail, mail_len );
+   return STORE_RECORD_HEAD + name_len + mail_len;
+}
+
+static void user_record( Store_record* rec, const char* name, const Users* user )
+{
+   memset( rec, 0, sizeof( *rec ) );
+   // las bajas no llevan correo
+   const char* mail = user ? user->mail : "";
+   size_t mail_len = user ? strnlen( user->mail, HT_MAIL_MAX - 1 ) : 0;
+   to_record( rec, name, strnlen( name, HT_NAME_MAX - 1 ), mail, mail_len );
+   if( user )
+   {
+      rec->password = user->password;
+      rec->credit_card = user->credit_card;
+   }
+}
+
+/**
+ * @return false si las longitudes del registro no caben en un Users (registro dañado).
+ */
+static bool from_record( Users* user, const Store_record* rec )
+{
+   if( rec->name_len >= HT_NAME_MAX || rec->mail_len >= HT_MAIL_MAX ) return false;
+
+   memcpy( user->name, rec->text, rec->name_len );
+   user->name[ rec->name_len ] = '\0';
+   memcpy( user->mail, rec->text + rec->name_len, rec->mail_len );
+   user->mail[ rec->mail_len ] = '\0';
+   user->password = rec->password;
+   user->credit_card = rec->credit_card;
+   user->state = USED_CELL;
+   return true;
+}
+
+/**
+ * @brief Aplica un registro del diario a la tabla durante la recuperación.
+ */
+static void replay( uint32_t type, uint64_t lsn, const void* payload, void* ctx )
+{
+   (void) lsn;
+   Concurrent_table* ct = ( Concurrent_table* ) ctx;
+   Store_record rec;
+   memcpy( &rec, payload, sizeof( rec ) );
+
+   Users user;
+   if( !from_record( &user, &rec ) ) return;
+
+   // los registros posteriores al corte del snapshot pueden estar ya aplicados: un alta
+   // que ya existe o una baja que ya no existe no cambian nada
+   if( type == STORE_INSERT ) CHT_Insert( ct, &user );
+   else if( type == STORE_REMOVE ) CHT_Remove( ct, user.name );
+}
+
+/**
+ * @brief Último registro que anexó cada hilo, para que espere a que sea durable después
+ * de soltar sus candados (@see Store_Commit).
+ */
+static _Thread_local struct
+{
+   const User_store* store;
+   uint64_t          lsn;
+} pending;
+
+/**
+ * @brief Registrador de la tabla (@see CHT_SetLogger): anexa la operación al diario, sin
+ * esperar a que llegue a disco. Se llama dentro de CHT_Insert o CHT_Remove, con el
+ * candado de la franja tomado, así que el orden del diario es el de cada franja; la
+ * espera se hace después con Store_Commit y las esperas de varios hilos comparten fsync.
+ *
+ * Cada STORE_SNAPSHOT_RECORDS registros despierta al hilo de snapshots; el snapshot no se
+ * puede hacer aquí, porque recorre las franjas y ésta está tomada.
+ */
+static void log_change( int op, const char* name, const Users* user, void* ctx )
+{
+   User_store* store = ( User_store* ) ctx;
+
+   Store_record rec;
+   user_record( &rec, name, user );
+
+   pending.store = store;
+   pending.lsn = Journal_Append( store->log, ( uint32_t ) op, &rec );
+   uint64_t since = atomic_fetch_add_explicit( &store->since_snapshot, 1, memory_order_relaxed ) + 1;
+   if( since % STORE_SNAPSHOT_RECORDS == 0 )
+   {
+      pthread_mutex_lock( &store->due_lock );
+      pthread_cond_signal( &store->due );
+      pthread_mutex_unlock( &store->due_lock );
+   }
+}
+
+/**
+ * @brief Carga un snapshot mapeándolo en memoria y crea una tabla del tamaño justo para
+ * que los usuarios quepan sin crecer. Los registros se insertan por lotes con
+ * @see CHT_BulkInsert.
+ *
+ * @param path Ruta del snapshot.
+ * @param next_lsn Devuelve el LSN a partir del cual hay que repetir el diario.
+ *
+ * @return La tabla, o NULL si el snapshot existe pero está dañado o no hubo memoria.
+ */
+static Concurrent_table* load_snapshot( const char* path, uint64_t* next_lsn )
+{
+   *next_lsn = 0;
+
+   int fd = open( path, O_RDONLY );
+   if( fd < 0 ) return CHT_New( HASH_TABLE_SIZE, CHT_STRIPES );
+
+   Concurrent_table* ct = NULL;
+   struct stat st;
+   const char* map = MAP_FAILED;
+   if( fstat( fd, &st ) == 0 && ( size_t ) st.st_size >= sizeof( Store_snapshot ) )
+   {
+      map = ( const char* ) mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   }
+   close( fd );
+   if( map == MAP_FAILED )
+   {
+      fprintf( stderr, "%s: unreadable snapshot\n", path );
+      return NULL;
+   }
+   madvise( ( void* ) map, st.st_size, MADV_SEQUENTIAL | MADV_WILLNEED );
+
+   Store_snapshot h;
+   memcpy( &h, map, sizeof( h ) );
+   const char* records = map + sizeof( h );
+   size_t bytes = ( size_t ) st.st_size - sizeof( h );
+
+   bool valid = memcmp( h.magic, SNAP_MAGIC, sizeof( SNAP_MAGIC ) ) == 0 &&
+                h.record_size == sizeof( Store_record ) &&
+                bytes >= h.count * STORE_RECORD_HEAD &&
+                Journal_Crc32c( 0, records, bytes ) == h.crc;
+   if( valid )
+   {
+      ct = CHT_New( h.count, CHT_STRIPES );
+      Users* batch = ( Users* ) malloc( STORE_LOAD_BATCH * sizeof( Users ) );
+      if( ct && batch )
+      {
+         // los registros son de longitud variable: cada uno se valida antes de leer el
+         // siguiente
+         size_t at = 0;
+         for( uint64_t i = 0; i < h.count && valid; i += STORE_LOAD_BATCH )
+         {
+            size_t n = h.count - i < STORE_LOAD_BATCH ? h.count - i : STORE_LOAD_BATCH;
+            for( size_t k = 0; k < n && valid; ++k )
+            {
+               Store_record rec;
+               valid = bytes - at >= STORE_RECORD_HEAD;
+               if( valid )
+               {
+                  memcpy( &rec, records + at, STORE_RECORD_HEAD );
+                  size_t text = ( size_t ) rec.name_len + rec.mail_len;
+                  valid = text <= sizeof( rec.text ) && bytes - at - STORE_RECORD_HEAD >= text;
+                  if( valid )
+                  {
+                     memcpy( rec.text, records + at + STORE_RECORD_HEAD, text );
+                     at += STORE_RECORD_HEAD + text;
+                     valid = from_record( &batch[ k ], &rec );
+                  }
+               }
+            }
+            if( valid ) CHT_BulkInsert( ct, batch, n, NULL, NULL );
+         }
+         valid = valid && at == bytes;
+         if( valid ) *next_lsn = h.next_lsn;
+      }
+      if( ct && !( batch && valid ) ) CHT_Delete( &ct );
+      free( batch );
+   }
+   if( !valid ) fprintf( stderr, "%s: corrupt snapshot\n", path );
+
+   munmap( ( void* ) map, st.st_size );
+   return ct;
+}
+
+/**
+ * @brief Escribe todos los usuarios de una tabla concreta al snapshot.
+ */
+static bool write_array( FILE* f, const HT_Array* a, uint32_t* crc, uint64_t* count )
+{
+   for( size_t i = 0; a && i < a->capacity; ++i )
+   {
+      if( a->ctrl[ i ] & 0x80 ) continue;
+
+      const HT_Slot* slot = &a->slots[ i ];
+      Store_record rec;
+      size_t size = to_record( &rec, a->arena->data + slot->name.offset, slot->name.len,
+                               a->arena->data + slot->mail.offset, slot->mail.len );
+      rec.password = slot->password;
+      rec.credit_card = slot->credit_card;
+      if( fwrite( &rec, size, 1, f ) != 1 ) return false;
+      *crc = Journal_Crc32c( *crc, &rec, size );
+      ++*count;
+   }
+   return true;
+}
+
+/**
+ * @brief Estado de la escritura de un snapshot.
+ */
+typedef struct
+{
+   FILE*    f;
+   uint32_t crc;
+   uint64_t count;
+} snap_writer;
+
+/**
+ * @brief Escribe los usuarios de una franja (@see CHT_Scan), que está quieta mientras
+ * tanto.
+ */
+static bool write_stripe( const Hash_table* ht, void* ctx )
+{
+   snap_writer* w = ( snap_writer* ) ctx;
+   return write_array( w->f, ht->table, &w->crc, &w->count ) &&
+          write_array( w->f, ht->old_table, &w->crc, &w->count );
+}
+
+/**
+ * @brief Hace el snapshot (@see Store_Snapshot).
+ *
+ * @pre Se tiene |snap_lock|.
+ */
+static bool snapshot( User_store* store )
+{
+   // todo registro anterior al corte ya está en su franja: se anexa después de cambiarla
+   // y con su candado tomado, y la franja se lee con el mismo candado
+   uint64_t upto = Journal_NextLsn( store->log );
+   uint64_t counted = atomic_load( &store->since_snapshot );
+
+   size_t len = strlen( store->snap_path ) + 5;
+   char* tmp_path = ( char* ) malloc( len );
+   if( NULL == tmp_path ) return false;
+   snprintf( tmp_path, len, "%s.tmp", store->snap_path );
+
+   bool ok = false;
+   FILE* f = fopen( tmp_path, "wb" );
+   if( f )
+   {
+      Store_snapshot h;
+      memset( &h, 0, sizeof( h ) );
+      memcpy( h.magic, SNAP_MAGIC, sizeof( SNAP_MAGIC ) );
+      h.record_size = sizeof( Store_record );
+      h.next_lsn = upto;
+
+      snap_writer w = { .f = f };
+      ok = fwrite( &h, sizeof( h ), 1, f ) == 1 &&
+           CHT_Scan( store->ct, write_stripe, &w );
+      h.crc = w.crc;
+      h.count = w.count;
+      ok = ok &&
+           fseek( f, 0, SEEK_SET ) == 0 &&
+           fwrite( &h, sizeof( h ), 1, f ) == 1 &&
+           fflush( f ) == 0 &&
+           fsync( fileno( f ) ) == 0;
+      ok = fclose( f ) == 0 && ok;
+   }
+
+   ok = ok && rename( tmp_path, store->snap_path ) == 0;
+   free( tmp_path );
+
+   if( ok )
+   {
+      // el rename sólo es durable cuando el directorio llega a disco
+      char* dir = strdup( store->snap_path );
+      char* slash = dir ? strrchr( dir, '/' ) : NULL;
+      if( slash )
+      {
+         *slash = '\0';
+         int dfd = open( dir, O_RDONLY );
+         if( dfd >= 0 )
+         {
+            fsync( dfd );
+            close( dfd );
+         }
+      }
+      free( dir );
+
+      // los registros desde el corte se quedan: cambios hechos durante el snapshot que
+      // pueden no estar en él
+      ok = Journal_Trim( store->log, upto );
+      if( ok ) atomic_fetch_sub( &store->since_snapshot, counted );
+   }
+
+   if( !ok ) fprintf( stderr, "%s: snapshot failed\n", store->snap_path );
+   return ok;
+}
+
+/**
+ * @brief Hilo de snapshots: espera a que el diario junte STORE_SNAPSHOT_RECORDS registros
+ * y hace el snapshot mientras los demás hilos siguen dando de alta y de baja. El diario
+ * conserva todo lo posterior al último snapshot, así que un snapshot tardío sólo hace que
+ * el diario (y la recuperación) sean más largos.
+ */
+static void* snapshot_main( void* arg )
+{
+   User_store* store = ( User_store* ) arg;
+   bool stalled = false;    // el último intento falló; se espera al siguiente aviso
+
+   pthread_mutex_lock( &store->due_lock );
+   while( store->running )
+   {
+      if( stalled || atomic_load( &store->since_snapshot ) < STORE_SNAPSHOT_RECORDS )
+      {
+         pthread_cond_wait( &store->due, &store->due_lock );
+         stalled = false;
+         continue;
+      }
+      pthread_mutex_unlock( &store->due_lock );
+
+      stalled = !Store_Snapshot( store );
+
+      pthread_mutex_lock( &store->due_lock );
+   }
+   pthread_mutex_unlock( &store->due_lock );
+
+   return NULL;
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Abre el almacén de usuarios del directorio |dir| (lo crea si no existe) y
+ * recupera su contenido: carga el último snapshot y repite sólo los registros del diario
+ * posteriores a él.
+ *
+ * @param dir Directorio de los datos.
+ *
+ * @return Una referencia al almacén, o NULL si los datos no se pudieron recuperar.
+ */
+User_store* Store_Open( const char* dir )
+{
+   if( mkdir( dir, 0755 ) != 0 && errno != EEXIST ) return NULL;
+
+   User_store* store = ( User_store* ) calloc( 1, sizeof( User_store ) );
+   if( NULL == store ) return NULL;
+
+   store->snap_path = join_path( dir, "users.snap" );
+   store->log_path = join_path( dir, "users.log" );
+   if( store->snap_path && store->log_path )
+   {
+      uint64_t next_lsn;
+      store->ct = load_snapshot( store->snap_path, &next_lsn );
+      if( store->ct )
+      {
+         uint64_t end = Journal_Replay( store->log_path, sizeof( Store_record ), next_lsn, replay, store->ct );
+         atomic_init( &store->since_snapshot, end - next_lsn );
+         store->log = Journal_Open( store->log_path, sizeof( Store_record ), end );
+      }
+   }
+
+   pthread_mutex_init( &store->snap_lock, NULL );
+   pthread_mutex_init( &store->due_lock, NULL );
+   pthread_cond_init( &store->due, NULL );
+   store->running = true;
+   if( store->log && pthread_create( &store->snapshotter, NULL, snapshot_main, store ) != 0 )
+   {
+      Journal_Close( &store->log );
+   }
+
+   if( NULL == store->log )
+   {
+      if( store->ct ) CHT_Delete( &store->ct );
+      pthread_mutex_destroy( &store->snap_lock );
+      pthread_mutex_destroy( &store->due_lock );
+      pthread_cond_destroy( &store->due );
+      free( store->snap_path );
+      free( store->log_path );
+      free( store );
+      return NULL;
+   }
+
+   CHT_SetLogger( store->ct, log_change, store );
+   return store;
+}
+
+/**
+ * @brief Escribe un snapshot y cierra el almacén.
+ *
+ * @param store La dirección de una referencia al almacén.
+ */
+void Store_Close( User_store** store )
+{
+   assert( store && *store );
+   User_store* s = *store;
+
+   pthread_mutex_lock( &s->due_lock );
+   s->running = false;
+   pthread_cond_signal( &s->due );
+   pthread_mutex_unlock( &s->due_lock );
+   pthread_join( s->snapshotter, NULL );
+
+   if( atomic_load( &s->since_snapshot ) > 0 ) Store_Snapshot( s );
+
+   Journal_Close( &s->log );
+   CHT_Delete( &s->ct );
+   pthread_mutex_destroy( &s->snap_lock );
+   pthread_mutex_destroy( &s->due_lock );
+   pthread_cond_destroy( &s->due );
+   free( s->snap_path );
+   free( s->log_path );
+   free( s );
+   *store = NULL;
+}
+
+/**
+ * @brief Espera a que la última alta o baja que hizo el hilo que llama llegue a disco.
+ * Se llama después de CHT_Insert o CHT_Remove, ya sin candados, para que un fsync no
+ * detenga a los demás hilos que usan la tabla.
+ *
+ * @param store Referencia al almacén.
+ *
+ * @return true si el cambio es durable (o el hilo no tenía cambios pendientes); false si
+ * el diario ya no se puede escribir.
+ */
+bool Store_Commit( User_store* store )
+{
+   assert( store );
+
+   if( pending.store != store ) return !store->failed;
+   pending.store = NULL;
+
+   if( !Journal_Wait( store->log, pending.lsn ) && !store->failed )
+   {
+      store->failed = true;
+      fprintf( stderr, "%s: write failed, changes are no longer durable\n", store->log_path );
+   }
+   return !store->failed;
+}
+
+/**
+ * @brief Importa usuarios de un archivo (@see CHT_BulkInsertFile). Las altas no pasan por
+ * el diario una por una: al terminar se escribe un snapshot que las cubre a todas.
+ *
+ * @param store Referencia al almacén.
+ * @param f Archivo con un usuario por línea: "nombre,correo,contraseña,tarjeta".
+ * @param pool Grupo de hilos que deriva las contraseñas.
+ * @param dup Recibe cada usuario que no se importó porque su nombre ya existía; puede
+ * ser NULL.
+ * @param ctx Argumento que se le pasa a |dup|.
+ * @param read Devuelve el número de usuarios leídos; puede ser NULL.
+ *
+ * @return El número de usuarios importados.
+ */
+size_t Store_Import( User_store* store, FILE* f, Auth_pool* pool,
+                     void (*dup)( const Users*, void* ), void* ctx, size_t* read )
+{
+   assert( store && f );
+
+   CHT_SetLogger( store->ct, NULL, NULL );
+   size_t inserted = CHT_BulkInsertFile( store->ct, f, pool, dup, ctx, read );
+   CHT_SetLogger( store->ct, log_change, store );
+
+   if( inserted > 0 ) Store_Snapshot( store );
+   return inserted;
+}
+
+/**
+ * @brief Vuelca la tabla completa a un snapshot nuevo y recorta el diario.
+ *
+ * El snapshot se escribe en un archivo temporal que sólo reemplaza al anterior (con
+ * rename()) cuando ya está en disco, así que una caída a la mitad deja el snapshot
+ * anterior intacto. No detiene a los demás hilos: el snapshot guarda el LSN del diario
+ * al empezar (el corte) y cada franja se copia con su candado tomado, así que contiene
+ * todos los registros anteriores al corte y quizá algunos posteriores. El diario
+ * conserva los registros desde el corte y la recuperación los repite; repetir uno que ya
+ * está aplicado no cambia nada.
+ *
+ * @param store Referencia al almacén.
+ *
+ * @return true si el snapshot quedó en disco; false en caso contrario.
+ */
+bool Store_Snapshot( User_store* store )
+{
+   assert( store );
+
+   pthread_mutex_lock( &store->snap_lock );
+   bool ok = snapshot( store );
+   pthread_mutex_unlock( &store->snap_lock );
+
+   return ok;
+}
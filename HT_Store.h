@@ -0,0 +1,87 @@
+#ifndef  HT_STORE_INC
+#define  HT_STORE_INC
+
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "HT_Users.h"
+#include "CHT_Users.h"
+#include "Journal.h"
+
+#define STORE_DIR "skynet_data"              ///< Directorio por defecto de los datos de usuarios
+#define STORE_SNAPSHOT_RECORDS ( 1u << 20 )  ///< Registros del diario que disparan un snapshot
+#define STORE_LOAD_BATCH ( 1u << 16 )        ///< Usuarios que se convierten e insertan a la vez al cargar un snapshot
+
+/**
+ * @brief Tipos de registro del diario de usuarios.
+ */
+enum
+{
+   STORE_INSERT = HT_LOG_INSERT,
+   STORE_REMOVE = HT_LOG_REMOVE,
+};
+
+/**
+ * @brief Un usuario tal como se guarda en el diario y en el snapshot, sin relleno que
+ * dependa del compilador. El diario guarda el registro completo (sus registros son de
+ * tamaño fijo); el snapshot sólo STORE_RECORD_HEAD bytes más los del texto usado.
+ */
+typedef struct
+{
+  Kdf_hash password;
+  int64_t  credit_card;
+  uint16_t name_len;
+  uint16_t mail_len;
+  uint32_t reserved;      ///< Siempre 0
+  char     text[ HT_NAME_MAX + HT_MAIL_MAX ]; ///< El nombre y después el correo, sin fines de cadena
+} Store_record;
+
+#define STORE_RECORD_HEAD offsetof( Store_record, text )  ///< Bytes de un registro antes del texto
+
+/**
+ * @brief Encabezado del archivo de snapshot. Le siguen |count| registros Store_record,
+ * cada uno recortado a su texto.
+ */
+typedef struct
+{
+  char     magic[ 8 ];    ///< "SKYUSR3"
+  uint64_t count;         ///< Número de usuarios
+  uint64_t next_lsn;      ///< Los registros del diario con LSN menor ya están en el snapshot
+  uint32_t record_size;   ///< sizeof( Store_record ); los registros guardados pueden ser más cortos
+  uint32_t crc;           ///< CRC-32C de los registros
+} Store_snapshot;
+
+/**
+ * @brief Tabla de usuarios persistente: cada alta y baja se anexa a un diario y no se
+ * confirma hasta que el registro llega a disco (@see Store_Commit), y cada
+ * STORE_SNAPSHOT_RECORDS registros un hilo propio vuelca la tabla completa a un snapshot
+ * compacto y recorta el diario, sin que ninguna alta o baja tenga que esperarlo.
+ *
+ * La tabla es concurrente: las altas y bajas de varios hilos sólo se detienen entre sí en
+ * la misma franja y las búsquedas no toman candados. El snapshot recorre las franjas una
+ * por una mientras las demás siguen aceptando cambios (@see Store_Snapshot).
+ */
+typedef struct
+{
+  Concurrent_table* ct;   ///< La tabla de usuarios; se usa con las funciones CHT_*
+  Journal*    log;        ///< Diario de altas y bajas
+  char*       snap_path;  ///< Ruta del snapshot
+  char*       log_path;   ///< Ruta del diario
+  _Atomic uint64_t since_snapshot; ///< Registros anexados desde el último snapshot (aproximado)
+  pthread_mutex_t snap_lock;       ///< Un snapshot a la vez
+  pthread_mutex_t due_lock;        ///< Protege |running| y la espera del hilo de snapshots
+  pthread_cond_t  due;             ///< Se juntaron STORE_SNAPSHOT_RECORDS registros más
+  bool        running;    ///< false para pedirle al hilo de snapshots que termine
+  pthread_t   snapshotter; ///< Hilo que hace los snapshots
+  bool        failed;     ///< Hubo un error de E/S; las operaciones ya no son durables
+} User_store;
+
+User_store* Store_Open( const char* dir );
+void Store_Close( User_store** store );
+bool Store_Commit( User_store* store );
+bool Store_Snapshot( User_store* store );
+size_t Store_Import( User_store* store, FILE* f, Auth_pool* pool,
+                     void (*dup)( const Users*, void* ), void* ctx, size_t* read );
+
+#endif   /* ----- #ifndef HT_STORE_INC  ----- */
@@ -1,453 +1,1942 @@
 
 #include "HT_Users.h"
 #include "List.h"
+
 //----------------------------------------------------------------------
-//            Funciones de la interfaz de Usuario de la HT
+//                     Funciones privadas
 //----------------------------------------------------------------------
 
+#include <time.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
 /**
- * @brief Muestra los usuarios registrados en ese momento.
+ * @brief Calcula el índice para la HT de una cadena de caracteres
+ *
+ * @param s que es la cadena a la que le vamos a calcular su índice
  *
- * @param ht Referencia a la tabla hash.
+ * @return Un entero que será usado como índice de la HT.
  */
-void Show_Users( Hash_table* ht )
+size_t h_gon99( const char* s, size_t m )
 {
-    assert( ht );
-    if( HT_IsEmpty( ht ) )
+    size_t res;
+    for( res=0; *s; ++s)
     {
-        fprintf( stderr, "No registered user.");
-    }
-    else{
-        fprintf( stderr, "\t------- REGISTERED USERS -------");
-        for( size_t i = 0; i < ht->capacity; ++i )
-        {
-            if( ht->table[i].state == USED_CELL )
-            {
-                printf( "\n[%02ld]   Name: %s"
-                        "       Mail: %s"
-                        "   Password: %c***\n"
-                        "Credit Card: ************%04ld\n", 
-                        i, ht->table[ i ].name,ht->table[ i ].mail, ht->table[ i ].password[0], 
-                        ht->table[ i ].credit_card % 10000 );
-            }
-        }
+        res = 131 * res + *s; 
     }
+
+    return res % m;
 }
 
 /**
- * @brief Elimina un usuario.
- *
- * @param ht Referencia a la tabla hash.
+ * @brief Lee 8 bytes sin importar su alineación.
  */
-void Delete_Account( Hash_table* ht )
+static inline uint64_t read64( const char* p )
 {
-    getchar();
-    assert( ht );
+    uint64_t v;
+    memcpy( &v, p, sizeof( v ) );
+    return v;
+}
+
+/**
+ * @brief Multiplica 64x64->128 bits y pliega las dos mitades con xor.
+ */
+static inline uint64_t mum( uint64_t a, uint64_t b )
+{
+    __uint128_t r = ( __uint128_t ) a * b;
+    return ( uint64_t ) r ^ ( uint64_t )( r >> 64 );
+}
 
-    Show_Users( ht );
-    Users user;
-    if( HT_IsEmpty( ht ) )
+static inline uint64_t rotl64( uint64_t x, int r )
+{
+    return ( x << r ) | ( x >> ( 64 - r ) );
+}
+
+/**
+ * @brief h_gon99() sobre la llave completa, con la semilla y una multiplicación final
+ * para que los bits bajos (que van al byte de control) no dependan sólo del último
+ * carácter.
+ */
+uint64_t HT_Hash_Gon99( const char* key, size_t len, uint64_t seed )
+{
+    uint64_t res = seed;
+    for( size_t i = 0; i < len; ++i )
     {
-        fprintf( stderr, "There are no registered users");
-        return;
+        res = 131 * res + key[ i ];
     }
-    else{
-        bool search = false;
-        while( search != true )
-        {
-            fprintf( stderr, "\nEnter the name of the user you want to delete: ");
-            fgets( user.name, TAM, stdin );
+    res *= 0x9E3779B97F4A7C15ull;
+    return res ^ ( res >> 29 );
+}
 
-            if( !HT_Search( ht, &user ) )
-            {
-                fprintf( stderr, "The user doesn't exist, enter it again");
-            }
-            else{ 
-                search = true;
-                if( HT_Remove( ht, user.name ) )
-                {
-                    fprintf( stderr, "\n\tUser successfully deleted!");
-                }
-                else{
-                    fprintf( stderr, "The user could not be deleted, please try again");
-                }
-            }
-        }
+/**
+ * @brief Hash estilo wyhash: una multiplicación 64x64->128 por cada 16 bytes de la llave
+ * (los últimos, rellenados con ceros) y una más para mezclar la longitud.
+ */
+uint64_t HT_Hash_Wy( const char* key, size_t len, uint64_t seed )
+{
+    static const uint64_t p0 = 0xa0761d6478bd642full, p1 = 0xe7037ed1a0b428dbull,
+                          p2 = 0x8ebc6af09c88c6e3ull, p3 = 0x589965cc75374cc3ull;
+
+    seed ^= p0;
+    size_t i = len;
+    for( ; i > 16; i -= 16, key += 16 )
+    {
+        seed = mum( read64( key ) ^ p1, read64( key + 8 ) ^ seed );
     }
+
+    uint64_t w[ 2 ] = { 0, 0 };
+    memcpy( w, key, i );
+    uint64_t a = mum( w[ 0 ] ^ p2, w[ 1 ] ^ seed );
+    return mum( a ^ p3 ^ len, seed ^ p1 );
 }
 
 /**
- * @brief Verifica al usuario que está iniciando sesion.
- *
- * @param ht Referencia a la tabla hash.
- *
- * @return true si el usuario y contraseña son correctos; false en caso contrario.
+ * @brief XXH64: cuatro carriles de multiplicar-rotar por cada 32 bytes, el resto de la
+ * llave de 8, 4 y 1 bytes, y la avalancha final.
  */
-bool Log_In( Hash_table* ht )
+uint64_t HT_Hash_XX( const char* key, size_t len, uint64_t seed )
 {
-    getchar();
-    assert( ht );
+    static const uint64_t P1 = 0x9E3779B185EBCA87ull, P2 = 0xC2B2AE3D27D4EB4Full,
+                          P3 = 0x165667B19E3779F9ull, P4 = 0x85EBCA77C2B2AE63ull,
+                          P5 = 0x27D4EB2F165667C5ull;
+    const char* end = key + len;
 
-    Users user;
-    if( HT_IsEmpty( ht ) )
+    uint64_t h;
+    if( len >= 32 )
     {
-        fprintf( stderr, "There are no registered users");
-        return false;
-    }
-    else{
-        fprintf( stderr, "\t------- LOGGING IN -------");
-        bool search = false;
-        while( search != true )
+        uint64_t v[ 4 ] = { seed + P1 + P2, seed + P2, seed, seed - P1 };
+        for( ; key + 32 <= end; key += 32 )
         {
-            fprintf( stderr, "\nEnter username: ");
-            fgets( user.name, TAM, stdin );
-
-            if( !HT_Search( ht, &user ) )
+            for( int i = 0; i < 4; ++i )
             {
-                fprintf( stderr, "The user doesn't exist, enter it again");
-            }
-            else{ 
-                search = true;
+                v[ i ] = rotl64( v[ i ] + read64( key + 8 * i ) * P2, 31 ) * P1;
             }
         }
 
-        Users temp;
-        fprintf( stderr, "\nPassword: ");
-        fgets( temp.password, TAM_PSW, stdin );
-
-        if( !strcmp( user.password, temp.password ) )
+        h = rotl64( v[ 0 ], 1 ) + rotl64( v[ 1 ], 7 ) + rotl64( v[ 2 ], 12 ) + rotl64( v[ 3 ], 18 );
+        for( int i = 0; i < 4; ++i )
         {
-            fprintf( stderr, "Incorrect password");
-            return false;
-        }
-        else{
-            return true;
+            h ^= rotl64( v[ i ] * P2, 31 ) * P1;
+            h = h * P1 + P4;
         }
     }
-}
+    else
+    {
+        h = seed + P5;
+    }
+    h += len;
+
+    for( ; key + 8 <= end; key += 8 )
+    {
+        h ^= rotl64( read64( key ) * P2, 31 ) * P1;
+        h = rotl64( h, 27 ) * P1 + P4;
+    }
+    if( key + 4 <= end )
+    {
+        uint32_t w;
+        memcpy( &w, key, sizeof( w ) );
+        h ^= ( uint64_t ) w * P1;
+        h = rotl64( h, 23 ) * P2 + P3;
+        key += 4;
+    }
+    for( ; key < end; ++key )
+    {
+        h ^= ( uint8_t ) *key * P5;
+        h = rotl64( h, 11 ) * P1;
+    }
 
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    return h ^ ( h >> 32 );
+}
 
 /**
- * @brief Reune la información necesaria para registrar a un usuario nuevo.
- *
- * @param ht Referencia a la tabla hash
+ * @brief Calcula el hash completo (sin reducir) de una llave. Los 7 bits bajos se
+ * guardan en el byte de control y el resto elige el grupo inicial.
  */
-void Sing_Up( Hash_table* ht )
+static inline size_t hash_key( const Hash_table* ht, const char* s, size_t len )
 {
-    getchar();
-    Users user;
-
-    fprintf( stderr, "\t-----DATA FOR REGISTRATION-----\n" );
-    fprintf( stderr, "Name: " );
-    fgets(user.name, TAM, stdin);
-
-    fprintf( stderr, "Mail: " );
-    fgets(user.mail, TAM, stdin);
+   return ht->hash( s, len, ht->seed );
+}
 
-    char pass1[ TAM_PSW ];
-    fprintf( stderr, "Password (4 characters): " );
-    fgets(pass1, TAM_PSW, stdin);
+/**
+ * @brief Longitud de una llave. Un nombre que llena su campo sin fin de cadena se corta en
+ * HT_NAME_MAX - 1 bytes, igual que al guardarlo.
+ */
+static inline size_t name_len( const char* name )
+{
+   return strnlen( name, HT_NAME_MAX - 1 );
+}
 
-    char pass2[ TAM_PSW ];
-    fprintf( stderr, "Confirm Password: " );
-    fgets(pass2, TAM_PSW, stdin);
+static inline size_t mail_len( const char* mail )
+{
+   return strnlen( mail, HT_MAIL_MAX - 1 );
+}
 
-    while( strcmp( pass1, pass2 ) )
-    {
-        fprintf( stderr, "Password doesn't match! Enter it again: ");
-        fgets(pass2, TAM_PSW, stdin);
-    }
-    strcpy(user.password, pass2);
+/**
+ * @brief Copia un texto a un campo de |size| bytes, cortándolo si no cabe, y le pone fin
+ * de cadena.
+ */
+static void copy_field( char* dst, size_t size, const char* src )
+{
+   size_t len = strnlen( src, size - 1 );
+   memcpy( dst, src, len );
+   dst[ len ] = '\0';
+}
 
-    fprintf( stderr, "Credit Card (16 numbers): " );
-    scanf("%ld", &user.credit_card);
+/**
+ * @brief Copia un nombre o correo a un campo de |size| bytes como lo deja fgets() en el alta
+ * interactiva: cortado si no cabe, con '\n' y fin de cadena. Así las búsquedas encuentran
+ * igual a los usuarios importados que a los demás.
+ */
+static void copy_key( char* dst, size_t size, const char* src )
+{
+   size_t len = strnlen( src, size - 2 );
+   memcpy( dst, src, len );
+   dst[ len ] = '\n';
+   dst[ len + 1 ] = '\0';
+}
 
-    if( HT_Insert( ht, &user ) )
+/**
+ * @brief Elige una semilla al azar para una tabla nueva.
+ */
+static uint64_t random_seed( void )
+{
+    uint64_t seed = 0;
+    FILE* f = fopen( "/dev/urandom", "rb" );
+    if( f )
     {
-        fprintf( stderr, "\t¡Successful registration!" );
-    }
-    else{
-        fprintf( stderr, "Registration couldn't be successful, please try again");
+        if( fread( &seed, sizeof( seed ), 1, f ) != 1 ) seed = 0;
+        fclose( f );
     }
+    // si no hay /dev/urandom, al menos no es la misma semilla en cada ejecución
+    if( seed == 0 ) seed = ( uint64_t ) time( NULL ) ^ ( uint64_t )( uintptr_t ) &seed;
+    return seed;
 }
 
+/**
+ * @brief Calcula el inicio del siguiente grupo de celdas a revisar en caso de una
+ * colisión. El sondeo es lineal por grupos de HT_GROUP_WIDTH celdas.
+ *
+ * @param pos Inicio del grupo actual.
+ * @param i Número de grupos revisados hasta ahora.
+ * @param mask capacity - 1.
+ *
+ * @return El inicio del siguiente grupo.
+ */
+static size_t probe( size_t pos, size_t i, size_t mask )
+{
+   (void) i;
+   return ( pos + HT_GROUP_WIDTH ) & mask;
+}
 
+/**
+ * @brief Compara los HT_GROUP_WIDTH bytes de control que empiezan en |ctrl| contra |h2|.
+ *
+ * @return Un mapa de bits con un 1 en cada celda cuyo byte de control vale |h2|.
+ */
+static inline uint32_t group_match( const uint8_t* ctrl, uint8_t h2 )
+{
+#ifdef __SSE2__
+   __m128i group = _mm_loadu_si128( ( const __m128i* ) ctrl );
+   return ( uint32_t ) _mm_movemask_epi8( _mm_cmpeq_epi8( group, _mm_set1_epi8( ( char ) h2 ) ) );
+#else
+   uint32_t mask = 0;
+   for( int i = 0; i < HT_GROUP_WIDTH; ++i ) mask |= ( uint32_t )( ctrl[ i ] == h2 ) << i;
+   return mask;
+#endif
+}
 
-//----------------------------------------------------------------------
-//                     Funciones privadas
-//----------------------------------------------------------------------
-
+/**
+ * @brief Mapa de bits de las celdas libres del grupo. Sólo las vacías tienen el bit alto
+ * encendido, así que basta con extraer ese bit de cada byte.
+ */
+static inline uint32_t group_match_free( const uint8_t* ctrl )
+{
+#ifdef __SSE2__
+   return ( uint32_t ) _mm_movemask_epi8( _mm_loadu_si128( ( const __m128i* ) ctrl ) );
+#else
+   uint32_t mask = 0;
+   for( int i = 0; i < HT_GROUP_WIDTH; ++i ) mask |= ( uint32_t )( ctrl[ i ] >> 7 ) << i;
+   return mask;
+#endif
+}
 
 /**
- * @brief Calcula el índice para la HT de una cadena de caracteres
- *
- * @param s que es la cadena a la que le vamos a calcular su índice
- *
- * @return Un entero que será usado como índice de la HT.
+ * @brief Mapa de bits de las celdas vacías del grupo.
  */
-size_t h_gon99( char* s, size_t m )
+static inline uint32_t group_match_empty( const uint8_t* ctrl )
 {
-    size_t res;
-    for( res=0; *s; ++s)
-    {
-        res = 131 * res + *s; 
-    }
+   return group_match( ctrl, CTRL_EMPTY );
+}
 
-    return res % m;
+/**
+ * @brief Escribe el byte de control de la celda |i|, manteniendo la copia del inicio del
+ * arreglo que permite leer un grupo completo a partir de cualquier celda.
+ */
+static inline void set_ctrl( HT_Array* a, size_t i, uint8_t v )
+{
+   a->ctrl[ i ] = v;
+   if( i < HT_GROUP_WIDTH ) a->ctrl[ a->capacity + i ] = v;
 }
 
 /**
- * @brief Calcula un nuevo índice para la HT de una cadena de caracteres en
- * caso de una colisión
+ * @brief Calcula el bloque del filtro de Bloom de una llave y el mapa de los bits que le
+ * corresponden dentro de él (ocho palabras de 64 bits, una línea de caché).
  *
- * @param key que es la cadena a la que le vamos a calcular su índice e i que
- * es el indice calculado previamente con h_gon99()
+ * Los bits salen de volver a mezclar el hash de la llave, así que no dependen de los que
+ * usa la tabla para elegir la celda.
  *
- * @return Un entero que será usado como nuevo índice para la HT.
+ * @return El índice del bloque.
  */
-static char probe( char* key, size_t i )
+static inline size_t bloom_locate( const HT_Array* a, size_t hash, uint64_t bits[ 8 ] )
 {
-   return i + 1;
+   uint64_t h = mum( hash ^ 0xA0761D6478BD642Full, 0xE7037ED1A0B428DBull );
+   uint32_t pos = ( uint32_t ) h;
+   uint32_t step = ( uint32_t )( h >> 32 ) | 1;
+
+   memset( bits, 0, 8 * sizeof( uint64_t ) );
+   for( unsigned i = 0; i < a->bloom_k; ++i, pos += step )
+   {
+      unsigned b = ( pos >> 23 ) & 511;
+      bits[ b >> 6 ] |= ( uint64_t ) 1 << ( b & 63 );
+   }
+   return ( size_t )( ( ( uint64_t ) hash >> 32 ) * a->bloom_blocks >> 32 );
 }
 
 /**
- * @brief Retoma la información del numero de registros
- *
- * @param Una tabla hash
+ * @brief Agrega una llave al filtro de Bloom de |a| (si tiene).
  *
- * @return El numero de registros en la HT
+ * @param shared true si otros hilos pueden estar agregando llaves al mismo tiempo
+ * (@see HT_BulkInsert); los bits se encienden entonces con operaciones atómicas.
  */
-int Len( Hash_table* ht )
+static inline void bloom_add( HT_Array* a, size_t hash, bool shared )
 {
-    return ht->len;
-}
+   if( NULL == a->bloom ) return;
 
+   uint64_t bits[ 8 ];
+   uint64_t* block = a->bloom + 8 * bloom_locate( a, hash, bits );
+   for( int w = 0; w < 8; ++w )
+   {
+      if( !bits[ w ] ) continue;
+      if( shared ) __atomic_fetch_or( &block[ w ], bits[ w ], __ATOMIC_RELAXED );
+      else block[ w ] |= bits[ w ];
+   }
+}
 
 /**
- * @brief Crea una nueva tabla hash
+ * @brief Consulta el filtro de Bloom de |a|. Sólo lee una línea de caché.
  *
- * @param capacity Número de celdas (slots) que tendrá la tabla. Es recomendable utilizar
- * un valor mayor al número de elementos que se quiere guardar
- * 
- * @return Una referencia a una tabla hash
+ * @return false si la llave seguro no está en |a|; true si puede estar (o no hay filtro).
  */
-Hash_table* HT_New( size_t capacity )
+static inline bool bloom_may_contain( const HT_Array* a, size_t hash )
 {
-   Hash_table* ht = ( Hash_table* )malloc( sizeof( Hash_table ) );
-   if( NULL != ht )
-   {
-      ht->len = 0;
-      ht->capacity = capacity;
+   if( NULL == a->bloom ) return true;
 
-      ht->table = ( Users* ) malloc( capacity * sizeof( Users ) );
-      if( NULL != ht->table )
-      {
-         for( int i = 0; i < ht->capacity; ++i )
-         {
-            ht->table[ i ].state = EMPTY_CELL;
-            // en esta aplicación los ID's son enteros positivos
+   uint64_t bits[ 8 ];
+   const uint64_t* block = a->bloom + 8 * bloom_locate( a, hash, bits );
+   uint64_t miss = 0;
+   for( int w = 0; w < 8; ++w ) miss |= bits[ w ] & ~block[ w ];
+   return miss == 0;
+}
 
-            strncpy(ht->table[ i ].password, "", TAM_PSW );
-         }
-      }
-      else
-      {
-         free( ht );
-         ht = NULL;
-      }
-   }
+/**
+ * @brief Compara la cadena |s| de la arena |ar| contra |len| bytes de |key|: primero el
+ * hash y la longitud, y sólo si coinciden los bytes. La posición se acota contra la
+ * arena porque un lector optimista puede ver un encabezado a medio escribir.
+ */
+static inline bool str_equals( const HT_Arena* ar, const HT_Str* s, const char* key, size_t len, uint64_t hash )
+{
+   return s->hash == hash && s->len == len &&
+          s->offset <= ar->cap && len <= ar->cap - s->offset &&
+          memcmp( ar->data + s->offset, key, len ) == 0;
+}
 
-   return ht;
+/**
+ * @brief Copia la cadena |s| de la arena |ar| a |dst| (de |cap| bytes) con su fin de
+ * cadena. Acotada igual que str_equals().
+ */
+static void str_copy( const HT_Arena* ar, const HT_Str* s, char* dst, size_t cap )
+{
+   size_t len = s->len < cap ? s->len : cap - 1;
+   if( s->offset > ar->cap || len > ar->cap - s->offset ) len = 0;
+   memcpy( dst, ar->data + s->offset, len );
+   dst[ len ] = '\0';
 }
 
 /**
- * @brief Destruye una tabla hash
+ * @brief Escribe |len| bytes de |s| y su fin de cadena en la posición |offset| de la
+ * arena.
  *
- * @param ht La dirección de una referencia a una tabla hash
+ * @pre El lugar ya está reservado (@see arena_reserve).
+ *
+ * @return La referencia a la cadena guardada.
  */
-void HT_Delete( Hash_table** ht )
+static inline HT_Str arena_put( HT_Arena* ar, size_t offset, const char* s, size_t len, uint64_t hash )
 {
-   assert( ht );
+   memcpy( ar->data + offset, s, len );
+   ar->data[ offset + len ] = '\0';
+   return ( HT_Str ){ hash, ( uint32_t ) offset, ( uint32_t ) len };
+}
 
-   free( (*ht)->table );
-   free( *ht );
-   *ht = NULL;
+/**
+ * @brief Bytes de arena que ocupan las cadenas de un registro.
+ */
+static inline size_t user_bytes( const Users* user )
+{
+   return name_len( user->name ) + mail_len( user->mail ) + 2;
+}
+
+static inline size_t slot_bytes( const HT_Slot* slot )
+{
+   return ( size_t ) slot->name.len + slot->mail.len + 2;
 }
 
 /**
- * @brief Inserta el campo |name| en la tabla hash.
+ * @brief Busca la llave |name| en un arreglo concreto (el actual o el viejo).
  *
- * @param ht Referencia a una tabla hash
- * @param user Referencia a un usuario a registrar
+ * @param a Arreglo de celdas.
+ * @param name La llave de búsqueda.
+ * @param len La longitud de |name| (@see name_len).
+ * @param hash El hash de |name| (@see hash_key).
  *
- * @return true si el elemento pudo ser insertado; false en caso contrario (elemento
- * duplicado, tabla llena, etc).
+ * @return El índice de la celda que contiene a |name|; -1 si no está.
  */
-bool HT_Insert( Hash_table* ht, Users* user )
+static long find_slot( const HT_Array* a, const char* name, size_t len, size_t hash )
 {
-   assert( ht );
-   assert( !HT_IsFull(ht) );
+   size_t mask = a->capacity - 1;
+   size_t pos = ( hash >> 7 ) & mask;
+   uint8_t h2 = hash & 0x7F;
 
-   int pos;
-   // índice que se actualizará en cada colisión
+   // la mayoría de las búsquedas fallidas terminan aquí, sin recorrer el sondeo
+   if( !bloom_may_contain( a, hash ) ) return -1;
 
-   // calcula una hash key base
-   int home = pos = h_gon99( user->name, ht->capacity );
+   // la arena se lee una sola vez, como los arreglos en lookup()
+   const HT_Arena* ar = __atomic_load_n( &a->arena, __ATOMIC_ACQUIRE );
 
-   int i = 0;
+   for( size_t i = 0; i <= mask / HT_GROUP_WIDTH; ++i )
+   {
+      const uint8_t* group = a->ctrl + pos;
 
-   // si el slot está desocupado, se salta el while; en caso contrario entra a buscar uno.
-   // Asumimos que hay más slots que datos a guardar:
-    while( ht->table[ pos ].state == -3 )
-    {
-      // no aceptamos duplicados:
-      if( ht->table[ pos ].name == user->name )
+      for( uint32_t m = group_match( group, h2 ); m; m &= m - 1 )
       {
-         //Llave duplicada
-         return false;
+         size_t idx = ( pos + __builtin_ctz( m ) ) & mask;
+         if( str_equals( ar, &a->slots[ idx ].name, name, len, hash ) ) return idx;
       }
 
-      pos = ( home + probe( user->name, i ) ) % ht->capacity;
-      ++i;
-    }
-
-    strncpy(ht->table[ pos ].name, user->name, TAM );
-    strncpy(ht->table[ pos ].mail, user->mail, TAM );
-    strncpy(ht->table[ pos ].password, user->password, TAM_PSW );
-    ht->table[ pos ].credit_card = user->credit_card;
-    ht->table[ pos ].state = USED_CELL;
+      if( group_match_empty( group ) ) return -1;
 
-   ++ht->len;
-
-   return true;
+      pos = probe( pos, i, mask );
+   }
+   return -1;
 }
 
 /**
- * @brief Verifica si la tabla hash está vacía o no.
- *
- * @param ht Referencia a una tabla hash.
- *
- * @return true la tabla hash está vacía; false en caso contrario.
+ * @brief Hash del campo |mail| para el índice secundario. Usa la misma función que las
+ * llaves pero con otra semilla.
  */
-bool HT_IsEmpty( const Hash_table* ht )
+static inline size_t mail_hash( const Hash_table* ht, const char* mail, size_t len )
 {
-   return ht->len == 0;
+   return ht->hash( mail, len, ht->seed ^ 0x6D61696C6D61696Cull );
 }
 
 /**
- * @brief Verifica si la tabla hash está llena o no.
- *
- * @param ht Referencia a una tabla hash.
- *
- * @return true la tabla hash está llena; false en caso contrario.
+ * @brief Agrega al índice por correo de |a| una entrada hacia la celda |slot|. El índice
+ * es de sondeo lineal; la celda de origen es |mhash| & mask. Los usuarios sin correo no
+ * se indexan (todos caerían en la misma cadena).
  */
-bool HT_IsFull( const Hash_table* ht )
+static void mail_insert( HT_Array* a, size_t slot, size_t mhash )
 {
-   return ht->len == ht->capacity;
-}
+   size_t mask = a->capacity - 1;
+   size_t pos = mhash & mask;
+   while( a->mail[ pos ].slot != 0 ) pos = ( pos + 1 ) & mask;
 
+   a->mail[ pos ].tag = ( uint32_t ) mhash;
+   a->mail[ pos ].slot = ( uint32_t ) slot + 1;
+}
 
 /**
- * @brief Busca en la tabla hash los datos de usuario correspondiente a la llave 
- * name del empleado.
- *
- * @param ht Referencia a una tabla hash.
- * @param user Argumento que guardará los datos del usuario (en caso de que éste 
- * exista en la tabla hash)
+ * @brief Encuentra la entrada del índice por correo que apunta a la celda |slot|.
  *
- * @return true si el elemento fue encontrado; false en caso contrario.
+ * @pre La celda está ocupada y |mhash| es el hash de su correo.
  */
-bool HT_Search( const Hash_table* ht, Users* user )
+static size_t mail_entry_of( const HT_Array* a, size_t slot, size_t mhash )
 {
-   assert( ht );
-   assert( ht->len > 0 );
+   size_t mask = a->capacity - 1;
+   size_t pos = mhash & mask;
+   while( a->mail[ pos ].slot != slot + 1 ) pos = ( pos + 1 ) & mask;
+   return pos;
+}
 
-   int home = h_gon99( user->name, ht->capacity);
-   int pos = home;
+/**
+ * @brief Quita del índice por correo la entrada de la celda |slot|, recorriendo hacia
+ * atrás las entradas siguientes igual que @see backward_shift.
+ */
+static void mail_remove( HT_Array* a, size_t slot, size_t mhash )
+{
+   size_t mask = a->capacity - 1;
+   size_t hole = mail_entry_of( a, slot, mhash );
 
-   bool found = false;
-   if( strcmp( ht->table[ pos ].name, user->name ) )
-   {
-      found = true;
-   }
-   else if( ht->table[ pos ].state == EMPTY_CELL )
-   {
-      found = false;
-   }
-   else
+   for( size_t j = ( hole + 1 ) & mask; a->mail[ j ].slot != 0; j = ( j + 1 ) & mask )
    {
-      int i = 0;
-      while( ht->table[ pos ].state != EMPTY_CELL && found == false )
+      size_t home = a->mail[ j ].tag & mask;
+      if( ( ( j - home ) & mask ) >= ( ( j - hole ) & mask ) )
       {
-         pos = ( home + probe( user->name, i ) ) % ht->capacity;
-         ++i;
-
-         if( strcmp( ht->table[ pos ].name, user->name ) )
-         {
-            found = true;
-         }
+         a->mail[ hole ] = a->mail[ j ];
+         hole = j;
       }
    }
+   a->mail[ hole ].slot = 0;
+}
 
-   bool ret_val = false;
-   if( found )
+/**
+ * @brief Busca por correo en un arreglo concreto.
+ *
+ * @return La celda del primer usuario con ese correo; -1 si no hay.
+ */
+static long find_mail( const HT_Array* a, const char* mail, size_t len, size_t mhash )
+{
+   size_t mask = a->capacity - 1;
+   size_t pos = mhash & mask;
+   uint32_t tag = ( uint32_t ) mhash;
+   const HT_Arena* ar = __atomic_load_n( &a->arena, __ATOMIC_ACQUIRE );
+
+   for( size_t i = 0; i < a->capacity; ++i )
    {
-        strncpy(ht->table[ pos ].name, user->name, TAM );
-        strncpy(ht->table[ pos ].mail, user->mail, TAM );
-        strncpy(ht->table[ pos ].password, user->password, TAM_PSW );
-        ht->table[ pos ].credit_card = user->credit_card;
-        ht->table[ pos ].state = DELETED_CELL;
-        ret_val = true;
+      HT_MailEntry e = a->mail[ pos ];
+      if( e.slot == 0 ) return -1;
+
+      size_t slot = ( e.slot - 1 ) & mask;
+      if( e.tag == tag && !( a->ctrl[ slot ] & 0x80 ) &&
+          str_equals( ar, &a->slots[ slot ].mail, mail, len, mhash ) )
+      {
+         return slot;
+      }
+      pos = ( pos + 1 ) & mask;
    }
-   return ret_val;
+   return -1;
 }
 
 /**
- * @brief Elimina una entrada en la tabla hash.
- *
- * @param ht Referencia a una tabla hash.
- * @param name La llave de la entrada que se desea eliminar.
+ * @brief Busca la primera celda libre de la secuencia de sondeo de |hash|.
  *
- * @return true si el elemento existía; false si el elemento no existe.
+ * @pre Hay al menos una celda libre.
  */
-bool HT_Remove( Hash_table* ht, char* name )
+static size_t free_cell( const HT_Array* a, size_t hash )
 {
-   int home = h_gon99( name, ht->capacity);
+   size_t mask = a->capacity - 1;
+   size_t pos = ( hash >> 7 ) & mask;
 
-    if( strcmp( ht->table[home].name, name ) )
-    {
-        strncpy(ht->table[home].name, " ", TAM);
-        strncpy(ht->table[home].mail, " ", TAM);
-        strncpy(ht->table[home].password, " ", TAM_PSW );
-        ht->table[home].credit_card = 0;
-        ht->table[home].state = DELETED_CELL;
+   uint32_t m;
+   for( size_t i = 0; ( m = group_match_free( a->ctrl + pos ) ) == 0; ++i )
+   {
+      pos = probe( pos, i, mask );
+   }
+   return ( pos + __builtin_ctz( m ) ) & mask;
+}
 
-        --ht->len;
+/**
+ * @brief Copia un registro a la celda libre |pos| y la marca como ocupada. Las cadenas
+ * van a la arena a partir de |offset|. No toca el índice por correo.
+ *
+ * @pre Los user_bytes( user ) bytes a partir de |offset| están reservados para él.
+ */
+static void fill_cell( HT_Array* a, size_t pos, const Users* user, size_t hash, size_t mhash, size_t offset )
+{
+   HT_Slot* slot = &a->slots[ pos ];
+   slot->name = arena_put( a->arena, offset, user->name, name_len( user->name ), hash );
+   slot->mail = arena_put( a->arena, offset + slot->name.len + 1, user->mail, mail_len( user->mail ), mhash );
+   slot->password = user->password;
+   slot->credit_card = user->credit_card;
+   set_ctrl( a, pos, hash & 0x7F );
+}
 
-        return true;
+/**
+ * @brief Coloca un registro en la primera celda vacía de su secuencia de sondeo. No
+ * verifica duplicados.
+ *
+ * @param a Arreglo de celdas.
+ * @param user Registro a copiar.
+ * @param hash El hash de |user->name|.
+ * @param mhash El hash de |user->mail| (@see mail_hash).
+ *
+ * @pre La arena de |a| tiene lugar para las cadenas (@see arena_reserve).
+ */
+static void place( HT_Array* a, const Users* user, size_t hash, size_t mhash )
+{
+   size_t pos = free_cell( a, hash );
+   fill_cell( a, pos, user, hash, mhash, a->arena->len );
+   a->arena->len += user_bytes( user );
+   bloom_add( a, hash, false );
+
+   if( user->mail[ 0 ] != '\0' ) mail_insert( a, pos, mhash );
+}
+
+/**
+ * @brief Mueve el registro de la celda |i| de |from| a la primera celda vacía de |to|,
+ * copiando sus cadenas a la arena de |to|. Los hashes viajan con el registro, así que no
+ * se vuelven a calcular.
+ *
+ * @pre La arena de |to| tiene lugar para las cadenas.
+ */
+static void move_cell( HT_Array* to, const HT_Array* from, size_t i )
+{
+   const HT_Slot* src = &from->slots[ i ];
+   HT_Arena* ar = to->arena;
+
+   size_t pos = free_cell( to, src->name.hash );
+   HT_Slot* dst = &to->slots[ pos ];
+   *dst = *src;
+   dst->name = arena_put( ar, ar->len, from->arena->data + src->name.offset, src->name.len, src->name.hash );
+   dst->mail = arena_put( ar, ar->len + src->name.len + 1, from->arena->data + src->mail.offset,
+                          src->mail.len, src->mail.hash );
+   ar->len += slot_bytes( src );
+   set_ctrl( to, pos, src->name.hash & 0x7F );
+   bloom_add( to, src->name.hash, false );
+
+   if( src->mail.len > 0 ) mail_insert( to, pos, src->mail.hash );
+}
+
+/**
+ * @brief Libera la celda |pos| de |a| sin dejar una celda borrada (algoritmo R de Knuth).
+ *
+ * Se recorre el grupo de celdas ocupadas que sigue a |pos|; un registro en la celda j
+ * cuya celda de origen no está en el intervalo circular (i, j] puede ocupar el hueco i,
+ * y entonces el hueco pasa a j. Al final el hueco se marca como vacío. Ninguna llave
+ * queda detrás de una celda vacía respecto a su celda de origen, que es lo que supone
+ * find_slot().
+ *
+ * Durante un rehash el recorrido nunca cruza la zona ya migrada de la tabla vieja,
+ * porque esa zona empieza con una celda vacía.
+ *
+ * Las cadenas del registro se quedan en la arena como basura.
+ *
+ * @param a Arreglo que contiene la celda.
+ * @param pos Celda a liberar.
+ */
+static void backward_shift( HT_Array* a, size_t pos )
+{
+   size_t mask = a->capacity - 1;
+   size_t hole = pos;
+
+   if( a->slots[ pos ].mail.len > 0 ) mail_remove( a, pos, a->slots[ pos ].mail.hash );
+   a->arena->garbage += slot_bytes( &a->slots[ pos ] );
+
+   for( size_t j = ( pos + 1 ) & mask; a->ctrl[ j ] != CTRL_EMPTY; j = ( j + 1 ) & mask )
+   {
+      size_t home = ( a->slots[ j ].name.hash >> 7 ) & mask;
+      if( ( ( j - home ) & mask ) >= ( ( j - hole ) & mask ) )
+      {
+         // el índice por correo apunta a la celda; hay que seguir al registro
+         if( a->slots[ j ].mail.len > 0 )
+         {
+            size_t e = mail_entry_of( a, j, a->slots[ j ].mail.hash );
+            a->mail[ e ].slot = ( uint32_t ) hole + 1;
+         }
+
+         a->slots[ hole ] = a->slots[ j ];
+         set_ctrl( a, hole, a->ctrl[ j ] );
+         hole = j;
+      }
+   }
+
+   set_ctrl( a, hole, CTRL_EMPTY );
+}
+
+/**
+ * @brief Reserva un arreglo de celdas vacías. El encabezado, los registros y los bytes de
+ * control van en un solo bloque, así que un puntero a HT_Array basta para ver siempre
+ * una capacidad y unos arreglos consistentes entre sí.
+ *
+ * Si la tabla usa filtro de Bloom (@see HT_SetBloom), el filtro también va en el bloque,
+ * dimensionado para las llaves que caben antes de que la tabla crezca; por eso se
+ * reconstruye solo (y sin los bits de llaves borradas) cada vez que la tabla cambia de
+ * arreglo.
+ *
+ * La arena de cadenas es un bloque aparte, porque crece independientemente de las celdas.
+ *
+ * @param ht La tabla a la que pertenecerá el arreglo.
+ * @param capacity Número de celdas; potencia de 2 y al menos HT_GROUP_WIDTH.
+ * @param bytes Tamaño inicial de la arena.
+ *
+ * @return El arreglo, o NULL si no hubo memoria.
+ */
+static HT_Array* array_new( const Hash_table* ht, size_t capacity, size_t bytes )
+{
+   size_t blocks = 0;
+   unsigned k = 0;
+   if( ht->bloom_fpr > 0.0 )
+   {
+      // bits por llave de un filtro clásico, más un 25% por concentrar cada llave en un
+      // solo bloque
+      double bits_per_key = -log( ht->bloom_fpr ) / ( M_LN2 * M_LN2 );
+      double keys = ht->max_load * capacity;
+      k = ( unsigned ) lround( bits_per_key * M_LN2 );
+      k = k < 1 ? 1 : k > 16 ? 16 : k;
+
+      blocks = ( size_t ) ceil( keys * bits_per_key * 1.25 / 512 );
+   }
+
+   size_t header = ( sizeof( HT_Array ) + 63 ) & ~( size_t ) 63;
+   size_t body = ( capacity * ( sizeof( HT_Slot ) + sizeof( HT_MailEntry ) ) + capacity + HT_GROUP_WIDTH + 63 ) &
+                 ~( size_t ) 63;
+   if( bytes > UINT32_MAX ) bytes = UINT32_MAX;
+   HT_Array* a = ( HT_Array* ) aligned_alloc( 64, header + body + blocks * 64 );
+   HT_Arena* ar = ( HT_Arena* ) malloc( sizeof( HT_Arena ) + bytes );
+   if( NULL == a || NULL == ar )
+   {
+      free( a );
+      free( ar );
+      return NULL;
+   }
+   else
+   {
+      ar->cap = bytes;
+      ar->len = 0;
+      ar->garbage = 0;
+      a->arena = ar;
+
+      a->capacity = capacity;
+      a->slots = ( HT_Slot* )( ( char* ) a + header );
+      a->mail = ( HT_MailEntry* )( a->slots + capacity );
+      a->ctrl = ( uint8_t* )( a->mail + capacity );
+      memset( a->mail, 0, capacity * sizeof( HT_MailEntry ) );
+      memset( a->ctrl, CTRL_EMPTY, capacity + HT_GROUP_WIDTH );
+
+      a->bloom = blocks ? ( uint64_t* )( ( char* ) a + header + body ) : NULL;
+      a->bloom_blocks = blocks;
+      a->bloom_k = k;
+      a->bloom_stale = 0;
+      if( a->bloom ) memset( a->bloom, 0, blocks * 64 );
+   }
+   return a;
+}
+
+/**
+ * @brief Libera un bloque (un arreglo o una arena) que ya no es alcanzable desde la
+ * tabla. Si la tabla tiene un @see HT_SetRetire, el bloque se le entrega en lugar de
+ * liberarlo, porque puede haber lectores concurrentes que todavía lo estén recorriendo.
+ */
+static void retire_block( Hash_table* ht, void* block )
+{
+   if( ht->retire ) ht->retire( block, ht->retire_ctx );
+   else free( block );
+}
+
+static void array_retire( Hash_table* ht, HT_Array* a )
+{
+   retire_block( ht, a->arena );
+   retire_block( ht, a );
+}
+
+/**
+ * @brief Garantiza que la arena de |a| tiene lugar para |bytes| bytes más. Si no, la
+ * copia a un bloque del doble de tamaño y retira la anterior.
+ *
+ * @return false si no hubo memoria o la arena rebasaría los 4 GiB que alcanzan las
+ * posiciones de 32 bits.
+ */
+static bool arena_reserve( Hash_table* ht, HT_Array* a, size_t bytes )
+{
+   HT_Arena* ar = a->arena;
+   if( bytes <= ar->cap - ar->len ) return true;
+
+   size_t cap = ar->cap * 2 > ar->len + bytes ? ar->cap * 2 : ar->len + bytes;
+   if( cap > UINT32_MAX ) cap = UINT32_MAX;
+   if( ar->len + bytes > cap ) return false;
+
+   HT_Arena* grown = ( HT_Arena* ) malloc( sizeof( HT_Arena ) + cap );
+   if( NULL == grown ) return false;
+
+   memcpy( grown->data, ar->data, ar->len );
+   grown->cap = cap;
+   grown->len = ar->len;
+   grown->garbage = ar->garbage;
+
+   __atomic_store_n( &a->arena, grown, __ATOMIC_RELEASE );
+   retire_block( ht, ar );
+   return true;
+}
+
+/**
+ * @brief Busca |name| en la tabla actual y, si hay un rehash en curso, en la vieja.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param name La llave de búsqueda.
+ * @param len La longitud de |name|.
+ * @param hash El hash de |name|.
+ * @param where Devuelve el arreglo en el que se encontró la llave.
+ *
+ * @return El índice de la celda dentro de |*where|; -1 si la llave no existe.
+ */
+static long lookup( const Hash_table* ht, const char* name, size_t len, size_t hash, const HT_Array** where )
+{
+   // cada puntero se lee una sola vez: @see HT_SearchOptimistic los lee mientras otro
+   // hilo puede estar cambiándolos
+   const HT_Array* table = __atomic_load_n( &ht->table, __ATOMIC_ACQUIRE );
+   const HT_Array* old = __atomic_load_n( &ht->old_table, __ATOMIC_ACQUIRE );
+
+   *where = table;
+   long pos = find_slot( table, name, len, hash );
+   if( pos < 0 && old )
+   {
+      *where = old;
+      pos = find_slot( old, name, len, hash );
+   }
+   return pos;
+}
+
+/**
+ * @brief Migra a lo más |steps| celdas de la tabla vieja a la tabla actual.
+ *
+ * Las celdas se recorren hacia atrás a partir de una celda vacía, de modo que la
+ * celda que se vacía siempre es la última de su grupo de celdas ocupadas y ninguna
+ * secuencia de sondeo de la tabla vieja se rompe a la mitad. Sólo las cadenas vivas se
+ * copian a la arena nueva, así que migrar también compacta la arena.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param steps Número máximo de celdas a migrar.
+ */
+static void rehash_step( Hash_table* ht, size_t steps )
+{
+   HT_Array* old = ht->old_table;
+
+   while( old && steps > 0 )
+   {
+      size_t i = ht->rehash_idx;
+      if( !( old->ctrl[ i ] & 0x80 ) )
+      {
+         // sin memoria para la arena la celda se queda donde está; se reintenta después
+         const HT_Slot* cell = &old->slots[ i ];
+         if( !arena_reserve( ht, ht->table, slot_bytes( cell ) ) ) return;
+
+         if( cell->mail.len > 0 ) mail_remove( old, i, cell->mail.hash );
+         move_cell( ht->table, old, i );
+      }
+      set_ctrl( old, i, CTRL_EMPTY );
+
+      ht->rehash_idx = ( i - 1 ) & ( old->capacity - 1 );
+      --ht->rehash_left;
+      --steps;
+
+      if( ht->rehash_left == 0 )
+      {
+         __atomic_store_n( &ht->old_table, NULL, __ATOMIC_RELEASE );
+         array_retire( ht, old );
+         old = NULL;
+      }
+   }
+}
+
+/**
+ * @brief Inicia un rehash incremental hacia una tabla de |capacity| celdas. Si ya
+ * había uno en curso, primero lo termina.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param capacity Número de celdas de la nueva tabla.
+ *
+ * @return true si la nueva tabla se pudo crear; false en caso contrario.
+ */
+static bool rehash_start( Hash_table* ht, size_t capacity )
+{
+   rehash_step( ht, ht->rehash_left );
+   if( ht->old_table ) return false;
+
+   // la arena nueva empieza con lugar para las cadenas vivas, escaladas al tamaño nuevo
+   HT_Array* old = ht->table;
+   size_t live = old->arena->len - old->arena->garbage;
+   HT_Array* table = array_new( ht, capacity, live * ( capacity / old->capacity ) + live / 4 + HT_ARENA_BYTES );
+   if( NULL == table ) return false;
+
+   // la migración empieza en una celda vacía; siempre hay una porque el factor de
+   // carga nunca llega a 1
+   size_t start = 0;
+   while( start < old->capacity && old->ctrl[ start ] != CTRL_EMPTY ) ++start;
+
+   ht->rehash_idx = start & ( old->capacity - 1 );
+   ht->rehash_left = old->capacity;
+
+   // la tabla vieja se publica antes que la nueva para que un lector concurrente nunca
+   // vea una tabla nueva vacía sin la vieja
+   __atomic_store_n( &ht->old_table, old, __ATOMIC_RELEASE );
+   __atomic_store_n( &ht->table, table, __ATOMIC_RELEASE );
+
+   return true;
+}
+
+/**
+ * @brief Retoma la información del numero de registros
+ *
+ * @param Una tabla hash
+ *
+ * @return El numero de registros en la HT
+ */
+int Len( Hash_table* ht )
+{
+    return ht->len;
+}
+
+
+/**
+ * @brief Crea una nueva tabla hash
+ *
+ * @param capacity Número de celdas (slots) que tendrá la tabla al inicio; se redondea a
+ * la siguiente potencia de 2 (mínimo HT_GROUP_WIDTH). La tabla crece por sí sola cuando
+ * su factor de carga rebasa @see HT_SetMaxLoadFactor
+ * 
+ * @return Una referencia a una tabla hash
+ */
+Hash_table* HT_New( size_t capacity )
+{
+   size_t cap = HT_GROUP_WIDTH;
+   while( cap < capacity ) cap *= 2;
+
+   Hash_table* ht = ( Hash_table* )malloc( sizeof( Hash_table ) );
+   if( NULL != ht )
+   {
+      ht->len = 0;
+      ht->max_load = HT_MAX_LOAD_FACTOR;
+      ht->hash = HT_Hash_Wy;
+      ht->seed = random_seed();
+
+      ht->retire = NULL;
+      ht->retire_ctx = NULL;
+      ht->logger = NULL;
+      ht->logger_ctx = NULL;
+
+      ht->bloom_fpr = 0.0;
+
+      ht->old_table = NULL;
+      ht->rehash_idx = 0;
+      ht->rehash_left = 0;
+
+      ht->table = array_new( ht, cap, cap * HT_ARENA_BYTES );
+      if( NULL == ht->table )
+      {
+         free( ht );
+         ht = NULL;
+      }
+   }
+
+   return ht;
+}
+
+/**
+ * @brief Destruye una tabla hash
+ *
+ * @param ht La dirección de una referencia a una tabla hash
+ */
+void HT_Delete( Hash_table** ht )
+{
+   assert( ht );
+
+   if( (*ht)->old_table ) free( (*ht)->old_table->arena );
+   free( (*ht)->old_table );
+   free( (*ht)->table->arena );
+   free( (*ht)->table );
+   free( *ht );
+   *ht = NULL;
+}
+
+/**
+ * @brief Cambia el factor de carga a partir del cual la tabla crece.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param max_load Fracción de celdas ocupadas, entre 0.25 y 0.95. Con valores
+ * menores a 0.25 la migración incremental no alcanzaría a terminar antes del siguiente
+ * crecimiento.
+ */
+void HT_SetMaxLoadFactor( Hash_table* ht, double max_load )
+{
+   assert( ht );
+   assert( 0.25 <= max_load && max_load <= 0.95 );
+
+   ht->max_load = max_load;
+}
+
+/**
+ * @brief Indica si hay una migración incremental en curso.
+ *
+ * @param ht Referencia a una tabla hash.
+ *
+ * @return true si todavía quedan celdas en la tabla vieja; false en caso contrario.
+ */
+bool HT_IsRehashing( const Hash_table* ht )
+{
+   return ht->old_table != NULL;
+}
+
+/**
+ * @brief Instala la función que recibe los arreglos y arenas viejos en lugar de
+ * liberarlos directamente (@see retire_block). La usa el almacén concurrente
+ * (@see CHT_New) para diferir la liberación hasta que ningún lector los esté usando.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param retire Función que se hace cargo del bloque (que se libera con free()); NULL
+ * para liberarlo con free() de inmediato.
+ * @param ctx Argumento que se le pasa a |retire|.
+ */
+void HT_SetRetire( Hash_table* ht, void (*retire)( void*, void* ), void* ctx )
+{
+   assert( ht );
+
+   ht->retire = retire;
+   ht->retire_ctx = ctx;
+}
+
+/**
+ * @brief Instala la función que se entera de cada alta y baja exitosa, por ejemplo para
+ * escribirla en un diario (@see Store_Open). La llamada ocurre cuando la tabla ya refleja
+ * la operación, así que el registrador puede recorrerla.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param logger Recibe la operación (HT_LOG_INSERT o HT_LOG_REMOVE), la llave y, en las
+ * altas, el registro; NULL para no notificar.
+ * @param ctx Argumento que se le pasa a |logger|.
+ */
+void HT_SetLogger( Hash_table* ht, void (*logger)( int, const char*, const Users*, void* ), void* ctx )
+{
+   assert( ht );
+
+   ht->logger = logger;
+   ht->logger_ctx = ctx;
+}
+
+/**
+ * @brief Activa (o desactiva) el filtro de Bloom que precede a la tabla, para que la
+ * mayoría de las búsquedas de llaves inexistentes (y la verificación de duplicados al
+ * insertar) terminen después de leer una sola línea de caché.
+ *
+ * El filtro vive dentro de cada arreglo de celdas: si la tabla ya tiene registros, se
+ * inicia una migración incremental a un arreglo del mismo tamaño que ya trae el filtro.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param fpr Tasa de falsos positivos deseada, entre 0 y 0.5 (p. ej. HT_BLOOM_FPR); 0
+ * para quitar el filtro. Más pequeña significa un filtro más grande.
+ *
+ * @return true si la migración empezó; false si no hubo memoria para el arreglo nuevo o
+ * no se pudo terminar la migración en curso. En ese caso la tabla queda como estaba.
+ */
+bool HT_SetBloom( Hash_table* ht, double fpr )
+{
+   assert( ht );
+   assert( 0.0 <= fpr && fpr <= 0.5 );
+
+   // array_new dimensiona el filtro con |bloom_fpr|
+   double previous = ht->bloom_fpr;
+   ht->bloom_fpr = fpr;
+   if( rehash_start( ht, ht->table->capacity ) ) return true;
+   ht->bloom_fpr = previous;
+   return false;
+}
+
+/**
+ * @brief Cambia la función hash de la tabla.
+ *
+ * @param ht Referencia a una tabla hash vacía (las llaves ya guardadas quedarían en
+ * posiciones que la nueva función no encontraría).
+ * @param kind La función a utilizar.
+ * @param seed La semilla.
+ */
+void HT_SetHash( Hash_table* ht, eHTHash kind, uint64_t seed )
+{
+   assert( ht );
+   assert( HT_IsEmpty( ht ) );
+
+   switch( kind )
+   {
+      case eHTHash_GON99:  ht->hash = HT_Hash_Gon99; break;
+      case eHTHash_XXHASH: ht->hash = HT_Hash_XX;    break;
+      case eHTHash_WYHASH:
+      default:             ht->hash = HT_Hash_Wy;    break;
+   }
+   ht->seed = seed;
+}
+
+/**
+ * @brief Inserta el campo |name| en la tabla hash.
+ *
+ * Si al insertar se rebasaría el factor de carga, se crea una tabla nueva del doble de
+ * tamaño y los registros se migran unos cuantos por operación.
+ *
+ * @param ht Referencia a una tabla hash
+ * @param user Referencia a un usuario a registrar
+ *
+ * @return true si el elemento pudo ser insertado; false en caso contrario (elemento
+ * duplicado, sin memoria, etc).
+ */
+bool HT_Insert( Hash_table* ht, Users* user )
+{
+   assert( ht );
+
+   rehash_step( ht, HT_REHASH_STEPS );
+
+   // no aceptamos duplicados:
+   size_t len = name_len( user->name );
+   size_t hash = hash_key( ht, user->name, len );
+   const HT_Array* where;
+   if( lookup( ht, user->name, len, hash, &where ) >= 0 ) return false;
+
+   size_t capacity = ht->table->capacity;
+   if( ( double )( ht->len + 1 ) > ht->max_load * capacity )
+   {
+      if( !rehash_start( ht, capacity * 2 ) && ht->len + 1 >= capacity )
+      {
+         // sin memoria y sin espacio
+         return false;
+      }
+      rehash_step( ht, HT_REHASH_STEPS );
+   }
+
+   if( !arena_reserve( ht, ht->table, user_bytes( user ) ) ) return false;
+   place( ht->table, user, hash, mail_hash( ht, user->mail, mail_len( user->mail ) ) );
+
+   ++ht->len;
+
+   if( ht->logger ) ht->logger( HT_LOG_INSERT, user->name, user, ht->logger_ctx );
+
+   return true;
+}
+
+/**
+ * @brief Verifica si la tabla hash está vacía o no.
+ *
+ * @param ht Referencia a una tabla hash.
+ *
+ * @return true la tabla hash está vacía; false en caso contrario.
+ */
+bool HT_IsEmpty( const Hash_table* ht )
+{
+   return ht->len == 0;
+}
+
+/**
+ * @brief Verifica si la tabla hash está llena o no.
+ *
+ * @param ht Referencia a una tabla hash.
+ *
+ * @return true la tabla hash está llena; false en caso contrario.
+ */
+bool HT_IsFull( const Hash_table* ht )
+{
+   return ht->len == ht->table->capacity;
+}
+
+
+/**
+ * @brief Busca en la tabla hash los datos de usuario correspondiente a la llave 
+ * name del empleado.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param user Argumento que guardará los datos del usuario (en caso de que éste 
+ * exista en la tabla hash)
+ *
+ * @return true si el elemento fue encontrado; false en caso contrario.
+ */
+bool HT_Search( const Hash_table* ht, Users* user )
+{
+   assert( ht );
+   assert( ht->len > 0 );
+
+   return HT_SearchOptimistic( ht, user );
+}
+
+/**
+ * @brief Igual que @see HT_Search, pero sin exigir que la tabla tenga elementos y
+ * tolerando que otro hilo la modifique al mismo tiempo: todos los recorridos están
+ * acotados y cada arreglo se lee a través de un único puntero. El resultado sólo es
+ * válido si el llamador comprueba después que no hubo una escritura concurrente (por
+ * ejemplo con el contador de secuencia de @see CHT_Search).
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param user Llave de búsqueda y destino de los datos.
+ *
+ * @return true si el elemento fue encontrado; false en caso contrario.
+ */
+bool HT_SearchOptimistic( const Hash_table* ht, Users* user )
+{
+   size_t len = name_len( user->name );
+   const HT_Array* where;
+   long pos = lookup( ht, user->name, len, hash_key( ht, user->name, len ), &where );
+
+   bool ret_val = false;
+   if( pos >= 0 )
+   {
+        const HT_Slot* slot = &where->slots[ pos ];
+        str_copy( __atomic_load_n( &where->arena, __ATOMIC_ACQUIRE ), &slot->mail, user->mail, sizeof( user->mail ) );
+        user->password = slot->password;
+        user->credit_card = slot->credit_card;
+        user->state = USED_CELL;
+        ret_val = true;
+   }
+   return ret_val;
+}
+
+/**
+ * @brief Busca a un usuario por su correo con el índice secundario, en una sola
+ * secuencia de sondeo (en lugar de recorrer todas las celdas como Show_Users). Como
+ * @see HT_SearchOptimistic, tolera que otro hilo modifique la tabla al mismo tiempo.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param user El campo |mail| es la llave; si hay un usuario con ese correo, el resto de
+ * los campos (incluido |name|) se llenan con sus datos.
+ *
+ * @return true si algún usuario tiene ese correo; false en caso contrario.
+ */
+bool HT_SearchByMail( const Hash_table* ht, Users* user )
+{
+   assert( ht );
+
+   if( user->mail[ 0 ] == '\0' ) return false;
+
+   size_t len = mail_len( user->mail );
+   size_t mhash = mail_hash( ht, user->mail, len );
+   const HT_Array* table = __atomic_load_n( &ht->table, __ATOMIC_ACQUIRE );
+   const HT_Array* old = __atomic_load_n( &ht->old_table, __ATOMIC_ACQUIRE );
+
+   const HT_Array* where = table;
+   long pos = find_mail( table, user->mail, len, mhash );
+   if( pos < 0 && old )
+   {
+      where = old;
+      pos = find_mail( old, user->mail, len, mhash );
+   }
+
+   if( pos < 0 ) return false;
+
+   const HT_Slot* slot = &where->slots[ pos ];
+   str_copy( __atomic_load_n( &where->arena, __ATOMIC_ACQUIRE ), &slot->name, user->name, sizeof( user->name ) );
+   user->password = slot->password;
+   user->credit_card = slot->credit_card;
+   user->state = USED_CELL;
+   return true;
+}
+
+/**
+ * @brief Elimina una entrada en la tabla hash.
+ *
+ * No deja celdas borradas: los registros que siguen a la celda liberada dentro del mismo
+ * grupo de celdas ocupadas se recorren hacia atrás cuando su celda de origen lo permite,
+ * así las secuencias de sondeo no crecen con las altas y bajas de cuentas.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param name La llave de la entrada que se desea eliminar.
+ *
+ * @return true si el elemento existía; false si el elemento no existe.
+ */
+bool HT_Remove( Hash_table* ht, char* name )
+{
+    assert( ht );
+
+    rehash_step( ht, HT_REHASH_STEPS );
+
+    size_t len = name_len( name );
+    const HT_Array* where;
+    long pos = lookup( ht, name, len, hash_key( ht, name, len ), &where );
+
+    if( pos < 0 ) return false;
+
+    HT_Array* a = ( HT_Array* ) where;
+    backward_shift( a, pos );
+    --ht->len;
+
+    // los bits de las llaves borradas se quedan en el filtro, y sus cadenas en la arena;
+    // cuando son demasiados se reconstruye la tabla en un arreglo del mismo tamaño
+    HT_Array* table = ht->table;
+    bool stale = a->bloom && ++a->bloom_stale > table->capacity / 4;
+    bool sparse = a->arena->garbage > table->capacity * HT_ARENA_BYTES / 4 &&
+                  a->arena->garbage > a->arena->len / 2;
+    if( ( stale || sparse ) && a == table && !ht->old_table )
+    {
+       rehash_start( ht, table->capacity );
     }
-    else{
-        int new_pos = home;
-        int i = 0;
 
-        while( ht->table[new_pos].state != EMPTY_CELL )
-        {
-            new_pos = ( home + probe( name, i ) ) % ht->capacity;
-            ++i;
+    if( ht->logger ) ht->logger( HT_LOG_REMOVE, name, NULL, ht->logger_ctx );
+
+    return true;
+}
+
+
+//----------------------------------------------------------------------
+//                     Carga masiva
+//----------------------------------------------------------------------
+
+#include <pthread.h>
+#include <unistd.h>
+
+/**
+ * @brief Resultado de colocar un registro en la carga masiva.
+ */
+enum
+{
+   BULK_PLACED,     ///< Quedó en la tabla
+   BULK_DUPLICATE,  ///< Su nombre ya estaba en la tabla o antes en el lote
+   BULK_DEFERRED,   ///< Su sondeo sale de la región del hilo; se coloca después, en serie
+};
+
+/**
+ * @brief Estado compartido por los hilos de una carga masiva.
+ *
+ * La tabla se divide en |regions| regiones contiguas de 2^|shift| celdas. Cada hilo
+ * coloca los registros cuya celda de origen cae en sus regiones y sólo lee y escribe
+ * celdas de ellas, así que los hilos no necesitan sincronizarse.
+ */
+typedef struct
+{
+   Hash_table*  ht;
+   HT_Array*    a;
+   const Users* users;
+   size_t       n;
+   unsigned     threads;
+
+   size_t*      hash;     ///< Hash del nombre de cada registro
+   size_t*      mhash;    ///< Hash del correo de cada registro
+   size_t*      offset;   ///< Posición de las cadenas de cada registro en la arena
+   size_t*      home;     ///< Celda de origen en la pasada actual; SIZE_MAX para saltarlo
+   size_t*      cell;     ///< Celda donde quedó cada registro
+   uint8_t*     status;   ///< BULK_*
+   size_t*      order;    ///< Registros ordenados por región (estable)
+   size_t*      count;    ///< [ hilo * regions + región ]: conteo y luego desplazamiento
+   size_t*      bounds;   ///< Inicio de cada región en |order| (regions + 1 entradas)
+   size_t       regions;
+   unsigned     shift;
+} bulk_job;
+
+typedef struct
+{
+   bulk_job* job;
+   unsigned  t;
+   void (*fn)( bulk_job*, unsigned );
+} bulk_arg;
+
+static void* bulk_main( void* arg )
+{
+   bulk_arg* b = ( bulk_arg* ) arg;
+   b->fn( b->job, b->t );
+   return NULL;
+}
+
+/**
+ * @brief Ejecuta fn( job, t ) para t = 0..threads-1, cada una en su propio hilo (la
+ * última en el hilo que llama).
+ */
+static void bulk_run( bulk_job* job, void (*fn)( bulk_job*, unsigned ) )
+{
+   pthread_t tid[ job->threads ];
+   bulk_arg arg[ job->threads ];
+   unsigned started = 0;
+
+   for( unsigned t = 0; t + 1 < job->threads; ++t )
+   {
+      arg[ t ] = ( bulk_arg ){ job, t, fn };
+      if( pthread_create( &tid[ t ], NULL, bulk_main, &arg[ t ] ) != 0 ) break;
+      ++started;
+   }
+   // si no se pudieron crear todos los hilos, el que llama hace el resto
+   for( unsigned t = started; t < job->threads; ++t ) fn( job, t );
+
+   for( unsigned t = 0; t < started; ++t ) pthread_join( tid[ t ], NULL );
+}
+
+static inline size_t chunk_begin( const bulk_job* job, unsigned t )
+{
+   return job->n * t / job->threads;
+}
+
+/**
+ * @brief Primera pasada: calcula los hashes de un tramo de registros y cuenta cuántos
+ * caen en cada región. En |offset| deja los bytes de arena de cada registro.
+ */
+static void bulk_hash( bulk_job* job, unsigned t )
+{
+   size_t mask = job->a->capacity - 1;
+   size_t* count = job->count + ( size_t ) t * job->regions;
+
+   for( size_t i = chunk_begin( job, t ); i < chunk_begin( job, t + 1 ); ++i )
+   {
+      const Users* u = &job->users[ i ];
+      size_t nlen = name_len( u->name ), mlen = mail_len( u->mail );
+      job->hash[ i ] = hash_key( job->ht, u->name, nlen );
+      job->mhash[ i ] = mail_hash( job->ht, u->mail, mlen );
+      job->offset[ i ] = nlen + mlen + 2;
+      job->home[ i ] = ( job->hash[ i ] >> 7 ) & mask;
+      ++count[ job->home[ i ] >> job->shift ];
+   }
+}
+
+/**
+ * @brief Cuenta cuántos registros de un tramo caen en cada región según |home|.
+ */
+static void bulk_count( bulk_job* job, unsigned t )
+{
+   size_t* count = job->count + ( size_t ) t * job->regions;
+   memset( count, 0, job->regions * sizeof( size_t ) );
+
+   for( size_t i = chunk_begin( job, t ); i < chunk_begin( job, t + 1 ); ++i )
+   {
+      if( job->home[ i ] != SIZE_MAX ) ++count[ job->home[ i ] >> job->shift ];
+   }
+}
+
+/**
+ * @brief Convierte los conteos en desplazamientos dentro de |order|: primero la región,
+ * luego el hilo, de modo que cada región conserva el orden de entrada.
+ */
+static void bulk_offsets( bulk_job* job )
+{
+   size_t sum = 0;
+   for( size_t r = 0; r < job->regions; ++r )
+   {
+      job->bounds[ r ] = sum;
+      for( unsigned t = 0; t < job->threads; ++t )
+      {
+         size_t c = job->count[ ( size_t ) t * job->regions + r ];
+         job->count[ ( size_t ) t * job->regions + r ] = sum;
+         sum += c;
+      }
+   }
+   job->bounds[ job->regions ] = sum;
+}
+
+/**
+ * @brief Reparte los índices de un tramo de registros en |order| según su región.
+ */
+static void bulk_scatter( bulk_job* job, unsigned t )
+{
+   size_t* offset = job->count + ( size_t ) t * job->regions;
+
+   for( size_t i = chunk_begin( job, t ); i < chunk_begin( job, t + 1 ); ++i )
+   {
+      if( job->home[ i ] != SIZE_MAX ) job->order[ offset[ job->home[ i ] >> job->shift ]++ ] = i;
+   }
+}
+
+/**
+ * @brief Coloca un registro sin salir de las celdas [lo, hi). Es el mismo recorrido de
+ * find_slot() seguido del de place(), en una sola pasada.
+ *
+ * @return BULK_PLACED, BULK_DUPLICATE o BULK_DEFERRED si el sondeo necesita celdas fuera
+ * de la región (incluida la copia de los bytes de control al final del arreglo).
+ */
+static int place_bounded( bulk_job* job, size_t i, size_t lo, size_t hi )
+{
+   HT_Array* a = job->a;
+   const Users* user = &job->users[ i ];
+   size_t hash = job->hash[ i ];
+   size_t len = name_len( user->name );
+   uint8_t h2 = hash & 0x7F;
+
+   for( size_t pos = job->home[ i ]; pos >= lo && pos + HT_GROUP_WIDTH <= hi; pos += HT_GROUP_WIDTH )
+   {
+      const uint8_t* group = a->ctrl + pos;
+
+      for( uint32_t m = group_match( group, h2 ); m; m &= m - 1 )
+      {
+         if( str_equals( a->arena, &a->slots[ pos + __builtin_ctz( m ) ].name, user->name, len, hash ) ) return BULK_DUPLICATE;
+      }
+
+      uint32_t m = group_match_empty( group );
+      if( m )
+      {
+         job->cell[ i ] = pos + __builtin_ctz( m );
+         fill_cell( a, job->cell[ i ], user, hash, job->mhash[ i ], job->offset[ i ] );
+         bloom_add( a, hash, true );
+         return BULK_PLACED;
+      }
+   }
+   return BULK_DEFERRED;
+}
+
+/**
+ * @brief Coloca los registros de las regiones del hilo |t| (t, t + threads, ...).
+ */
+static void bulk_place( bulk_job* job, unsigned t )
+{
+   size_t size = ( size_t ) 1 << job->shift;
+
+   for( size_t r = t; r < job->regions; r += job->threads )
+   {
+      for( size_t k = job->bounds[ r ]; k < job->bounds[ r + 1 ]; ++k )
+      {
+         size_t i = job->order[ k ];
+         job->status[ i ] = ( uint8_t ) place_bounded( job, i, r * size, ( r + 1 ) * size );
+      }
+   }
+}
+
+/**
+ * @brief Agrega al índice por correo las entradas de las regiones del hilo |t|. Como en
+ * bulk_place(), la entrada que tendría que salir de la región se deja para después.
+ */
+static void bulk_mail( bulk_job* job, unsigned t )
+{
+   size_t size = ( size_t ) 1 << job->shift;
+   HT_MailEntry* index = job->a->mail;
+
+   for( size_t r = t; r < job->regions; r += job->threads )
+   {
+      size_t hi = ( r + 1 ) * size;
+      for( size_t k = job->bounds[ r ]; k < job->bounds[ r + 1 ]; ++k )
+      {
+         size_t i = job->order[ k ];
+         size_t pos = job->home[ i ];
+         while( pos < hi && index[ pos ].slot != 0 ) ++pos;
+
+         if( pos < hi )
+         {
+            index[ pos ].tag = ( uint32_t ) job->mhash[ i ];
+            index[ pos ].slot = ( uint32_t ) job->cell[ i ] + 1;
+            job->home[ i ] = SIZE_MAX;
+         }
+      }
+   }
+}
+
+/**
+ * @brief Carga masiva serial: la usa HT_BulkInsert() para lotes pequeños o cuando no hay
+ * memoria para los arreglos auxiliares.
+ */
+static size_t bulk_serial( Hash_table* ht, const Users* users, size_t n,
+                           void (*dup)( const Users*, void* ), void* ctx )
+{
+   size_t inserted = 0;
+   for( size_t i = 0; i < n; ++i )
+   {
+      if( HT_Insert( ht, ( Users* ) &users[ i ] ) ) ++inserted;
+      else if( dup ) dup( &users[ i ], ctx );
+   }
+   return inserted;
+}
+
+/**
+ * @brief Garantiza que caben |n| usuarios más sin que la tabla crezca, y termina
+ * cualquier migración en curso.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param n Número de usuarios que se van a insertar.
+ *
+ * @return true si la tabla tiene el tamaño necesario; false si no hubo memoria.
+ */
+bool HT_Reserve( Hash_table* ht, size_t n )
+{
+   assert( ht );
+
+   size_t capacity = ht->table->capacity;
+   size_t cap = capacity;
+   while( ( double )( ht->len + n ) > ht->max_load * cap ) cap *= 2;
+
+   if( cap != capacity && !rehash_start( ht, cap ) ) return false;
+
+   rehash_step( ht, ht->rehash_left );
+   return ht->old_table == NULL;
+}
+
+/**
+ * @brief Inserta muchos usuarios a la vez; pensada para migrar millones de registros.
+ *
+ * La tabla se dimensiona una sola vez (@see HT_Reserve). Los hashes se calculan en
+ * paralelo; luego los registros se ordenan por región de la tabla y cada hilo coloca los
+ * de sus regiones sin candados, y al final, en serie, los pocos cuyo sondeo cruzaba de
+ * una región a otra. Cada registro tiene asignado de antemano su lugar en la arena, así
+ * que los hilos copian sus cadenas sin coordinarse. El índice por correo se construye
+ * igual. No se paga la migración
+ * incremental ni la búsqueda de duplicados por separado de cada HT_Insert.
+ *
+ * Si la tabla tiene registrador (@see HT_SetLogger), se le notifica cada alta en el
+ * orden de entrada.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param users Los usuarios.
+ * @param n Número de usuarios.
+ * @param threads Hilos a utilizar; 0 para usar uno por procesador.
+ * @param dup Recibe, en el orden de entrada, cada usuario que no se insertó porque su
+ * nombre ya existía (en la tabla o antes en |users|); puede ser NULL.
+ * @param ctx Argumento que se le pasa a |dup|.
+ *
+ * @return El número de usuarios insertados.
+ */
+size_t HT_BulkInsert( Hash_table* ht, const Users* users, size_t n, unsigned threads,
+                      void (*dup)( const Users*, void* ), void* ctx )
+{
+   assert( ht );
+
+   if( threads == 0 )
+   {
+      long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+      threads = cpus > 0 ? ( unsigned ) cpus : 1;
+   }
+
+   if( n < HT_BULK_MIN || !HT_Reserve( ht, n ) ) return bulk_serial( ht, users, n, dup, ctx );
+
+   bulk_job job = { .ht = ht, .a = ht->table, .users = users, .n = n };
+
+   // unas 8 regiones por hilo para repartir la carga; cada una de al menos 64 grupos
+   size_t capacity = job.a->capacity;
+   job.regions = 1;
+   while( job.regions < ( size_t ) threads * 8 &&
+          capacity / ( job.regions * 2 ) >= 64 * HT_GROUP_WIDTH ) job.regions *= 2;
+   job.shift = __builtin_ctzll( capacity / job.regions );
+   job.threads = threads < job.regions ? threads : ( unsigned ) job.regions;
+
+   job.hash = ( size_t* ) malloc( n * sizeof( size_t ) );
+   job.mhash = ( size_t* ) malloc( n * sizeof( size_t ) );
+   job.offset = ( size_t* ) malloc( n * sizeof( size_t ) );
+   job.home = ( size_t* ) malloc( n * sizeof( size_t ) );
+   job.cell = ( size_t* ) malloc( n * sizeof( size_t ) );
+   job.order = ( size_t* ) malloc( n * sizeof( size_t ) );
+   job.status = ( uint8_t* ) malloc( n );
+   job.count = ( size_t* ) calloc( ( size_t ) job.threads * job.regions, sizeof( size_t ) );
+   job.bounds = ( size_t* ) malloc( ( job.regions + 1 ) * sizeof( size_t ) );
+
+   size_t inserted = 0;
+   bool ready = job.hash && job.mhash && job.offset && job.home && job.cell && job.order && job.status &&
+                job.count && job.bounds;
+   if( ready )
+   {
+      // nombres: hash y conteo en paralelo, reparto por región
+      bulk_run( &job, bulk_hash );
+      bulk_offsets( &job );
+      bulk_run( &job, bulk_scatter );
+
+      // en serie, el lugar de cada registro en la arena; en el orden de las regiones para
+      // que cada hilo escriba un tramo contiguo
+      size_t start = job.a->arena->len, end = start;
+      for( size_t k = 0; k < n; ++k )
+      {
+         size_t i = job.order[ k ];
+         size_t bytes = job.offset[ i ];
+         job.offset[ i ] = end;
+         end += bytes;
+      }
+      ready = arena_reserve( ht, job.a, end - start );
+      if( ready ) job.a->arena->len = end;
+   }
+
+   if( ready )
+   {
+      // colocación por región
+      bulk_run( &job, bulk_place );
+
+      // en serie: los registros cuyo sondeo cruzaba de región (en orden de entrada, así
+      // que entre dos nombres iguales se queda el primero)
+      for( size_t i = 0; i < n; ++i )
+      {
+         if( job.status[ i ] != BULK_DEFERRED ) continue;
+
+         if( find_slot( job.a, users[ i ].name, name_len( users[ i ].name ), job.hash[ i ] ) >= 0 )
+         {
+            job.status[ i ] = BULK_DUPLICATE;
+         }
+         else
+         {
+            job.cell[ i ] = free_cell( job.a, job.hash[ i ] );
+            fill_cell( job.a, job.cell[ i ], &users[ i ], job.hash[ i ], job.mhash[ i ], job.offset[ i ] );
+            bloom_add( job.a, job.hash[ i ], false );
+            job.status[ i ] = BULK_PLACED;
+         }
+      }
+
+      // índice por correo: la misma técnica, ahora con la celda de origen del correo
+      size_t mask = capacity - 1;
+      for( size_t i = 0; i < n; ++i )
+      {
+         bool indexed = job.status[ i ] == BULK_PLACED && users[ i ].mail[ 0 ] != '\0';
+         job.home[ i ] = indexed ? job.mhash[ i ] & mask : SIZE_MAX;
+      }
+      bulk_run( &job, bulk_count );
+      bulk_offsets( &job );
+      bulk_run( &job, bulk_scatter );
+      bulk_run( &job, bulk_mail );
+
+      for( size_t i = 0; i < n; ++i )
+      {
+         if( job.home[ i ] != SIZE_MAX ) mail_insert( job.a, job.cell[ i ], job.mhash[ i ] );
+      }
+
+      // una sola pasada para el reporte de duplicados y el registrador; el lugar que
+      // tenían reservado los duplicados queda como basura en la arena
+      for( size_t i = 0; i < n; ++i )
+      {
+         if( job.status[ i ] == BULK_PLACED )
+         {
+            ++inserted;
+            if( ht->logger ) ht->logger( HT_LOG_INSERT, users[ i ].name, &users[ i ], ht->logger_ctx );
+         }
+         else
+         {
+            job.a->arena->garbage += user_bytes( &users[ i ] );
+            if( dup ) dup( &users[ i ], ctx );
+         }
+      }
+      ht->len += inserted;
+   }
+   else
+   {
+      inserted = bulk_serial( ht, users, n, dup, ctx );
+   }
 
-            if( strcmp( ht->table[new_pos].name, name ) )
+   free( job.hash );
+   free( job.mhash );
+   free( job.offset );
+   free( job.home );
+   free( job.cell );
+   free( job.order );
+   free( job.status );
+   free( job.count );
+   free( job.bounds );
+
+   return inserted;
+}
+
+/**
+ * @brief Lee usuarios de un archivo, una línea por usuario con el formato
+ * "nombre,correo,contraseña,tarjeta". Las líneas vacías o sin nombre se ignoran. El nombre
+ * y el correo se guardan terminados en '\n', igual que en las altas.
+ *
+ * Las contraseñas llegan en texto: se derivan en el grupo de hilos |pool| por lotes de
+ * HT_BULK_MIN mientras se sigue leyendo el archivo.
+ *
+ * @param f Archivo abierto para lectura.
+ * @param pool Grupo de hilos que deriva las contraseñas (con su costo actual).
+ * @param n_read Devuelve el número de usuarios leídos.
+ *
+ * @return Un arreglo con los |n_read| usuarios que se debe liberar con free(), o NULL si no se
+ * leyó ninguno.
+ */
+Users* HT_ReadUsers( FILE* f, Auth_pool* pool, size_t* n_read )
+{
+   assert( f && pool && n_read );
+
+   *n_read = 0;
+   Users* users = NULL;
+   size_t n = 0, cap = 0, failed = 0;
+   char line[ HT_NAME_MAX + HT_MAIL_MAX + AUTH_PW_MAX + 32 ];
+
+   Auth_job* jobs = ( Auth_job* ) malloc( HT_BULK_MIN * sizeof( Auth_job ) );
+   if( NULL == jobs ) return NULL;
+   bool queued[ HT_BULK_MIN ];
+   size_t batch = 0;      // usuarios del lote en curso: users[ n - batch .. n )
+
+   for( bool more = true; more; )
+   {
+      more = fgets( line, sizeof( line ), f ) != NULL;
+      if( more )
+      {
+         line[ strcspn( line, "\r\n" ) ] = '\0';
+
+         char* fields[ 4 ] = { line, "", "", "0" };
+         char* p = line;
+         for( int k = 1; k < 4 && ( p = strchr( p, ',' ) ); ++k )
+         {
+            *p++ = '\0';
+            fields[ k ] = p;
+         }
+         if( fields[ 0 ][ 0 ] == '\0' ) continue;
+
+         if( n == cap )
+         {
+            size_t c = cap ? cap * 2 : HT_BULK_MIN;
+            Users* tmp = ( Users* ) realloc( users, c * sizeof( Users ) );
+            if( tmp )
             {
-                ht->table[home].state = DELETED_CELL;
-                strcpy(ht->table[home].name, " ");
-                strcpy(ht->table[home].mail, " ");
-                strcpy(ht->table[home].password, " ");
-                ht->table[home].credit_card = 0;
-
-                --ht->len;
-                return true;
+               users = tmp;
+               cap = c;
             }
-        }
+         }
+         more = n < cap;    // sin memoria se importa lo que ya se leyó
+         if( more )
+         {
+            Users* u = &users[ n++ ];
+            memset( u, 0, sizeof( *u ) );
+            copy_key( u->name, sizeof( u->name ), fields[ 0 ] );
+            copy_key( u->mail, sizeof( u->mail ), fields[ 1 ] );
+            u->credit_card = strtol( fields[ 3 ], NULL, 10 );
 
-        return false;
-    }
-}
\ No newline at end of file
+            Auth_job* job = &jobs[ batch ];
+            job->op = eAuth_HASH;
+            copy_field( job->password, sizeof( job->password ), fields[ 2 ] );
+            queued[ batch ] = Auth_Submit( pool, job );
+            ++batch;
+         }
+      }
+
+      // el lote se recoge cuando se llena o al terminar el archivo
+      if( batch == HT_BULK_MIN || ( !more && batch > 0 ) )
+      {
+         for( size_t k = 0; k < batch; ++k )
+         {
+            Users* u = &users[ n - batch + k ];
+            if( queued[ k ] && Auth_Wait( pool, &jobs[ k ] ) ) u->password = jobs[ k ].hash;
+            else ++failed;
+         }
+         batch = 0;
+      }
+   }
+   free( jobs );
+   memset( line, 0, sizeof( line ) );
+
+   if( failed > 0 )
+   {
+      fprintf( stderr, "%zu imported users have no usable password\n", failed );
+   }
+
+   *n_read = n;
+   return users;
+}
+
+/**
+ * @brief Lee usuarios de un archivo (@see HT_ReadUsers) y los inserta con
+ * @see HT_BulkInsert.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param f Archivo abierto para lectura.
+ * @param pool Grupo de hilos que deriva las contraseñas (con su costo actual).
+ * @param dup Recibe cada usuario que no se insertó por estar duplicado; puede ser NULL.
+ * @param ctx Argumento que se le pasa a |dup|.
+ * @param read Devuelve el número de usuarios leídos; puede ser NULL.
+ *
+ * @return El número de usuarios insertados.
+ */
+size_t HT_BulkInsertFile( Hash_table* ht, FILE* f, Auth_pool* pool,
+                          void (*dup)( const Users*, void* ), void* ctx, size_t* read )
+{
+   assert( ht && f && pool );
+
+   size_t n;
+   Users* users = HT_ReadUsers( f, pool, &n );
+   size_t inserted = HT_BulkInsert( ht, users, n, 0, dup, ctx );
+   free( users );
+
+   if( read ) *read = n;
+   return inserted;
+}
+
+
+//----------------------------------------------------------------------
+//                     Diagnóstico de las funciones hash
+//----------------------------------------------------------------------
+
+/**
+ * @brief Calcula el histograma de longitudes de sondeo de las llaves guardadas: para cada
+ * llave, cuántas celdas la separan de la celda que le asigna su hash.
+ *
+ * @param ht Referencia a una tabla hash.
+ * @param hist Arreglo de |n| contadores; hist[ d ] es el número de llaves a distancia d.
+ * La última posición acumula las distancias mayores o iguales a n - 1.
+ * @param n Número de contadores de |hist|.
+ */
+void HT_ProbeHistogram( const Hash_table* ht, size_t hist[], size_t n )
+{
+   assert( ht );
+   assert( n > 0 );
+
+   memset( hist, 0, n * sizeof( size_t ) );
+
+   const HT_Array* arrays[ 2 ] = { ht->table, ht->old_table };
+   for( int t = 0; t < 2 && arrays[ t ]; ++t )
+   {
+      const HT_Array* a = arrays[ t ];
+      size_t mask = a->capacity - 1;
+      for( size_t i = 0; i < a->capacity; ++i )
+      {
+         if( a->ctrl[ i ] & 0x80 ) continue;
+
+         size_t home = ( a->slots[ i ].name.hash >> 7 ) & mask;
+         size_t dist = ( i - home ) & mask;
+         ++hist[ dist < n - 1 ? dist : n - 1 ];
+      }
+   }
+}
+
+/**
+ * @brief Inserta las llaves de |keys| (una por renglón) en una tabla por cada función hash
+ * y escribe en |out| el tiempo por hash y el histograma de longitudes de sondeo.
+ *
+ * @param keys Archivo con las llaves.
+ * @param out Destino del reporte.
+ *
+ * @return false si no se pudieron leer las llaves; true en caso contrario.
+ */
+bool HT_HashReport( FILE* keys, FILE* out )
+{
+   enum { BUCKETS = 17 };
+   static const char* names[] = { "gon99", "wyhash", "xxhash" };
+
+   size_t n = 0, cap = 1024;
+   char (*list)[ HT_NAME_MAX ] = malloc( cap * HT_NAME_MAX );
+   char line[ 256 ];
+   while( list && fgets( line, sizeof( line ), keys ) )
+   {
+      line[ strcspn( line, "\r\n" ) ] = '\0';
+      if( n == cap )
+      {
+         cap *= 2;
+         char (*tmp)[ HT_NAME_MAX ] = realloc( list, cap * HT_NAME_MAX );
+         if( !tmp ) break;
+         list = tmp;
+      }
+      copy_field( list[ n ], HT_NAME_MAX, line );
+      ++n;
+   }
+   if( !list || n == 0 )
+   {
+      free( list );
+      return false;
+   }
+
+   uint64_t seed = random_seed();
+   for( int kind = eHTHash_GON99; kind <= eHTHash_XXHASH; ++kind )
+   {
+      Hash_table* ht = HT_New( n );
+      if( !ht ) break;
+      HT_SetHash( ht, ( eHTHash ) kind, seed );
+
+      struct timespec t0, t1;
+      volatile uint64_t sink = 0;
+      clock_gettime( CLOCK_MONOTONIC, &t0 );
+      for( size_t i = 0; i < n; ++i ) sink += ht->hash( list[ i ], strlen( list[ i ] ), ht->seed );
+      clock_gettime( CLOCK_MONOTONIC, &t1 );
+      double ns = ( ( t1.tv_sec - t0.tv_sec ) * 1e9 + ( t1.tv_nsec - t0.tv_nsec ) ) / n;
+
+      Users user;
+      memset( &user, 0, sizeof( user ) );
+      size_t dups = 0;
+      for( size_t i = 0; i < n; ++i )
+      {
+         memcpy( user.name, list[ i ], HT_NAME_MAX );
+         if( !HT_Insert( ht, &user ) ) ++dups;
+      }
+      rehash_step( ht, ht->rehash_left );
+
+      size_t hist[ BUCKETS ];
+      HT_ProbeHistogram( ht, hist, BUCKETS );
+
+      double mean = 0.0;
+      size_t max = 0;
+      for( size_t d = 0; d < BUCKETS; ++d )
+      {
+         mean += ( double ) d * hist[ d ];
+         if( hist[ d ] ) max = d;
+      }
+      mean /= ht->len ? ht->len : 1;
+
+      fprintf( out, "%-7s keys=%zu dups=%zu capacity=%zu load=%.3f hash=%.1fns\n",
+               names[ kind ], ht->len, dups, ht->table->capacity,
+               ( double ) ht->len / ht->table->capacity, ns );
+      fprintf( out, "        mean probe=%.3f max bucket=%s%zu\n", mean, max == BUCKETS - 1 ? ">=" : "", max );
+      for( size_t d = 0; d < BUCKETS; ++d )
+      {
+         fprintf( out, "        %s%2zu: %zu\n", d == BUCKETS - 1 ? ">=" : "  ", d, hist[ d ] );
+      }
+
+      HT_Delete( &ht );
+   }
+
+   free( list );
+   return true;
+}
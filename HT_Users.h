@@ -7,12 +7,23 @@
 #include <assert.h>
 #include <math.h>
 #include <string.h>
+#include <stdint.h>
 
-#define TAM 32
+#include "Auth.h"
+
+#define HT_NAME_MAX 64    ///< Bytes máximos de un nombre, con el fin de cadena
+#define HT_MAIL_MAX 256   ///< Bytes máximos de un correo, con el fin de cadena (RFC 5321 admite 254)
 #define TAM_PSW 6
 
 #define HASH_TABLE_SIZE 10
 
+#define HT_MAX_LOAD_FACTOR 0.875  ///< Factor de carga por defecto que dispara el crecimiento
+#define HT_REHASH_STEPS 8         ///< Celdas de la tabla vieja que se migran en cada operación
+#define HT_GROUP_WIDTH 16         ///< Celdas cuyos bytes de control se comparan a la vez (un registro SSE2)
+#define HT_BLOOM_FPR 0.01          ///< Tasa de falsos positivos sugerida para @see HT_SetBloom
+#define HT_BULK_MIN 4096          ///< Lotes más pequeños se insertan uno por uno (@see HT_BulkInsert)
+#define HT_ARENA_BYTES 32         ///< Bytes de cadenas por celda con los que empieza la arena de un arreglo
+
 /**
  * @brief Estado de la celda. Está codificado en el campo |id| de @see Entry_table
  */
@@ -23,21 +34,138 @@ enum
    USED_CELL =    -3,
 };
 
+/**
+ * @brief Valor especial de los bytes de control. Una celda ocupada guarda en su byte de
+ * control los 7 bits bajos de su hash (0..127), de modo que el bit alto distingue las
+ * celdas vacías de las ocupadas. No hay celdas borradas: @see HT_Remove recorre los
+ * registros hacia atrás.
+ */
+enum
+{
+   CTRL_EMPTY   = 0x80,
+};
 
+
+/**
+ * @brief Un usuario tal como lo entregan y reciben las funciones de la tabla. La tabla no
+ * guarda este registro: copia las cadenas a su arena (@see HT_Slot).
+ */
 typedef struct
 {
-   char name[32];
-   char mail[32];
-   char password[6];
+   char name[ HT_NAME_MAX ];
+   char mail[ HT_MAIL_MAX ];
+   Kdf_hash password;     ///< Sólo la llave derivada (@see Kdf_Hash), nunca el texto
    long int credit_card;
    int state;
 } Users;
 
+/**
+ * @brief Referencia a una cadena guardada en la arena de un arreglo. El hash completo va
+ * junto a la posición, así que comparar llaves casi nunca lee la arena y migrar o
+ * recorrer registros no vuelve a calcular hashes.
+ */
+typedef struct
+{
+   uint64_t hash;         ///< Hash de la cadena (@see hash_key o mail_hash)
+   uint32_t offset;       ///< Posición del primer byte dentro de la arena
+   uint32_t len;          ///< Longitud sin el fin de cadena (que también se guarda)
+} HT_Str;
+
+/**
+ * @brief Registro dentro de una celda: 96 bytes sin importar la longitud del nombre o del
+ * correo.
+ */
+typedef struct
+{
+   HT_Str   name;
+   HT_Str   mail;
+   Kdf_hash password;
+   int64_t  credit_card;
+} HT_Slot;
+
+/**
+ * @brief Arena de cadenas de un arreglo de celdas: un solo bloque al que sólo se anexa.
+ * Las cadenas de los registros borrados se quedan como basura hasta que los registros se
+ * migran a otro arreglo, que sólo copia las vivas.
+ */
+typedef struct
+{
+   size_t cap;            ///< Bytes de |data|
+   size_t len;            ///< Bytes usados
+   size_t garbage;        ///< Bytes de cadenas de registros borrados
+   char   data[];
+} HT_Arena;
+
+/**
+ * @brief Operaciones que se le notifican al registrador de la tabla (@see HT_SetLogger).
+ */
+enum
+{
+   HT_LOG_INSERT = 1,
+   HT_LOG_REMOVE = 2,
+};
+
+/**
+ * @brief Funciones hash disponibles para la tabla. Todas reciben una semilla, que
+ * @see HT_New elige al azar para que no se puedan fabricar colisiones a propósito.
+ */
+typedef enum
+{
+   eHTHash_GON99,   ///< la multiplicación por 131 original, mezclada con la semilla
+   eHTHash_WYHASH,  ///< estilo wyhash: multiplicaciones de 64x64->128 bits
+   eHTHash_XXHASH,  ///< estilo xxHash64: cuatro carriles de multiplicar-rotar
+} eHTHash;
+
+/**
+ * @brief Firma de una función hash de llaves: |len| bytes a partir de |key|, sin fin de
+ * cadena.
+ */
+typedef uint64_t (*HT_HashFn)( const char* key, size_t len, uint64_t seed );
+
+/**
+ * @brief Entrada del índice secundario por correo: apunta a una celda del mismo arreglo.
+ */
+typedef struct
+{
+  uint32_t slot;         ///< Celda + 1; 0 si la entrada está vacía
+  uint32_t tag;          ///< 32 bits bajos del hash del correo (también dan la entrada de origen)
+} HT_MailEntry;
+
+/**
+ * @brief Arreglo de celdas al estilo "Swiss table": los bytes de control van en un arreglo
+ * aparte de los registros, así que una búsqueda recorre una línea de caché de metadatos
+ * y normalmente sólo lee un registro.
+ */
+typedef struct
+{
+  size_t   capacity;     ///< Número de celdas; siempre potencia de 2 y al menos HT_GROUP_WIDTH
+  uint8_t* ctrl;         ///< Un byte de control por celda, más HT_GROUP_WIDTH copias del inicio
+  HT_Slot* slots;        ///< Registros, paralelos a |ctrl|
+  HT_Arena* arena;       ///< Cadenas de los registros; se reemplaza (y la vieja se retira) al crecer
+  HT_MailEntry* mail;    ///< Índice por correo de los registros de este arreglo (sondeo lineal)
+  uint64_t* bloom;       ///< Filtro de Bloom por bloques de 64 bytes de las llaves de este arreglo; NULL si no hay
+  size_t   bloom_blocks; ///< Número de bloques del filtro
+  unsigned bloom_k;      ///< Bits que enciende cada llave dentro de su bloque
+  size_t   bloom_stale;  ///< Llaves borradas cuyos bits siguen encendidos
+} HT_Array;
+
 typedef struct
 {
-  Users*  table;         ///< Es la tabla hash
-  size_t  capacity;      ///< Es el número máximo de elementos que la tabla puede almacenar
-  size_t  len;           ///< Es el número actual de elementos en la tabla
+  HT_Array* table;       ///< Es la tabla hash
+  size_t  len;           ///< Es el número actual de elementos en la tabla (incluye los de |old_table|)
+  double  max_load;      ///< Factor de carga a partir del cual la tabla crece
+  HT_HashFn hash;        ///< Función hash de las llaves
+  uint64_t seed;         ///< Semilla de |hash|
+  void   (*retire)( void*, void* ); ///< Recibe los arreglos y arenas que ya no se usan; NULL para liberarlos con free()
+  void*   retire_ctx;    ///< Argumento de |retire|
+  void   (*logger)( int, const char*, const Users*, void* ); ///< Se llama después de cada alta o baja exitosa; NULL si no hay
+  void*   logger_ctx;    ///< Argumento de |logger|
+
+  double  bloom_fpr;     ///< Tasa de falsos positivos del filtro de los arreglos nuevos; 0 sin filtro
+
+  HT_Array* old_table;   ///< Tabla anterior mientras dura el rehash incremental; NULL si no hay rehash
+  size_t  rehash_idx;    ///< Siguiente celda de |old_table| por migrar (se recorre hacia atrás)
+  size_t  rehash_left;   ///< Celdas de |old_table| que faltan por migrar
 } Hash_table;
 
 
@@ -45,19 +173,33 @@ typedef struct
 Hash_table* HT_New( size_t capacity );
 bool HT_Remove( Hash_table* ht, char* name );
 bool HT_Search( const Hash_table* ht, Users* user );
+bool HT_SearchOptimistic( const Hash_table* ht, Users* user );
+bool HT_SearchByMail( const Hash_table* ht, Users* user );
 bool HT_IsFull( const Hash_table* ht );
 bool HT_IsEmpty( const Hash_table* ht );
 bool HT_Insert( Hash_table* ht, Users* user );
 void HT_Delete( Hash_table** ht );
+void HT_SetMaxLoadFactor( Hash_table* ht, double max_load );
+bool HT_IsRehashing( const Hash_table* ht );
+bool HT_SetBloom( Hash_table* ht, double fpr );
+void HT_SetHash( Hash_table* ht, eHTHash kind, uint64_t seed );
+void HT_SetRetire( Hash_table* ht, void (*retire)( void*, void* ), void* ctx );
+void HT_SetLogger( Hash_table* ht, void (*logger)( int, const char*, const Users*, void* ), void* ctx );
+bool HT_Reserve( Hash_table* ht, size_t n );
+size_t HT_BulkInsert( Hash_table* ht, const Users* users, size_t n, unsigned threads,
+                      void (*dup)( const Users*, void* ), void* ctx );
+Users* HT_ReadUsers( FILE* f, Auth_pool* pool, size_t* n_read );
+size_t HT_BulkInsertFile( Hash_table* ht, FILE* f, Auth_pool* pool,
+                          void (*dup)( const Users*, void* ), void* ctx, size_t* read );
+void HT_ProbeHistogram( const Hash_table* ht, size_t hist[], size_t n );
+bool HT_HashReport( FILE* keys, FILE* out );
 int Len( Hash_table* ht );
-static char probe( char* key, size_t i );
-size_t h_gon99( char* s, size_t m );
+size_t h_gon99( const char* s, size_t m );
+uint64_t HT_Hash_Gon99( const char* key, size_t len, uint64_t seed );
+uint64_t HT_Hash_Wy( const char* key, size_t len, uint64_t seed );
+uint64_t HT_Hash_XX( const char* key, size_t len, uint64_t seed );
 int h_str_sum( char* str, int m );
 
-// ----- Funciones Usuario -----
-void Sing_Up( Hash_table* ht );
-void Show_Users( Hash_table* ht );
-bool Log_In( Hash_table* ht );
-void Delete_Account( Hash_table* ht );
+// Las funciones de usuario (Sing_Up, Log_In, ...) usan la tabla concurrente: @see CHT_Users.h
 
 #endif
\ No newline at end of file
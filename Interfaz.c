@@ -3,11 +3,28 @@
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <time.h>
 
 #include "Interfaz.h"
 #include "HT_Users.h"
+#include "HT_Store.h"
+#include "Session.h"
 #include "Graph.h"
 #include "Boleto.h"
+#include "Seats.h"
+#include "Waitlist.h"
+#include "Fares.h"
+#include "Ledger.h"
+#include "Bookings.h"
+#include "Wallets.h"
+#include "Service.h"
+
+static Service* servicio = NULL;          ///< Usuarios, vuelos y billeteras; lo abre menuPrincipal
+static Seat_inventory* asientos = NULL;   ///< Asientos libres de cada vuelo (los del servicio)
+static Ledger* libro = NULL;              ///< Ventas y cancelaciones de todos los clientes (el del servicio)
+static Wallet_store* billeteras = NULL;   ///< Billeteras de los clientes y diario de boletos (las del servicio)
+
+static void reporteVentas( Graph* g );
 
 /**
  * @brief La función "menuPrincipal" muestra un menú para un programa llamado "Líneas SkyNet México" y
@@ -17,9 +34,14 @@
  * @param g El parámetro "g" es un puntero a un objeto Graph.
  */
 void menuPrincipal( Graph* g ){
-  Hash_table* tabla = HT_New( HASH_TABLE_SIZE );
-  assert( tabla );                         // el programa se detiene si la tabla no se pudo crear
-  assert( HT_IsEmpty( tabla ) == true );   // la tabla recién se creó, debe estar vacía
+  servicio = Service_Open( g, STORE_DIR );
+  assert( servicio );                      // el programa se detiene si los datos no se pudieron recuperar
+  Concurrent_table* tabla = servicio->users->ct; // las altas y bajas de la tabla quedan en el diario del almacén
+  Auth_pool* auth = servicio->auth;        // las contraseñas se verifican fuera de este hilo
+  Session_table* sesiones = servicio->sessions;
+  asientos = servicio->seats;
+  libro = servicio->ledger;
+  billeteras = servicio->wallets;          // los asientos se reconstruyen desde el diario de boletos
 
   int option = 0;
   bool menu = true;
@@ -34,18 +56,29 @@ void menuPrincipal( Graph* g ){
       printf("2. Sign up\n");           // Registrarse
       printf("3. Show users\n");        // Mostart Usuarios registrados
       printf("4. Delete account\n");    // Eliminar cuenta
-      printf("5. Go out\n");
+      printf("5. Sales report\n");     // Ventas del día por vuelo y aeropuerto
+      printf("6. Go out\n");
       printf("-------------------------------------\n");
       printf("Option: ");
       scanf("%d", &option);
 
+      Session_Advance( sesiones, Session_Clock() );   // expira las sesiones inactivas
+      Wallets_Reclaim( billeteras, Session_Clock(), WALLETS_IDLE );   // y descarga las billeteras sin uso
+
       switch(option)
       {
           case 1:
           {
               system("clear");
-              bool log_in = Log_In( tabla );
-              if( log_in ) menuCliente( g );
+              char nombre[ HT_NAME_MAX ];
+              Session_token ficha;
+              bool log_in = Log_In( tabla, auth, nombre ) && Session_Create( sesiones, nombre, &ficha );
+              Wallet* wallet = log_in ? Wallets_Acquire( billeteras, nombre ) : NULL;
+              if( wallet ){
+                menuCliente( g, wallet );
+                Service_Release( servicio, wallet );
+                Session_End( sesiones, &ficha );
+              }
               else printf("Could not log in, try again");
               getchar();
               getchar();
@@ -54,7 +87,8 @@ void menuPrincipal( Graph* g ){
           case 2:
           {
               system("clear");
-              Sing_Up( tabla );
+              Sing_Up( tabla, auth );
+              Store_Commit( servicio->users );   // el alta no se confirma hasta que llega a disco
               getchar();
               getchar();
               break;
@@ -71,11 +105,20 @@ void menuPrincipal( Graph* g ){
           {
               system("clear");
               Delete_Account( tabla );
+              Store_Commit( servicio->users );
               getchar();
               //getchar();
               break;
           }
           case 5:
+          {
+              system("clear");
+              reporteVentas( g );
+              getchar();
+              getchar();
+              break;
+          }
+          case 6:
           {
               system("clear");
               printf("Thanks for using SkyNet Mexico Lines");
@@ -87,13 +130,14 @@ void menuPrincipal( Graph* g ){
           {
               printf("Invalid option.\n");
               getchar();
-              menuPrincipal( g );
+              // el ciclo vuelve a mostrar el menú; abrir otro almacén aquí duplicaría el diario
               break;
           }
       }
   }
-  HT_Delete( &tabla );
-  assert( tabla == NULL );
+  Auth_Report( auth, stderr );
+  Service_Close( &servicio );
+  assert( servicio == NULL );
 }
 
 /**
@@ -130,7 +174,7 @@ void menuCliente( Graph* g, Wallet* wallet)
       break;
     case 2:
       system("clear");
-      tusViajes(wallet);
+      tusViajes(g, wallet);
       break;
     case 3:
       printf("\nThank you for using SkyNet Mexico Lines.\n");
@@ -145,6 +189,120 @@ void menuCliente( Graph* g, Wallet* wallet)
   }
 }
 
+/**
+ * @brief Muestra las ventas netas del día (desde la medianoche local): el total, cada
+ * aeropuerto de salida y cada vuelo con movimiento, con su factor de ocupación.
+ */
+static void reporteVentas( Graph* g )
+{
+  time_t ahora = time( NULL );
+  struct tm hoy = *localtime( &ahora );
+  hoy.tm_hour = hoy.tm_min = hoy.tm_sec = 0;
+  time_t medianoche = mktime( &hoy );
+
+  const Graph_csr* rutas = &asientos->routes;
+  Ledger_sum* por_vuelo = (Ledger_sum*) malloc( ( rutas->edges + 1 ) * sizeof( Ledger_sum ) );
+  Ledger_sum* por_aeropuerto = (Ledger_sum*) malloc( ( rutas->vertices + 1 ) * sizeof( Ledger_sum ) );
+  float* ocupacion_vuelo = (float*) malloc( ( rutas->edges + 1 ) * sizeof( float ) );
+  float* ocupacion_aeropuerto = (float*) malloc( ( rutas->vertices + 1 ) * sizeof( float ) );
+  if( !por_vuelo || !por_aeropuerto || !ocupacion_vuelo || !ocupacion_aeropuerto ){
+    printf("Not enough memory for the report.\n");
+    goto fin;
+  }
+
+  Ledger_ByRoute( libro, medianoche, ahora + 1, rutas->edges, por_vuelo );
+  Ledger_ByAirport( por_vuelo, rutas, por_aeropuerto );
+  Ledger_LoadFactor( por_vuelo, asientos, ocupacion_vuelo, ocupacion_aeropuerto );
+
+  Ledger_sum total = Ledger_Total( libro, medianoche, ahora + 1 );
+  printf("-------------------------------------\n");
+  printf("  Sales today\n");
+  printf("-------------------------------------\n");
+  printf("Revenue: %lld.00 MXN  Passengers: %lld\n", (long long) total.revenue, (long long) total.pax);
+  printf("-------------------------------------\n");
+  for( uint32_t v = 0; v < rutas->vertices; ++v ){
+    if( por_aeropuerto[ v ].revenue == 0 && por_aeropuerto[ v ].pax == 0 ) continue;
+    Airport* salida = Graph_GetDataByIndex( g, v );
+    printf("%s: %lld.00 MXN, %lld passengers, %.1f%% load\n", salida->iata_code,
+           (long long) por_aeropuerto[ v ].revenue, (long long) por_aeropuerto[ v ].pax,
+           100.0f * ocupacion_aeropuerto[ v ]);
+    for( uint32_t e = rutas->first[ v ]; e < rutas->first[ v + 1 ]; ++e ){
+      if( por_vuelo[ e ].revenue == 0 && por_vuelo[ e ].pax == 0 ) continue;
+      Airport* llegada = Graph_GetDataByIndex( g, rutas->dest[ e ] );
+      printf("    -> %s: %lld.00 MXN, %lld passengers, %.1f%% load\n", llegada->iata_code,
+             (long long) por_vuelo[ e ].revenue, (long long) por_vuelo[ e ].pax, 100.0f * ocupacion_vuelo[ e ]);
+    }
+  }
+  printf("-------------------------------------\n");
+
+fin:
+  free( por_vuelo );
+  free( por_aeropuerto );
+  free( ocupacion_vuelo );
+  free( ocupacion_aeropuerto );
+}
+
+/**
+ * @brief Ofrece formar a los |pasajeros| en la lista de espera del vuelo cotizado, que está
+ * agotado; cada pasajero espera su propio asiento (@see Service_Waitlist).
+ */
+static void formarEnEspera( Wallet* wallet, const Service_quote* cotizacion, time_t salida, int pasajeros )
+{
+  printf("Sorry, there are not enough seats left on this flight.\n");
+  printf("1. Join the waitlist\n");
+  printf("2. Go back\n");
+  printf("Opcion: ");
+  int opcion = 2;
+  scanf("%d", &opcion);
+  if( opcion != 1 ) return;
+
+  printf("Fare class:\n");
+  printf("1. First\n");
+  printf("2. Business\n");
+  printf("3. Economy\n");
+  printf("Opcion: ");
+  int clase = 3;
+  scanf("%d", &clase);
+  eFareClass fare = clase == 1 ? eFare_FIRST : clase == 2 ? eFare_BUSINESS : eFare_ECONOMY;
+
+  int emitidos = 0, formados = 0;
+  for( int i = 0; i < pasajeros; ++i ){
+    uint32_t boleto;
+    eServiceResult r = Service_Waitlist( servicio, wallet, cotizacion, fare, salida, &boleto );
+    if( r == eService_OK ) ++emitidos;
+    else if( r == eService_QUEUED ) ++formados;
+  }
+  if( emitidos ) printf("%d seat(s) opened up and were booked.\n", emitidos);
+  if( formados ) printf("%d passenger(s) added to the waitlist; the tickets will appear in your wallet.\n", formados);
+  if( emitidos + formados < pasajeros ) printf("Some passengers could not be added, try again.\n");
+}
+
+/**
+ * @brief Emite un boleto por pasajero en el vuelo cotizado (@see Service_Book). Si algo
+ * falla no queda ningún asiento ni boleto; si el vuelo está agotado ofrece la lista de
+ * espera. |salida| es la hora de salida del vuelo.
+ *
+ * @return true si se emitieron todos los boletos.
+ */
+static bool emitirBoletos( Wallet* wallet, const Service_quote* cotizacion, time_t salida, int pasajeros,
+                           uint16_t pref )
+{
+  uint32_t boletos[ SEATS_MAX_WIDTH ];
+  switch( Service_Book( servicio, wallet, cotizacion, pasajeros, pref, salida, boletos, NULL ) ){
+    case eService_OK:
+      return true;
+    case eService_SOLD_OUT:
+      formarEnEspera( wallet, cotizacion, salida, pasajeros );
+      return false;
+    case eService_NOT_DURABLE:
+      printf("Your booking could not be saved, please contact us.\n");
+      return false;
+    default:
+      printf("Your flight could not be booked, try again.\n");
+      return false;
+  }
+}
+
 /**
  * @brief La función "reservarTicket" permite al usuario reservar un vuelo seleccionando los aeropuertos de
  * salida y llegada, mostrando la información del vuelo y ofreciendo opciones para confirmar o cancelar
@@ -169,22 +327,30 @@ void reservarTicket( Graph* g, Wallet* wallet)
   char code1[4];
   printf("\nDeparture airport: ");
   scanf( "%3s", code1 );
-  int idx1 = Graph_GetIndexByIATA(g , code1);
   
   char code2[4];
   printf("\nArrival airport: ");
   scanf( "%3s", code2 );
-  int idx2 = Graph_GetIndexByIATA(g , code1);
-  if( idx1 == -1 || idx2 == -1 ){
+  // Precio y duración salen de las tablas de tarifas; el precio depende de la hora de salida
+  time_t ahora = time( NULL );
+  Service_quote cotizacion;
+  eServiceResult cotizado = Service_Quote( servicio, code1, code2, ahora, &cotizacion );
+  if( cotizado == eService_BAD_REQUEST ){
     printf("Invalid airport code. Press Enter to continue\n");
     printf("-------------------------------------\n");
     getchar();
     reservarTicket( g, wallet );
   }
+  else if( cotizado != eService_OK ){
+    printf("There are no flights on this route. Press Enter to continue\n");
+    printf("-------------------------------------\n");
+    getchar();
+    reservarTicket( g, wallet );
+  }
   else{
-    int dist = Graph_GetWeight( g, idx1, idx2 );
-    int time_flight = dist/14;
-    int ticket_price = dist*2 + 500;
+    int dist = cotizacion.distance;
+    int time_flight = cotizacion.minutes;
+    int ticket_price = cotizacion.price;
     printf("-------------------------------------\n");
     printf("**Flight info:**\n");
     printf("%s --> %s \n", code1, code2);
@@ -218,16 +384,31 @@ void reservarTicket( Graph* g, Wallet* wallet)
         scanf("%d", &opcion2);
         switch(opcion2){
           case 1:
-            Airport* start = Graph_GetDataByIndex( g, idx1 );
-            Airport* end = Graph_GetDataByIndex( g, idx2 ); 
-
-            Wallet_insert(wallet, ticket_price, dist, time_flight, start, end);
+          {
+            int pasajeros = 0;
+            printf("Number of passengers (1-%d): ", SEATS_MAX_WIDTH);
+            scanf("%d", &pasajeros);
+            printf("Seat preference:\n");
+            printf("1. Window\n");
+            printf("2. Aisle\n");
+            printf("3. No preference\n");
+            printf("Opcion: ");
+            int preferencia = 3;
+            scanf("%d", &preferencia);
+            uint16_t pref = preferencia == 1 ? asientos->layout.window :
+                            preferencia == 2 ? asientos->layout.aisle : 0;
 
-            printf("Your flight was booked sucessfully!.\n");
+            if( pasajeros < 1 || pasajeros > SEATS_MAX_WIDTH ){
+              printf("Invalid number of passengers.\n");
+            }
+            else if( emitirBoletos( wallet, &cotizacion, ahora, pasajeros, pref ) ){
+              printf("Your flight was booked sucessfully!.\n");
+            }
             printf("Press Enter to continue\n");
             printf("-------------------------------------\n");
             getchar();
             break;
+          }
           case 2:
             menuCliente( g, wallet);
               break;
@@ -250,32 +431,126 @@ void reservarTicket( Graph* g, Wallet* wallet)
 }
 
 /**
- * @brief La función “tusViajes” permite al usuario cancelar un vuelo desde su billetera
- * o volver al menú principal.
+ * @brief Cancela un boleto que sale del aeropuerto |code|. Los boletos se buscan en el
+ * índice de salidas de la billetera; si hay varios se pregunta cuál.
+ */
+static void cancelarPorSalida( Graph* g, Wallet* wallet, char code[] )
+{
+  int idx = Graph_GetIndexByIATA( g, code );
+  if( idx == -1 ){
+    printf("Invalid airport code.\n");
+    return;
+  }
+
+  size_t primero;
+  size_t n = Wallet_Range( wallet, eWalletBy_START, idx, idx, &primero );
+  const uint32_t* salidas = Wallet_Sorted( wallet, eWalletBy_START ) + primero;
+  uint32_t handle = WALLET_NO_TICKET;
+  if( n == 0 ){
+    printf("You have no flights departing from %s.\n", code);
+    return;
+  }
+  else if( n == 1 ){
+    handle = salidas[ 0 ];
+  }
+  else{
+    for( size_t i = 0; i < n; ++i ){
+      printf("Ticket #%u: \n", (unsigned) salidas[ i ]);
+      TicketPrint( g, Wallet_Get( wallet, salidas[ i ] ) );
+      printf("\n");
+    }
+    printf("Ticket # to cancel: ");
+    unsigned elegido = WALLET_NO_TICKET;
+    scanf("%u", &elegido);
+    for( size_t i = 0; i < n; ++i ){
+      if( salidas[ i ] == elegido ) handle = elegido;
+    }
+    if( handle == WALLET_NO_TICKET ){
+      printf("Invalid option.\n");
+      return;
+    }
+  }
+  // Su asiento pasa al primero de la lista de espera del vuelo o vuelve al inventario
+  if( Service_Cancel( servicio, wallet, handle, time( NULL ) ) == eService_NOT_DURABLE ){
+    printf("Your cancellation could not be saved, please contact us.\n");
+  }
+  else printf("Your flight was cancelled.\n");
+}
+
+/**
+ * @brief Muestra los pasajeros de la billetera que esperan asiento y saca de la lista de
+ * espera al que se elija (@see Service_LeaveWaitlist).
+ */
+static void dejarEspera( Graph* g, Wallet* wallet )
+{
+  if( wallet->n_waits == 0 ){
+    printf("You are not on any waitlist.\n");
+    return;
+  }
+  for( uint32_t i = 0; i < wallet->n_waits; ++i ){
+    printf("Waitlist #%u: \n", (unsigned) i + 1);
+    TicketPrint( g, &wallet->waits[ i ].ticket );
+    printf("\n");
+  }
+  printf("Waitlist # to leave: ");
+  unsigned elegido = 0;
+  scanf("%u", &elegido);
+  if( elegido == 0 || elegido > wallet->n_waits ){
+    printf("Invalid option.\n");
+    return;
+  }
+  // si mientras tanto recibió su asiento, el boleto ya está en la billetera
+  if( Service_LeaveWaitlist( servicio, wallet, wallet->waits[ elegido - 1 ].place ) == eService_OK ){
+    printf("You left the waitlist.\n");
+  }
+  else printf("A seat was already assigned; the ticket is in your wallet.\n");
+}
+
+/**
+ * @brief La función “tusViajes” permite al usuario cancelar un vuelo desde su billetera,
+ * ver sus boletos ordenados por precio o por hora de salida, dejar una lista de espera o volver
+ * al menú principal.
  * 
+ * @param g El grafo de aeropuertos, para mostrar los boletos.
  * @param wallet El parámetro "wallet" es un puntero a un objeto Wallet.
  */
-void tusViajes(Wallet* wallet){
+void tusViajes(Graph* g, Wallet* wallet){
   system("clear");
   printf("-------------------------------------\n");
-  Wallet_Print(wallet);
+  Wallet_Print(g, wallet);
   printf("-------------------------------------\n");
   printf("Choose an option:\n");
   printf("1. Cancel a flight\n");
-  printf("2. Go back to main menu\n");
+  printf("2. Sort by price\n");
+  printf("3. Sort by departure\n");
+  printf("4. Leave a waitlist (%u waiting)\n", (unsigned) wallet->n_waits);
+  printf("5. Go back to main menu\n");
   printf("-------------------------------------\n");
   printf("Opcion: ");
   int opcion;
   scanf("%d", &opcion);
   switch(opcion){
     case 1:
-      printf("Please type the IATA code of the flight you want cancel");
+      printf("Please type the IATA code of the departure airport of the flight you want cancel: ");
       char code[4];
       scanf("%3s", code);
-      Wallet_Pop(wallet, *code);
+      cancelarPorSalida(g, wallet, code);
     break;
     case 2:
-    menuCliente( wallet);
+    case 3:
+      system("clear");
+      printf("-------------------------------------\n");
+      Wallet_PrintBy(g, wallet, opcion == 2 ? eWalletBy_PRICE : eWalletBy_DEPARTURE);
+      printf("Press Enter to continue\n");
+      getchar();
+      getchar();
+      tusViajes(g, wallet);
+    break;
+    case 4:
+      dejarEspera(g, wallet);
+    break;
+    case 5:
+    menuCliente( g, wallet);
     break;
     default:
     printf("Invalid option.\n");
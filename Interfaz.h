@@ -10,6 +10,6 @@ void inicioSesion();
 void menuCliente( Graph* g, Wallet* wallet);
 
 void reservarTicket( Graph* g, Wallet* wallet);
-void tusViajes(Wallet* wallet);
+void tusViajes(Graph* g, Wallet* wallet);
 
 #endif   /* ----- #ifndef INTERFAZ_INC  ----- */
\ No newline at end of file
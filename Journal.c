@@ -0,0 +1,451 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Journal.h"
+
+#if defined( __x86_64__ )
+#include <nmmintrin.h>
+#endif
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+static uint32_t crc_table[ 256 ];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Llena la tabla del CRC-32C (polinomio de Castagnoli, reflejado).
+ */
+static void crc_init( void )
+{
+   for( uint32_t i = 0; i < 256; ++i )
+   {
+      uint32_t c = i;
+      for( int k = 0; k < 8; ++k ) c = c & 1 ? ( c >> 1 ) ^ 0x82F63B78u : c >> 1;
+      crc_table[ i ] = c;
+   }
+}
+
+#if defined( __x86_64__ )
+/**
+ * @brief CRC-32C con la instrucción crc32 de SSE4.2, ocho bytes a la vez.
+ */
+__attribute__(( target( "sse4.2" ) ))
+static uint32_t crc32c_hw( uint32_t crc, const unsigned char* p, size_t len )
+{
+   uint64_t c = crc;
+   for( ; len >= 8; len -= 8, p += 8 )
+   {
+      uint64_t w;
+      memcpy( &w, p, 8 );
+      c = _mm_crc32_u64( c, w );
+   }
+   for( ; len > 0; --len, ++p ) c = _mm_crc32_u8( ( uint32_t ) c, *p );
+   return ( uint32_t ) c;
+}
+#endif
+
+/**
+ * @brief Escribe |len| bytes completos (write() puede escribir menos).
+ */
+static bool write_all( int fd, const char* p, size_t len )
+{
+   while( len > 0 )
+   {
+      ssize_t n = write( fd, p, len );
+      if( n < 0 )
+      {
+         if( errno == EINTR ) continue;
+         return false;
+      }
+      p += n;
+      len -= ( size_t ) n;
+   }
+   return true;
+}
+
+/**
+ * @brief Hilo de "group commit": toma todos los registros acumulados, los escribe con un
+ * solo write() y hace un solo fdatasync() por lote.
+ */
+static void* syncer_main( void* arg )
+{
+   Journal* j = ( Journal* ) arg;
+   char* spare = NULL;
+   size_t spare_cap = 0;
+
+   pthread_mutex_lock( &j->lock );
+   for( ;; )
+   {
+      while( j->running && j->buf_len == 0 ) pthread_cond_wait( &j->work, &j->lock );
+      if( j->buf_len == 0 ) break;
+      // !running y sin pendientes: terminamos; con pendientes, se escriben primero
+
+      char* batch = j->buf;
+      size_t batch_cap = j->buf_cap;
+      size_t len = j->buf_len;
+      uint64_t upto = j->next_lsn;
+      int fd = j->fd;     // Journal_Trim sólo lo cambia entre lotes
+
+      j->buf = spare;
+      j->buf_cap = spare_cap;
+      j->buf_len = 0;
+      j->writing = true;
+      pthread_mutex_unlock( &j->lock );
+
+      bool ok = write_all( fd, batch, len ) && fdatasync( fd ) == 0;
+
+      pthread_mutex_lock( &j->lock );
+      j->writing = false;
+      spare = batch;
+      spare_cap = batch_cap;
+      if( ok ) j->durable_lsn = upto;
+      else j->failed = true;
+      ++j->syncs;
+      pthread_cond_broadcast( &j->durable );
+   }
+   pthread_mutex_unlock( &j->lock );
+
+   free( spare );
+   return NULL;
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Calcula el CRC-32C de un bloque de memoria. Usa la instrucción de SSE4.2 si el
+ * procesador la tiene.
+ *
+ * @param crc CRC acumulado (0 para empezar).
+ * @param data Los datos.
+ * @param len Número de bytes.
+ *
+ * @return El CRC acumulado.
+ */
+uint32_t Journal_Crc32c( uint32_t crc, const void* data, size_t len )
+{
+   const unsigned char* p = ( const unsigned char* ) data;
+   crc = ~crc;
+
+#if defined( __x86_64__ )
+   if( __builtin_cpu_supports( "sse4.2" ) ) return ~crc32c_hw( crc, p, len );
+#endif
+
+   pthread_once( &crc_once, crc_init );
+   for( ; len > 0; --len, ++p ) crc = crc_table[ ( crc ^ *p ) & 0xFF ] ^ ( crc >> 8 );
+   return ~crc;
+}
+
+/**
+ * @brief Abre (o crea) un diario para anexar registros y arranca su hilo de fsync.
+ *
+ * @param path Ruta del archivo.
+ * @param payload_size Tamaño fijo de la carga útil de cada registro.
+ * @param next_lsn LSN del siguiente registro (el que devolvió @see Journal_Replay).
+ *
+ * @return Una referencia al diario, o NULL si no se pudo abrir.
+ */
+Journal* Journal_Open( const char* path, size_t payload_size, uint64_t next_lsn )
+{
+   Journal* j = ( Journal* ) calloc( 1, sizeof( Journal ) );
+   if( NULL == j ) return NULL;
+
+   // también se lee: al recortarlo se copian sus últimos registros (@see Journal_Trim)
+   j->fd = open( path, O_RDWR | O_CREAT | O_APPEND, 0644 );
+   j->path = j->fd >= 0 ? strdup( path ) : NULL;
+   if( NULL == j->path )
+   {
+      if( j->fd >= 0 ) close( j->fd );
+      free( j );
+      return NULL;
+   }
+
+   j->payload_size = payload_size;
+   j->record_size = sizeof( Journal_header ) + payload_size;
+   j->next_lsn = next_lsn;
+   j->durable_lsn = next_lsn;
+   j->running = true;
+
+   pthread_mutex_init( &j->lock, NULL );
+   pthread_cond_init( &j->work, NULL );
+   pthread_cond_init( &j->durable, NULL );
+
+   if( pthread_create( &j->syncer, NULL, syncer_main, j ) != 0 )
+   {
+      close( j->fd );
+      free( j->path );
+      free( j );
+      return NULL;
+   }
+
+   return j;
+}
+
+/**
+ * @brief Escribe lo pendiente, detiene el hilo de fsync y cierra el diario.
+ *
+ * @param j La dirección de una referencia al diario.
+ */
+void Journal_Close( Journal** j )
+{
+   assert( j && *j );
+   Journal* jr = *j;
+
+   pthread_mutex_lock( &jr->lock );
+   jr->running = false;
+   pthread_cond_signal( &jr->work );
+   pthread_mutex_unlock( &jr->lock );
+   pthread_join( jr->syncer, NULL );
+
+   close( jr->fd );
+   pthread_mutex_destroy( &jr->lock );
+   pthread_cond_destroy( &jr->work );
+   pthread_cond_destroy( &jr->durable );
+   free( jr->buf );
+   free( jr->path );
+   free( jr );
+   *j = NULL;
+}
+
+/**
+ * @brief Anexa un registro. No espera a que llegue a disco (@see Journal_Wait).
+ *
+ * @param j Referencia al diario.
+ * @param type Tipo del registro.
+ * @param payload |payload_size| bytes de carga útil.
+ *
+ * @return El LSN asignado al registro.
+ */
+uint64_t Journal_Append( Journal* j, uint32_t type, const void* payload )
+{
+   assert( j );
+
+   pthread_mutex_lock( &j->lock );
+
+   if( j->buf_len + j->record_size > j->buf_cap )
+   {
+      size_t cap = j->buf_cap ? j->buf_cap * 2 : 64 * j->record_size;
+      char* tmp = ( char* ) realloc( j->buf, cap );
+      if( NULL == tmp )
+      {
+         j->failed = true;
+         uint64_t lsn = j->next_lsn;
+         pthread_mutex_unlock( &j->lock );
+         return lsn;
+      }
+      j->buf = tmp;
+      j->buf_cap = cap;
+   }
+
+   Journal_header h = { 0, type, j->next_lsn };
+   char* rec = j->buf + j->buf_len;
+   memcpy( rec, &h, sizeof( h ) );
+   memcpy( rec + sizeof( h ), payload, j->payload_size );
+   h.crc = Journal_Crc32c( 0, rec + sizeof( h.crc ), j->record_size - sizeof( h.crc ) );
+   memcpy( rec, &h.crc, sizeof( h.crc ) );
+
+   j->buf_len += j->record_size;
+   uint64_t lsn = j->next_lsn++;
+
+   pthread_cond_signal( &j->work );
+   pthread_mutex_unlock( &j->lock );
+
+   return lsn;
+}
+
+/**
+ * @brief Espera a que el registro |lsn| (y todos los anteriores) esté en disco.
+ *
+ * @param j Referencia al diario.
+ * @param lsn El LSN que devolvió @see Journal_Append.
+ *
+ * @return true si el registro es durable; false si hubo un error de escritura.
+ */
+bool Journal_Wait( Journal* j, uint64_t lsn )
+{
+   assert( j );
+
+   pthread_mutex_lock( &j->lock );
+   while( !j->failed && j->durable_lsn <= lsn ) pthread_cond_wait( &j->durable, &j->lock );
+   bool ok = !j->failed;
+   pthread_mutex_unlock( &j->lock );
+
+   return ok;
+}
+
+/**
+ * @brief Espera a que todos los registros anexados hasta ahora estén en disco.
+ *
+ * @return true si lo están; false si hubo un error de escritura.
+ */
+bool Journal_Flush( Journal* j )
+{
+   assert( j );
+
+   pthread_mutex_lock( &j->lock );
+   uint64_t last = j->next_lsn;
+   pthread_mutex_unlock( &j->lock );
+
+   return last == 0 || Journal_Wait( j, last - 1 );
+}
+
+/**
+ * @return El LSN que tendrá el siguiente registro; los anteriores ya se anexaron.
+ */
+uint64_t Journal_NextLsn( Journal* j )
+{
+   assert( j );
+
+   pthread_mutex_lock( &j->lock );
+   uint64_t lsn = j->next_lsn;
+   pthread_mutex_unlock( &j->lock );
+
+   return lsn;
+}
+
+/**
+ * @brief Quita del archivo los registros con LSN menor que |upto|, que ya cubre un
+ * snapshot. Los demás se copian a un archivo nuevo que reemplaza al diario con rename(),
+ * así que una caída a la mitad deja el diario anterior completo. Los LSN siguen
+ * creciendo.
+ *
+ * Se puede llamar mientras otros hilos anexan: sólo esperan mientras se copian los
+ * registros posteriores a |upto| (los que llegaron durante el snapshot); los que aún no
+ * se escriben siguen en memoria y van al archivo nuevo.
+ *
+ * @param j Referencia al diario.
+ * @param upto Primer LSN que se conserva.
+ *
+ * @return true si el diario quedó recortado; false si hubo un error (el diario anterior
+ * sigue en uso).
+ */
+bool Journal_Trim( Journal* j, uint64_t upto )
+{
+   assert( j );
+
+   size_t len = strlen( j->path ) + 5;
+   char* tmp_path = ( char* ) malloc( len );
+   if( NULL == tmp_path ) return false;
+   snprintf( tmp_path, len, "%s.tmp", j->path );
+
+   pthread_mutex_lock( &j->lock );
+   // el archivo sólo está completo entre dos lotes del hilo de fsync
+   while( j->writing ) pthread_cond_wait( &j->durable, &j->lock );
+
+   // el archivo tiene, seguidos, todos los registros anteriores a |durable_lsn|
+   bool ok = !j->failed;
+   off_t size = ok ? lseek( j->fd, 0, SEEK_END ) : -1;
+   uint64_t keep = j->durable_lsn > upto ? j->durable_lsn - upto : 0;
+   if( size >= 0 && keep > ( uint64_t ) size / j->record_size ) keep = ( uint64_t ) size / j->record_size;
+   size_t bytes = ( size_t ) keep * j->record_size;
+   char* tail = ( char* ) malloc( bytes ? bytes : 1 );
+   ok = size >= 0 && tail && pread( j->fd, tail, bytes, size - ( off_t ) bytes ) == ( ssize_t ) bytes;
+
+   int fd = ok ? open( tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644 ) : -1;
+   ok = fd >= 0 && write_all( fd, tail, bytes ) && fsync( fd ) == 0 && rename( tmp_path, j->path ) == 0;
+   if( ok )
+   {
+      close( j->fd );
+      j->fd = fd;
+
+      // el rename sólo es durable cuando el directorio llega a disco
+      char* dir = strdup( j->path );
+      char* slash = dir ? strrchr( dir, '/' ) : NULL;
+      if( slash )
+      {
+         *slash = '\0';
+         int dfd = open( dir, O_RDONLY );
+         if( dfd >= 0 )
+         {
+            fsync( dfd );
+            close( dfd );
+         }
+      }
+      free( dir );
+   }
+   else if( fd >= 0 )
+   {
+      close( fd );
+      unlink( tmp_path );
+   }
+   pthread_mutex_unlock( &j->lock );
+
+   free( tail );
+   free( tmp_path );
+   return ok;
+}
+
+/**
+ * @brief Lee un diario y entrega a |fn| cada registro válido con LSN mayor o igual a
+ * |from_lsn|. La lectura se detiene en el primer registro incompleto o con CRC inválido
+ * (una escritura interrumpida por una caída) y el archivo se trunca en ese punto, para
+ * que los registros nuevos no queden detrás de basura.
+ *
+ * @param path Ruta del archivo; si no existe, no hay nada que recuperar.
+ * @param payload_size Tamaño fijo de la carga útil.
+ * @param from_lsn Los registros con LSN menor ya están cubiertos por un snapshot.
+ * @param fn Función que aplica cada registro.
+ * @param ctx Argumento de |fn|.
+ *
+ * @return El LSN que debe tener el siguiente registro (al menos |from_lsn|).
+ */
+uint64_t Journal_Replay( const char* path, size_t payload_size, uint64_t from_lsn, Journal_Fn fn, void* ctx )
+{
+   uint64_t next_lsn = from_lsn;
+
+   int fd = open( path, O_RDWR );
+   if( fd < 0 ) return next_lsn;
+
+   struct stat st;
+   if( fstat( fd, &st ) != 0 || st.st_size == 0 )
+   {
+      close( fd );
+      return next_lsn;
+   }
+
+   size_t size = ( size_t ) st.st_size;
+   const char* map = ( const char* ) mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   if( map == MAP_FAILED )
+   {
+      close( fd );
+      return next_lsn;
+   }
+   madvise( ( void* ) map, size, MADV_SEQUENTIAL );
+
+   size_t record_size = sizeof( Journal_header ) + payload_size;
+   size_t off = 0;
+   for( ; off + record_size <= size; off += record_size )
+   {
+      Journal_header h;
+      memcpy( &h, map + off, sizeof( h ) );
+      uint32_t crc = Journal_Crc32c( 0, map + off + sizeof( h.crc ), record_size - sizeof( h.crc ) );
+      if( crc != h.crc ) break;
+
+      if( h.lsn >= from_lsn )
+      {
+         fn( h.type, h.lsn, map + off + sizeof( h ), ctx );
+      }
+      if( h.lsn >= next_lsn ) next_lsn = h.lsn + 1;
+   }
+
+   munmap( ( void* ) map, size );
+   if( off < size )
+   {
+      fprintf( stderr, "%s: discarding %zu bytes of a torn record\n", path, size - off );
+      if( ftruncate( fd, ( off_t ) off ) == 0 ) fsync( fd );
+   }
+   close( fd );
+
+   return next_lsn;
+}
@@ -0,0 +1,64 @@
+#ifndef  JOURNAL_INC
+#define  JOURNAL_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/**
+ * @brief Encabezado de cada registro en disco. Le sigue una carga útil de tamaño fijo.
+ */
+typedef struct
+{
+  uint32_t crc;    ///< CRC-32C de |type|, |lsn| y la carga útil
+  uint32_t type;   ///< Tipo de registro; lo define quien usa el diario
+  uint64_t lsn;    ///< Número de secuencia del registro; crece aunque el archivo se vacíe
+} Journal_header;
+
+/**
+ * @brief Diario de sólo anexar con registros de tamaño fijo.
+ *
+ * Los registros se acumulan en memoria y un hilo los escribe y hace fsync por lotes
+ * ("group commit"): mientras un fsync está en curso se juntan los registros de todos los
+ * hilos que estén escribiendo, y el siguiente fsync los cubre a todos.
+ */
+typedef struct
+{
+  int      fd;            ///< Descriptor del archivo del diario; cambia al recortarlo
+  char*    path;          ///< Ruta del archivo
+  size_t   payload_size;  ///< Tamaño de la carga útil de cada registro
+  size_t   record_size;   ///< sizeof( Journal_header ) + payload_size
+
+  pthread_mutex_t lock;   ///< Protege todo lo que sigue
+  pthread_cond_t  work;   ///< Despierta al hilo de fsync
+  pthread_cond_t  durable;///< Despierta a los que esperan un registro durable
+  char*    buf;           ///< Registros anexados que aún no se escriben
+  size_t   buf_len;
+  size_t   buf_cap;
+  uint64_t next_lsn;      ///< LSN que tendrá el siguiente registro
+  uint64_t durable_lsn;   ///< Todos los registros con LSN menor ya están en disco
+  uint64_t syncs;         ///< Número de fsync realizados (para medir el agrupamiento)
+  bool     failed;        ///< Hubo un error de escritura; ya no se garantiza durabilidad
+  bool     running;       ///< false para pedirle al hilo que termine
+  bool     writing;       ///< El hilo está escribiendo un lote fuera del candado
+
+  pthread_t syncer;       ///< Hilo que escribe y hace fsync
+} Journal;
+
+/**
+ * @brief Función que recibe cada registro válido durante la recuperación.
+ */
+typedef void (*Journal_Fn)( uint32_t type, uint64_t lsn, const void* payload, void* ctx );
+
+Journal* Journal_Open( const char* path, size_t payload_size, uint64_t next_lsn );
+void Journal_Close( Journal** j );
+uint64_t Journal_Append( Journal* j, uint32_t type, const void* payload );
+bool Journal_Wait( Journal* j, uint64_t lsn );
+bool Journal_Flush( Journal* j );
+uint64_t Journal_NextLsn( Journal* j );
+bool Journal_Trim( Journal* j, uint64_t upto );
+uint64_t Journal_Replay( const char* path, size_t payload_size, uint64_t from_lsn, Journal_Fn fn, void* ctx );
+uint32_t Journal_Crc32c( uint32_t crc, const void* data, size_t len );
+
+#endif   /* ----- #ifndef JOURNAL_INC  ----- */
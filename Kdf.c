@@ -0,0 +1,479 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "Kdf.h"
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+static const uint32_t SHA256_K[ 64 ] =
+{
+   0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+   0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+   0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+   0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+   0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+   0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+   0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+   0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/**
+ * @brief Estado de un cálculo de SHA-256 por partes.
+ */
+typedef struct
+{
+   uint32_t h[ 8 ];
+   uint8_t  buf[ 64 ];
+   size_t   buf_len;
+   uint64_t total;
+} sha256_ctx;
+
+static inline uint32_t ror32( uint32_t x, int r )
+{
+   return ( x >> r ) | ( x << ( 32 - r ) );
+}
+
+static inline uint32_t load_be32( const uint8_t* p )
+{
+   return ( uint32_t ) p[ 0 ] << 24 | ( uint32_t ) p[ 1 ] << 16 | ( uint32_t ) p[ 2 ] << 8 | p[ 3 ];
+}
+
+static inline void store_be32( uint8_t* p, uint32_t x )
+{
+   p[ 0 ] = x >> 24; p[ 1 ] = x >> 16; p[ 2 ] = x >> 8; p[ 3 ] = x;
+}
+
+static inline uint32_t load_le32( const uint8_t* p )
+{
+   return ( uint32_t ) p[ 3 ] << 24 | ( uint32_t ) p[ 2 ] << 16 | ( uint32_t ) p[ 1 ] << 8 | p[ 0 ];
+}
+
+static inline void store_le32( uint8_t* p, uint32_t x )
+{
+   p[ 0 ] = x; p[ 1 ] = x >> 8; p[ 2 ] = x >> 16; p[ 3 ] = x >> 24;
+}
+
+static void sha256_block( uint32_t h[ 8 ], const uint8_t* p )
+{
+   uint32_t w[ 64 ];
+   for( int i = 0; i < 16; ++i ) w[ i ] = load_be32( p + 4 * i );
+   for( int i = 16; i < 64; ++i )
+   {
+      uint32_t s0 = ror32( w[ i - 15 ], 7 ) ^ ror32( w[ i - 15 ], 18 ) ^ ( w[ i - 15 ] >> 3 );
+      uint32_t s1 = ror32( w[ i - 2 ], 17 ) ^ ror32( w[ i - 2 ], 19 ) ^ ( w[ i - 2 ] >> 10 );
+      w[ i ] = w[ i - 16 ] + s0 + w[ i - 7 ] + s1;
+   }
+
+   uint32_t a = h[ 0 ], b = h[ 1 ], c = h[ 2 ], d = h[ 3 ];
+   uint32_t e = h[ 4 ], f = h[ 5 ], g = h[ 6 ], k = h[ 7 ];
+   for( int i = 0; i < 64; ++i )
+   {
+      uint32_t t1 = k + ( ror32( e, 6 ) ^ ror32( e, 11 ) ^ ror32( e, 25 ) ) + ( ( e & f ) ^ ( ~e & g ) ) +
+                    SHA256_K[ i ] + w[ i ];
+      uint32_t t2 = ( ror32( a, 2 ) ^ ror32( a, 13 ) ^ ror32( a, 22 ) ) + ( ( a & b ) ^ ( a & c ) ^ ( b & c ) );
+      k = g; g = f; f = e; e = d + t1;
+      d = c; c = b; b = a; a = t1 + t2;
+   }
+   h[ 0 ] += a; h[ 1 ] += b; h[ 2 ] += c; h[ 3 ] += d;
+   h[ 4 ] += e; h[ 5 ] += f; h[ 6 ] += g; h[ 7 ] += k;
+}
+
+static void sha256_init( sha256_ctx* c )
+{
+   static const uint32_t iv[ 8 ] =
+   {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+   };
+   memcpy( c->h, iv, sizeof( iv ) );
+   c->buf_len = 0;
+   c->total = 0;
+}
+
+static void sha256_update( sha256_ctx* c, const void* data, size_t len )
+{
+   const uint8_t* p = ( const uint8_t* ) data;
+   c->total += len;
+
+   if( c->buf_len > 0 )
+   {
+      size_t n = 64 - c->buf_len < len ? 64 - c->buf_len : len;
+      memcpy( c->buf + c->buf_len, p, n );
+      c->buf_len += n;
+      p += n;
+      len -= n;
+      if( c->buf_len < 64 ) return;
+      sha256_block( c->h, c->buf );
+      c->buf_len = 0;
+   }
+   for( ; len >= 64; len -= 64, p += 64 ) sha256_block( c->h, p );
+
+   memcpy( c->buf, p, len );
+   c->buf_len = len;
+}
+
+static void sha256_final( sha256_ctx* c, uint8_t out[ 32 ] )
+{
+   uint64_t bits = c->total * 8;
+   uint8_t pad[ 72 ] = { 0x80 };
+   size_t n = ( c->buf_len < 56 ? 56 : 120 ) - c->buf_len;
+   for( int i = 0; i < 8; ++i ) pad[ n + i ] = ( uint8_t )( bits >> ( 56 - 8 * i ) );
+   sha256_update( c, pad, n + 8 );
+
+   for( int i = 0; i < 8; ++i ) store_be32( out + 4 * i, c->h[ i ] );
+}
+
+/**
+ * @brief HMAC-SHA256 con las llaves interna y externa ya procesadas, para no repetir ese
+ * trabajo en cada bloque de PBKDF2.
+ */
+typedef struct
+{
+   sha256_ctx inner;
+   sha256_ctx outer;
+} hmac_ctx;
+
+static void hmac_init( hmac_ctx* hm, const void* key, size_t key_len )
+{
+   uint8_t k[ 64 ] = { 0 };
+   if( key_len > 64 ) Kdf_Sha256( key, key_len, k );
+   else memcpy( k, key, key_len );
+
+   uint8_t pad[ 64 ];
+   for( int i = 0; i < 64; ++i ) pad[ i ] = k[ i ] ^ 0x36;
+   sha256_init( &hm->inner );
+   sha256_update( &hm->inner, pad, 64 );
+
+   for( int i = 0; i < 64; ++i ) pad[ i ] = k[ i ] ^ 0x5c;
+   sha256_init( &hm->outer );
+   sha256_update( &hm->outer, pad, 64 );
+}
+
+static void hmac_final( const hmac_ctx* hm, sha256_ctx* inner, uint8_t out[ 32 ] )
+{
+   uint8_t ih[ 32 ];
+   sha256_final( inner, ih );
+
+   sha256_ctx outer = hm->outer;
+   sha256_update( &outer, ih, 32 );
+   sha256_final( &outer, out );
+}
+
+/**
+ * @brief Salsa20/8 sobre un bloque de 16 palabras, en su lugar.
+ */
+static void salsa20_8( uint32_t b[ 16 ] )
+{
+   uint32_t x[ 16 ];
+   memcpy( x, b, sizeof( x ) );
+
+#define R( a, n ) ( ( ( a ) << ( n ) ) | ( ( a ) >> ( 32 - ( n ) ) ) )
+   for( int i = 0; i < 8; i += 2 )
+   {
+      x[  4 ] ^= R( x[  0 ] + x[ 12 ],  7 );  x[  8 ] ^= R( x[  4 ] + x[  0 ],  9 );
+      x[ 12 ] ^= R( x[  8 ] + x[  4 ], 13 );  x[  0 ] ^= R( x[ 12 ] + x[  8 ], 18 );
+      x[  9 ] ^= R( x[  5 ] + x[  1 ],  7 );  x[ 13 ] ^= R( x[  9 ] + x[  5 ],  9 );
+      x[  1 ] ^= R( x[ 13 ] + x[  9 ], 13 );  x[  5 ] ^= R( x[  1 ] + x[ 13 ], 18 );
+      x[ 14 ] ^= R( x[ 10 ] + x[  6 ],  7 );  x[  2 ] ^= R( x[ 14 ] + x[ 10 ],  9 );
+      x[  6 ] ^= R( x[  2 ] + x[ 14 ], 13 );  x[ 10 ] ^= R( x[  6 ] + x[  2 ], 18 );
+      x[  3 ] ^= R( x[ 15 ] + x[ 11 ],  7 );  x[  7 ] ^= R( x[  3 ] + x[ 15 ],  9 );
+      x[ 11 ] ^= R( x[  7 ] + x[  3 ], 13 );  x[ 15 ] ^= R( x[ 11 ] + x[  7 ], 18 );
+
+      x[  1 ] ^= R( x[  0 ] + x[  3 ],  7 );  x[  2 ] ^= R( x[  1 ] + x[  0 ],  9 );
+      x[  3 ] ^= R( x[  2 ] + x[  1 ], 13 );  x[  0 ] ^= R( x[  3 ] + x[  2 ], 18 );
+      x[  6 ] ^= R( x[  5 ] + x[  4 ],  7 );  x[  7 ] ^= R( x[  6 ] + x[  5 ],  9 );
+      x[  4 ] ^= R( x[  7 ] + x[  6 ], 13 );  x[  5 ] ^= R( x[  4 ] + x[  7 ], 18 );
+      x[ 11 ] ^= R( x[ 10 ] + x[  9 ],  7 );  x[  8 ] ^= R( x[ 11 ] + x[ 10 ],  9 );
+      x[  9 ] ^= R( x[  8 ] + x[ 11 ], 13 );  x[ 10 ] ^= R( x[  9 ] + x[  8 ], 18 );
+      x[ 12 ] ^= R( x[ 15 ] + x[ 14 ],  7 );  x[ 13 ] ^= R( x[ 12 ] + x[ 15 ],  9 );
+      x[ 14 ] ^= R( x[ 13 ] + x[ 12 ], 13 );  x[ 15 ] ^= R( x[ 14 ] + x[ 13 ], 18 );
+   }
+#undef R
+
+   for( int i = 0; i < 16; ++i ) b[ i ] += x[ i ];
+}
+
+/**
+ * @brief BlockMix de scrypt: |in| y |out| son 2r bloques de 16 palabras.
+ */
+static void block_mix( const uint32_t* in, uint32_t* out, unsigned r )
+{
+   uint32_t x[ 16 ];
+   memcpy( x, in + ( 2 * r - 1 ) * 16, sizeof( x ) );
+
+   for( unsigned i = 0; i < 2 * r; ++i )
+   {
+      for( int k = 0; k < 16; ++k ) x[ k ] ^= in[ i * 16 + k ];
+      salsa20_8( x );
+      // los bloques pares van a la primera mitad y los impares a la segunda
+      memcpy( out + ( ( i & 1 ) * r + i / 2 ) * 16, x, sizeof( x ) );
+   }
+}
+
+/**
+ * @brief ROMix de scrypt sobre un bloque de 128 * r bytes. Es la parte que cuesta
+ * memoria: guarda N versiones del bloque y luego las visita en un orden que depende
+ * de los datos.
+ *
+ * @param v Espacio para N * 32 * r palabras.
+ * @param xy Espacio para 64 * r palabras.
+ */
+static void ro_mix( uint8_t* b, unsigned r, uint64_t n, uint32_t* v, uint32_t* xy )
+{
+   size_t words = 32 * r;
+   uint32_t* x = xy;
+   uint32_t* y = xy + words;
+
+   for( size_t k = 0; k < words; ++k ) x[ k ] = load_le32( b + 4 * k );
+
+   for( uint64_t i = 0; i < n; i += 2 )
+   {
+      memcpy( v + i * words, x, words * 4 );
+      block_mix( x, y, r );
+      memcpy( v + ( i + 1 ) * words, y, words * 4 );
+      block_mix( y, x, r );
+   }
+
+   for( uint64_t i = 0; i < n; i += 2 )
+   {
+      uint64_t j = x[ ( 2 * r - 1 ) * 16 ] & ( n - 1 );
+      for( size_t k = 0; k < words; ++k ) x[ k ] ^= v[ j * words + k ];
+      block_mix( x, y, r );
+
+      j = y[ ( 2 * r - 1 ) * 16 ] & ( n - 1 );
+      for( size_t k = 0; k < words; ++k ) y[ k ] ^= v[ j * words + k ];
+      block_mix( y, x, r );
+   }
+
+   for( size_t k = 0; k < words; ++k ) store_le32( b + 4 * k, x[ k ] );
+}
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+typedef struct
+{
+   size_t size;
+   void*  mem;
+} scratch_buf;
+
+static void scratch_free( void* p )
+{
+   scratch_buf* s = ( scratch_buf* ) p;
+   free( s->mem );
+   free( s );
+}
+
+static void scratch_init( void )
+{
+   pthread_key_create( &scratch_key, scratch_free );
+}
+
+/**
+ * @brief Memoria de trabajo de scrypt del hilo que llama. Se conserva entre llamadas:
+ * pedir y regresar al sistema 16 MB en cada verificación costaría casi tanto como la
+ * verificación misma (una falla de página por cada 4 KB).
+ *
+ * @return Al menos |size| bytes alineados a 64, o NULL si no hubo memoria.
+ */
+static void* scratch_get( size_t size )
+{
+   pthread_once( &scratch_once, scratch_init );
+
+   scratch_buf* s = ( scratch_buf* ) pthread_getspecific( scratch_key );
+   if( NULL == s )
+   {
+      s = ( scratch_buf* ) calloc( 1, sizeof( scratch_buf ) );
+      if( NULL == s || pthread_setspecific( scratch_key, s ) != 0 )
+      {
+         free( s );
+         return NULL;
+      }
+   }
+
+   if( s->size < size )
+   {
+      free( s->mem );
+      s->mem = aligned_alloc( 64, ( size + 63 ) & ~( size_t ) 63 );
+      s->size = s->mem ? size : 0;
+   }
+   return s->mem;
+}
+
+/**
+ * @brief Lee bytes aleatorios del sistema.
+ */
+static bool random_bytes( void* buf, size_t len )
+{
+   int fd = open( "/dev/urandom", O_RDONLY );
+   if( fd < 0 ) return false;
+
+   bool ok = read( fd, buf, len ) == ( ssize_t ) len;
+   close( fd );
+   return ok;
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief SHA-256 de un bloque de memoria.
+ */
+void Kdf_Sha256( const void* data, size_t len, uint8_t out[ 32 ] )
+{
+   sha256_ctx c;
+   sha256_init( &c );
+   sha256_update( &c, data, len );
+   sha256_final( &c, out );
+}
+
+/**
+ * @brief PBKDF2 con HMAC-SHA256 (RFC 8018).
+ *
+ * @param pw La contraseña.
+ * @param pw_len Su longitud en bytes.
+ * @param salt La sal.
+ * @param salt_len Su longitud en bytes.
+ * @param iterations Número de iteraciones (scrypt usa 1).
+ * @param out Destino de la llave derivada.
+ * @param out_len Bytes a derivar.
+ */
+void Kdf_Pbkdf2Sha256( const void* pw, size_t pw_len, const void* salt, size_t salt_len,
+                       uint32_t iterations, uint8_t* out, size_t out_len )
+{
+   hmac_ctx hm;
+   hmac_init( &hm, pw, pw_len );
+
+   sha256_ctx salted = hm.inner;
+   sha256_update( &salted, salt, salt_len );
+
+   for( uint32_t block = 1; out_len > 0; ++block )
+   {
+      uint8_t be[ 4 ];
+      store_be32( be, block );
+
+      sha256_ctx inner = salted;
+      sha256_update( &inner, be, 4 );
+
+      uint8_t u[ 32 ], t[ 32 ];
+      hmac_final( &hm, &inner, u );
+      memcpy( t, u, 32 );
+
+      for( uint32_t i = 1; i < iterations; ++i )
+      {
+         inner = hm.inner;
+         sha256_update( &inner, u, 32 );
+         hmac_final( &hm, &inner, u );
+         for( int k = 0; k < 32; ++k ) t[ k ] ^= u[ k ];
+      }
+
+      size_t n = out_len < 32 ? out_len : 32;
+      memcpy( out, t, n );
+      out += n;
+      out_len -= n;
+   }
+}
+
+/**
+ * @brief scrypt (RFC 7914): una función de derivación de llaves que, además de tiempo,
+ * exige 128 * r * N bytes de memoria, lo que encarece los ataques con hardware
+ * especializado.
+ *
+ * @param pw La contraseña.
+ * @param pw_len Su longitud en bytes.
+ * @param salt La sal.
+ * @param salt_len Su longitud en bytes.
+ * @param log_n Costo: N = 2^log_n, entre 1 y 30.
+ * @param r Tamaño de bloque.
+ * @param p Paralelismo.
+ * @param out Destino de la llave derivada.
+ * @param out_len Bytes a derivar.
+ *
+ * @return true si se pudo calcular; false si los parámetros no son válidos o no hubo
+ * memoria.
+ */
+bool Kdf_Scrypt( const void* pw, size_t pw_len, const void* salt, size_t salt_len,
+                 unsigned log_n, unsigned r, unsigned p, uint8_t* out, size_t out_len )
+{
+   if( log_n < 1 || log_n > 30 || r == 0 || p == 0 || ( uint64_t ) r * p >= ( 1u << 30 ) ) return false;
+
+   uint64_t n = ( uint64_t ) 1 << log_n;
+   size_t block = 128 * ( size_t ) r;
+
+   uint8_t* b = ( uint8_t* ) malloc( block * p );
+   uint8_t* work = ( uint8_t* ) scratch_get( block * n + 2 * block );
+   if( NULL == b || NULL == work )
+   {
+      free( b );
+      return false;
+   }
+
+   Kdf_Pbkdf2Sha256( pw, pw_len, salt, salt_len, 1, b, block * p );
+   for( unsigned i = 0; i < p; ++i )
+   {
+      ro_mix( b + i * block, r, n, ( uint32_t* ) work, ( uint32_t* )( work + block * n ) );
+   }
+   Kdf_Pbkdf2Sha256( pw, pw_len, b, block * p, 1, out, out_len );
+
+   free( b );
+   return true;
+}
+
+/**
+ * @brief Deriva la llave de una contraseña nueva con una sal aleatoria.
+ *
+ * @param h Destino de la sal, la llave y los parámetros.
+ * @param password La contraseña en texto.
+ * @param log_n Costo (@see Kdf_Scrypt); KDF_LOG_N por defecto.
+ *
+ * @return true si se pudo derivar; false en caso contrario.
+ */
+bool Kdf_Hash( Kdf_hash* h, const char* password, unsigned log_n )
+{
+   assert( h && password );
+
+   memset( h, 0, sizeof( *h ) );
+   h->log_n = ( uint8_t ) log_n;
+   h->r = KDF_R;
+   h->p = KDF_P;
+
+   if( random_bytes( h->salt, KDF_SALT_LEN ) &&
+       Kdf_Scrypt( password, strlen( password ), h->salt, KDF_SALT_LEN, h->log_n, h->r, h->p, h->key, KDF_KEY_LEN ) )
+   {
+      return true;
+   }
+
+   memset( h, 0, sizeof( *h ) );
+   return false;
+}
+
+/**
+ * @brief Verifica una contraseña contra su llave guardada, con los parámetros con los
+ * que se guardó. La comparación toma el mismo tiempo sin importar dónde difieran.
+ *
+ * @return true si la contraseña es correcta; false en caso contrario.
+ */
+bool Kdf_Verify( const Kdf_hash* h, const char* password )
+{
+   assert( h && password );
+
+   if( h->log_n == 0 ) return false;
+
+   uint8_t key[ KDF_KEY_LEN ];
+   if( !Kdf_Scrypt( password, strlen( password ), h->salt, KDF_SALT_LEN, h->log_n, h->r, h->p, key, KDF_KEY_LEN ) )
+   {
+      return false;
+   }
+
+   uint8_t diff = 0;
+   for( int i = 0; i < KDF_KEY_LEN; ++i ) diff |= key[ i ] ^ h->key[ i ];
+   return diff == 0;
+}
@@ -0,0 +1,36 @@
+#ifndef  KDF_INC
+#define  KDF_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define KDF_SALT_LEN 16   ///< Bytes de sal aleatoria por contraseña
+#define KDF_KEY_LEN 32    ///< Bytes de la llave derivada que se guarda
+#define KDF_LOG_N 14      ///< Costo por defecto: N = 2^14, 16 MB de memoria por verificación con r = 8
+#define KDF_R 8           ///< Tamaño de bloque de scrypt (128 * r bytes)
+#define KDF_P 1           ///< Paralelismo interno de scrypt
+
+/**
+ * @brief Contraseña guardada: nunca se guarda el texto, sólo la llave que scrypt deriva
+ * de él con una sal propia, junto con los parámetros de costo con los que se derivó.
+ */
+typedef struct
+{
+  uint8_t salt[ KDF_SALT_LEN ];
+  uint8_t key[ KDF_KEY_LEN ];
+  uint8_t log_n;          ///< N = 2^log_n; 0 si no hay contraseña
+  uint8_t r;
+  uint8_t p;
+  uint8_t pad[ 5 ];
+} Kdf_hash;
+
+void Kdf_Sha256( const void* data, size_t len, uint8_t out[ 32 ] );
+void Kdf_Pbkdf2Sha256( const void* pw, size_t pw_len, const void* salt, size_t salt_len,
+                       uint32_t iterations, uint8_t* out, size_t out_len );
+bool Kdf_Scrypt( const void* pw, size_t pw_len, const void* salt, size_t salt_len,
+                 unsigned log_n, unsigned r, unsigned p, uint8_t* out, size_t out_len );
+bool Kdf_Hash( Kdf_hash* h, const char* password, unsigned log_n );
+bool Kdf_Verify( const Kdf_hash* h, const char* password );
+
+#endif   /* ----- #ifndef KDF_INC  ----- */
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "Ledger.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Convierte una hora al origen del libro, saturando al rango de |stamp|.
+ */
+static int32_t stamp_of( const Ledger* ledger, time_t when )
+{
+   int64_t s = (int64_t) when - (int64_t) ledger->epoch;
+   if( s < INT32_MIN ) return INT32_MIN;
+   if( s > INT32_MAX ) return INT32_MAX;
+   return (int32_t) s;
+}
+
+/**
+ * @brief Pone en cero el importe y los pasajeros de los renglones fuera de [from, to).
+ *
+ * @param c El bloque.
+ * @param n Renglones del bloque a revisar.
+ * @param price Recibe los importes filtrados.
+ * @param pax Recibe los pasajeros filtrados.
+ */
+static void filter( const Ledger_chunk* c, size_t n, int32_t from, int32_t to, int32_t* price, int32_t* pax )
+{
+   size_t i = 0;
+#ifdef __SSE2__
+   __m128i lo = _mm_set1_epi32( from );
+   __m128i hi = _mm_set1_epi32( to );
+   for( ; i + 4 <= n; i += 4 )
+   {
+      __m128i s = _mm_load_si128( ( const __m128i* ) &c->stamp[ i ] );
+      // from <= s  <=>  !( from > s )
+      __m128i keep = _mm_andnot_si128( _mm_cmpgt_epi32( lo, s ), _mm_cmplt_epi32( s, hi ) );
+      _mm_storeu_si128( ( __m128i* ) &price[ i ], _mm_and_si128( keep, _mm_load_si128( ( const __m128i* ) &c->price[ i ] ) ) );
+      _mm_storeu_si128( ( __m128i* ) &pax[ i ], _mm_and_si128( keep, _mm_load_si128( ( const __m128i* ) &c->pax[ i ] ) ) );
+   }
+#endif
+   for( ; i < n; ++i )
+   {
+      bool keep = from <= c->stamp[ i ] && c->stamp[ i ] < to;
+      price[ i ] = keep ? c->price[ i ] : 0;
+      pax[ i ] = keep ? c->pax[ i ] : 0;
+   }
+}
+
+#ifdef __SSE2__
+/**
+ * @brief Suma los cuatro enteros de 32 bits de |v|, con signo, a los dos acumuladores de
+ * 64 bits de |acc|.
+ */
+static __m128i add_widened( __m128i acc, __m128i v )
+{
+   __m128i sign = _mm_srai_epi32( v, 31 );
+   acc = _mm_add_epi64( acc, _mm_unpacklo_epi32( v, sign ) );
+   return _mm_add_epi64( acc, _mm_unpackhi_epi32( v, sign ) );
+}
+
+static int64_t horizontal( __m128i acc )
+{
+   int64_t lanes[ 2 ];
+   _mm_storeu_si128( ( __m128i* ) lanes, acc );
+   return lanes[ 0 ] + lanes[ 1 ];
+}
+#endif
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Crea un libro vacío. Las horas se guardan relativas al momento de crearlo.
+ *
+ * @return El libro, o NULL si no hubo memoria.
+ */
+Ledger* Ledger_New( void )
+{
+   Ledger* ledger = (Ledger*) malloc( sizeof( Ledger ) );
+   if( !ledger ) return NULL;
+
+   ledger->chunks = (Ledger_chunk**) calloc( LEDGER_MAX_CHUNKS, sizeof( Ledger_chunk* ) );
+   if( !ledger->chunks )
+   {
+      free( ledger );
+      return NULL;
+   }
+   pthread_mutex_init( &ledger->lock, NULL );
+   atomic_init( &ledger->len, 0 );
+   ledger->epoch = time( NULL );
+   return ledger;
+}
+
+/**
+ * @brief Destruye el libro.
+ *
+ * @param ledger Referencia al libro; queda en NULL.
+ */
+void Ledger_Delete( Ledger** ledger )
+{
+   assert( ledger );
+   Ledger* l = *ledger;
+   if( !l ) return;
+
+   for( size_t i = 0; i < LEDGER_MAX_CHUNKS && l->chunks[ i ]; ++i ) free( l->chunks[ i ] );
+   free( l->chunks );
+   pthread_mutex_destroy( &l->lock );
+   free( l );
+   *ledger = NULL;
+}
+
+/**
+ * @brief Anexa una venta (|pax| > 0) o una cancelación (|pax| < 0) de un boleto.
+ *
+ * @param ledger El libro.
+ * @param ticket El boleto vendido o cancelado.
+ * @param route Su número de vuelo.
+ * @param pax Pasajeros: +1 por cada venta, -1 por cada cancelación.
+ * @param when Hora de la operación.
+ *
+ * @return false si el libro está lleno o no hubo memoria.
+ */
+bool Ledger_Append( Ledger* ledger, const Ticket* ticket, uint32_t route, int32_t pax, time_t when )
+{
+   assert( ledger && ticket );
+   assert( pax != 0 );
+
+   pthread_mutex_lock( &ledger->lock );
+   size_t row = atomic_load_explicit( &ledger->len, memory_order_relaxed );
+   size_t k = row / LEDGER_CHUNK;
+   size_t i = row % LEDGER_CHUNK;
+   if( k >= LEDGER_MAX_CHUNKS ) goto full;
+   if( !ledger->chunks[ k ] )
+   {
+      ledger->chunks[ k ] = (Ledger_chunk*) aligned_alloc( 64, sizeof( Ledger_chunk ) );
+      if( !ledger->chunks[ k ] ) goto full;
+   }
+
+   Ledger_chunk* c = ledger->chunks[ k ];
+   c->price[ i ] = pax > 0 ? ticket->price : -ticket->price;
+   c->pax[ i ] = pax;
+   c->stamp[ i ] = stamp_of( ledger, when );
+   c->route[ i ] = route;
+   c->start[ i ] = ticket->start;
+   c->end[ i ] = ticket->end;
+   c->distance[ i ] = ticket->distance;
+   c->minutes[ i ] = ticket->time;
+   // Publica el renglón: los lectores que vean el nuevo |len| ven también sus columnas
+   atomic_store_explicit( &ledger->len, row + 1, memory_order_release );
+   pthread_mutex_unlock( &ledger->lock );
+   return true;
+
+full:
+   pthread_mutex_unlock( &ledger->lock );
+   return false;
+}
+
+/**
+ * @brief Renglones publicados en el libro.
+ */
+size_t Ledger_Len( Ledger* ledger )
+{
+   assert( ledger );
+   return atomic_load_explicit( &ledger->len, memory_order_acquire );
+}
+
+/**
+ * @brief Importe y pasajeros netos de todas las operaciones hechas en [from, to).
+ */
+Ledger_sum Ledger_Total( Ledger* ledger, time_t from, time_t to )
+{
+   assert( ledger );
+
+   Ledger_sum sum = { 0, 0 };
+   size_t len = Ledger_Len( ledger );
+   int32_t lo = stamp_of( ledger, from ), hi = stamp_of( ledger, to );
+   for( size_t k = 0; k * LEDGER_CHUNK < len; ++k )
+   {
+      const Ledger_chunk* c = ledger->chunks[ k ];
+      size_t n = len - k * LEDGER_CHUNK < LEDGER_CHUNK ? len - k * LEDGER_CHUNK : LEDGER_CHUNK;
+
+      size_t i = 0;
+#ifdef __SSE2__
+      // Sin agrupar no hace falta pasar por filter(): se filtra y se suma en la misma pasada
+      __m128i vlo = _mm_set1_epi32( lo ), vhi = _mm_set1_epi32( hi );
+      __m128i rev = _mm_setzero_si128(), cnt = _mm_setzero_si128();
+      for( ; i + 4 <= n; i += 4 )
+      {
+         __m128i s = _mm_load_si128( ( const __m128i* ) &c->stamp[ i ] );
+         __m128i keep = _mm_andnot_si128( _mm_cmpgt_epi32( vlo, s ), _mm_cmplt_epi32( s, vhi ) );
+         rev = add_widened( rev, _mm_and_si128( keep, _mm_load_si128( ( const __m128i* ) &c->price[ i ] ) ) );
+         // pax es ±1: basta con 32 bits por carril dentro de un bloque
+         cnt = _mm_add_epi32( cnt, _mm_and_si128( keep, _mm_load_si128( ( const __m128i* ) &c->pax[ i ] ) ) );
+      }
+      sum.revenue += horizontal( rev );
+      sum.pax += horizontal( add_widened( _mm_setzero_si128(), cnt ) );
+#endif
+      for( ; i < n; ++i )
+      {
+         if( lo <= c->stamp[ i ] && c->stamp[ i ] < hi )
+         {
+            sum.revenue += c->price[ i ];
+            sum.pax += c->pax[ i ];
+         }
+      }
+   }
+   return sum;
+}
+
+/**
+ * @brief Importe y pasajeros netos por vuelo de las operaciones hechas en [from, to).
+ * Filtra cada bloque por hora con instrucciones vectoriales y después acumula por vuelo.
+ *
+ * @param ledger El libro.
+ * @param from Inicio del periodo.
+ * @param to Fin del periodo (no incluido).
+ * @param routes Número de vuelos; se ignoran los renglones de vuelos mayores.
+ * @param by_route Recibe |routes| sumas.
+ */
+void Ledger_ByRoute( Ledger* ledger, time_t from, time_t to, size_t routes, Ledger_sum by_route[] )
+{
+   assert( ledger && ( routes == 0 || by_route ) );
+
+   memset( by_route, 0, routes * sizeof( Ledger_sum ) );
+   size_t len = Ledger_Len( ledger );
+   int32_t lo = stamp_of( ledger, from ), hi = stamp_of( ledger, to );
+   int32_t price[ LEDGER_CHUNK ], pax[ LEDGER_CHUNK ];
+   for( size_t k = 0; k * LEDGER_CHUNK < len; ++k )
+   {
+      const Ledger_chunk* c = ledger->chunks[ k ];
+      size_t n = len - k * LEDGER_CHUNK < LEDGER_CHUNK ? len - k * LEDGER_CHUNK : LEDGER_CHUNK;
+      filter( c, n, lo, hi, price, pax );
+      for( size_t i = 0; i < n; ++i )
+      {
+         uint32_t r = c->route[ i ];
+         if( r < routes )
+         {
+            by_route[ r ].revenue += price[ i ];
+            by_route[ r ].pax += pax[ i ];
+         }
+      }
+   }
+}
+
+/**
+ * @brief Agrupa por aeropuerto de salida sumas hechas por vuelo.
+ *
+ * @param by_route Sumas por vuelo (@see Ledger_ByRoute), |routes->edges| elementos.
+ * @param routes Las aristas del grafo, numeradas como los vuelos.
+ * @param by_airport Recibe |routes->vertices| sumas.
+ */
+void Ledger_ByAirport( const Ledger_sum by_route[], const Graph_csr* routes, Ledger_sum by_airport[] )
+{
+   assert( by_route && routes && by_airport );
+
+   for( uint32_t v = 0; v < routes->vertices; ++v )
+   {
+      Ledger_sum sum = { 0, 0 };
+      for( uint32_t e = routes->first[ v ]; e < routes->first[ v + 1 ]; ++e )
+      {
+         sum.revenue += by_route[ e ].revenue;
+         sum.pax += by_route[ e ].pax;
+      }
+      by_airport[ v ] = sum;
+   }
+}
+
+/**
+ * @brief Factor de ocupación (pasajeros / asientos) por vuelo y por aeropuerto de salida.
+ *
+ * @param by_route Sumas por vuelo, una por vuelo del inventario.
+ * @param inv El inventario de asientos; da la capacidad de cada vuelo.
+ * @param route_lf Recibe el factor de cada vuelo; puede ser NULL.
+ * @param airport_lf Recibe el factor de cada aeropuerto; puede ser NULL.
+ */
+void Ledger_LoadFactor( const Ledger_sum by_route[], const Seat_inventory* inv, float route_lf[], float airport_lf[] )
+{
+   assert( by_route && inv );
+
+   const Graph_csr* routes = &inv->routes;
+   for( uint32_t v = 0; v < routes->vertices; ++v )
+   {
+      int64_t pax = 0, seats = 0;
+      for( uint32_t e = routes->first[ v ]; e < routes->first[ v + 1 ]; ++e )
+      {
+         if( route_lf ) route_lf[ e ] = inv->capacity[ e ] ? (float) by_route[ e ].pax / inv->capacity[ e ] : 0.0f;
+         pax += by_route[ e ].pax;
+         seats += inv->capacity[ e ];
+      }
+      if( airport_lf ) airport_lf[ v ] = seats ? (float) pax / (float) seats : 0.0f;
+   }
+}
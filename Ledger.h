@@ -0,0 +1,67 @@
+#ifndef  LEDGER_INC
+#define  LEDGER_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "Graph.h"
+#include "Boleto.h"
+#include "Seats.h"
+
+#define LEDGER_CHUNK 4096         ///< Renglones por bloque de columnas
+#define LEDGER_MAX_CHUNKS 65536   ///< Bloques como máximo (unos 268 millones de renglones)
+
+/**
+ * @brief Un bloque de renglones del libro, guardado por columnas para que las sumas
+ * recorran memoria contigua.
+ */
+typedef struct
+{
+  _Alignas( 64 ) int32_t price[ LEDGER_CHUNK ];  ///< Importe; negativo en las cancelaciones
+  _Alignas( 64 ) int32_t pax[ LEDGER_CHUNK ];    ///< +1 por venta, -1 por cancelación
+  _Alignas( 64 ) int32_t stamp[ LEDGER_CHUNK ];  ///< Segundos desde |epoch| del libro
+  _Alignas( 64 ) uint32_t route[ LEDGER_CHUNK ]; ///< Número de vuelo (@see Graph_Csr)
+  _Alignas( 64 ) uint32_t start[ LEDGER_CHUNK ]; ///< Vértice de salida
+  _Alignas( 64 ) uint32_t end[ LEDGER_CHUNK ];   ///< Vértice de llegada
+  _Alignas( 64 ) int32_t distance[ LEDGER_CHUNK ];
+  _Alignas( 64 ) int32_t minutes[ LEDGER_CHUNK ];
+} Ledger_chunk;
+
+/**
+ * @brief Libro de ventas y cancelaciones de todos los clientes, sólo de anexar.
+ *
+ * Los escritores se serializan con |lock| y publican cada renglón al avanzar |len|; los
+ * lectores no toman candados: leen |len| y sólo recorren renglones anteriores, que ya no
+ * cambian.
+ */
+typedef struct
+{
+  pthread_mutex_t lock;       ///< Serializa a los escritores
+  _Atomic size_t  len;        ///< Renglones publicados
+  time_t          epoch;      ///< Origen de |stamp|
+  Ledger_chunk**  chunks;     ///< LEDGER_MAX_CHUNKS apuntadores; los bloques se reservan al llenarse el anterior
+} Ledger;
+
+/**
+ * @brief Importe y pasajeros netos de un grupo.
+ */
+typedef struct
+{
+  int64_t revenue;
+  int64_t pax;
+} Ledger_sum;
+
+Ledger* Ledger_New( void );
+void Ledger_Delete( Ledger** ledger );
+bool Ledger_Append( Ledger* ledger, const Ticket* ticket, uint32_t route, int32_t pax, time_t when );
+size_t Ledger_Len( Ledger* ledger );
+Ledger_sum Ledger_Total( Ledger* ledger, time_t from, time_t to );
+void Ledger_ByRoute( Ledger* ledger, time_t from, time_t to, size_t routes, Ledger_sum by_route[] );
+void Ledger_ByAirport( const Ledger_sum by_route[], const Graph_csr* routes, Ledger_sum by_airport[] );
+void Ledger_LoadFactor( const Ledger_sum by_route[], const Seat_inventory* inv, float route_lf[], float airport_lf[] );
+
+#endif   /* ----- #ifndef LEDGER_INC  ----- */
@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+#include "Loadgen.h"
+#include "Server.h"
+#include "Wire.h"
+
+/**
+ * Generador de carga para el servidor (@see Server_Run): abre muchas conexiones a la vez y
+ * cada una tiene siempre una solicitud en curso. Las primeras LOADGEN_BOOKERS se registran,
+ * inician sesión y alternan entre comprar un boleto en un vuelo al azar y cancelarlo; las
+ * demás sólo consultan (aeropuertos, cotizaciones y rutas), que es lo que más llega.
+ */
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+#define CLIENT_BUFFER 256   ///< Bytes del búfer de cada conexión; cabe cualquier respuesta
+
+typedef enum
+{
+   eClient_BROWSE,      ///< Sólo consulta
+   eClient_SIGNUP,
+   eClient_LOGIN,
+   eClient_BOOK,
+   eClient_CANCEL,
+} eClientStep;
+
+typedef struct
+{
+   int           fd;
+   eClientStep   step;          ///< Lo que pide la solicitud en curso (o la siguiente)
+   bool          busy;          ///< Tiene una solicitud en curso
+   uint32_t      id;            ///< Identificador de la solicitud en curso
+   double        sent;          ///< Cuándo se envió, en segundos
+   Session_token token;
+   uint32_t      handle;        ///< Boleto por cancelar
+   size_t        in_len;
+   uint8_t       in[ CLIENT_BUFFER ];
+   size_t        out_len;
+   size_t        out_pos;
+   uint8_t       out[ CLIENT_BUFFER ];
+} Client;
+
+typedef struct
+{
+   const Graph*  graph;
+   Graph_csr     csr;
+   uint32_t*     from;          ///< Vértice de salida de cada arista de |csr|
+   Client*       clients;
+   unsigned      n_clients;
+   int           epoll_fd;
+   uint64_t      rng;
+   uint32_t      next_id;
+   bool          stopping;      ///< Ya no se envían solicitudes nuevas
+   unsigned      busy;          ///< Solicitudes en curso
+   uint64_t      requests;
+   uint64_t      errors;
+   uint64_t      histogram[ LOADGEN_BUCKETS ];
+} Loadgen;
+
+static double now( void )
+{
+   struct timespec t;
+   clock_gettime( CLOCK_MONOTONIC, &t );
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/**
+ * @brief xorshift64*: números al azar baratos y reproducibles.
+ */
+static uint32_t next_random( Loadgen* lg, uint32_t bound )
+{
+   lg->rng ^= lg->rng >> 12;
+   lg->rng ^= lg->rng << 25;
+   lg->rng ^= lg->rng >> 27;
+   return ( uint32_t )( ( ( lg->rng * 2685821657736338717ull ) >> 32 ) % bound );
+}
+
+static const char* iata_of( const Loadgen* lg, uint32_t vertex )
+{
+   return Graph_GetDataByIndex( lg->graph, ( int ) vertex )->iata_code;
+}
+
+/**
+ * @brief Cubeta del histograma de una latencia: cuatro por cada potencia de 2 de
+ * microsegundos.
+ */
+static size_t bucket_of( double us )
+{
+   size_t b = us < 1.0 ? 0 : ( size_t )( 4.0 * log2( us ) );
+   return b < LOADGEN_BUCKETS ? b : LOADGEN_BUCKETS - 1;
+}
+
+/**
+ * @brief Latencia por debajo de la cual queda la fracción |q| de las respuestas (el límite
+ * superior de su cubeta).
+ */
+static double percentile( const Loadgen* lg, double q )
+{
+   uint64_t target = ( uint64_t ) ceil( q * lg->requests ), seen = 0;
+   for( size_t b = 0; b < LOADGEN_BUCKETS; ++b )
+   {
+      seen += lg->histogram[ b ];
+      if( seen >= target && seen > 0 ) return exp2( ( b + 1 ) / 4.0 );
+   }
+   return 0.0;
+}
+
+/**
+ * @brief Escribe lo que el socket acepte de la solicitud en curso.
+ *
+ * @return false si se perdió la conexión.
+ */
+static bool flush( Loadgen* lg, Client* c )
+{
+   while( c->out_pos < c->out_len )
+   {
+      ssize_t n = send( c->fd, c->out + c->out_pos, c->out_len - c->out_pos, MSG_NOSIGNAL );
+      if( n > 0 ) c->out_pos += ( size_t ) n;
+      else if( n < 0 && errno == EINTR ) continue;
+      else if( n < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) break;
+      else return false;
+   }
+
+   struct epoll_event ev = { .events = EPOLLIN | ( c->out_pos < c->out_len ? EPOLLOUT : 0 ), .data.ptr = c };
+   epoll_ctl( lg->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev );
+   return true;
+}
+
+/**
+ * @brief Arma y envía la siguiente solicitud del cliente.
+ */
+static bool send_next( Loadgen* lg, Client* c )
+{
+   Wire w;
+   Wire_Writer( &w, c->out, sizeof( c->out ) );
+   Wire_PutU32( &w, 0 );
+   Wire_PutU32( &w, c->id = ++lg->next_id );
+
+   char name[ 32 ];
+   snprintf( name, sizeof( name ), "load%u", ( unsigned )( c - lg->clients ) );
+   uint32_t e = next_random( lg, lg->csr.edges );
+   switch( c->step )
+   {
+   case eClient_SIGNUP:
+      Wire_PutU8( &w, SERVER_OP_SIGNUP );
+      Wire_PutStr( &w, name );
+      Wire_PutStr( &w, strcat( name, "@load" ) );
+      Wire_PutStr( &w, "load" );
+      Wire_PutU64( &w, 4111111111111111ull );
+      break;
+   case eClient_LOGIN:
+      Wire_PutU8( &w, SERVER_OP_LOGIN );
+      Wire_PutStr( &w, name );
+      Wire_PutStr( &w, "load" );
+      break;
+   case eClient_BOOK:
+      Wire_PutU8( &w, SERVER_OP_BOOK );
+      Wire_PutBytes( &w, c->token.bytes, sizeof( c->token.bytes ) );
+      Wire_PutStr( &w, iata_of( lg, lg->from[ e ] ) );
+      Wire_PutStr( &w, iata_of( lg, lg->csr.dest[ e ] ) );
+      Wire_PutU8( &w, 1 );
+      Wire_PutU8( &w, 0 );
+      Wire_PutU64( &w, 0 );
+      break;
+   case eClient_CANCEL:
+      Wire_PutU8( &w, SERVER_OP_CANCEL );
+      Wire_PutBytes( &w, c->token.bytes, sizeof( c->token.bytes ) );
+      Wire_PutU32( &w, c->handle );
+      break;
+   case eClient_BROWSE:
+   {
+      // la mitad cotizaciones; el resto, rutas y aeropuertos
+      uint32_t pick = next_random( lg, 4 );
+      if( pick < 2 )
+      {
+         Wire_PutU8( &w, SERVER_OP_QUOTE );
+         Wire_PutStr( &w, iata_of( lg, lg->from[ e ] ) );
+         Wire_PutStr( &w, iata_of( lg, lg->csr.dest[ e ] ) );
+         Wire_PutU64( &w, 0 );
+      }
+      else if( pick == 2 && lg->csr.vertices > 1 )
+      {
+         uint32_t a = next_random( lg, lg->csr.vertices );
+         uint32_t b = ( a + 1 + next_random( lg, lg->csr.vertices - 1 ) ) % lg->csr.vertices;
+         Wire_PutU8( &w, SERVER_OP_ROUTE );
+         Wire_PutStr( &w, iata_of( lg, a ) );
+         Wire_PutStr( &w, iata_of( lg, b ) );
+         Wire_PutU64( &w, 0 );
+      }
+      else
+      {
+         Wire_PutU8( &w, SERVER_OP_LOOKUP );
+         Wire_PutStr( &w, iata_of( lg, next_random( lg, lg->csr.vertices ) ) );
+      }
+      break;
+   }
+   }
+   assert( !w.bad );
+
+   // la longitud no se cuenta a sí misma
+   uint32_t len = ( uint32_t ) w.len - 4;
+   for( int i = 0; i < 4; ++i ) c->out[ i ] = ( uint8_t )( len >> ( 24 - 8 * i ) );
+   c->out_len = w.len;
+   c->out_pos = 0;
+   c->busy = true;
+   c->sent = now();
+   ++lg->busy;
+   return flush( lg, c );
+}
+
+/**
+ * @brief Cuenta una respuesta y decide el siguiente paso del cliente.
+ */
+static void on_reply( Loadgen* lg, Client* c, const uint8_t* frame, size_t len )
+{
+   Wire r;
+   Wire_Reader( &r, frame, len );
+   uint32_t id = Wire_GetU32( &r );
+   eServiceResult status = ( eServiceResult ) Wire_GetU8( &r );
+   if( r.bad || id != c->id )
+   {
+      ++lg->errors;
+      return;
+   }
+
+   c->busy = false;
+   --lg->busy;
+   ++lg->requests;
+   ++lg->histogram[ bucket_of( ( now() - c->sent ) * 1e6 ) ];
+   bool expected = status == eService_OK || status == eService_SOLD_OUT ||
+                   ( c->step == eClient_SIGNUP && status == eService_EXISTS );
+   if( !expected ) ++lg->errors;
+
+   switch( c->step )
+   {
+   case eClient_SIGNUP:
+      c->step = expected ? eClient_LOGIN : eClient_BROWSE;
+      break;
+   case eClient_LOGIN:
+      Wire_GetBytes( &r, c->token.bytes, sizeof( c->token.bytes ) );
+      c->step = status == eService_OK && !r.bad ? eClient_BOOK : eClient_BROWSE;
+      break;
+   case eClient_BOOK:
+      if( status == eService_OK )
+      {
+         Wire_GetU32( &r );   // precio
+         Wire_GetU8( &r );    // boletos
+         c->handle = Wire_GetU32( &r );
+         if( !r.bad ) c->step = eClient_CANCEL;
+      }
+      else if( status == eService_DENIED ) c->step = eClient_LOGIN;
+      break;
+   case eClient_CANCEL:
+      c->step = eClient_BOOK;
+      break;
+   case eClient_BROWSE:
+      break;
+   }
+}
+
+/**
+ * @brief Lee las respuestas que llegaron a un cliente y le envía la siguiente solicitud.
+ *
+ * @return false si se perdió la conexión.
+ */
+static bool on_readable( Loadgen* lg, Client* c )
+{
+   ssize_t n = recv( c->fd, c->in + c->in_len, sizeof( c->in ) - c->in_len, 0 );
+   if( n < 0 ) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+   if( n == 0 ) return false;
+   c->in_len += ( size_t ) n;
+
+   size_t off = 0;
+   while( c->in_len - off >= 4 )
+   {
+      const uint8_t* p = c->in + off;
+      uint32_t len = ( ( uint32_t ) p[ 0 ] << 24 ) | ( ( uint32_t ) p[ 1 ] << 16 ) | ( ( uint32_t ) p[ 2 ] << 8 ) | p[ 3 ];
+      if( len > sizeof( c->in ) - 4 ) return false;
+      if( c->in_len - off < 4 + len ) break;
+      on_reply( lg, c, p + 4, len );
+      off += 4 + len;
+   }
+   memmove( c->in, c->in + off, c->in_len - off );
+   c->in_len -= off;
+
+   return c->busy || lg->stopping || send_next( lg, c );
+}
+
+static void drop( Loadgen* lg, Client* c )
+{
+   if( c->fd < 0 ) return;
+   epoll_ctl( lg->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL );
+   close( c->fd );
+   c->fd = -1;
+   if( c->busy )
+   {
+      c->busy = false;
+      --lg->busy;
+      ++lg->errors;
+   }
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Abre |connections| conexiones a un servidor que atiende la red |g| y lo mantiene
+ * ocupado durante |seconds| segundos (@see arriba).
+ *
+ * @param g La misma red de aeropuertos que usa el servidor.
+ * @param address La dirección del servidor (@see Server_Address).
+ * @param connections Conexiones simultáneas.
+ * @param seconds Duración de la corrida.
+ * @param stats Recibe las cuentas de la corrida.
+ *
+ * @return false si no se pudo conectar.
+ */
+bool Loadgen_Run( const Graph* g, const char* address, unsigned connections, double seconds,
+                  Loadgen_stats* stats )
+{
+   assert( g && address && connections > 0 && stats );
+
+   struct sockaddr_storage sa;
+   socklen_t sa_len;
+   if( !Server_Address( address, &sa, &sa_len ) ) return false;
+
+   Loadgen* lg = ( Loadgen* ) calloc( 1, sizeof( Loadgen ) );
+   if( NULL == lg ) return false;
+   lg->graph = g;
+   lg->rng = 0x9e3779b97f4a7c15ull ^ ( uint64_t ) getpid();
+   lg->epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+   lg->clients = ( Client* ) calloc( connections, sizeof( Client ) );
+   bool ok = lg->epoll_fd >= 0 && lg->clients && Graph_Csr( g, &lg->csr ) && lg->csr.edges > 0;
+   if( ok ) lg->from = ( uint32_t* ) malloc( lg->csr.edges * sizeof( uint32_t ) );
+   ok = ok && lg->from;
+   for( uint32_t v = 0; ok && v < lg->csr.vertices; ++v )
+   {
+      for( uint32_t e = lg->csr.first[ v ]; e < lg->csr.first[ v + 1 ]; ++e ) lg->from[ e ] = v;
+   }
+
+   // se conecta con sockets bloqueantes, para no saturar la cola de espera del servidor
+   for( unsigned i = 0; ok && i < connections; ++i )
+   {
+      Client* c = &lg->clients[ i ];
+      c->fd = socket( sa.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+      if( c->fd < 0 || connect( c->fd, ( struct sockaddr* ) &sa, sa_len ) != 0 )
+      {
+         perror( "connect" );
+         if( c->fd >= 0 ) close( c->fd );
+         c->fd = -1;
+         ok = i > 0;
+         break;
+      }
+      fcntl( c->fd, F_SETFL, fcntl( c->fd, F_GETFL ) | O_NONBLOCK );
+      struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+      epoll_ctl( lg->epoll_fd, EPOLL_CTL_ADD, c->fd, &ev );
+      c->step = i < LOADGEN_BOOKERS ? eClient_SIGNUP : eClient_BROWSE;
+      lg->n_clients = i + 1;
+   }
+
+   double start = now(), deadline = start + seconds;
+   for( unsigned i = 0; ok && i < lg->n_clients; ++i )
+   {
+      if( !send_next( lg, &lg->clients[ i ] ) ) drop( lg, &lg->clients[ i ] );
+   }
+
+   struct epoll_event events[ SERVER_EVENTS ];
+   while( ok && lg->busy > 0 )
+   {
+      double t = now();
+      if( !lg->stopping && t >= deadline )
+      {
+         // se esperan las respuestas en curso, pero no para siempre
+         lg->stopping = true;
+         deadline = t + 2.0;
+      }
+      else if( lg->stopping && t >= deadline ) break;
+
+      int n = epoll_wait( lg->epoll_fd, events, SERVER_EVENTS, 100 );
+      for( int i = 0; i < n; ++i )
+      {
+         Client* c = ( Client* ) events[ i ].data.ptr;
+         if( c->fd < 0 ) continue;
+         bool alive = true;
+         if( events[ i ].events & EPOLLOUT ) alive = flush( lg, c );
+         if( alive && ( events[ i ].events & ( EPOLLIN | EPOLLERR | EPOLLHUP ) ) ) alive = on_readable( lg, c );
+         if( !alive ) drop( lg, c );
+      }
+   }
+
+   if( ok )
+   {
+      stats->requests = lg->requests;
+      stats->errors = lg->errors + lg->busy;
+      stats->seconds = seconds;
+      stats->p50 = percentile( lg, 0.50 );
+      stats->p99 = percentile( lg, 0.99 );
+   }
+
+   for( unsigned i = 0; i < lg->n_clients; ++i ) drop( lg, &lg->clients[ i ] );
+   if( lg->epoll_fd >= 0 ) close( lg->epoll_fd );
+   Graph_CsrFree( &lg->csr );
+   free( lg->from );
+   free( lg->clients );
+   free( lg );
+   return ok;
+}
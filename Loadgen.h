@@ -0,0 +1,29 @@
+#ifndef  LOADGEN_INC
+#define  LOADGEN_INC
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "Graph.h"
+
+#define LOADGEN_BOOKERS 16        ///< Conexiones que inician sesión y compran y cancelan boletos
+#define LOADGEN_BUCKETS 128       ///< Cubetas del histograma de latencias (cuatro por potencia de 2)
+
+/**
+ * @brief Cuentas de una corrida del generador de carga.
+ */
+typedef struct
+{
+  uint64_t requests;      ///< Respuestas recibidas
+  uint64_t errors;        ///< Respuestas con error (sin contar EXISTS ni SOLD_OUT, que son esperados)
+                          ///< y solicitudes que no se respondieron a tiempo
+  double   seconds;
+  double   p50;           ///< Latencias en microsegundos
+  double   p99;
+} Loadgen_stats;
+
+bool Loadgen_Run( const Graph* g, const char* address, unsigned connections, double seconds,
+                  Loadgen_stats* stats );
+
+#endif   /* ----- #ifndef LOADGEN_INC  ----- */
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "Pool.h"
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+#define POOL_SLAB_HEAD 64   ///< Bytes al inicio de cada slab; guardan el enlace al siguiente
+
+#ifdef POOL_DEBUG
+#define POOL_HEAD 16                          ///< Encabezado de cada objeto en modo de depuración
+#define POOL_LIVE 0x4c4956454f424a31ull       ///< Estado de un objeto reservado
+#define POOL_FREE 0x465245454f424a31ull       ///< Estado de un objeto libre
+#define POOL_POISON 0xdd                      ///< Relleno de los objetos libres
+#else
+#define POOL_HEAD 0
+#endif
+
+#ifdef POOL_DEBUG
+static uint64_t* state_of( void* obj )
+{
+   return (uint64_t*)( (char*) obj - POOL_HEAD );
+}
+
+static void pool_panic( const char* what, void* obj )
+{
+   fprintf( stderr, "Pool: %s (%p)\n", what, obj );
+   abort();
+}
+
+/**
+ * @brief Marca un objeto como libre y lo rellena (salvo la palabra del enlace).
+ */
+static void poison( Pool* pool, void* obj )
+{
+   uint64_t* state = state_of( obj );
+   if( *state == POOL_FREE ) pool_panic( "double free", obj );
+   if( *state != POOL_LIVE ) pool_panic( "free of an object not from this pool", obj );
+   *state = POOL_FREE;
+   memset( (char*) obj + sizeof( void* ), POOL_POISON, pool->stride - POOL_HEAD - sizeof( void* ) );
+}
+
+/**
+ * @brief Revisa que un objeto libre no se haya escrito desde que se liberó y lo marca
+ * como reservado.
+ */
+static void unpoison( Pool* pool, void* obj )
+{
+   uint64_t* state = state_of( obj );
+   if( *state != POOL_FREE ) pool_panic( "corrupted free list", obj );
+   const unsigned char* p = (const unsigned char*) obj + sizeof( void* );
+   for( size_t i = 0; i < pool->stride - POOL_HEAD - sizeof( void* ); ++i )
+   {
+      if( p[ i ] != POOL_POISON ) pool_panic( "write after free", obj );
+   }
+   *state = POOL_LIVE;
+}
+#endif
+
+/**
+ * @brief Toma un objeto de la lista libre o, si está vacía, uno nunca usado de un slab.
+ *
+ * @pre Se tiene |pool->lock|.
+ *
+ * @return El objeto (sin revisar en modo de depuración), o NULL si no hubo memoria.
+ */
+static void* take( Pool* pool )
+{
+   void* obj = pool->free_list;
+   if( obj )
+   {
+      pool->free_list = *(void**) obj;
+      return obj;
+   }
+
+   if( pool->bump_left == 0 )
+   {
+      size_t bytes = POOL_SLAB_HEAD + pool->stride * POOL_SLAB_OBJECTS;
+      char* slab = (char*) aligned_alloc( 64, ( bytes + 63 ) & ~(size_t) 63 );
+      if( !slab ) return NULL;
+      *(void**) slab = pool->slabs;
+      pool->slabs = slab;
+      pool->n_slabs++;
+      pool->bump = slab + POOL_SLAB_HEAD;
+      pool->bump_left = POOL_SLAB_OBJECTS;
+   }
+   obj = pool->bump + POOL_HEAD;
+#ifdef POOL_DEBUG
+   // Los objetos nunca usados entran a la revisión como si se hubieran liberado
+   *state_of( obj ) = POOL_FREE;
+   memset( (char*) obj + sizeof( void* ), POOL_POISON, pool->stride - POOL_HEAD - sizeof( void* ) );
+#endif
+   pool->bump += pool->stride;
+   pool->bump_left--;
+   return obj;
+}
+
+/**
+ * @brief Regresa un objeto a la lista libre.
+ *
+ * @pre Se tiene |pool->lock|.
+ */
+static void give( Pool* pool, void* obj )
+{
+   *(void**) obj = pool->free_list;
+   pool->free_list = obj;
+}
+
+/**
+ * @brief Destructor de |pool->key|: cuando un hilo termina, sus objetos libres regresan
+ * a la lista compartida y su caché queda libre para otro hilo.
+ */
+static void drain_cache( void* arg )
+{
+   Pool_cache* cache = (Pool_cache*) arg;
+   Pool* pool = (Pool*) cache->pool;
+
+   pthread_mutex_lock( &pool->lock );
+   while( cache->n > 0 ) give( pool, cache->items[ --cache->n ] );
+   cache->used = false;
+   pthread_mutex_unlock( &pool->lock );
+}
+
+/**
+ * @brief Devuelve la caché del hilo que llama en esta reserva; la primera vez le asigna
+ * una que no tenga hilo.
+ *
+ * @return La caché, o NULL si POOL_MAX_THREADS hilos vivos ya tienen una.
+ */
+static Pool_cache* my_cache( Pool* pool )
+{
+   Pool_cache* cache = (Pool_cache*) pthread_getspecific( pool->key );
+   if( cache ) return cache;
+
+   pthread_mutex_lock( &pool->lock );
+   for( int i = 0; i < POOL_MAX_THREADS && !cache; ++i )
+   {
+      if( !pool->caches[ i ].used ) cache = &pool->caches[ i ];
+   }
+   if( cache )
+   {
+      cache->used = pthread_setspecific( pool->key, cache ) == 0;
+      if( !cache->used ) cache = NULL;
+   }
+   pthread_mutex_unlock( &pool->lock );
+   return cache;
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Crea una reserva de objetos de tamaño fijo. No reserva ningún slab hasta la
+ * primera llamada a Pool_Alloc.
+ *
+ * @param size Tamaño de cada objeto.
+ *
+ * @return La reserva, o NULL si no hubo memoria.
+ */
+Pool* Pool_New( size_t size )
+{
+   assert( size > 0 );
+
+   Pool* pool = (Pool*) malloc( sizeof( Pool ) );
+   if( !pool ) return NULL;
+
+   // Cada objeto debe poder guardar el enlace de la lista libre y quedar alineado a 16
+   size_t body = size < sizeof( void* ) ? sizeof( void* ) : size;
+   pool->size = size;
+   pool->stride = ( POOL_HEAD + body + 15 ) & ~(size_t) 15;
+   pool->free_list = NULL;
+   pool->bump = NULL;
+   pool->bump_left = 0;
+   pool->slabs = NULL;
+   pool->n_slabs = 0;
+   pool->caches = (Pool_cache*) aligned_alloc( 64, POOL_MAX_THREADS * sizeof( Pool_cache ) );
+   if( !pool->caches || pthread_key_create( &pool->key, drain_cache ) != 0 )
+   {
+      free( pool->caches );
+      free( pool );
+      return NULL;
+   }
+   for( int i = 0; i < POOL_MAX_THREADS; ++i )
+   {
+      pool->caches[ i ].n = 0;
+      pool->caches[ i ].pool = pool;
+      pool->caches[ i ].used = false;
+   }
+   pthread_mutex_init( &pool->lock, NULL );
+   return pool;
+}
+
+/**
+ * @brief Destruye la reserva y todos sus objetos, estén libres o no.
+ *
+ * @param pool Referencia a la reserva; queda en NULL.
+ *
+ * @pre Ningún otro hilo está usando la reserva ni terminando (sus cachés se vacían al
+ * terminar).
+ */
+void Pool_Delete( Pool** pool )
+{
+   assert( pool );
+   Pool* p = *pool;
+   if( !p ) return;
+
+   void* slab = p->slabs;
+   while( slab )
+   {
+      void* next = *(void**) slab;
+      free( slab );
+      slab = next;
+   }
+   // los hilos que sigan vivos ya no vacían su caché al terminar
+   pthread_key_delete( p->key );
+   free( p->caches );
+   pthread_mutex_destroy( &p->lock );
+   free( p );
+   *pool = NULL;
+}
+
+/**
+ * @brief Reserva un objeto. Su contenido es indefinido.
+ *
+ * @param pool La reserva.
+ *
+ * @return El objeto, o NULL si no hubo memoria.
+ */
+void* Pool_Alloc( Pool* pool )
+{
+   assert( pool );
+
+   void* obj;
+   Pool_cache* cache = my_cache( pool );
+   if( cache && cache->n > 0 )
+   {
+      obj = cache->items[ --cache->n ];
+   }
+   else
+   {
+      pthread_mutex_lock( &pool->lock );
+      obj = take( pool );
+      // Aprovecha el candado para llenar la mitad de la caché
+      if( obj && cache )
+      {
+         while( cache->n < POOL_CACHE / 2 )
+         {
+            void* extra = take( pool );
+            if( !extra ) break;
+            cache->items[ cache->n++ ] = extra;
+         }
+      }
+      pthread_mutex_unlock( &pool->lock );
+      if( !obj ) return NULL;
+   }
+#ifdef POOL_DEBUG
+   unpoison( pool, obj );
+#endif
+   return obj;
+}
+
+/**
+ * @brief Devuelve un objeto a la reserva.
+ *
+ * @param pool La reserva de la que salió el objeto.
+ * @param obj El objeto; puede ser NULL.
+ */
+void Pool_Free( Pool* pool, void* obj )
+{
+   assert( pool );
+   if( !obj ) return;
+
+#ifdef POOL_DEBUG
+   poison( pool, obj );
+#endif
+   Pool_cache* cache = my_cache( pool );
+   if( !cache )
+   {
+      pthread_mutex_lock( &pool->lock );
+      give( pool, obj );
+      pthread_mutex_unlock( &pool->lock );
+      return;
+   }
+
+   if( cache->n == POOL_CACHE )
+   {
+      // Devuelve la mitad de golpe para que el siguiente Pool_Free no vuelva a tomar el candado
+      pthread_mutex_lock( &pool->lock );
+      while( cache->n > POOL_CACHE / 2 ) give( pool, cache->items[ --cache->n ] );
+      pthread_mutex_unlock( &pool->lock );
+   }
+   cache->items[ cache->n++ ] = obj;
+}
+
+/**
+ * @brief Número de objetos para los que la reserva ya tiene memoria.
+ */
+size_t Pool_Capacity( Pool* pool )
+{
+   assert( pool );
+
+   pthread_mutex_lock( &pool->lock );
+   size_t n = pool->n_slabs * POOL_SLAB_OBJECTS;
+   pthread_mutex_unlock( &pool->lock );
+   return n;
+}
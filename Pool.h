@@ -0,0 +1,60 @@
+#ifndef  POOL_INC
+#define  POOL_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define POOL_SLAB_OBJECTS 1024   ///< Objetos que se reservan de una vez cuando la lista libre se agota
+#define POOL_CACHE 64            ///< Objetos libres que cada hilo guarda sin tomar el candado
+#define POOL_MAX_THREADS 64      ///< Hilos vivos con caché propia; los demás usan la lista libre
+
+/**
+ * @brief Caché de objetos libres de un hilo. Sólo la toca su hilo, así que no necesita
+ * candado; cada caché ocupa sus propias líneas de caché.
+ */
+typedef struct
+{
+  _Alignas( 64 ) void* items[ POOL_CACHE ];
+  size_t n;
+  void*  pool;            ///< La reserva (Pool*) a la que pertenece
+  bool   used;            ///< Tiene hilo; se protege con el candado de la reserva
+} Pool_cache;
+
+/**
+ * @brief Reserva de objetos de tamaño fijo.
+ *
+ * Los objetos salen de bloques grandes (slabs) y al liberarse se guardan para reutilizarse;
+ * la memoria sólo se devuelve al sistema con Pool_Delete. Cada hilo aparta hasta
+ * POOL_CACHE objetos libres y pide o devuelve la mitad de golpe a la lista compartida, así
+ * que la mayoría de las reservas y liberaciones no toman el candado. Cuando un hilo
+ * termina, su caché regresa a la lista compartida y queda libre para otro hilo.
+ *
+ * Compilado con -DPOOL_DEBUG cada objeto lleva un encabezado con su estado y los objetos
+ * libres se rellenan con un patrón: liberar dos veces, liberar algo que no salió de la
+ * reserva o escribir en un objeto ya liberado se reporta y aborta el programa.
+ */
+typedef struct
+{
+  size_t   size;          ///< Tamaño pedido de cada objeto
+  size_t   stride;        ///< Bytes que ocupa cada objeto dentro de un slab
+
+  pthread_mutex_t lock;   ///< Protege |free_list|, |bump|, |bump_left|, |slabs| y |n_slabs|
+  void*    free_list;     ///< Objetos libres encadenados por su primera palabra
+  char*    bump;          ///< Siguiente objeto nunca usado del slab más reciente
+  size_t   bump_left;     ///< Objetos nunca usados que quedan en ese slab
+  void*    slabs;         ///< Slabs encadenados por su primera palabra
+  size_t   n_slabs;
+
+  Pool_cache* caches;     ///< POOL_MAX_THREADS cachés, una por hilo
+  pthread_key_t key;      ///< Caché de cada hilo en esta reserva; se vacía cuando el hilo termina
+} Pool;
+
+Pool* Pool_New( size_t size );
+void Pool_Delete( Pool** pool );
+void* Pool_Alloc( Pool* pool );
+void Pool_Free( Pool* pool, void* obj );
+size_t Pool_Capacity( Pool* pool );
+
+#endif   /* ----- #ifndef POOL_INC  ----- */
@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "Seats.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const Seat_layout SEATS_NARROWBODY = { .rows = 30, .width = 6, .joined = 0x01b, .window = 0x021, .aisle = 0x00c };
+const Seat_layout SEATS_WIDEBODY = { .rows = 40, .width = 10, .joined = 0x1bb, .window = 0x201, .aisle = 0x0cc };
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+#define SEATS_CHUNK 8   ///< Filas que se revisan a la vez (8 x 16 bits = un registro SSE2)
+
+/**
+ * @brief Para cada fila, los asientos donde empieza un bloque de |k| asientos libres y
+ * juntos. Se construye con r(1) = libres y r(j + 1) = libres & juntos & ( r(j) >> 1 ): el
+ * bit i de r(j + 1) dice que i está libre, que i + 1 está a su lado y que en i + 1 empieza
+ * un bloque de j.
+ *
+ * @param rows SEATS_CHUNK filas de un mapa.
+ * @param joined Máscara de asientos juntos de la distribución.
+ * @param k Tamaño del bloque.
+ * @param want Sólo cuentan los inicios de bloque con este bit encendido.
+ * @param starts Recibe SEATS_CHUNK máscaras de inicios de bloque.
+ *
+ * @return Máscara de las filas (bit por fila) con algún inicio de bloque.
+ */
+static unsigned chunk_starts( const uint16_t rows[ SEATS_CHUNK ], uint16_t joined, unsigned k, uint16_t want,
+                              uint16_t starts[ SEATS_CHUNK ] )
+{
+#ifdef __SSE2__
+   __m128i free = _mm_loadu_si128( ( const __m128i* ) rows );
+   __m128i link = _mm_and_si128( free, _mm_set1_epi16( ( short ) joined ) );
+   __m128i r = free;
+   for( unsigned j = 1; j < k; ++j ) r = _mm_and_si128( link, _mm_srli_epi16( r, 1 ) );
+   r = _mm_and_si128( r, _mm_set1_epi16( ( short ) want ) );
+   _mm_storeu_si128( ( __m128i* ) starts, r );
+
+   // Empaca la comparación a un byte por fila para obtener un bit por fila
+   __m128i empty = _mm_cmpeq_epi16( r, _mm_setzero_si128() );
+   return ~( unsigned ) _mm_movemask_epi8( _mm_packs_epi16( empty, empty ) ) & 0xffu;
+#else
+   unsigned found = 0;
+   for( unsigned i = 0; i < SEATS_CHUNK; ++i )
+   {
+      uint16_t link = rows[ i ] & joined;
+      uint16_t r = rows[ i ];
+      for( unsigned j = 1; j < k; ++j ) r = link & ( r >> 1 );
+      starts[ i ] = r & want;
+      if( starts[ i ] ) found |= 1u << i;
+   }
+   return found;
+#endif
+}
+
+/**
+ * @brief Bits que ocupan un bloque de |k| asientos que empieza en |col|.
+ */
+static uint16_t block_bits( unsigned col, unsigned k )
+{
+   return ( uint16_t )( ( ( 1u << k ) - 1 ) << col );
+}
+
+/**
+ * @brief Busca el primer bloque de |k| asientos libres y juntos que contenga algún asiento
+ * de |pref| (o cualquiera si |pref| es 0) y lo marca como ocupado.
+ *
+ * @param map Mapa del vuelo.
+ * @param layout Distribución de asientos.
+ * @param rows Filas del mapa, múltiplo de SEATS_CHUNK.
+ * @param k Tamaño del bloque; a lo más el ancho de la fila.
+ * @param pref Asientos preferidos.
+ * @param seat Recibe el primer asiento del bloque.
+ *
+ * @return true si encontró y ocupó un bloque.
+ */
+static bool claim_block( _Atomic uint16_t* map, const Seat_layout* layout, size_t rows, unsigned k,
+                         uint16_t pref, Seat_pos* seat )
+{
+   // Un bloque contiene un asiento preferido si empieza a lo más k - 1 lugares antes de él
+   uint16_t want = 0xffff;
+   if( pref )
+   {
+      want = 0;
+      for( unsigned j = 0; j < k; ++j ) want |= pref >> j;
+   }
+
+   uint16_t chunk[ SEATS_CHUNK ];
+   uint16_t starts[ SEATS_CHUNK ];
+   for( size_t base = 0; base < rows; base += SEATS_CHUNK )
+   {
+      for( unsigned i = 0; i < SEATS_CHUNK; ++i )
+      {
+         chunk[ i ] = atomic_load_explicit( &map[ base + i ], memory_order_relaxed );
+      }
+      unsigned found = chunk_starts( chunk, layout->joined, k, want, starts );
+      while( found )
+      {
+         unsigned i = ( unsigned ) __builtin_ctz( found );
+         found &= found - 1;
+
+         // Otro hilo pudo ocupar parte del bloque desde la lectura: se reintenta con el
+         // valor actual de la fila mientras el bloque siga libre
+         _Atomic uint16_t* row = &map[ base + i ];
+         uint16_t have = chunk[ i ];
+         uint16_t cand = starts[ i ];
+         while( cand )
+         {
+            unsigned col = ( unsigned ) __builtin_ctz( cand );
+            uint16_t bits = block_bits( col, k );
+            if( ( have & bits ) != bits )
+            {
+               cand &= cand - 1;
+               continue;
+            }
+            if( atomic_compare_exchange_weak_explicit( row, &have, ( uint16_t )( have & ~bits ),
+                                                       memory_order_acq_rel, memory_order_relaxed ) )
+            {
+               seat->row = ( uint16_t )( base + i );
+               seat->col = ( uint16_t ) col;
+               return true;
+            }
+         }
+      }
+   }
+   return false;
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Crea el inventario de asientos de todas las aristas del grafo. Las aristas que se
+ * agreguen al grafo después no tienen vuelo.
+ *
+ * @param g El grafo de aeropuertos.
+ * @param layout Distribución de asientos de todos los vuelos; todos empiezan vacíos.
+ *
+ * @return El inventario, o NULL si no hubo memoria.
+ */
+Seat_inventory* Seats_New( const Graph* g, const Seat_layout* layout )
+{
+   assert( g );
+   assert( layout && 0 < layout->width && layout->width <= SEATS_MAX_WIDTH );
+
+   Seat_inventory* inv = (Seat_inventory*) calloc( 1, sizeof( Seat_inventory ) );
+   if( !inv ) return NULL;
+
+   inv->layout = *layout;
+   inv->map_stride = ( (size_t) layout->rows + 31 ) & ~(size_t) 31;
+   if( !Graph_Csr( g, &inv->routes ) )
+   {
+      free( inv );
+      return NULL;
+   }
+   uint32_t flights = inv->routes.edges;
+   inv->flights = flights;
+
+   inv->capacity = (int32_t*) malloc( ( flights ? flights : 1 ) * sizeof( int32_t ) );
+   inv->seats = (Seat_counter*) aligned_alloc( 64, ( flights ? flights : 1 ) * sizeof( Seat_counter ) );
+   inv->map = (_Atomic uint16_t*) aligned_alloc( 64, ( flights ? flights : 1 ) * inv->map_stride * sizeof( uint16_t ) );
+   if( !inv->capacity || !inv->seats || !inv->map )
+   {
+      Seats_Delete( &inv );
+      return NULL;
+   }
+
+   int32_t seats_per_flight = (int32_t) layout->rows * layout->width;
+   uint16_t full_row = (uint16_t)( ( 1u << layout->width ) - 1 );
+   for( uint32_t f = 0; f < flights; ++f )
+   {
+      inv->capacity[ f ] = seats_per_flight;
+      atomic_init( &inv->seats[ f ].free, seats_per_flight );
+      _Atomic uint16_t* map = &inv->map[ f * inv->map_stride ];
+      for( size_t r = 0; r < inv->map_stride; ++r ) atomic_init( &map[ r ], r < layout->rows ? full_row : 0 );
+   }
+   return inv;
+}
+
+/**
+ * @brief Destruye el inventario.
+ *
+ * @param inv Referencia al inventario; queda en NULL.
+ */
+void Seats_Delete( Seat_inventory** inv )
+{
+   assert( inv );
+   Seat_inventory* s = *inv;
+   if( !s ) return;
+
+   free( s->map );
+   free( s->seats );
+   free( s->capacity );
+   Graph_CsrFree( &s->routes );
+   free( s );
+   *inv = NULL;
+}
+
+/**
+ * @brief Busca el vuelo de la arista |start| -> |end|.
+ *
+ * @param inv El inventario.
+ * @param start Índice del vértice de salida.
+ * @param end Índice del vértice de llegada.
+ *
+ * @return El número de vuelo, o -1 si no hay arista entre esos vértices.
+ */
+int32_t Seats_Flight( const Seat_inventory* inv, int start, int end )
+{
+   assert( inv );
+   return Graph_CsrFind( &inv->routes, start, end );
+}
+
+/**
+ * @brief Asientos libres de un vuelo en este momento.
+ */
+int32_t Seats_Available( const Seat_inventory* inv, int32_t flight )
+{
+   assert( inv );
+   assert( 0 <= flight && (uint32_t) flight < inv->flights );
+
+   return atomic_load_explicit( &inv->seats[ flight ].free, memory_order_relaxed );
+}
+
+/**
+ * @brief Aparta |n| asientos de un vuelo si quedan suficientes.
+ *
+ * @param inv El inventario.
+ * @param flight El vuelo (@see Seats_Flight).
+ * @param n Asientos a apartar.
+ *
+ * @return true si se apartaron; false si no quedaban |n| asientos libres.
+ */
+bool Seats_Reserve( Seat_inventory* inv, int32_t flight, int32_t n )
+{
+   assert( inv );
+   assert( 0 <= flight && (uint32_t) flight < inv->flights );
+   assert( n > 0 );
+
+   _Atomic int32_t* counter = &inv->seats[ flight ].free;
+   int32_t have = atomic_load_explicit( counter, memory_order_relaxed );
+   // Si otro hilo cambió el contador, compare_exchange deja en |have| el valor nuevo
+   while( have >= n )
+   {
+      if( atomic_compare_exchange_weak_explicit( counter, &have, have - n,
+                                                 memory_order_acq_rel, memory_order_relaxed ) )
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * @brief Devuelve al vuelo |n| asientos apartados con Seats_Reserve.
+ */
+void Seats_Release( Seat_inventory* inv, int32_t flight, int32_t n )
+{
+   assert( inv );
+   assert( 0 <= flight && (uint32_t) flight < inv->flights );
+   assert( n > 0 );
+
+   int32_t before = atomic_fetch_add_explicit( &inv->seats[ flight ].free, n, memory_order_acq_rel );
+   assert( before + n <= inv->capacity[ flight ] );
+   (void) before;
+}
+
+/**
+ * @brief Aparta |n| asientos en cada tramo de un itinerario, o en ninguno: si algún tramo
+ * no tiene lugar, los tramos ya apartados se devuelven.
+ *
+ * Mientras se aparta, otro hilo puede ver temporalmente menos asientos en los primeros
+ * tramos y fallar aunque al final esos asientos se devuelvan; nunca se vende de más.
+ *
+ * @param inv El inventario.
+ * @param flights Los vuelos del itinerario.
+ * @param legs Número de tramos.
+ * @param n Asientos a apartar en cada tramo.
+ *
+ * @return true si se apartaron los asientos de todos los tramos.
+ */
+bool Seats_Hold( Seat_inventory* inv, const int32_t flights[], size_t legs, int32_t n )
+{
+   assert( inv );
+   assert( flights || legs == 0 );
+
+   for( size_t i = 0; i < legs; ++i )
+   {
+      if( !Seats_Reserve( inv, flights[ i ], n ) )
+      {
+         while( i-- > 0 ) Seats_Release( inv, flights[ i ], n );
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * @brief Devuelve los asientos apartados con Seats_Hold en todos los tramos.
+ */
+void Seats_Unhold( Seat_inventory* inv, const int32_t flights[], size_t legs, int32_t n )
+{
+   assert( inv );
+   assert( flights || legs == 0 );
+
+   for( size_t i = 0; i < legs; ++i ) Seats_Release( inv, flights[ i ], n );
+}
+
+/**
+ * @brief Elige |n| asientos ya apartados con Seats_Reserve o Seats_Hold. Si caben en una
+ * fila busca |n| asientos juntos, primero uno que incluya algún asiento de |pref| y luego
+ * cualquiera; si no hay bloque libre, asigna los asientos uno por uno con la misma
+ * preferencia.
+ *
+ * @param inv El inventario.
+ * @param flight El vuelo.
+ * @param n Asientos a asignar.
+ * @param pref Máscara de asientos preferidos (p. ej. layout.window); 0 si no hay preferencia.
+ * @param seats Recibe los |n| asientos.
+ *
+ * @return true si se asignaron; false si no se apartaron antes o si, con otros hilos
+ * asignando y devolviendo asientos del mismo vuelo, la búsqueda no vio ninguno libre
+ * (@see Seat_inventory). Al fallar no queda ningún asiento ocupado.
+ */
+bool Seats_Assign( Seat_inventory* inv, int32_t flight, int32_t n, uint16_t pref, Seat_pos seats[] )
+{
+   assert( inv );
+   assert( 0 <= flight && (uint32_t) flight < inv->flights );
+   assert( n > 0 && seats );
+
+   _Atomic uint16_t* map = &inv->map[ flight * inv->map_stride ];
+   const Seat_layout* layout = &inv->layout;
+
+   Seat_pos first;
+   if( n <= layout->width &&
+       ( ( pref && claim_block( map, layout, inv->map_stride, (unsigned) n, pref, &first ) ) ||
+         claim_block( map, layout, inv->map_stride, (unsigned) n, 0, &first ) ) )
+   {
+      for( int32_t i = 0; i < n; ++i )
+      {
+         seats[ i ].row = first.row;
+         seats[ i ].col = (uint16_t)( first.col + i );
+      }
+      return true;
+   }
+
+   for( int32_t i = 0; i < n; ++i )
+   {
+      if( !( pref && claim_block( map, layout, inv->map_stride, 1, pref, &seats[ i ] ) ) &&
+          !claim_block( map, layout, inv->map_stride, 1, 0, &seats[ i ] ) )
+      {
+         Seats_Unassign( inv, flight, seats, i );
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * @brief Libera en el mapa los asientos asignados con Seats_Assign. El contador del vuelo
+ * no cambia; para devolverlos también hay que llamar a Seats_Release.
+ */
+void Seats_Unassign( Seat_inventory* inv, int32_t flight, const Seat_pos seats[], int32_t n )
+{
+   assert( inv );
+   assert( 0 <= flight && (uint32_t) flight < inv->flights );
+   assert( seats || n == 0 );
+
+   _Atomic uint16_t* map = &inv->map[ flight * inv->map_stride ];
+   for( int32_t i = 0; i < n; ++i )
+   {
+      assert( seats[ i ].row < inv->layout.rows && seats[ i ].col < inv->layout.width );
+      uint16_t bit = (uint16_t)( 1u << seats[ i ].col );
+      uint16_t before = atomic_fetch_or_explicit( &map[ seats[ i ].row ], bit, memory_order_acq_rel );
+      assert( !( before & bit ) );
+      (void) before;
+   }
+}
+
+/**
+ * @brief Ocupa asientos concretos del mapa, p. ej. los de boletos recuperados de un diario.
+ * No cambia el contador del vuelo (@see Seats_Reserve).
+ *
+ * @param inv El inventario.
+ * @param flight El vuelo.
+ * @param seats Los asientos.
+ * @param n Número de asientos.
+ *
+ * @return true si todos estaban libres; si alguno no lo estaba, no se ocupa ninguno.
+ */
+bool Seats_Take( Seat_inventory* inv, int32_t flight, const Seat_pos seats[], int32_t n )
+{
+   assert( inv );
+   assert( 0 <= flight && (uint32_t) flight < inv->flights );
+   assert( seats || n == 0 );
+
+   _Atomic uint16_t* map = &inv->map[ flight * inv->map_stride ];
+   for( int32_t i = 0; i < n; ++i )
+   {
+      bool valid = seats[ i ].row < inv->layout.rows && seats[ i ].col < inv->layout.width;
+      uint16_t bit = valid ? (uint16_t)( 1u << seats[ i ].col ) : 0;
+      if( !valid || !( atomic_fetch_and_explicit( &map[ seats[ i ].row ], (uint16_t) ~bit, memory_order_acq_rel ) & bit ) )
+      {
+         Seats_Unassign( inv, flight, seats, i );
+         return false;
+      }
+   }
+   return true;
+}
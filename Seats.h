@@ -0,0 +1,90 @@
+#ifndef  SEATS_INC
+#define  SEATS_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "Graph.h"
+
+#define SEATS_MAX_WIDTH 16     ///< Asientos por fila como máximo; cada fila es un mapa de 16 bits
+#define SEATS_NO_ROW UINT16_MAX ///< Fila de un boleto sin asiento asignado
+
+/**
+ * @brief Distribución de asientos de un avión. El bit i de cada máscara corresponde al
+ * asiento i de la fila (el asiento 'A' es el bit 0).
+ */
+typedef struct
+{
+  uint16_t rows;          ///< Filas del avión
+  uint16_t width;         ///< Asientos por fila, hasta SEATS_MAX_WIDTH
+  uint16_t joined;        ///< Bit i: los asientos i e i + 1 están juntos (no hay pasillo entre ellos)
+  uint16_t window;        ///< Asientos de ventanilla
+  uint16_t aisle;         ///< Asientos de pasillo
+} Seat_layout;
+
+extern const Seat_layout SEATS_NARROWBODY;  ///< 30 filas de 3-3 (180 asientos)
+extern const Seat_layout SEATS_WIDEBODY;    ///< 40 filas de 3-4-3 (400 asientos)
+
+/**
+ * @brief Un asiento asignado.
+ */
+typedef struct
+{
+  uint16_t row;           ///< Fila, desde 0; SEATS_NO_ROW si no hay asiento
+  uint16_t col;           ///< Asiento dentro de la fila, desde 0
+} Seat_pos;
+
+/**
+ * @brief Asientos libres de un vuelo. Cada contador ocupa su propia línea de caché para
+ * que las reservas de rutas distintas no compitan entre sí.
+ */
+typedef struct
+{
+  _Alignas( 64 ) _Atomic int32_t free;
+} Seat_counter;
+
+/**
+ * @brief Inventario de asientos, un contador por arista dirigida del grafo (cada sentido
+ * de una ruta es un vuelo distinto).
+ *
+ * Los vuelos se numeran como las aristas de Graph_Csr, una copia de las aristas que no
+ * cambia después, así que varios hilos pueden buscar y reservar a la vez sin candados; las
+ * reservas sólo tocan el contador del vuelo con compare-and-swap.
+ *
+ * Además del contador, cada vuelo tiene un mapa con un entero de 16 bits por fila (bit
+ * encendido = asiento libre). Primero se aparta el número de asientos con Seats_Reserve y
+ * después se eligen los asientos con Seats_Assign. El contador nunca rebasa los bits
+ * libres (al devolver asientos se liberan primero en el mapa y luego en el contador), así
+ * que con un solo hilo la asignación siempre encuentra lugar. Con varios hilos puede
+ * fallar aunque haya asientos apartados: la búsqueda recorre el mapa una sola vez, y si
+ * mientras tanto otros hilos ocupan los asientos que aún no revisaba y se liberan otros en
+ * filas que ya revisó, termina sin ver ninguno. Quien la llama devuelve lo apartado y
+ * puede reintentar (@see Service_Book).
+ */
+typedef struct
+{
+  Seat_counter* seats;    ///< Un contador por vuelo
+  int32_t*  capacity;     ///< Asientos totales de cada vuelo
+  Graph_csr routes;       ///< Aristas del grafo; la arista i es el vuelo i
+  uint32_t  flights;      ///< Número de vuelos
+
+  Seat_layout layout;     ///< Distribución de asientos de todos los vuelos
+  _Atomic uint16_t* map;  ///< Mapas de asientos; el del vuelo f empieza en f * |map_stride|
+  size_t    map_stride;   ///< Filas por mapa, redondeadas a una línea de caché; las de relleno no tienen asientos
+} Seat_inventory;
+
+Seat_inventory* Seats_New( const Graph* g, const Seat_layout* layout );
+void Seats_Delete( Seat_inventory** inv );
+int32_t Seats_Flight( const Seat_inventory* inv, int start, int end );
+int32_t Seats_Available( const Seat_inventory* inv, int32_t flight );
+bool Seats_Reserve( Seat_inventory* inv, int32_t flight, int32_t n );
+void Seats_Release( Seat_inventory* inv, int32_t flight, int32_t n );
+bool Seats_Hold( Seat_inventory* inv, const int32_t flights[], size_t legs, int32_t n );
+void Seats_Unhold( Seat_inventory* inv, const int32_t flights[], size_t legs, int32_t n );
+bool Seats_Assign( Seat_inventory* inv, int32_t flight, int32_t n, uint16_t pref, Seat_pos seats[] );
+void Seats_Unassign( Seat_inventory* inv, int32_t flight, const Seat_pos seats[], int32_t n );
+bool Seats_Take( Seat_inventory* inv, int32_t flight, const Seat_pos seats[], int32_t n );
+
+#endif   /* ----- #ifndef SEATS_INC  ----- */
@@ -0,0 +1,725 @@
+#define _GNU_SOURCE  // accept4
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "Server.h"
+#include "Wire.h"
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Abre el socket en el que escucha el servidor.
+ *
+ * @param address La dirección (@see Server_Address).
+ * @param unix_path Recibe una copia de la ruta del socket Unix, o NULL si es TCP.
+ *
+ * @return El descriptor, o -1 si no se pudo.
+ */
+static int listen_on( const char* address, char** unix_path )
+{
+   *unix_path = NULL;
+   struct sockaddr_storage sa;
+   socklen_t len;
+   if( !Server_Address( address, &sa, &len ) ) return -1;
+
+   int fd = socket( sa.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+   if( fd < 0 ) return -1;
+   int one = 1;
+   if( sa.ss_family == AF_UNIX )
+   {
+      // un socket que quedó de una corrida anterior impediría el bind
+      const char* path = ( ( struct sockaddr_un* ) &sa )->sun_path;
+      unlink( path );
+      *unix_path = strdup( path );
+   }
+   else setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) );
+
+   if( bind( fd, ( struct sockaddr* ) &sa, len ) == 0 && listen( fd, SOMAXCONN ) == 0 ) return fd;
+   close( fd );
+   free( *unix_path );
+   *unix_path = NULL;
+   return -1;
+}
+
+static eServiceResult do_lookup( Service* svc, Wire* in, Wire* out )
+{
+   char iata[ 4 ];
+   Wire_GetStr( in, iata, sizeof( iata ) );
+   if( in->bad ) return eService_BAD_REQUEST;
+
+   int32_t index;
+   const Airport* airport;
+   eServiceResult r = Service_Lookup( svc, iata, &index, &airport );
+   if( r != eService_OK ) return r;
+   Wire_PutU32( out, ( uint32_t ) index );
+   Wire_PutStr( out, airport->city );
+   Wire_PutStr( out, airport->name );
+   return eService_OK;
+}
+
+static eServiceResult do_quote( Service* svc, Wire* in, Wire* out )
+{
+   char from[ 4 ], to[ 4 ];
+   Wire_GetStr( in, from, sizeof( from ) );
+   Wire_GetStr( in, to, sizeof( to ) );
+   time_t when = ( time_t ) Wire_GetU64( in );
+   if( in->bad ) return eService_BAD_REQUEST;
+
+   Service_quote q;
+   eServiceResult r = Service_Quote( svc, from, to, when ? when : time( NULL ), &q );
+   if( r != eService_OK ) return r;
+   Wire_PutU32( out, ( uint32_t ) q.distance );
+   Wire_PutU32( out, ( uint32_t ) q.minutes );
+   Wire_PutU32( out, ( uint32_t ) q.price );
+   Wire_PutU32( out, ( uint32_t ) q.available );
+   return eService_OK;
+}
+
+static eServiceResult do_route( Service* svc, Wire* in, Wire* out )
+{
+   char from[ 4 ], to[ 4 ];
+   Wire_GetStr( in, from, sizeof( from ) );
+   Wire_GetStr( in, to, sizeof( to ) );
+   time_t when = ( time_t ) Wire_GetU64( in );
+   if( in->bad ) return eService_BAD_REQUEST;
+
+   Service_route route;
+   eServiceResult r = Service_Route( svc, from, to, when ? when : time( NULL ), &route );
+   if( r != eService_OK ) return r;
+   Wire_PutU64( out, ( uint64_t ) route.distance );
+   Wire_PutU32( out, ( uint32_t ) route.total_price );
+   Wire_PutU32( out, ( uint32_t ) route.total_minutes );
+   Wire_PutU8( out, ( uint8_t ) route.legs );
+   for( uint32_t i = 0; i <= route.legs; ++i )
+   {
+      Wire_PutStr( out, Graph_GetDataByIndex( svc->graph, ( int ) route.stops[ i ] )->iata_code );
+   }
+   return eService_OK;
+}
+
+static eServiceResult do_sign_up( Service* svc, Wire* in, Wire* out )
+{
+   (void) out;
+   char name[ HT_NAME_MAX ], mail[ HT_MAIL_MAX ], password[ AUTH_PW_MAX ];
+   Wire_GetStr( in, name, sizeof( name ) );
+   Wire_GetStr( in, mail, sizeof( mail ) );
+   Wire_GetStr( in, password, sizeof( password ) );
+   long int card = ( long int ) Wire_GetU64( in );
+   eServiceResult r = in->bad ? eService_BAD_REQUEST : Service_SignUp( svc, name, mail, password, card );
+   memset( password, 0, sizeof( password ) );
+   return r;
+}
+
+static eServiceResult do_log_in( Service* svc, Wire* in, Wire* out )
+{
+   char name[ HT_NAME_MAX ], password[ AUTH_PW_MAX ];
+   Wire_GetStr( in, name, sizeof( name ) );
+   Wire_GetStr( in, password, sizeof( password ) );
+
+   Session_token token;
+   eServiceResult r = in->bad ? eService_BAD_REQUEST : Service_LogIn( svc, name, password, &token );
+   memset( password, 0, sizeof( password ) );
+   if( r == eService_OK ) Wire_PutBytes( out, token.bytes, sizeof( token.bytes ) );
+   return r;
+}
+
+static eServiceResult do_log_out( Service* svc, Wire* in, Wire* out )
+{
+   (void) out;
+   Session_token token;
+   Wire_GetBytes( in, token.bytes, sizeof( token.bytes ) );
+   return in->bad ? eService_BAD_REQUEST : Service_LogOut( svc, &token );
+}
+
+static eServiceResult do_book( Service* svc, Wire* in, Wire* out )
+{
+   Session_token token;
+   char from[ 4 ], to[ 4 ];
+   Wire_GetBytes( in, token.bytes, sizeof( token.bytes ) );
+   Wire_GetStr( in, from, sizeof( from ) );
+   Wire_GetStr( in, to, sizeof( to ) );
+   int pax = Wire_GetU8( in );
+   uint8_t pref = Wire_GetU8( in );
+   time_t when = ( time_t ) Wire_GetU64( in );
+   if( in->bad ) return eService_BAD_REQUEST;
+   if( !when ) when = time( NULL );
+
+   Wallet* wallet = Service_Acquire( svc, &token );
+   if( NULL == wallet ) return eService_DENIED;
+
+   const Seat_layout* layout = &svc->seats->layout;
+   Service_quote q;
+   uint32_t handles[ SEATS_MAX_WIDTH ];
+   Seat_pos seats[ SEATS_MAX_WIDTH ];
+   eServiceResult r = Service_Quote( svc, from, to, when, &q );
+   if( r == eService_OK )
+   {
+      r = Service_Book( svc, wallet, &q, pax, pref == 1 ? layout->window : pref == 2 ? layout->aisle : 0,
+                        when, handles, seats );
+   }
+   Service_Release( svc, wallet );
+   if( r != eService_OK ) return r;
+
+   Wire_PutU32( out, ( uint32_t ) q.price );
+   Wire_PutU8( out, ( uint8_t ) pax );
+   for( int i = 0; i < pax; ++i )
+   {
+      Wire_PutU32( out, handles[ i ] );
+      Wire_PutU16( out, seats[ i ].row );
+      Wire_PutU8( out, ( uint8_t ) seats[ i ].col );
+   }
+   return eService_OK;
+}
+
+static eServiceResult do_cancel( Service* svc, Wire* in, Wire* out )
+{
+   (void) out;
+   Session_token token;
+   Wire_GetBytes( in, token.bytes, sizeof( token.bytes ) );
+   uint32_t handle = Wire_GetU32( in );
+   if( in->bad ) return eService_BAD_REQUEST;
+
+   Wallet* wallet = Service_Acquire( svc, &token );
+   if( NULL == wallet ) return eService_DENIED;
+   eServiceResult r = Service_Cancel( svc, wallet, handle, time( NULL ) );
+   Service_Release( svc, wallet );
+   return r;
+}
+
+/**
+ * @brief Ejecuta la solicitud de |job| y deja en su lugar la respuesta.
+ */
+static void handle( Server* srv, Server_job* job )
+{
+   static eServiceResult ( * const ops[] )( Service*, Wire*, Wire* ) =
+   {
+      [ SERVER_OP_LOOKUP ] = do_lookup,
+      [ SERVER_OP_QUOTE ]  = do_quote,
+      [ SERVER_OP_ROUTE ]  = do_route,
+      [ SERVER_OP_SIGNUP ] = do_sign_up,
+      [ SERVER_OP_LOGIN ]  = do_log_in,
+      [ SERVER_OP_LOGOUT ] = do_log_out,
+      [ SERVER_OP_BOOK ]   = do_book,
+      [ SERVER_OP_CANCEL ] = do_cancel,
+   };
+
+   Wire in;
+   Wire_Reader( &in, job->frame + 4, job->len - 4 );
+   uint32_t id = Wire_GetU32( &in );
+   uint8_t op = Wire_GetU8( &in );
+
+   // 4 de la longitud, 4 del identificador y 1 del resultado
+   uint8_t body[ SERVER_FRAME_MAX - 9 ];
+   Wire out;
+   Wire_Writer( &out, body, sizeof( body ) );
+   eServiceResult r = eService_BAD_REQUEST;
+   if( !in.bad && op < sizeof( ops ) / sizeof( ops[ 0 ] ) && ops[ op ] ) r = ops[ op ]( srv->svc, &in, &out );
+   if( out.bad ) r = eService_NO_MEMORY;
+
+   Wire frame;
+   Wire_Writer( &frame, job->frame, sizeof( job->frame ) );
+   size_t len = r == eService_OK ? out.len : 0;
+   Wire_PutU32( &frame, ( uint32_t )( 5 + len ) );
+   Wire_PutU32( &frame, id );
+   Wire_PutU8( &frame, ( uint8_t ) r );
+   Wire_PutBytes( &frame, body, len );
+   job->len = ( uint32_t ) frame.len;
+}
+
+/**
+ * @brief Hilo del grupo: atiende solicitudes hasta que se le pide terminar y la cola se
+ * vacía.
+ */
+static void* worker_main( void* arg )
+{
+   Server* srv = ( Server* ) arg;
+   for( ;; )
+   {
+      pthread_mutex_lock( &srv->lock );
+      while( srv->running && NULL == srv->todo ) pthread_cond_wait( &srv->not_empty, &srv->lock );
+      Server_job* job = srv->todo;
+      if( NULL == job )
+      {
+         pthread_mutex_unlock( &srv->lock );
+         return NULL;
+      }
+      srv->todo = job->next;
+      if( NULL == srv->todo ) srv->todo_tail = NULL;
+      pthread_mutex_unlock( &srv->lock );
+
+      handle( srv, job );
+
+      pthread_mutex_lock( &srv->lock );
+      bool wake = NULL == srv->done;
+      job->next = srv->done;
+      srv->done = job;
+      pthread_mutex_unlock( &srv->lock );
+      // si la cola no estaba vacía el ciclo ya tiene un aviso pendiente
+      if( wake )
+      {
+         uint64_t one = 1;
+         ( void ) !write( srv->wake_fd, &one, sizeof( one ) );
+      }
+   }
+}
+
+/**
+ * @brief Le pide a epoll los eventos que la conexión necesita: leer si le caben más
+ * solicitudes en los hilos y escribir si tiene respuestas pendientes.
+ */
+static void arm( Server* srv, Server_conn* c )
+{
+   if( c->closing ) return;
+
+   uint32_t events = 0;
+   if( c->pending < SERVER_PIPELINE ) events |= EPOLLIN;
+   if( c->out_pos < c->out_len ) events |= EPOLLOUT;
+   if( events != c->events )
+   {
+      struct epoll_event ev = { .events = events, .data.ptr = c };
+      epoll_ctl( srv->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev );
+      c->events = events;
+   }
+}
+
+/**
+ * @brief Cierra una conexión. Su memoria se libera al final de la vuelta del ciclo, o
+ * cuando los hilos terminen sus solicitudes.
+ */
+static void drop( Server* srv, Server_conn* c, Server_conn** dead )
+{
+   if( c->closing ) return;
+   c->closing = true;
+   epoll_ctl( srv->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL );
+   close( c->fd );
+   c->fd = -1;
+   --srv->open;
+
+   if( c->prev ) c->prev->next = c->next;
+   else srv->all = c->next;
+   if( c->next ) c->next->prev = c->prev;
+
+   if( c->pending == 0 )
+   {
+      c->next_dead = *dead;
+      *dead = c;
+   }
+}
+
+/**
+ * @brief Escribe lo que el socket acepte de las respuestas pendientes.
+ */
+static void flush( Server* srv, Server_conn* c, Server_conn** dead )
+{
+   while( !c->closing && c->out_pos < c->out_len )
+   {
+      ssize_t n = send( c->fd, c->out + c->out_pos, c->out_len - c->out_pos, MSG_NOSIGNAL );
+      if( n > 0 ) c->out_pos += ( size_t ) n;
+      else if( n < 0 && errno == EINTR ) continue;
+      else if( n < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) break;
+      else drop( srv, c, dead );
+   }
+   if( c->out_pos == c->out_len ) c->out_pos = c->out_len = 0;
+   arm( srv, c );
+}
+
+/**
+ * @brief Parte lo leído en solicitudes completas y las pasa a los hilos, mientras la
+ * conexión no tenga SERVER_PIPELINE en curso.
+ */
+static void dispatch( Server* srv, Server_conn* c, Server_conn** dead )
+{
+   Server_job* head = NULL;
+   Server_job* tail = NULL;
+   size_t off = 0, n = 0;
+   while( c->pending < SERVER_PIPELINE && c->in_len - off >= 4 )
+   {
+      const uint8_t* p = c->in + off;
+      uint32_t len = ( ( uint32_t ) p[ 0 ] << 24 ) | ( ( uint32_t ) p[ 1 ] << 16 ) | ( ( uint32_t ) p[ 2 ] << 8 ) | p[ 3 ];
+      if( len < 5 || len > SERVER_FRAME_MAX - 4 )
+      {
+         drop( srv, c, dead );
+         break;
+      }
+      if( c->in_len - off < 4 + len ) break;
+
+      Server_job* job = ( Server_job* ) Pool_Alloc( srv->jobs );
+      if( NULL == job ) break;
+      memcpy( job->frame, p, 4 + len );
+      job->len = 4 + len;
+      job->conn = c;
+      job->next = NULL;
+      if( tail ) tail->next = job;
+      else head = job;
+      tail = job;
+      ++c->pending;
+      ++n;
+      off += 4 + len;
+   }
+   memmove( c->in, c->in + off, c->in_len - off );
+   c->in_len -= off;
+
+   if( head )
+   {
+      pthread_mutex_lock( &srv->lock );
+      if( srv->todo_tail ) srv->todo_tail->next = head;
+      else srv->todo = head;
+      srv->todo_tail = tail;
+      pthread_mutex_unlock( &srv->lock );
+      if( n == 1 ) pthread_cond_signal( &srv->not_empty );
+      else pthread_cond_broadcast( &srv->not_empty );
+   }
+   arm( srv, c );
+}
+
+static void on_readable( Server* srv, Server_conn* c, Server_conn** dead )
+{
+   ssize_t n = recv( c->fd, c->in + c->in_len, sizeof( c->in ) - c->in_len, 0 );
+   if( n > 0 )
+   {
+      c->in_len += ( size_t ) n;
+      dispatch( srv, c, dead );
+   }
+   else if( n == 0 || ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) ) drop( srv, c, dead );
+}
+
+static void accept_all( Server* srv )
+{
+   for( ;; )
+   {
+      int fd = accept4( srv->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC );
+      if( fd < 0 )
+      {
+         if( errno == EINTR || errno == ECONNABORTED ) continue;
+         if( errno != EAGAIN && errno != EWOULDBLOCK ) perror( "accept" );
+         return;
+      }
+
+      Server_conn* c = srv->open < SERVER_CONNECTIONS ? ( Server_conn* ) Pool_Alloc( srv->conns ) : NULL;
+      if( NULL == c )
+      {
+         close( fd );
+         continue;
+      }
+      memset( c, 0, offsetof( Server_conn, in ) );
+      c->out = NULL;
+      c->out_len = c->out_pos = c->out_cap = 0;
+      c->next_dead = NULL;
+      c->fd = fd;
+      c->events = EPOLLIN;
+      int one = 1;
+      if( NULL == srv->unix_path ) setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+
+      struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+      if( epoll_ctl( srv->epoll_fd, EPOLL_CTL_ADD, fd, &ev ) != 0 )
+      {
+         close( fd );
+         Pool_Free( srv->conns, c );
+         continue;
+      }
+      c->prev = NULL;
+      c->next = srv->all;
+      if( srv->all ) srv->all->prev = c;
+      srv->all = c;
+      if( ++srv->open > srv->peak ) srv->peak = srv->open;
+   }
+}
+
+/**
+ * @brief Entrega a sus conexiones las respuestas que terminaron los hilos.
+ */
+static void deliver( Server* srv, Server_conn** dead )
+{
+   uint64_t count;
+   ( void ) !read( srv->wake_fd, &count, sizeof( count ) );
+
+   pthread_mutex_lock( &srv->lock );
+   Server_job* job = srv->done;
+   srv->done = NULL;
+   pthread_mutex_unlock( &srv->lock );
+
+   // la cola viene al revés; se voltea para responder en el orden en que se terminaron
+   Server_job* fifo = NULL;
+   while( job )
+   {
+      Server_job* next = job->next;
+      job->next = fifo;
+      fifo = job;
+      job = next;
+   }
+
+   for( job = fifo; job; )
+   {
+      Server_job* next = job->next;
+      Server_conn* c = job->conn;
+      --c->pending;
+      ++srv->served;
+      if( !c->closing )
+      {
+         if( c->out_cap - c->out_len < job->len )
+         {
+            size_t cap = c->out_cap ? c->out_cap * 2 : 2 * SERVER_FRAME_MAX;
+            while( cap - c->out_len < job->len ) cap *= 2;
+            uint8_t* out = ( uint8_t* ) realloc( c->out, cap );
+            if( out )
+            {
+               c->out = out;
+               c->out_cap = cap;
+            }
+            else drop( srv, c, dead );
+         }
+         if( !c->closing )
+         {
+            memcpy( c->out + c->out_len, job->frame, job->len );
+            c->out_len += job->len;
+            flush( srv, c, dead );
+            // lo que se dejó de leer por el límite de solicitudes en curso
+            if( !c->closing ) dispatch( srv, c, dead );
+         }
+      }
+      else if( c->pending == 0 )
+      {
+         c->next_dead = *dead;
+         *dead = c;
+      }
+      Pool_Free( srv->jobs, job );
+      job = next;
+   }
+}
+
+static void bury( Server* srv, Server_conn* dead )
+{
+   while( dead )
+   {
+      Server_conn* next = dead->next_dead;
+      free( dead->out );
+      Pool_Free( srv->conns, dead );
+      dead = next;
+   }
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Traduce una dirección del servidor: "unix:RUTA" (o una ruta que empiece con /)
+ * para un socket Unix, o "[tcp:][HOST:]PUERTO" para TCP sobre IPv4; el host por defecto es
+ * 127.0.0.1.
+ *
+ * @param address La dirección.
+ * @param sa Recibe la dirección del socket.
+ * @param len Recibe los bytes de |sa| que se usan.
+ *
+ * @return false si la dirección no es válida.
+ */
+bool Server_Address( const char* address, struct sockaddr_storage* sa, socklen_t* len )
+{
+   assert( address && sa && len );
+
+   memset( sa, 0, sizeof( *sa ) );
+   if( strncmp( address, "unix:", 5 ) == 0 || address[ 0 ] == '/' )
+   {
+      const char* path = address[ 0 ] == '/' ? address : address + 5;
+      struct sockaddr_un* un = ( struct sockaddr_un* ) sa;
+      if( strlen( path ) == 0 || strlen( path ) >= sizeof( un->sun_path ) ) return false;
+      un->sun_family = AF_UNIX;
+      strcpy( un->sun_path, path );
+      *len = sizeof( *un );
+      return true;
+   }
+
+   if( strncmp( address, "tcp:", 4 ) == 0 ) address += 4;
+   char host[ 64 ] = "127.0.0.1";
+   const char* port = strrchr( address, ':' );
+   if( port )
+   {
+      size_t n = ( size_t )( port - address );
+      if( n >= sizeof( host ) ) return false;
+      memcpy( host, address, n );
+      host[ n ] = '\0';
+      ++port;
+   }
+   else port = address;
+
+   char* end;
+   long p = strtol( port, &end, 10 );
+   struct sockaddr_in* in = ( struct sockaddr_in* ) sa;
+   if( end == port || *end != '\0' || p <= 0 || p > 65535 ) return false;
+   in->sin_family = AF_INET;
+   in->sin_port = htons( ( uint16_t ) p );
+   *len = sizeof( *in );
+   return inet_pton( AF_INET, host, &in->sin_addr ) == 1;
+}
+
+/**
+ * @brief Crea un servidor que escucha en |address| (@see Server_Address) y atiende con |svc|.
+ *
+ * @param svc El servicio; debe vivir más que el servidor.
+ * @param address La dirección.
+ * @param workers Hilos que ejecutan solicitudes; 0 para dos por procesador, y al menos
+ * SERVER_WORKERS: con pocos hilos, las ventas que esperan al disco detienen a las consultas.
+ *
+ * @return Una referencia al servidor, o NULL si no se pudo escuchar en |address|.
+ */
+Server* Server_New( Service* svc, const char* address, unsigned workers )
+{
+   assert( svc && address );
+
+   Server* srv = ( Server* ) calloc( 1, sizeof( Server ) );
+   if( NULL == srv ) return NULL;
+   srv->svc = svc;
+   srv->epoll_fd = srv->wake_fd = -1;
+   atomic_init( &srv->stop, false );
+   pthread_mutex_init( &srv->lock, NULL );
+   pthread_cond_init( &srv->not_empty, NULL );
+
+   if( 0 == workers )
+   {
+      long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+      workers = cpus * 2 > SERVER_WORKERS ? ( unsigned ) cpus * 2 : SERVER_WORKERS;
+   }
+   srv->n_workers = workers;
+   srv->workers = ( pthread_t* ) calloc( workers, sizeof( pthread_t ) );
+   srv->jobs = Pool_New( sizeof( Server_job ) );
+   srv->conns = Pool_New( sizeof( Server_conn ) );
+
+   srv->listen_fd = listen_on( address, &srv->unix_path );
+   if( srv->listen_fd >= 0 ) srv->epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+   if( srv->epoll_fd >= 0 ) srv->wake_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+   bool ok = srv->workers && srv->jobs && srv->conns && srv->wake_fd >= 0;
+   if( ok )
+   {
+      struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &srv->listen_fd };
+      ok = epoll_ctl( srv->epoll_fd, EPOLL_CTL_ADD, srv->listen_fd, &ev ) == 0;
+      ev.data.ptr = &srv->wake_fd;
+      ok = ok && epoll_ctl( srv->epoll_fd, EPOLL_CTL_ADD, srv->wake_fd, &ev ) == 0;
+   }
+   if( !ok )
+   {
+      Server_Delete( &srv );
+      return NULL;
+   }
+   return srv;
+}
+
+/**
+ * @brief Deja de escuchar y destruye el servidor (no el servicio).
+ *
+ * @param srv La dirección de una referencia al servidor; queda en NULL.
+ */
+void Server_Delete( Server** srv )
+{
+   assert( srv && *srv );
+   Server* s = *srv;
+
+   if( s->listen_fd >= 0 ) close( s->listen_fd );
+   if( s->epoll_fd >= 0 ) close( s->epoll_fd );
+   if( s->wake_fd >= 0 ) close( s->wake_fd );
+   if( s->unix_path ) unlink( s->unix_path );
+   free( s->unix_path );
+   if( s->jobs ) Pool_Delete( &s->jobs );
+   if( s->conns ) Pool_Delete( &s->conns );
+   free( s->workers );
+   pthread_mutex_destroy( &s->lock );
+   pthread_cond_destroy( &s->not_empty );
+   free( s );
+   *srv = NULL;
+}
+
+/**
+ * @brief Atiende conexiones hasta que se llame a Server_Stop. Cada segundo expira las
+ * sesiones inactivas y descarga las billeteras sin uso. Al terminar espera a los hilos y
+ * cierra todas las conexiones.
+ *
+ * @return false si no se pudieron arrancar los hilos.
+ */
+bool Server_Run( Server* srv )
+{
+   assert( srv );
+
+   srv->running = true;
+   unsigned started = 0;
+   while( started < srv->n_workers && pthread_create( &srv->workers[ started ], NULL, worker_main, srv ) == 0 )
+   {
+      ++started;
+   }
+
+   struct epoll_event events[ SERVER_EVENTS ];
+   time_t tick = time( NULL );
+   while( started == srv->n_workers && !atomic_load( &srv->stop ) )
+   {
+      int n = epoll_wait( srv->epoll_fd, events, SERVER_EVENTS, 1000 );
+      if( n < 0 && errno != EINTR )
+      {
+         perror( "epoll_wait" );
+         break;
+      }
+
+      Server_conn* dead = NULL;
+      for( int i = 0; i < n; ++i )
+      {
+         void* who = events[ i ].data.ptr;
+         if( who == &srv->listen_fd ) accept_all( srv );
+         else if( who == &srv->wake_fd ) deliver( srv, &dead );
+         else
+         {
+            Server_conn* c = ( Server_conn* ) who;
+            uint32_t ev = events[ i ].events;
+            if( !c->closing && ( ev & EPOLLIN ) ) on_readable( srv, c, &dead );
+            if( !c->closing && ( ev & EPOLLOUT ) ) flush( srv, c, &dead );
+            if( !c->closing && ( ev & ( EPOLLERR | EPOLLHUP ) ) && !( ev & EPOLLIN ) ) drop( srv, c, &dead );
+         }
+      }
+      bury( srv, dead );
+
+      if( time( NULL ) != tick )
+      {
+         tick = time( NULL );
+         Session_Advance( srv->svc->sessions, Session_Clock() );
+         Wallets_Reclaim( srv->svc->wallets, Session_Clock(), WALLETS_IDLE );
+      }
+   }
+
+   pthread_mutex_lock( &srv->lock );
+   srv->running = false;
+   pthread_cond_broadcast( &srv->not_empty );
+   pthread_mutex_unlock( &srv->lock );
+   for( unsigned i = 0; i < started; ++i ) pthread_join( srv->workers[ i ], NULL );
+
+   // ya no hay hilos: se entregan (o descartan) las últimas respuestas y se cierra todo
+   Server_conn* dead = NULL;
+   deliver( srv, &dead );
+   while( srv->all ) drop( srv, srv->all, &dead );
+   bury( srv, dead );
+   return started == srv->n_workers;
+}
+
+/**
+ * @brief Pide que Server_Run termine. Se puede llamar desde un manejador de señales.
+ */
+void Server_Stop( Server* srv )
+{
+   assert( srv );
+
+   atomic_store( &srv->stop, true );
+   uint64_t one = 1;
+   ( void ) !write( srv->wake_fd, &one, sizeof( one ) );
+}
@@ -0,0 +1,125 @@
+#ifndef  SERVER_INC
+#define  SERVER_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "Service.h"
+#include "Pool.h"
+
+#define SERVER_ADDRESS "unix:skynet.sock"  ///< Dirección por defecto (@see Server_Address)
+#define SERVER_FRAME_MAX 1024     ///< Bytes máximos de un mensaje, con su longitud
+#define SERVER_PIPELINE 32        ///< Solicitudes de una conexión que pueden estar en los hilos a la vez
+#define SERVER_CONNECTIONS 65536  ///< Conexiones abiertas a la vez
+#define SERVER_EVENTS 256         ///< Eventos que se atienden por vuelta del ciclo
+#define SERVER_WORKERS 16         ///< Hilos mínimos por omisión; casi siempre esperan a la KDF o al disco
+
+/**
+ * Protocolo. Cada mensaje empieza con su longitud (u32, sin contarse a sí misma) y un
+ * identificador (u32) que la respuesta repite; después la solicitud lleva su operación (u8)
+ * y la respuesta su resultado (u8, un eServiceResult). Los campos se codifican con Wire.
+ * Una conexión puede enviar varias solicitudes sin esperar: las respuestas pueden llegar
+ * en otro orden.
+ *
+ *   LOOKUP  iata                                  -> u32 índice, str ciudad, str nombre
+ *   QUOTE   iata, iata, u64 hora (0 = ahora)      -> u32 km, u32 minutos, u32 precio, u32 libres
+ *   ROUTE   iata, iata, u64 hora                  -> u64 km, u32 precio, u32 minutos,
+ *                                                    u8 tramos, iata por escala (tramos + 1)
+ *   SIGNUP  str nombre, str correo, str contraseña, u64 tarjeta
+ *   LOGIN   str nombre, str contraseña            -> 16 bytes de ficha
+ *   LOGOUT  ficha
+ *   BOOK    ficha, iata, iata, u8 pasajeros, u8 preferencia (0 ninguna, 1 ventana,
+ *           2 pasillo), u64 hora                  -> u32 precio, u8 n, n x ( u32 boleto, u16 fila, u8 columna )
+ *   CANCEL  ficha, u32 boleto
+ */
+typedef enum
+{
+   SERVER_OP_LOOKUP = 1,
+   SERVER_OP_QUOTE,
+   SERVER_OP_ROUTE,
+   SERVER_OP_SIGNUP,
+   SERVER_OP_LOGIN,
+   SERVER_OP_LOGOUT,
+   SERVER_OP_BOOK,
+   SERVER_OP_CANCEL,
+} eServerOp;
+
+/**
+ * @brief Una conexión. Sólo la toca el hilo del ciclo de eventos.
+ */
+typedef struct Server_conn
+{
+  int      fd;            ///< -1 cuando ya se cerró
+  uint32_t events;        ///< Eventos que se le piden a epoll
+  uint32_t pending;       ///< Solicitudes en los hilos; la conexión no se libera mientras haya
+  bool     closing;       ///< El cliente se fue o hubo un error; ya no se lee ni se escribe
+  size_t   in_len;        ///< Bytes leídos que aún no forman una solicitud completa
+  uint8_t  in[ SERVER_FRAME_MAX ];
+  uint8_t* out;           ///< Respuestas por escribir
+  size_t   out_len;
+  size_t   out_pos;       ///< Primer byte de |out| aún no escrito
+  size_t   out_cap;
+  struct Server_conn* prev;       ///< Conexiones abiertas, para cerrarlas al terminar
+  struct Server_conn* next;
+  struct Server_conn* next_dead;  ///< Siguiente conexión por liberar al final de la vuelta
+} Server_conn;
+
+/**
+ * @brief Una solicitud completa; el hilo que la atiende escribe la respuesta en el mismo
+ * arreglo.
+ */
+typedef struct Server_job
+{
+  struct Server_job* next;
+  Server_conn* conn;
+  uint32_t len;           ///< Bytes de |frame|
+  uint8_t  frame[ SERVER_FRAME_MAX ];
+} Server_job;
+
+/**
+ * @brief Servidor de un solo proceso: un hilo atiende todas las conexiones con epoll
+ * (aceptar, leer, partir en mensajes, escribir) y un grupo de hilos ejecuta las
+ * solicitudes contra el servicio, de modo que un inicio de sesión (KDF) o una venta que
+ * espera al disco no detienen a las demás conexiones. Los hilos devuelven las respuestas
+ * por una cola y despiertan al ciclo con un eventfd.
+ */
+typedef struct
+{
+  Service*        svc;
+  int             listen_fd;
+  int             epoll_fd;
+  int             wake_fd;    ///< eventfd: hay respuestas o se pidió detener el servidor
+  char*           unix_path;  ///< Ruta del socket Unix, para borrarlo al terminar; NULL si es TCP
+
+  _Atomic bool    stop;       ///< Se pidió detener el ciclo (@see Server_Stop)
+
+  pthread_mutex_t lock;       ///< Protege las dos colas y |running|
+  pthread_cond_t  not_empty;
+  Server_job*     todo;       ///< Solicitudes por atender (FIFO)
+  Server_job*     todo_tail;
+  Server_job*     done;       ///< Respuestas por entregar (la última primero)
+  bool            running;    ///< false para pedirle a los hilos que terminen
+
+  Pool*           jobs;       ///< Reserva de Server_job
+  Pool*           conns;      ///< Reserva de Server_conn
+  Server_conn*    all;        ///< Conexiones abiertas
+  size_t          open;       ///< Conexiones abiertas
+  size_t          peak;       ///< Máximo de conexiones abiertas a la vez
+  uint64_t        served;     ///< Solicitudes respondidas
+
+  pthread_t*      workers;
+  unsigned        n_workers;
+} Server;
+
+bool Server_Address( const char* address, struct sockaddr_storage* sa, socklen_t* len );
+Server* Server_New( Service* svc, const char* address, unsigned workers );
+void Server_Delete( Server** srv );
+bool Server_Run( Server* srv );
+void Server_Stop( Server* srv );
+
+#endif   /* ----- #ifndef SERVER_INC  ----- */
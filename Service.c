@@ -0,0 +1,557 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "Service.h"
+#include "Bookings.h"
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Repite un registro del diario de boletos al arrancar: lo aplica al inventario de
+ * asientos y al libro de ventas. Las billeteras se leen del diario hasta que su dueño
+ * inicia sesión (@see Wallets_Acquire).
+ */
+static void recover( uint32_t type, uint64_t lsn, const Booking_record* rec, void* ctx )
+{
+   Service* svc = ( Service* ) ctx;
+   if( !Bookings_Restore( type, rec, svc->seats, NULL ) )
+   {
+      fprintf( stderr, "%s: booking record %llu does not match the current state\n", BOOKINGS_FILE,
+               ( unsigned long long ) lsn );
+   }
+   int32_t flight = Seats_Flight( svc->seats, ( int ) rec->start, ( int ) rec->end );
+   if( flight >= 0 )
+   {
+      Ticket ticket = { .price = rec->price, .distance = rec->distance, .time = rec->minutes,
+                        .start = rec->start, .end = rec->end };
+      Ledger_Append( svc->ledger, &ticket, ( uint32_t ) flight, type == BOOKING_SELL ? 1 : -1, ( time_t ) rec->stamp );
+   }
+}
+
+/**
+ * @brief Escribe en |key| el texto tal como lo guardan las pantallas, que lo leen con fgets
+ * y conservan el salto de línea; así un usuario registrado por un lado puede entrar por el
+ * otro.
+ *
+ * @return false si el texto está vacío, tiene un salto de línea o no cabe.
+ */
+static bool key_of( char* key, size_t size, const char* text )
+{
+   size_t len = strlen( text );
+   if( len == 0 || len + 2 > size || strchr( text, '\n' ) ) return false;
+   memcpy( key, text, len );
+   key[ len ] = '\n';
+   key[ len + 1 ] = '\0';
+   return true;
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Abre los datos de |dir| (usuarios y diario de boletos) y arma el estado de los
+ * vuelos de |g|: asientos, listas de espera, tarifas y libro de ventas.
+ *
+ * @param g La red de aeropuertos; debe vivir más que el servicio.
+ * @param dir Directorio de los datos.
+ *
+ * @return Una referencia al servicio, o NULL si algo no se pudo abrir o recuperar.
+ */
+Service* Service_Open( Graph* g, const char* dir )
+{
+   assert( g && dir );
+
+   Service* svc = ( Service* ) calloc( 1, sizeof( Service ) );
+   if( NULL == svc ) return NULL;
+   svc->graph = g;
+   pthread_mutex_init( &svc->book_lock, NULL );
+
+   svc->users = Store_Open( dir );
+   // los nombres inexistentes casi nunca recorren la tabla
+   if( svc->users && CHT_SetBloom( svc->users->ct, HT_BLOOM_FPR ) )
+   {
+      svc->auth = Auth_New( 0, AUTH_QUEUE, KDF_LOG_N );
+   }
+   // un nombre inexistente cuesta una verificación, como uno que sí existe
+   if( svc->auth && Auth_Hash( svc->auth, &svc->decoy, "" ) )
+   {
+      svc->sessions = Session_New( SESSION_CAPACITY, SESSION_IDLE, Session_Clock() );
+   }
+   if( svc->sessions ) svc->seats = Seats_New( g, &SEATS_NARROWBODY );
+   if( svc->seats ) svc->waitlist = Waitlist_New( svc->seats->flights );
+   if( svc->waitlist ) svc->fares = Fares_New( g, Fares_Classic, NULL );
+   if( svc->fares ) svc->ledger = Ledger_New();
+   // los asientos y el libro se reconstruyen desde el diario de boletos
+   if( svc->ledger ) svc->wallets = Wallets_Open( dir, recover, svc );
+
+   if( NULL == svc->wallets )
+   {
+      Service_Close( &svc );
+      return NULL;
+   }
+   return svc;
+}
+
+/**
+ * @brief Cierra los diarios y destruye el estado del servicio (no la red de aeropuertos).
+ *
+ * @param svc La dirección de una referencia al servicio; queda en NULL.
+ */
+void Service_Close( Service** svc )
+{
+   assert( svc && *svc );
+   Service* s = *svc;
+
+   if( s->wallets ) Wallets_Close( &s->wallets );
+   if( s->ledger ) Ledger_Delete( &s->ledger );
+   if( s->fares ) Fares_Delete( &s->fares );
+   if( s->waitlist ) Waitlist_Delete( &s->waitlist );
+   if( s->seats ) Seats_Delete( &s->seats );
+   if( s->sessions ) Session_Delete( &s->sessions );
+   if( s->auth ) Auth_Delete( &s->auth );
+   if( s->users ) Store_Close( &s->users );
+   pthread_mutex_destroy( &s->book_lock );
+   free( s );
+   *svc = NULL;
+}
+
+/**
+ * @brief Nombre corto de un resultado, para salidas que leen otros programas.
+ */
+const char* Service_Error( eServiceResult r )
+{
+   switch( r )
+   {
+      case eService_OK:          return "ok";
+      case eService_BAD_REQUEST: return "bad-request";
+      case eService_DENIED:      return "denied";
+      case eService_EXISTS:      return "exists";
+      case eService_NOT_FOUND:   return "not-found";
+      case eService_NO_ROUTE:    return "no-route";
+      case eService_SOLD_OUT:    return "sold-out";
+      case eService_RETRY:       return "retry";
+      case eService_NO_MEMORY:   return "no-memory";
+      case eService_NOT_DURABLE: return "not-durable";
+      case eService_QUEUED:      return "queued";
+   }
+   return "unknown";
+}
+
+/**
+ * @brief Registra un usuario nuevo (@see Sing_Up). La contraseña se guarda derivada.
+ *
+ * @param svc El servicio.
+ * @param name Nombre del usuario.
+ * @param mail Su correo.
+ * @param password La contraseña; a lo más TAM_PSW - 2 caracteres, como en las pantallas.
+ * @param credit_card Número de la tarjeta.
+ *
+ * @return eService_OK, eService_BAD_REQUEST, eService_EXISTS, eService_NO_MEMORY o
+ * eService_NOT_DURABLE.
+ */
+eServiceResult Service_SignUp( Service* svc, const char* name, const char* mail, const char* password,
+                               long int credit_card )
+{
+   assert( svc && name && mail && password );
+
+   Users user;
+   memset( &user, 0, sizeof( user ) );
+   size_t len = strlen( password );
+   if( !key_of( user.name, sizeof( user.name ), name ) || !key_of( user.mail, sizeof( user.mail ), mail ) ||
+       len == 0 || len > TAM_PSW - 2 )
+   {
+      return eService_BAD_REQUEST;
+   }
+
+   // la derivación es lo caro; se hace antes de tocar la tabla
+   if( !Auth_Hash( svc->auth, &user.password, password ) ) return eService_NO_MEMORY;
+   user.credit_card = credit_card;
+
+   // CHT_Insert rechaza nombres y correos repetidos sin detener a los inicios de sesión
+   Concurrent_table* ct = svc->users->ct;
+   if( !CHT_Insert( ct, &user ) )
+   {
+      Users by_name = user, by_mail = user;
+      return CHT_Search( ct, &by_name ) || CHT_SearchByMail( ct, &by_mail ) ? eService_EXISTS : eService_NO_MEMORY;
+   }
+
+   // el alta ya está en el diario; la espera al disco se hace sin candados
+   return Store_Commit( svc->users ) ? eService_OK : eService_NOT_DURABLE;
+}
+
+/**
+ * @brief Verifica usuario y contraseña y abre una sesión.
+ *
+ * @param svc El servicio.
+ * @param name Nombre del usuario.
+ * @param password La contraseña.
+ * @param token Recibe la ficha de la sesión.
+ *
+ * @return eService_OK, eService_DENIED o eService_NO_MEMORY (no caben más sesiones).
+ */
+eServiceResult Service_LogIn( Service* svc, const char* name, const char* password, Session_token* token )
+{
+   assert( svc && name && password && token );
+
+   Users user;
+   if( !key_of( user.name, sizeof( user.name ), name ) || strlen( password ) > TAM_PSW - 2 ) return eService_DENIED;
+   // si el usuario no existe se verifica contra |decoy| de todos modos: responder antes
+   // dejaría saber qué nombres están registrados por el tiempo de la respuesta
+   if( !CHT_Search( svc->users->ct, &user ) )
+   {
+      Auth_Verify( svc->auth, &svc->decoy, password );
+      return eService_DENIED;
+   }
+   // la verificación es cara a propósito; la hace el grupo de hilos
+   if( !Auth_Verify( svc->auth, &user.password, password ) ) return eService_DENIED;
+   return Session_Create( svc->sessions, user.name, token ) ? eService_OK : eService_NO_MEMORY;
+}
+
+/**
+ * @brief Cierra una sesión.
+ *
+ * @return eService_OK, o eService_DENIED si la sesión no existe.
+ */
+eServiceResult Service_LogOut( Service* svc, const Session_token* token )
+{
+   assert( svc && token );
+
+   return Session_End( svc->sessions, token ) ? eService_OK : eService_DENIED;
+}
+
+/**
+ * @brief Da la billetera del dueño de una sesión, cargándola si hace falta, y reinicia el
+ * tiempo de inactividad de la sesión. Se suelta con Service_Release.
+ *
+ * @return La billetera, o NULL si la sesión no existe o no hubo memoria.
+ */
+Wallet* Service_Acquire( Service* svc, const Session_token* token )
+{
+   assert( svc && token );
+
+   char user[ HT_NAME_MAX ];
+   if( !Session_Check( svc->sessions, token, user ) ) return NULL;
+   return Wallets_Acquire( svc->wallets, user );
+}
+
+/**
+ * @brief Suelta una billetera obtenida con Service_Acquire (o con Wallets_Acquire).
+ */
+void Service_Release( Service* svc, Wallet* wallet )
+{
+   assert( svc && wallet );
+
+   Wallets_Release( svc->wallets, wallet, Session_Clock() );
+}
+
+/**
+ * @brief Busca un aeropuerto por su código IATA.
+ *
+ * @param svc El servicio.
+ * @param iata El código.
+ * @param index Recibe el índice de su vértice.
+ * @param airport Si no es NULL, recibe sus datos.
+ *
+ * @return eService_OK o eService_BAD_REQUEST si el código no existe.
+ */
+eServiceResult Service_Lookup( Service* svc, const char* iata, int32_t* index, const Airport** airport )
+{
+   assert( svc && iata && index );
+
+   // Graph_GetIndexByIATA copia el código a un arreglo de 4 bytes
+   char code[ 4 ];
+   if( strlen( iata ) != 3 ) return eService_BAD_REQUEST;
+   memcpy( code, iata, 4 );
+
+   *index = Graph_GetIndexByIATA( svc->graph, code );
+   if( *index == -1 ) return eService_BAD_REQUEST;
+   if( airport ) *airport = Graph_GetDataByIndex( svc->graph, *index );
+   return eService_OK;
+}
+
+/**
+ * @brief Cotiza el vuelo directo entre dos aeropuertos a la hora |when|.
+ *
+ * @param svc El servicio.
+ * @param from Código IATA del aeropuerto de salida.
+ * @param to Código IATA del aeropuerto de llegada.
+ * @param when Hora de salida; el precio depende de ella (@see Fares_Quote).
+ * @param quote Recibe la cotización.
+ *
+ * @return eService_OK, eService_BAD_REQUEST (código inexistente) o eService_NO_ROUTE.
+ */
+eServiceResult Service_Quote( Service* svc, const char* from, const char* to, time_t when, Service_quote* quote )
+{
+   assert( svc && from && to && quote );
+
+   if( Service_Lookup( svc, from, &quote->start, NULL ) != eService_OK ||
+       Service_Lookup( svc, to, &quote->end, NULL ) != eService_OK )
+   {
+      return eService_BAD_REQUEST;
+   }
+
+   quote->route = Fares_Route( svc->fares, quote->start, quote->end );
+   quote->flight = Seats_Flight( svc->seats, quote->start, quote->end );
+   if( quote->route < 0 || quote->flight < 0 ) return eService_NO_ROUTE;
+
+   struct tm local;
+   localtime_r( &when, &local );
+   quote->distance = svc->fares->routes.weight[ quote->route ];
+   quote->minutes = svc->fares->minutes[ quote->route ];
+   quote->price = Fares_Quote( svc->fares, quote->route, ( unsigned ) local.tm_hour );
+   quote->available = Seats_Available( svc->seats, quote->flight );
+   return eService_OK;
+}
+
+/**
+ * @brief Busca la ruta de menor distancia entre dos aeropuertos (@see Graph_CsrPath) y
+ * cotiza sus tramos de una vez (@see Fares_QuoteBatch); cada tramo sale a la hora en que
+ * llega el anterior.
+ *
+ * @param svc El servicio.
+ * @param from Código IATA del aeropuerto de salida.
+ * @param to Código IATA del aeropuerto de llegada.
+ * @param when Hora de salida del primer tramo.
+ * @param route Recibe la ruta.
+ *
+ * @return eService_OK, eService_BAD_REQUEST o eService_NO_ROUTE (tampoco con a lo más
+ * SERVICE_ROUTE_MAX tramos).
+ */
+eServiceResult Service_Route( Service* svc, const char* from, const char* to, time_t when, Service_route* route )
+{
+   assert( svc && from && to && route );
+
+   int32_t start, end;
+   if( Service_Lookup( svc, from, &start, NULL ) != eService_OK ||
+       Service_Lookup( svc, to, &end, NULL ) != eService_OK )
+   {
+      return eService_BAD_REQUEST;
+   }
+
+   const Fare_table* ft = svc->fares;
+   size_t n = Graph_CsrPath( &ft->routes, start, end, route->stops, SERVICE_ROUTE_MAX + 1, &route->distance );
+   if( n < 2 ) return eService_NO_ROUTE;
+   route->legs = ( uint32_t )( n - 1 );
+
+   uint8_t hour[ SERVICE_ROUTE_MAX ];
+   time_t departure = when;
+   for( uint32_t i = 0; i < route->legs; ++i )
+   {
+      struct tm local;
+      localtime_r( &departure, &local );
+      hour[ i ] = ( uint8_t ) local.tm_hour;
+      int32_t r = Fares_Route( ft, ( int ) route->stops[ i ], ( int ) route->stops[ i + 1 ] );
+      departure += ( time_t ) ft->minutes[ r ] * 60;
+   }
+   Fares_QuoteBatch( ft, route->legs, &route->stops[ 0 ], &route->stops[ 1 ], hour, route->price, route->minutes );
+
+   route->total_price = 0;
+   route->total_minutes = 0;
+   for( uint32_t i = 0; i < route->legs; ++i )
+   {
+      route->total_price += route->price[ i ];
+      route->total_minutes += route->minutes[ i ];
+   }
+   return eService_OK;
+}
+
+/**
+ * @brief Aparta y asigna |pax| asientos del vuelo cotizado (juntos si se puede) y emite un
+ * boleto por asiento. La venta se confirma cuando está en el diario; si algo falla antes
+ * no queda ningún asiento ni boleto.
+ *
+ * @param svc El servicio.
+ * @param wallet La billetera del cliente, obtenida con Service_Acquire o Wallets_Acquire.
+ * @param quote La cotización (@see Service_Quote).
+ * @param pax Pasajeros, de 1 a SEATS_MAX_WIDTH.
+ * @param pref Máscara de columnas preferidas (@see Seats_Assign); 0 si no hay preferencia.
+ * @param when Hora de la venta y de salida del vuelo.
+ * @param handles Recibe los identificadores de los |pax| boletos.
+ * @param seats Si no es NULL, recibe sus asientos.
+ *
+ * @return eService_OK, eService_BAD_REQUEST, eService_SOLD_OUT (se puede formar en la
+ * lista de espera), eService_RETRY, eService_NO_MEMORY o eService_NOT_DURABLE.
+ */
+eServiceResult Service_Book( Service* svc, Wallet* wallet, const Service_quote* quote, int pax, uint16_t pref,
+                             time_t when, uint32_t handles[], Seat_pos seats[] )
+{
+   assert( svc && wallet && quote && handles );
+
+   if( pax < 1 || pax > SEATS_MAX_WIDTH ) return eService_BAD_REQUEST;
+   int32_t flight = quote->flight;
+
+   // el asiento se aparta antes de emitir el boleto para no vender de más
+   if( !Seats_Reserve( svc->seats, flight, pax ) ) return eService_SOLD_OUT;
+   Seat_pos taken[ SEATS_MAX_WIDTH ];
+   // sólo falla si otros hilos movieron el mapa durante la búsqueda (@see Seat_inventory)
+   if( !Seats_Assign( svc->seats, flight, pax, pref, taken ) )
+   {
+      Seats_Release( svc->seats, flight, pax );
+      return eService_RETRY;
+   }
+
+   pthread_mutex_lock( &svc->book_lock );
+   for( int i = 0; i < pax; ++i )
+   {
+      handles[ i ] = Wallet_insert( wallet, quote->price, quote->distance, quote->minutes,
+                                    ( uint32_t ) quote->start, ( uint32_t ) quote->end, taken[ i ], when );
+      if( handles[ i ] == WALLET_NO_TICKET )
+      {
+         while( i-- > 0 ) Wallet_Remove( wallet, handles[ i ] );
+         pthread_mutex_unlock( &svc->book_lock );
+         Seats_Unassign( svc->seats, flight, taken, pax );
+         Seats_Release( svc->seats, flight, pax );
+         return eService_NO_MEMORY;
+      }
+   }
+
+   // basta esperar al último registro: los anteriores llegan a disco con él
+   uint64_t lsn = 0;
+   for( int i = 0; i < pax; ++i )
+   {
+      const Ticket* sold = Wallet_Get( wallet, handles[ i ] );
+      lsn = Wallets_Log( svc->wallets, BOOKING_SELL, wallet, sold, handles[ i ], when );
+      Ledger_Append( svc->ledger, sold, ( uint32_t ) flight, 1, when );
+   }
+   pthread_mutex_unlock( &svc->book_lock );
+
+   if( seats ) memcpy( seats, taken, pax * sizeof( Seat_pos ) );
+   return Bookings_Wait( svc->wallets->log, lsn ) ? eService_OK : eService_NOT_DURABLE;
+}
+
+/**
+ * @brief Cancela un boleto. Su asiento pasa al primero de la lista de espera del vuelo o,
+ * si no hay nadie, vuelve al inventario.
+ *
+ * @param svc El servicio.
+ * @param wallet La billetera del cliente.
+ * @param handle El identificador del boleto.
+ * @param when Hora de la cancelación.
+ *
+ * @return eService_OK, eService_NOT_FOUND o eService_NOT_DURABLE.
+ */
+eServiceResult Service_Cancel( Service* svc, Wallet* wallet, uint32_t handle, time_t when )
+{
+   assert( svc && wallet );
+
+   // se copia antes de quitarlo: el asiento puede ir a parar a esta misma billetera
+   pthread_mutex_lock( &svc->book_lock );
+   const Ticket* found = Wallet_Get( wallet, handle );
+   if( NULL == found )
+   {
+      pthread_mutex_unlock( &svc->book_lock );
+      return eService_NOT_FOUND;
+   }
+   Ticket ticket = *found;
+   Wallet_Remove( wallet, handle );
+
+   uint64_t lsn = Wallets_Log( svc->wallets, BOOKING_CANCEL, wallet, &ticket, handle, when );
+   int32_t flight = Seats_Flight( svc->seats, ( int ) ticket.start, ( int ) ticket.end );
+   if( flight >= 0 )
+   {
+      Ledger_Append( svc->ledger, &ticket, ( uint32_t ) flight, -1, when );
+      if( ticket.seat.row != SEATS_NO_ROW )
+      {
+         // si el asiento pasó a alguien en espera, su boleto es el último de su billetera
+         Waitlist_handle place;
+         Wallet* promoted = Waitlist_Release( svc->waitlist, svc->seats, flight, ticket.seat, &place );
+         if( promoted )
+         {
+            Wallet_DropWait( promoted, place );
+            size_t last = Wallet_Len( promoted ) - 1;
+            lsn = Wallets_Log( svc->wallets, BOOKING_SELL, promoted, &promoted->boletos[ last ],
+                               Wallet_Handle( promoted, last ), when );
+            Ledger_Append( svc->ledger, &promoted->boletos[ last ], ( uint32_t ) flight, 1, when );
+            Service_Release( svc, promoted );   // ya no espera
+         }
+      }
+      else Seats_Release( svc->seats, flight, 1 );
+   }
+   pthread_mutex_unlock( &svc->book_lock );
+   return Bookings_Wait( svc->wallets->log, lsn ) ? eService_OK : eService_NOT_DURABLE;
+}
+
+/**
+ * @brief Forma a un pasajero en la lista de espera de un vuelo agotado. Si se liberó un
+ * asiento desde la cotización se le emite en lugar de formarlo. Mientras espera, su lugar
+ * queda anotado en la billetera (@see Wallet_AddWait) y la billetera no se descarga.
+ *
+ * @param svc El servicio.
+ * @param wallet La billetera del cliente.
+ * @param quote La cotización del vuelo (@see Service_Quote).
+ * @param fare Clase tarifaria; decide la prioridad junto con el orden de llegada.
+ * @param when Hora de la venta y de salida del vuelo.
+ * @param handle Si el boleto se emitió, recibe su identificador.
+ *
+ * @return eService_OK (boleto emitido), eService_QUEUED, eService_NO_MEMORY o
+ * eService_NOT_DURABLE.
+ */
+eServiceResult Service_Waitlist( Service* svc, Wallet* wallet, const Service_quote* quote, eFareClass fare,
+                                 time_t when, uint32_t* handle )
+{
+   assert( svc && wallet && quote && handle );
+
+   Ticket ticket = { .price = quote->price, .distance = quote->distance, .time = quote->minutes,
+                     .start = ( uint32_t ) quote->start, .end = ( uint32_t ) quote->end,
+                     .seat = { .row = SEATS_NO_ROW }, .departure = when };
+   Waitlist_handle place;
+
+   // Waitlist_Add puede emitir el boleto, y Waitlist_Release lo hace con este mismo candado
+   pthread_mutex_lock( &svc->book_lock );
+   eWaitlistResult r = Waitlist_Add( svc->waitlist, svc->seats, quote->flight, fare, wallet, &ticket, &place );
+   if( r == eWaitlist_QUEUED )
+   {
+      eServiceResult queued = eService_QUEUED;
+      if( !Wallet_AddWait( wallet, place, &ticket ) )
+      {
+         Waitlist_Cancel( svc->waitlist, place );
+         queued = eService_NO_MEMORY;
+      }
+      else Wallets_Acquire( svc->wallets, wallet->owner );   // la lista guarda su dirección
+      pthread_mutex_unlock( &svc->book_lock );
+      return queued;
+   }
+   if( r == eWaitlist_FAILED )
+   {
+      pthread_mutex_unlock( &svc->book_lock );
+      return eService_NO_MEMORY;
+   }
+
+   // Waitlist_Add emitió el boleto al final de la billetera
+   size_t last = Wallet_Len( wallet ) - 1;
+   *handle = Wallet_Handle( wallet, last );
+   uint64_t lsn = Wallets_Log( svc->wallets, BOOKING_SELL, wallet, &wallet->boletos[ last ], *handle, when );
+   Ledger_Append( svc->ledger, &wallet->boletos[ last ], ( uint32_t ) quote->flight, 1, when );
+   pthread_mutex_unlock( &svc->book_lock );
+   return Bookings_Wait( svc->wallets->log, lsn ) ? eService_OK : eService_NOT_DURABLE;
+}
+
+/**
+ * @brief Saca a un pasajero de la lista de espera y suelta la billetera que ésta retenía.
+ *
+ * @param svc El servicio.
+ * @param wallet La billetera del cliente.
+ * @param place Uno de los lugares de |wallet->waits|.
+ *
+ * @return eService_OK, o eService_NOT_FOUND si el pasajero ya recibió su asiento.
+ */
+eServiceResult Service_LeaveWaitlist( Service* svc, Wallet* wallet, Waitlist_handle place )
+{
+   assert( svc && wallet );
+
+   pthread_mutex_lock( &svc->book_lock );
+   bool waiting = Wallet_DropWait( wallet, place );
+   if( waiting )
+   {
+      Waitlist_Cancel( svc->waitlist, place );
+      Service_Release( svc, wallet );
+   }
+   pthread_mutex_unlock( &svc->book_lock );
+   return waiting ? eService_OK : eService_NOT_FOUND;
+}
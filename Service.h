@@ -0,0 +1,118 @@
+#ifndef  SERVICE_INC
+#define  SERVICE_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "Graph.h"
+#include "Boleto.h"
+#include "HT_Users.h"
+#include "HT_Store.h"
+#include "Auth.h"
+#include "Session.h"
+#include "Seats.h"
+#include "Waitlist.h"
+#include "Fares.h"
+#include "Ledger.h"
+#include "Wallets.h"
+
+#define SERVICE_ROUTE_MAX 8   ///< Tramos máximos de una ruta con escalas
+
+/**
+ * @brief Resultado de una operación del servicio.
+ */
+typedef enum
+{
+   eService_OK,
+   eService_BAD_REQUEST,  ///< Faltan datos o no son válidos (p. ej. un código IATA que no existe)
+   eService_DENIED,       ///< Usuario o contraseña incorrectos, o sesión inexistente o expirada
+   eService_EXISTS,       ///< El nombre o el correo ya están registrados
+   eService_NOT_FOUND,    ///< El boleto no existe
+   eService_NO_ROUTE,     ///< No hay vuelo directo entre los aeropuertos
+   eService_SOLD_OUT,     ///< No quedan suficientes asientos
+   eService_RETRY,        ///< Otros clientes tomaron los asientos a la vez; se puede reintentar
+   eService_NO_MEMORY,
+   eService_NOT_DURABLE,  ///< La operación se aplicó pero no llegó a disco
+   eService_QUEUED,       ///< El cliente quedó en la lista de espera
+} eServiceResult;
+
+/**
+ * @brief Cotización de un vuelo directo.
+ */
+typedef struct
+{
+  int32_t route;        ///< Arista del vuelo (@see Fares_Route)
+  int32_t flight;       ///< Vuelo en el inventario de asientos (@see Seats_Flight)
+  int32_t start;        ///< Índice del vértice de salida
+  int32_t end;          ///< Índice del vértice de llegada
+  int32_t distance;     ///< Kilómetros
+  int32_t minutes;
+  int32_t price;        ///< Precio por pasajero a la hora de la cotización
+  int32_t available;    ///< Asientos libres
+} Service_quote;
+
+/**
+ * @brief Ruta de menor distancia entre dos aeropuertos, con escalas si hace falta.
+ */
+typedef struct
+{
+  uint32_t legs;                              ///< Tramos
+  uint32_t stops[ SERVICE_ROUTE_MAX + 1 ];    ///< Vértices de la ruta, de la salida a la llegada
+  int32_t  price[ SERVICE_ROUTE_MAX ];        ///< Precio de cada tramo a su hora de salida
+  int32_t  minutes[ SERVICE_ROUTE_MAX ];      ///< Minutos de cada tramo
+  int64_t  distance;                          ///< Kilómetros de toda la ruta
+  int32_t  total_price;
+  int32_t  total_minutes;                     ///< Sin contar el tiempo en tierra de las escalas
+} Service_route;
+
+/**
+ * @brief Todo lo que necesita atender a los clientes: la red de aeropuertos, los usuarios
+ * y sus sesiones, los asientos, tarifas y listas de espera de los vuelos, el libro de
+ * ventas y las billeteras. Las pantallas (@see menuPrincipal), el modo por lotes
+ * (@see Batch_Run) y el servidor (@see Server_Run) hacen las mismas operaciones a través
+ * de él.
+ *
+ * Las operaciones Service_* se pueden llamar desde varios hilos a la vez: la tabla de
+ * usuarios es concurrente (los inicios de sesión no toman candados y las altas sólo se
+ * detienen en su franja) y los cambios a las billeteras (que incluyen pasar un asiento a
+ * otra billetera desde la lista de espera) se serializan con |book_lock|; la espera a que
+ * lleguen a disco se hace fuera de los candados para que los fsync se compartan.
+ */
+typedef struct
+{
+  Graph*          graph;      ///< Red de aeropuertos; no es del servicio
+  User_store*     users;      ///< Usuarios y su diario
+  Auth_pool*      auth;       ///< Hilos que derivan y verifican contraseñas
+  Kdf_hash        decoy;      ///< Llave de nadie con el costo de |auth|; se verifica cuando el usuario no existe
+  Session_table*  sessions;   ///< Sesiones activas
+  Seat_inventory* seats;      ///< Asientos libres de cada vuelo
+  Waitlist_table* waitlist;   ///< Listas de espera de los vuelos agotados
+  Fare_table*     fares;      ///< Precios y tiempos de cada vuelo
+  Ledger*         ledger;     ///< Ventas y cancelaciones de todos los clientes
+  Wallet_store*   wallets;    ///< Billeteras de los clientes y diario de boletos
+  pthread_mutex_t book_lock;  ///< Serializa los cambios a las billeteras en memoria
+} Service;
+
+Service* Service_Open( Graph* g, const char* dir );
+void Service_Close( Service** svc );
+const char* Service_Error( eServiceResult r );
+eServiceResult Service_SignUp( Service* svc, const char* name, const char* mail, const char* password,
+                               long int credit_card );
+eServiceResult Service_LogIn( Service* svc, const char* name, const char* password, Session_token* token );
+eServiceResult Service_LogOut( Service* svc, const Session_token* token );
+Wallet* Service_Acquire( Service* svc, const Session_token* token );
+void Service_Release( Service* svc, Wallet* wallet );
+eServiceResult Service_Lookup( Service* svc, const char* iata, int32_t* index, const Airport** airport );
+eServiceResult Service_Quote( Service* svc, const char* from, const char* to, time_t when, Service_quote* quote );
+eServiceResult Service_Route( Service* svc, const char* from, const char* to, time_t when, Service_route* route );
+eServiceResult Service_Book( Service* svc, Wallet* wallet, const Service_quote* quote, int pax, uint16_t pref,
+                             time_t when, uint32_t handles[], Seat_pos seats[] );
+eServiceResult Service_Cancel( Service* svc, Wallet* wallet, uint32_t handle, time_t when );
+eServiceResult Service_Waitlist( Service* svc, Wallet* wallet, const Service_quote* quote, eFareClass fare,
+                                 time_t when, uint32_t* handle );
+eServiceResult Service_LeaveWaitlist( Service* svc, Wallet* wallet, Waitlist_handle place );
+
+#endif   /* ----- #ifndef SERVICE_INC  ----- */
@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Session.h"
+
+#define WHEEL_SLOTS ( 1u << SESSION_WHEEL_BITS )
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Celda de origen de una ficha en el mapa. Las fichas son aleatorias, así que sus
+ * primeros 8 bytes ya sirven como hash.
+ */
+static inline size_t token_home( const Session_table* st, const Session_token* token )
+{
+   uint64_t h;
+   memcpy( &h, token->bytes, sizeof( h ) );
+   return ( size_t ) h & st->map_mask;
+}
+
+/**
+ * @brief Busca una ficha en el mapa.
+ *
+ * @return La celda del mapa que apunta a la sesión; -1 si la ficha no existe.
+ */
+static long map_find( const Session_table* st, const Session_token* token )
+{
+   for( size_t pos = token_home( st, token ); st->map[ pos ] != 0; pos = ( pos + 1 ) & st->map_mask )
+   {
+      const Session* s = &st->sessions[ st->map[ pos ] - 1 ];
+      if( memcmp( s->token.bytes, token->bytes, sizeof( token->bytes ) ) == 0 ) return ( long ) pos;
+   }
+   return -1;
+}
+
+static void map_insert( Session_table* st, int32_t idx )
+{
+   size_t pos = token_home( st, &st->sessions[ idx ].token );
+   while( st->map[ pos ] != 0 ) pos = ( pos + 1 ) & st->map_mask;
+   st->map[ pos ] = ( uint32_t ) idx + 1;
+}
+
+/**
+ * @brief Vacía la celda |pos| del mapa recorriendo hacia atrás las siguientes, igual que
+ * la tabla de usuarios (@see backward_shift), para no dejar celdas borradas.
+ */
+static void map_remove( Session_table* st, size_t pos )
+{
+   size_t mask = st->map_mask;
+   size_t hole = pos;
+
+   for( size_t j = ( pos + 1 ) & mask; st->map[ j ] != 0; j = ( j + 1 ) & mask )
+   {
+      size_t home = token_home( st, &st->sessions[ st->map[ j ] - 1 ].token );
+      if( ( ( j - home ) & mask ) >= ( ( j - hole ) & mask ) )
+      {
+         st->map[ hole ] = st->map[ j ];
+         hole = j;
+      }
+   }
+   st->map[ hole ] = 0;
+}
+
+/**
+ * @brief Pone una sesión en la ranura de la rueda que le corresponde a su expiración:
+ * el nivel más bajo cuyo alcance (64^(nivel+1) ticks) cubre lo que le falta.
+ */
+static void wheel_link( Session_table* st, int32_t idx )
+{
+   Session* s = &st->sessions[ idx ];
+
+   uint64_t delta = s->expires > st->now ? s->expires - st->now : 0;
+   uint64_t when = s->expires;
+   unsigned level = 0;
+   while( level + 1 < SESSION_WHEEL_LEVELS && delta >> ( SESSION_WHEEL_BITS * ( level + 1 ) ) ) ++level;
+
+   // más allá del alcance de la rueda se espera en la última ranura posible y se vuelve
+   // a acomodar al llegar a ella
+   uint64_t reach = ( uint64_t ) 1 << ( SESSION_WHEEL_BITS * SESSION_WHEEL_LEVELS );
+   if( delta >= reach ) when = st->now + reach - 1;
+
+   uint16_t slot = ( uint16_t )( level * WHEEL_SLOTS + ( ( when >> ( SESSION_WHEEL_BITS * level ) ) & ( WHEEL_SLOTS - 1 ) ) );
+
+   s->slot = slot;
+   s->prev = -1;
+   s->next = st->wheel[ slot ];
+   if( s->next >= 0 ) st->sessions[ s->next ].prev = idx;
+   st->wheel[ slot ] = idx;
+}
+
+static void wheel_unlink( Session_table* st, int32_t idx )
+{
+   Session* s = &st->sessions[ idx ];
+
+   if( s->prev >= 0 ) st->sessions[ s->prev ].next = s->next;
+   else st->wheel[ s->slot ] = s->next;
+   if( s->next >= 0 ) st->sessions[ s->next ].prev = s->prev;
+}
+
+/**
+ * @brief Quita una sesión de la rueda y del mapa y la regresa a la lista libre.
+ */
+static void session_free( Session_table* st, int32_t idx, size_t map_pos )
+{
+   wheel_unlink( st, idx );
+   map_remove( st, map_pos );
+
+   Session* s = &st->sessions[ idx ];
+   memset( s, 0, sizeof( *s ) );
+   s->next = st->free_list;
+   st->free_list = idx;
+   --st->len;
+}
+
+/**
+ * @brief Avanza un tick: primero redistribuye las ranuras de los niveles superiores que
+ * empiezan en este tick (de arriba hacia abajo) y luego expira la ranura del nivel 0.
+ *
+ * @return El número de sesiones expiradas.
+ */
+static size_t wheel_tick( Session_table* st )
+{
+   ++st->now;
+
+   unsigned top = 0;
+   while( top + 1 < SESSION_WHEEL_LEVELS &&
+          ( st->now & ( ( ( uint64_t ) 1 << ( SESSION_WHEEL_BITS * ( top + 1 ) ) ) - 1 ) ) == 0 ) ++top;
+
+   for( unsigned level = top; level >= 1; --level )
+   {
+      size_t slot = level * WHEEL_SLOTS + ( ( st->now >> ( SESSION_WHEEL_BITS * level ) ) & ( WHEEL_SLOTS - 1 ) );
+      int32_t idx = st->wheel[ slot ];
+      st->wheel[ slot ] = -1;
+      while( idx >= 0 )
+      {
+         int32_t next = st->sessions[ idx ].next;
+         wheel_link( st, idx );
+         idx = next;
+      }
+   }
+
+   size_t expired = 0;
+   int32_t idx = st->wheel[ st->now & ( WHEEL_SLOTS - 1 ) ];
+   while( idx >= 0 )
+   {
+      int32_t next = st->sessions[ idx ].next;
+      if( st->sessions[ idx ].expires <= st->now )
+      {
+         session_free( st, idx, ( size_t ) map_find( st, &st->sessions[ idx ].token ) );
+         ++expired;
+      }
+      idx = next;
+   }
+   return expired;
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Reloj en segundos para @see Session_Advance (monótono: no retrocede si alguien
+ * cambia la hora del sistema).
+ */
+uint64_t Session_Clock( void )
+{
+   struct timespec t;
+   clock_gettime( CLOCK_MONOTONIC, &t );
+   return ( uint64_t ) t.tv_sec;
+}
+
+/**
+ * @brief Crea una tabla de sesiones. Toda la memoria se reserva aquí.
+ *
+ * @param capacity Número máximo de sesiones simultáneas.
+ * @param idle Ticks sin actividad tras los que una sesión expira (al menos 1).
+ * @param now Tick actual (p. ej. @see Session_Clock).
+ *
+ * @return Una referencia a la tabla, o NULL si no hubo memoria.
+ */
+Session_table* Session_New( size_t capacity, uint64_t idle, uint64_t now )
+{
+   assert( capacity > 0 && capacity < INT32_MAX && idle > 0 );
+
+   size_t cells = 16;
+   while( cells < 2 * capacity ) cells *= 2;
+
+   Session_table* st = ( Session_table* ) calloc( 1, sizeof( Session_table ) );
+   if( NULL == st ) return NULL;
+
+   st->sessions = ( Session* ) calloc( capacity, sizeof( Session ) );
+   st->map = ( uint32_t* ) calloc( cells, sizeof( uint32_t ) );
+   st->random_fd = open( "/dev/urandom", O_RDONLY | O_CLOEXEC );
+   if( NULL == st->sessions || NULL == st->map || st->random_fd < 0 )
+   {
+      if( st->random_fd >= 0 ) close( st->random_fd );
+      free( st->sessions );
+      free( st->map );
+      free( st );
+      return NULL;
+   }
+
+   st->capacity = capacity;
+   st->map_mask = cells - 1;
+   st->now = now;
+   st->idle = idle;
+   pthread_mutex_init( &st->lock, NULL );
+
+   for( size_t i = 0; i < sizeof( st->wheel ) / sizeof( st->wheel[ 0 ] ); ++i ) st->wheel[ i ] = -1;
+
+   for( size_t i = 0; i < capacity; ++i ) st->sessions[ i ].next = i + 1 < capacity ? ( int32_t )( i + 1 ) : -1;
+   st->free_list = 0;
+
+   return st;
+}
+
+/**
+ * @brief Destruye la tabla de sesiones.
+ *
+ * @param st La dirección de una referencia a la tabla.
+ */
+void Session_Delete( Session_table** st )
+{
+   assert( st && *st );
+   Session_table* s = *st;
+
+   close( s->random_fd );
+   pthread_mutex_destroy( &s->lock );
+   free( s->sessions );
+   free( s->map );
+   free( s );
+   *st = NULL;
+}
+
+/**
+ * @brief Abre una sesión para un usuario que ya se autenticó.
+ *
+ * @param st Referencia a la tabla.
+ * @param user Nombre del usuario.
+ * @param token Devuelve la ficha de la sesión.
+ *
+ * @return true si se abrió; false si la tabla está llena o no hubo bytes aleatorios.
+ */
+bool Session_Create( Session_table* st, const char* user, Session_token* token )
+{
+   assert( st && user && token );
+
+   pthread_mutex_lock( &st->lock );
+
+   bool ok = st->free_list >= 0;
+   while( ok )
+   {
+      ok = read( st->random_fd, token->bytes, sizeof( token->bytes ) ) == ( ssize_t ) sizeof( token->bytes );
+      if( ok && map_find( st, token ) < 0 ) break;
+   }
+
+   if( ok )
+   {
+      int32_t idx = st->free_list;
+      Session* s = &st->sessions[ idx ];
+      st->free_list = s->next;
+
+      s->token = *token;
+      strncpy( s->user, user, HT_NAME_MAX - 1 );
+      s->user[ HT_NAME_MAX - 1 ] = '\0';
+      s->expires = st->now + st->idle;
+
+      map_insert( st, idx );
+      wheel_link( st, idx );
+      ++st->len;
+   }
+
+   pthread_mutex_unlock( &st->lock );
+   return ok;
+}
+
+/**
+ * @brief Valida una ficha y, si es válida, reinicia su tiempo de inactividad. Es lo único
+ * que necesita una solicitud autenticada: no toca la tabla de usuarios ni la KDF.
+ *
+ * @param st Referencia a la tabla.
+ * @param token La ficha que presenta el cliente.
+ * @param user Si no es NULL, devuelve el nombre del dueño de la sesión.
+ *
+ * @return true si la sesión existe; false si nunca existió o ya expiró.
+ */
+bool Session_Check( Session_table* st, const Session_token* token, char user[ HT_NAME_MAX ] )
+{
+   assert( st && token );
+
+   pthread_mutex_lock( &st->lock );
+
+   long pos = map_find( st, token );
+   if( pos >= 0 )
+   {
+      int32_t idx = ( int32_t ) st->map[ pos ] - 1;
+      Session* s = &st->sessions[ idx ];
+      if( user ) memcpy( user, s->user, HT_NAME_MAX );
+
+      wheel_unlink( st, idx );
+      s->expires = st->now + st->idle;
+      wheel_link( st, idx );
+   }
+
+   pthread_mutex_unlock( &st->lock );
+   return pos >= 0;
+}
+
+/**
+ * @brief Cierra una sesión (el usuario salió).
+ *
+ * @return true si la sesión existía; false en caso contrario.
+ */
+bool Session_End( Session_table* st, const Session_token* token )
+{
+   assert( st && token );
+
+   pthread_mutex_lock( &st->lock );
+
+   long pos = map_find( st, token );
+   if( pos >= 0 ) session_free( st, ( int32_t ) st->map[ pos ] - 1, ( size_t ) pos );
+
+   pthread_mutex_unlock( &st->lock );
+   return pos >= 0;
+}
+
+/**
+ * @brief Avanza la rueda hasta el tick |now| y expira las sesiones inactivas. Cada tick
+ * cuesta O(1) más las sesiones que expiran en él; si no hay sesiones, el reloj salta
+ * directamente.
+ *
+ * @param st Referencia a la tabla.
+ * @param now Tick actual (p. ej. @see Session_Clock).
+ *
+ * @return El número de sesiones expiradas.
+ */
+size_t Session_Advance( Session_table* st, uint64_t now )
+{
+   assert( st );
+
+   pthread_mutex_lock( &st->lock );
+
+   size_t expired = 0;
+   while( st->now < now )
+   {
+      if( st->len == 0 )
+      {
+         st->now = now;
+         break;
+      }
+      expired += wheel_tick( st );
+   }
+
+   pthread_mutex_unlock( &st->lock );
+   return expired;
+}
+
+/**
+ * @brief Número de sesiones activas.
+ */
+size_t Session_Len( Session_table* st )
+{
+   assert( st );
+
+   pthread_mutex_lock( &st->lock );
+   size_t len = st->len;
+   pthread_mutex_unlock( &st->lock );
+
+   return len;
+}
+
+/**
+ * @brief Escribe una ficha como 32 dígitos hexadecimales (para dársela a un cliente).
+ */
+void Session_TokenToHex( const Session_token* token, char hex[ 33 ] )
+{
+   static const char digits[] = "0123456789abcdef";
+   for( int i = 0; i < 16; ++i )
+   {
+      hex[ 2 * i ] = digits[ token->bytes[ i ] >> 4 ];
+      hex[ 2 * i + 1 ] = digits[ token->bytes[ i ] & 15 ];
+   }
+   hex[ 32 ] = '\0';
+}
+
+/**
+ * @brief Lee una ficha escrita con @see Session_TokenToHex.
+ *
+ * @return true si |hex| son exactamente 32 dígitos hexadecimales; false en caso contrario.
+ */
+bool Session_TokenFromHex( const char* hex, Session_token* token )
+{
+   for( int i = 0; i < 32; ++i )
+   {
+      char c = hex[ i ];
+      int v = c >= '0' && c <= '9' ? c - '0' :
+              c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+              c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+      if( v < 0 ) return false;
+
+      if( i % 2 == 0 ) token->bytes[ i / 2 ] = ( uint8_t )( v << 4 );
+      else token->bytes[ i / 2 ] |= ( uint8_t ) v;
+   }
+   return hex[ 32 ] == '\0';
+}
@@ -0,0 +1,79 @@
+#ifndef  SESSION_INC
+#define  SESSION_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "HT_Users.h"
+
+#define SESSION_CAPACITY 4096    ///< Sesiones simultáneas por defecto
+#define SESSION_IDLE 900         ///< Segundos sin actividad tras los que una sesión expira
+#define SESSION_WHEEL_BITS 6     ///< Cada nivel de la rueda tiene 2^6 = 64 ranuras
+#define SESSION_WHEEL_LEVELS 4   ///< Niveles de la rueda: alcanzan 64^4 ticks (unos 194 días de 1 s)
+
+/**
+ * @brief Ficha de sesión: 128 bits aleatorios que el cliente presenta en lugar de su
+ * contraseña.
+ */
+typedef struct
+{
+  uint8_t bytes[ 16 ];
+} Session_token;
+
+/**
+ * @brief Una sesión activa. Las sesiones viven en un arreglo fijo; los enlaces son
+ * índices dentro de él.
+ */
+typedef struct
+{
+  Session_token token;
+  char     user[ HT_NAME_MAX ]; ///< Nombre del usuario dueño de la sesión
+  uint64_t expires;       ///< Tick en el que expira si no hay actividad
+  int32_t  next;          ///< Siguiente en la ranura de la rueda (o en la lista libre)
+  int32_t  prev;          ///< Anterior en la ranura de la rueda; -1 si es la primera
+  uint16_t slot;          ///< Ranura de la rueda: nivel * 64 + índice
+} Session;
+
+/**
+ * @brief Tabla de sesiones de capacidad fija con expiración por una rueda de tiempo
+ * jerárquica.
+ *
+ * Las fichas se buscan en un mapa de direccionamiento abierto. Cada sesión está además en
+ * una ranura de la rueda según su tick de expiración: el nivel 0 tiene una ranura por
+ * tick y cada nivel superior cubre 64 veces más. Avanzar un tick sólo visita una ranura
+ * del nivel 0 (y, cada 64 ticks, redistribuye una ranura del nivel siguiente), así que el
+ * costo de expirar no depende del número de sesiones activas.
+ */
+typedef struct
+{
+  pthread_mutex_t lock;   ///< Protege todo lo que sigue
+
+  Session*  sessions;     ///< |capacity| sesiones
+  int32_t   free_list;    ///< Primera sesión libre; -1 si no hay
+  size_t    capacity;
+  size_t    len;          ///< Sesiones activas
+
+  uint32_t* map;          ///< Índice de sesión + 1 por celda; 0 si está vacía
+  size_t    map_mask;     ///< Celdas del mapa - 1 (el doble de |capacity|, redondeado)
+
+  int32_t   wheel[ SESSION_WHEEL_LEVELS << SESSION_WHEEL_BITS ]; ///< Primera sesión de cada ranura
+  uint64_t  now;          ///< Tick actual
+  uint64_t  idle;         ///< Ticks de inactividad tras los que una sesión expira
+
+  int       random_fd;    ///< /dev/urandom, abierto una sola vez
+} Session_table;
+
+Session_table* Session_New( size_t capacity, uint64_t idle, uint64_t now );
+void Session_Delete( Session_table** st );
+bool Session_Create( Session_table* st, const char* user, Session_token* token );
+bool Session_Check( Session_table* st, const Session_token* token, char user[ HT_NAME_MAX ] );
+bool Session_End( Session_table* st, const Session_token* token );
+size_t Session_Advance( Session_table* st, uint64_t now );
+size_t Session_Len( Session_table* st );
+uint64_t Session_Clock( void );
+void Session_TokenToHex( const Session_token* token, char hex[ 33 ] );
+bool Session_TokenFromHex( const char* hex, Session_token* token );
+
+#endif   /* ----- #ifndef SESSION_INC  ----- */
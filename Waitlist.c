@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "Waitlist.h"
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+#define WAITLIST_NONE UINT32_MAX
+#define WAITLIST_SEQ_BITS 48
+
+/**
+ * @brief Coloca el lugar |slot| en la posición |pos| del montículo.
+ */
+static void put( Waitlist* wl, uint32_t pos, uint32_t slot )
+{
+   wl->heap[ pos ] = slot;
+   wl->entries[ slot ].pos = pos;
+}
+
+static uint64_t key_at( const Waitlist* wl, uint32_t pos )
+{
+   return wl->entries[ wl->heap[ pos ] ].key;
+}
+
+/**
+ * @brief Sube el elemento de |pos| mientras su llave sea menor que la de su padre.
+ */
+static void sift_up( Waitlist* wl, uint32_t pos )
+{
+   uint32_t slot = wl->heap[ pos ];
+   uint64_t key = wl->entries[ slot ].key;
+   while( pos > 0 )
+   {
+      uint32_t parent = ( pos - 1 ) / WAITLIST_ARITY;
+      if( key_at( wl, parent ) <= key ) break;
+      put( wl, pos, wl->heap[ parent ] );
+      pos = parent;
+   }
+   put( wl, pos, slot );
+}
+
+/**
+ * @brief Baja el elemento de |pos| mientras algún hijo tenga una llave menor.
+ */
+static void sift_down( Waitlist* wl, uint32_t pos )
+{
+   uint32_t slot = wl->heap[ pos ];
+   uint64_t key = wl->entries[ slot ].key;
+   for( ;; )
+   {
+      uint32_t first = pos * WAITLIST_ARITY + 1;
+      if( first >= wl->len ) break;
+      uint32_t last = first + WAITLIST_ARITY < wl->len ? first + WAITLIST_ARITY : wl->len;
+      uint32_t best = first;
+      for( uint32_t c = first + 1; c < last; ++c )
+      {
+         if( key_at( wl, c ) < key_at( wl, best ) ) best = c;
+      }
+      if( key_at( wl, best ) >= key ) break;
+      put( wl, pos, wl->heap[ best ] );
+      pos = best;
+   }
+   put( wl, pos, slot );
+}
+
+/**
+ * @brief Quita del montículo el elemento en |pos| y libera su lugar.
+ *
+ * @pre Se tiene |wl->lock|.
+ */
+static void remove_at( Waitlist* wl, uint32_t pos )
+{
+   uint32_t slot = wl->heap[ pos ];
+   uint32_t last = --wl->len;
+   if( pos != last )
+   {
+      put( wl, pos, wl->heap[ last ] );
+      if( pos > 0 && key_at( wl, pos ) < key_at( wl, ( pos - 1 ) / WAITLIST_ARITY ) ) sift_up( wl, pos );
+      else sift_down( wl, pos );
+   }
+
+   Waitlist_entry* e = &wl->entries[ slot ];
+   e->gen++;
+   e->wallet = NULL;
+   e->pos = wl->free_head;
+   wl->free_head = slot;
+}
+
+/**
+ * @brief Duplica los lugares de la lista; la primera vez reserva WAITLIST_CAPACITY.
+ *
+ * @return true si hubo memoria.
+ */
+static bool grow( Waitlist* wl )
+{
+   uint32_t capacity = wl->capacity ? wl->capacity * 2 : WAITLIST_CAPACITY;
+   Waitlist_entry* entries = (Waitlist_entry*) realloc( wl->entries, capacity * sizeof( Waitlist_entry ) );
+   if( !entries ) return false;
+   wl->entries = entries;
+   uint32_t* heap = (uint32_t*) realloc( wl->heap, capacity * sizeof( uint32_t ) );
+   if( !heap ) return false;
+   wl->heap = heap;
+   wl->capacity = capacity;
+   return true;
+}
+
+/**
+ * @brief Intenta apartar y asignar un asiento y emitir el boleto en |wallet|.
+ *
+ * @return true si el boleto quedó emitido; si no, el vuelo queda como estaba.
+ */
+static bool book( Seat_inventory* inv, int32_t flight, Wallet* wallet, const Ticket* ticket )
+{
+   if( !Seats_Reserve( inv, flight, 1 ) ) return false;
+
+   Seat_pos seat;
+   if( Seats_Assign( inv, flight, 1, 0, &seat ) )
+   {
+      if( Wallet_insert( wallet, ticket->price, ticket->distance, ticket->time,
+                         ticket->start, ticket->end, seat, ticket->departure ) != WALLET_NO_TICKET )
+      {
+         return true;
+      }
+      Seats_Unassign( inv, flight, &seat, 1 );
+   }
+   Seats_Release( inv, flight, 1 );
+   return false;
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Crea las listas de espera, vacías, de |flights| vuelos.
+ *
+ * @param flights Número de vuelos (@see Seat_inventory).
+ *
+ * @return Las listas, o NULL si no hubo memoria.
+ */
+Waitlist_table* Waitlist_New( size_t flights )
+{
+   Waitlist_table* wt = (Waitlist_table*) malloc( sizeof( Waitlist_table ) );
+   if( !wt ) return NULL;
+
+   wt->flights = flights;
+   wt->lists = (Waitlist*) aligned_alloc( 64, ( flights ? flights : 1 ) * sizeof( Waitlist ) );
+   if( !wt->lists )
+   {
+      free( wt );
+      return NULL;
+   }
+   for( size_t f = 0; f < flights; ++f )
+   {
+      Waitlist* wl = &wt->lists[ f ];
+      pthread_mutex_init( &wl->lock, NULL );
+      wl->entries = NULL;
+      wl->heap = NULL;
+      wl->len = 0;
+      wl->capacity = 0;
+      wl->n_slots = 0;
+      wl->free_head = WAITLIST_NONE;
+      wl->seq = 0;
+   }
+   return wt;
+}
+
+/**
+ * @brief Destruye las listas de espera; los clientes en espera se descartan.
+ *
+ * @param wt Referencia a las listas; queda en NULL.
+ */
+void Waitlist_Delete( Waitlist_table** wt )
+{
+   assert( wt );
+   Waitlist_table* t = *wt;
+   if( !t ) return;
+
+   for( size_t f = 0; f < t->flights; ++f )
+   {
+      free( t->lists[ f ].entries );
+      free( t->lists[ f ].heap );
+      pthread_mutex_destroy( &t->lists[ f ].lock );
+   }
+   free( t->lists );
+   free( t );
+   *wt = NULL;
+}
+
+/**
+ * @brief Pone a un cliente en la lista de espera de un vuelo agotado. Antes vuelve a
+ * intentar la reserva con el candado de la lista tomado: un asiento liberado después de
+ * que el cliente lo viera agotado se le asigna en lugar de formarlo.
+ *
+ * @param wt Las listas de espera.
+ * @param inv El inventario de asientos.
+ * @param flight El vuelo.
+ * @param fare Clase tarifaria; decide la prioridad junto con el orden de llegada.
+ * @param wallet Billetera que recibirá el boleto; debe seguir existiendo mientras espera. Si
+ * hay asiento se le emite aquí, así que quien llama serializa los cambios a las billeteras
+ * (@see Service_Waitlist).
+ * @param ticket Datos del boleto a emitir; se ignora su asiento.
+ * @param handle Recibe el identificador del lugar si el cliente quedó en espera.
+ *
+ * @return eWaitlist_QUEUED, eWaitlist_BOOKED o eWaitlist_FAILED.
+ */
+eWaitlistResult Waitlist_Add( Waitlist_table* wt, Seat_inventory* inv, int32_t flight, eFareClass fare,
+                              Wallet* wallet, const Ticket* ticket, Waitlist_handle* handle )
+{
+   assert( wt && inv && wallet && ticket && handle );
+   assert( 0 <= flight && (size_t) flight < wt->flights );
+
+   Waitlist* wl = &wt->lists[ flight ];
+   eWaitlistResult result = eWaitlist_FAILED;
+   pthread_mutex_lock( &wl->lock );
+
+   if( book( inv, flight, wallet, ticket ) )
+   {
+      result = eWaitlist_BOOKED;
+   }
+   else if( wl->free_head != WAITLIST_NONE || wl->n_slots < wl->capacity || grow( wl ) )
+   {
+      uint32_t slot = wl->free_head;
+      if( slot != WAITLIST_NONE ) wl->free_head = wl->entries[ slot ].pos;
+      else
+      {
+         slot = wl->n_slots++;
+         wl->entries[ slot ].gen = 0;
+      }
+
+      Waitlist_entry* e = &wl->entries[ slot ];
+      e->key = ( (uint64_t) fare << WAITLIST_SEQ_BITS ) | ( wl->seq++ & ( ( 1ull << WAITLIST_SEQ_BITS ) - 1 ) );
+      e->wallet = wallet;
+      e->ticket = *ticket;
+      e->ticket.seat.row = SEATS_NO_ROW;
+      put( wl, wl->len++, slot );
+      sift_up( wl, wl->len - 1 );
+
+      handle->flight = flight;
+      handle->slot = slot;
+      handle->gen = e->gen;
+      result = eWaitlist_QUEUED;
+   }
+
+   pthread_mutex_unlock( &wl->lock );
+   return result;
+}
+
+/**
+ * @brief Saca a un cliente de la lista de espera.
+ *
+ * @param wt Las listas de espera.
+ * @param handle El identificador que devolvió Waitlist_Add.
+ *
+ * @return true si el cliente seguía esperando.
+ */
+bool Waitlist_Cancel( Waitlist_table* wt, Waitlist_handle handle )
+{
+   assert( wt );
+   if( handle.flight < 0 || (size_t) handle.flight >= wt->flights ) return false;
+
+   Waitlist* wl = &wt->lists[ handle.flight ];
+   bool found = false;
+   pthread_mutex_lock( &wl->lock );
+   if( handle.slot < wl->n_slots )
+   {
+      Waitlist_entry* e = &wl->entries[ handle.slot ];
+      if( e->gen == handle.gen && e->pos < wl->len && wl->heap[ e->pos ] == handle.slot )
+      {
+         remove_at( wl, e->pos );
+         found = true;
+      }
+   }
+   pthread_mutex_unlock( &wl->lock );
+   return found;
+}
+
+/**
+ * @brief Entrega un asiento cancelado: si alguien espera en el vuelo, el asiento pasa
+ * directamente al primero de la lista (el contador del vuelo no cambia); si no, vuelve al
+ * inventario.
+ *
+ * @param wt Las listas de espera.
+ * @param inv El inventario de asientos.
+ * @param flight El vuelo.
+ * @param seat El asiento que se liberó; sigue ocupado en el mapa.
+ * @param place Recibe el lugar que tenía quien recibió el boleto; puede ser NULL.
+ *
+ * @return La billetera que recibió el boleto, o NULL si el asiento volvió al inventario.
+ */
+Wallet* Waitlist_Release( Waitlist_table* wt, Seat_inventory* inv, int32_t flight, Seat_pos seat,
+                          Waitlist_handle* place )
+{
+   assert( wt && inv );
+   assert( 0 <= flight && (size_t) flight < wt->flights );
+   assert( seat.row != SEATS_NO_ROW );
+
+   Waitlist* wl = &wt->lists[ flight ];
+   Wallet* promoted = NULL;
+   pthread_mutex_lock( &wl->lock );
+   while( wl->len > 0 && !promoted )
+   {
+      uint32_t slot = wl->heap[ 0 ];
+      Waitlist_entry* e = &wl->entries[ slot ];
+      Ticket* t = &e->ticket;
+      // Si la billetera no tiene memoria para el boleto, el cliente pierde su turno
+      if( Wallet_insert( e->wallet, t->price, t->distance, t->time, t->start, t->end, seat, t->departure ) != WALLET_NO_TICKET )
+      {
+         promoted = e->wallet;
+         if( place ) *place = ( Waitlist_handle ){ .flight = flight, .slot = slot, .gen = e->gen };
+      }
+      remove_at( wl, 0 );
+   }
+   if( !promoted )
+   {
+      Seats_Unassign( inv, flight, &seat, 1 );
+      Seats_Release( inv, flight, 1 );
+   }
+   pthread_mutex_unlock( &wl->lock );
+   return promoted;
+}
+
+/**
+ * @brief Clientes esperando en un vuelo.
+ */
+size_t Waitlist_Len( Waitlist_table* wt, int32_t flight )
+{
+   assert( wt );
+   assert( 0 <= flight && (size_t) flight < wt->flights );
+
+   Waitlist* wl = &wt->lists[ flight ];
+   pthread_mutex_lock( &wl->lock );
+   size_t len = wl->len;
+   pthread_mutex_unlock( &wl->lock );
+   return len;
+}
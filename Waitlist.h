@@ -0,0 +1,82 @@
+#ifndef  WAITLIST_INC
+#define  WAITLIST_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "Boleto.h"
+#include "Seats.h"
+
+#define WAITLIST_ARITY 4      ///< Hijos de cada nodo del montículo
+#define WAITLIST_CAPACITY 16  ///< Lugares con los que empieza la lista de un vuelo
+
+/**
+ * @brief Clase tarifaria de quien espera; las clases menores se atienden primero.
+ */
+typedef enum
+{
+  eFare_FIRST,
+  eFare_BUSINESS,
+  eFare_ECONOMY,
+} eFareClass;
+
+/**
+ * @brief Resultado de Waitlist_Add.
+ */
+typedef enum
+{
+  eWaitlist_FAILED,   ///< No hubo memoria
+  eWaitlist_QUEUED,   ///< El cliente quedó en la lista de espera
+  eWaitlist_BOOKED,   ///< Se liberó un asiento mientras tanto y el boleto ya se emitió
+} eWaitlistResult;
+
+/**
+ * @brief Un cliente en espera: a quién y con qué datos se le emite el boleto.
+ */
+typedef struct
+{
+  uint64_t key;       ///< Clase tarifaria en los 16 bits altos y orden de llegada en los demás
+  uint32_t pos;       ///< Posición en el montículo, o el siguiente lugar libre
+  uint32_t gen;       ///< Cambia cada vez que el lugar se libera
+  Wallet*  wallet;    ///< Billetera que recibe el boleto
+  Ticket   ticket;    ///< El boleto a emitir; el asiento se asigna al promoverlo
+} Waitlist_entry;
+
+/**
+ * @brief Lista de espera de un vuelo: un montículo WAITLIST_ARITY-ario de mínimos sobre
+ * |key|. El montículo guarda índices de |entries| y cada entrada sabe su posición, así que
+ * cancelar por identificador no recorre la lista.
+ */
+typedef struct
+{
+  _Alignas( 64 ) pthread_mutex_t lock;  ///< Protege todo lo que sigue; también ordena la liberación de asientos del vuelo
+  Waitlist_entry* entries;
+  uint32_t* heap;       ///< Índices de |entries| en orden de montículo
+  uint32_t  len;        ///< Clientes en espera
+  uint32_t  capacity;   ///< Lugares de |entries| y |heap|
+  uint32_t  n_slots;    ///< Lugares usados alguna vez
+  uint32_t  free_head;  ///< Primer lugar libre, o UINT32_MAX
+  uint64_t  seq;        ///< Orden de llegada del siguiente cliente
+} Waitlist;
+
+/**
+ * @brief Listas de espera de todos los vuelos de un inventario de asientos.
+ */
+typedef struct
+{
+  Waitlist* lists;      ///< Una lista por vuelo
+  size_t    flights;
+} Waitlist_table;
+
+Waitlist_table* Waitlist_New( size_t flights );
+void Waitlist_Delete( Waitlist_table** wt );
+eWaitlistResult Waitlist_Add( Waitlist_table* wt, Seat_inventory* inv, int32_t flight, eFareClass fare,
+                              Wallet* wallet, const Ticket* ticket, Waitlist_handle* handle );
+bool Waitlist_Cancel( Waitlist_table* wt, Waitlist_handle handle );
+Wallet* Waitlist_Release( Waitlist_table* wt, Seat_inventory* inv, int32_t flight, Seat_pos seat,
+                          Waitlist_handle* place );
+size_t Waitlist_Len( Waitlist_table* wt, int32_t flight );
+
+#endif   /* ----- #ifndef WAITLIST_INC  ----- */
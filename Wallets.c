@@ -0,0 +1,396 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "Wallets.h"
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Lo que recibe recover(): el almacén y la función del usuario con su argumento.
+ */
+typedef struct
+{
+   Wallet_store* store;
+   Booking_fn    fn;
+   void*         ctx;
+} Recover_ctx;
+
+/**
+ * @brief FNV-1a de 64 bits de un nombre.
+ */
+static uint64_t hash_of( const char* owner )
+{
+   uint64_t h = 0xcbf29ce484222325ull;
+   for( const unsigned char* p = ( const unsigned char* ) owner; *p; ++p )
+   {
+      h ^= *p;
+      h *= 0x100000001b3ull;
+   }
+   return h;
+}
+
+/**
+ * @brief Busca a |owner| en |entries|.
+ *
+ * @return Su posición, o la del lugar vacío donde iría.
+ */
+static size_t find_slot( const Wallets_entry* entries, size_t capacity, const char* owner, uint64_t hash )
+{
+   size_t mask = capacity - 1;
+   size_t i = ( size_t ) hash & mask;
+   while( entries[ i ].owner[ 0 ] != '\0' &&
+          ( entries[ i ].hash != hash || strcmp( entries[ i ].owner, owner ) != 0 ) )
+   {
+      i = ( i + 1 ) & mask;
+   }
+   return i;
+}
+
+/**
+ * @brief Duplica la tabla y reacomoda a los clientes.
+ *
+ * @pre Se tiene |store->lock|.
+ */
+static bool grow( Wallet_store* store )
+{
+   size_t capacity = store->capacity * 2;
+   Wallets_entry* entries = ( Wallets_entry* ) calloc( capacity, sizeof( Wallets_entry ) );
+   if( NULL == entries ) return false;
+
+   for( size_t i = 0; i < store->capacity; ++i )
+   {
+      const Wallets_entry* e = &store->entries[ i ];
+      if( e->owner[ 0 ] != '\0' ) entries[ find_slot( entries, capacity, e->owner, e->hash ) ] = *e;
+   }
+   free( store->entries );
+   store->entries = entries;
+   store->capacity = capacity;
+   return true;
+}
+
+/**
+ * @brief El cliente |owner|; si no está, lo agrega.
+ *
+ * @pre Se tiene |store->lock|.
+ *
+ * @return El cliente, o NULL si no hubo memoria o el nombre está vacío.
+ */
+static Wallets_entry* entry_of( Wallet_store* store, const char* owner )
+{
+   if( owner[ 0 ] == '\0' ) return NULL;
+
+   uint64_t hash = hash_of( owner );
+   size_t i = find_slot( store->entries, store->capacity, owner, hash );
+   if( store->entries[ i ].owner[ 0 ] != '\0' ) return &store->entries[ i ];
+
+   // se crece al 70 % de ocupación para que las búsquedas sigan siendo cortas
+   if( ( store->len + 1 ) * 10 > store->capacity * 7 )
+   {
+      if( !grow( store ) ) return NULL;
+      i = find_slot( store->entries, store->capacity, owner, hash );
+   }
+   Wallets_entry* e = &store->entries[ i ];
+   memset( e, 0, sizeof( *e ) );
+   snprintf( e->owner, sizeof( e->owner ), "%s", owner );
+   e->hash = hash;
+   ++store->len;
+   return e;
+}
+
+/**
+ * @brief Anota en la lista del cliente |owner| un registro del diario.
+ *
+ * @pre Se tiene |store->lock|.
+ */
+static bool note( Wallet_store* store, const char* owner, uint64_t lsn )
+{
+   Wallets_entry* e = entry_of( store, owner );
+   if( NULL == e ) return false;
+
+   if( NULL == e->tail || e->tail->n == WALLETS_CHUNK )
+   {
+      // cada venta de un cliente nuevo o con el bloque lleno pide uno, con el candado tomado
+      Wallets_chunk* c = ( Wallets_chunk* ) Pool_Alloc( store->chunks );
+      if( NULL == c ) return false;
+      c->next = NULL;
+      c->n = 0;
+      c->reserved = 0;
+      if( e->tail ) e->tail->next = c;
+      else e->head = c;
+      e->tail = c;
+   }
+   e->tail->lsn[ e->tail->n++ ] = lsn;
+   return true;
+}
+
+/**
+ * @brief Copia la lista de LSN de un cliente para leer sus registros sin el candado.
+ *
+ * @pre Se tiene |store->lock|.
+ *
+ * @return Un arreglo con |*n| LSN que se libera con free(), o NULL si no hubo memoria.
+ */
+static uint64_t* lsns_of( const Wallets_entry* e, size_t* n )
+{
+   size_t total = 0;
+   for( const Wallets_chunk* c = e->head; c; c = c->next ) total += c->n;
+
+   uint64_t* lsn = ( uint64_t* ) malloc( ( total ? total : 1 ) * sizeof( uint64_t ) );
+   if( NULL == lsn ) return NULL;
+   size_t k = 0;
+   for( const Wallets_chunk* c = e->head; c; c = c->next )
+   {
+      memcpy( &lsn[ k ], c->lsn, c->n * sizeof( uint64_t ) );
+      k += c->n;
+   }
+   *n = total;
+   return lsn;
+}
+
+/**
+ * @brief Arma la billetera de |owner| repitiendo sus |n| registros del diario.
+ *
+ * Se llama sin |store->lock|: cada lectura puede esperar a que el registro llegue a disco.
+ */
+static Wallet* load( Booking_log* log, const char* owner, const uint64_t* lsn, size_t n )
+{
+   Wallet* wallet = Wallet_New( TAM_MAX );
+   if( NULL == wallet ) return NULL;
+   snprintf( wallet->owner, sizeof( wallet->owner ), "%s", owner );
+
+   for( size_t i = 0; i < n; ++i )
+   {
+      uint32_t type;
+      Booking_record rec;
+      if( !Bookings_Read( log, lsn[ i ], &type, &rec ) || !Bookings_Restore( type, &rec, NULL, wallet ) )
+      {
+         fprintf( stderr, "%s: bad record %llu for %s\n", log->log_path,
+                  ( unsigned long long ) lsn[ i ], owner );
+      }
+   }
+   return wallet;
+}
+
+/**
+ * @brief Anota cada registro del diario durante la recuperación y lo pasa a la función
+ * de quien abrió el almacén.
+ */
+static void recover( uint32_t type, uint64_t lsn, const Booking_record* rec, void* ctx )
+{
+   Recover_ctx* r = ( Recover_ctx* ) ctx;
+   if( !note( r->store, rec->owner, lsn ) )
+   {
+      fprintf( stderr, "Wallets: could not index record %llu\n", ( unsigned long long ) lsn );
+   }
+   if( r->fn ) r->fn( type, lsn, rec, r->ctx );
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Abre el almacén de billeteras sobre el diario de boletos de |dir|. Recorre el
+ * diario para saber qué registros son de cada cliente, sin cargar ninguna billetera, y le
+ * entrega cada registro a |fn| (p. ej. para reconstruir el inventario de asientos).
+ *
+ * @param dir Directorio de los datos.
+ * @param fn Función que recibe cada registro; puede ser NULL.
+ * @param ctx Argumento de |fn|.
+ *
+ * @return Una referencia al almacén, o NULL si el diario no se pudo abrir.
+ */
+Wallet_store* Wallets_Open( const char* dir, Booking_fn fn, void* ctx )
+{
+   Wallet_store* store = ( Wallet_store* ) calloc( 1, sizeof( Wallet_store ) );
+   if( NULL == store ) return NULL;
+
+   store->capacity = WALLETS_CAPACITY;
+   store->entries = ( Wallets_entry* ) calloc( store->capacity, sizeof( Wallets_entry ) );
+   store->chunks = Pool_New( sizeof( Wallets_chunk ) );
+   pthread_mutex_init( &store->lock, NULL );
+   pthread_cond_init( &store->load_done, NULL );
+   if( store->entries && store->chunks )
+   {
+      Recover_ctx r = { .store = store, .fn = fn, .ctx = ctx };
+      store->log = Bookings_Open( dir, recover, &r );
+   }
+
+   if( NULL == store->log )
+   {
+      Wallets_Close( &store );
+      return NULL;
+   }
+   return store;
+}
+
+/**
+ * @brief Cierra el almacén y su diario. Las billeteras cargadas se destruyen.
+ *
+ * @param store La dirección de una referencia al almacén; queda en NULL.
+ */
+void Wallets_Close( Wallet_store** store )
+{
+   assert( store && *store );
+   Wallet_store* s = *store;
+
+   if( s->log ) Bookings_Close( &s->log );
+   for( size_t i = 0; s->entries && i < s->capacity; ++i )
+   {
+      if( s->entries[ i ].owner[ 0 ] != '\0' ) Wallet_Delete( s->entries[ i ].wallet );
+   }
+   // los bloques se devuelven todos juntos con su reserva
+   if( s->chunks ) Pool_Delete( &s->chunks );
+   free( s->entries );
+   pthread_cond_destroy( &s->load_done );
+   pthread_mutex_destroy( &s->lock );
+   free( s );
+   *store = NULL;
+}
+
+/**
+ * @brief Da la billetera de un cliente, cargándola del diario si no está en memoria. La
+ * billetera no se descarga mientras no se suelte con Wallets_Release (una vez por cada
+ * llamada a esta función). Los registros se leen sin el candado del almacén, así que una
+ * carga lenta sólo detiene a quien pide esa misma billetera.
+ *
+ * @param store El almacén.
+ * @param owner Nombre del cliente.
+ *
+ * @return La billetera, o NULL si no hubo memoria.
+ */
+Wallet* Wallets_Acquire( Wallet_store* store, const char* owner )
+{
+   assert( store && owner );
+
+   pthread_mutex_lock( &store->lock );
+   Wallets_entry* e = entry_of( store, owner );
+   // si otro hilo la está leyendo se espera; la tabla puede crecer mientras, así que se
+   // vuelve a buscar al cliente
+   while( e && e->loading )
+   {
+      pthread_cond_wait( &store->load_done, &store->lock );
+      e = entry_of( store, owner );
+   }
+
+   size_t n;
+   uint64_t* lsn = e && NULL == e->wallet ? lsns_of( e, &n ) : NULL;
+   if( lsn )
+   {
+      // nadie anexa registros de un cliente sin billetera, así que la copia está completa
+      e->loading = true;
+      pthread_mutex_unlock( &store->lock );
+      Wallet* loaded = load( store->log, owner, lsn, n );
+      free( lsn );
+
+      pthread_mutex_lock( &store->lock );
+      e = entry_of( store, owner );
+      e->loading = false;
+      e->wallet = loaded;
+      if( loaded ) ++store->loaded;
+      pthread_cond_broadcast( &store->load_done );
+   }
+
+   Wallet* wallet = e ? e->wallet : NULL;
+   if( wallet ) ++e->pins;
+   pthread_mutex_unlock( &store->lock );
+   return wallet;
+}
+
+/**
+ * @brief Suelta una billetera obtenida con Wallets_Acquire.
+ *
+ * @param store El almacén.
+ * @param wallet La billetera.
+ * @param now Tick actual (p. ej. @see Session_Clock); desde él cuenta la inactividad.
+ */
+void Wallets_Release( Wallet_store* store, Wallet* wallet, uint64_t now )
+{
+   assert( store && wallet );
+
+   pthread_mutex_lock( &store->lock );
+   size_t i = find_slot( store->entries, store->capacity, wallet->owner, hash_of( wallet->owner ) );
+   Wallets_entry* e = &store->entries[ i ];
+   assert( e->wallet == wallet && e->pins > 0 );
+   --e->pins;
+   e->last_use = now;
+   pthread_mutex_unlock( &store->lock );
+}
+
+/**
+ * @brief Anexa al diario una venta o una cancelación de un boleto de |wallet| y la anota en
+ * la lista de su dueño. No espera a que llegue a disco (@see Bookings_Wait).
+ *
+ * @param store El almacén.
+ * @param type BOOKING_SELL o BOOKING_CANCEL.
+ * @param wallet La billetera, obtenida con Wallets_Acquire.
+ * @param ticket El boleto.
+ * @param handle Su identificador en la billetera.
+ * @param when Hora de la operación.
+ *
+ * @return El LSN del registro.
+ */
+uint64_t Wallets_Log( Wallet_store* store, uint32_t type, Wallet* wallet, const Ticket* ticket,
+                      uint32_t handle, time_t when )
+{
+   assert( store && wallet && ticket );
+
+   // con el candado tomado la lista de cada cliente queda en el orden del diario
+   pthread_mutex_lock( &store->lock );
+   uint64_t lsn = Bookings_Append( store->log, type, wallet->owner, ticket, handle, when );
+   if( !note( store, wallet->owner, lsn ) )
+   {
+      fprintf( stderr, "Wallets: could not index record %llu\n", ( unsigned long long ) lsn );
+   }
+   pthread_mutex_unlock( &store->lock );
+   return lsn;
+}
+
+/**
+ * @brief Descarga las billeteras que nadie usa desde hace |idle| ticks o más. Sus boletos
+ * siguen en el diario y se vuelven a leer cuando se pidan.
+ *
+ * @param store El almacén.
+ * @param now Tick actual.
+ * @param idle Ticks de inactividad (p. ej. WALLETS_IDLE segundos).
+ *
+ * @return El número de billeteras descargadas.
+ */
+size_t Wallets_Reclaim( Wallet_store* store, uint64_t now, uint64_t idle )
+{
+   assert( store );
+
+   size_t freed = 0;
+   pthread_mutex_lock( &store->lock );
+   for( size_t i = 0; i < store->capacity && store->loaded > 0; ++i )
+   {
+      Wallets_entry* e = &store->entries[ i ];
+      if( e->wallet && e->pins == 0 && now - e->last_use >= idle )
+      {
+         Wallet_Delete( e->wallet );
+         e->wallet = NULL;
+         --store->loaded;
+         ++freed;
+      }
+   }
+   pthread_mutex_unlock( &store->lock );
+   return freed;
+}
+
+/**
+ * @brief Billeteras cargadas en memoria.
+ */
+size_t Wallets_Loaded( Wallet_store* store )
+{
+   assert( store );
+
+   pthread_mutex_lock( &store->lock );
+   size_t loaded = store->loaded;
+   pthread_mutex_unlock( &store->lock );
+   return loaded;
+}
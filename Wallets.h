@@ -0,0 +1,78 @@
+#ifndef  WALLETS_INC
+#define  WALLETS_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "Boleto.h"
+#include "Bookings.h"
+#include "Pool.h"
+
+#define WALLETS_CAPACITY 64   ///< Clientes que caben en el índice antes de crecer
+#define WALLETS_CHUNK 30      ///< LSN por bloque (bloques de 256 bytes)
+#define WALLETS_IDLE 1800     ///< Segundos sin uso tras los que una billetera se descarga
+
+/**
+ * @brief Bloque de la lista de registros del diario que pertenecen a un cliente.
+ */
+typedef struct Wallets_chunk
+{
+  struct Wallets_chunk* next;
+  uint32_t n;                       ///< LSN ocupados
+  uint32_t reserved;
+  uint64_t lsn[ WALLETS_CHUNK ];    ///< En orden creciente
+} Wallets_chunk;
+
+/**
+ * @brief Un cliente del almacén. Sus boletos no se guardan aquí: se guardan los LSN de sus
+ * ventas y cancelaciones, y la billetera se arma repitiéndolas sólo cuando se necesita.
+ */
+typedef struct
+{
+  char     owner[ WALLET_OWNER_MAX ];  ///< Nombre del cliente; "" si el lugar está vacío
+  uint64_t hash;          ///< Hash de |owner|
+  Wallet*  wallet;        ///< La billetera, o NULL si no está cargada
+  uint32_t pins;          ///< Usos en curso (sesiones, lugares en listas de espera)
+  bool     loading;       ///< Un hilo está leyendo la billetera del diario sin el candado
+  uint64_t last_use;      ///< Tick en que se soltó por última vez
+  Wallets_chunk* head;    ///< Primer bloque de LSN
+  Wallets_chunk* tail;    ///< Último bloque de LSN, donde se anexa
+} Wallets_entry;
+
+/**
+ * @brief Billeteras de todos los clientes, indexadas por nombre de usuario (la llave de la
+ * tabla de usuarios; sus lugares cambian al crecer, el nombre no).
+ *
+ * El almacén es dueño del diario de boletos (@see Booking_log): cada venta o cancelación
+ * pasa por Wallets_Log, que además anota su LSN en la lista del cliente. Al arrancar sólo
+ * se recorre el diario para armar esas listas; la billetera de un cliente se lee del disco
+ * la primera vez que se pide (al iniciar sesión) y se descarga cuando nadie la usa durante
+ * un tiempo (@see Wallets_Reclaim). Esa lectura se hace sin |lock|, para no detener las
+ * ventas de los demás mientras se espera al disco; quien pide la misma billetera a la vez
+ * espera en |load_done|.
+ */
+typedef struct
+{
+  pthread_mutex_t lock;     ///< Protege todo lo que sigue
+  pthread_cond_t  load_done;  ///< Se avisa cada vez que termina una lectura (@see Wallets_entry)
+  Wallets_entry*  entries;  ///< Tabla de dispersión con sondeo lineal
+  size_t          capacity; ///< Potencia de 2
+  size_t          len;      ///< Clientes en la tabla
+  size_t          loaded;   ///< Billeteras cargadas en memoria
+  Booking_log*    log;      ///< Diario de boletos
+  Pool*           chunks;   ///< Bloques de LSN de todos los clientes
+} Wallet_store;
+
+Wallet_store* Wallets_Open( const char* dir, Booking_fn fn, void* ctx );
+void Wallets_Close( Wallet_store** store );
+Wallet* Wallets_Acquire( Wallet_store* store, const char* owner );
+void Wallets_Release( Wallet_store* store, Wallet* wallet, uint64_t now );
+uint64_t Wallets_Log( Wallet_store* store, uint32_t type, Wallet* wallet, const Ticket* ticket,
+                      uint32_t handle, time_t when );
+size_t Wallets_Reclaim( Wallet_store* store, uint64_t now, uint64_t idle );
+size_t Wallets_Loaded( Wallet_store* store );
+
+#endif   /* ----- #ifndef WALLETS_INC  ----- */
@@ -0,0 +1,176 @@
+#include <string.h>
+#include <assert.h>
+
+#include "Wire.h"
+
+//----------------------------------------------------------------------
+//                     Funciones privadas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Reserva |n| bytes para escribir.
+ *
+ * @return A dónde escribirlos, o NULL si no caben.
+ */
+static uint8_t* put( Wire* w, size_t n )
+{
+   if( w->bad || w->cap - w->len < n )
+   {
+      w->bad = true;
+      return NULL;
+   }
+   uint8_t* p = w->data + w->len;
+   w->len += n;
+   return p;
+}
+
+/**
+ * @brief Toma |n| bytes para leer.
+ *
+ * @return De dónde leerlos, o NULL si el mensaje no los tiene.
+ */
+static const uint8_t* get( Wire* w, size_t n )
+{
+   if( w->bad || w->len - w->pos < n )
+   {
+      w->bad = true;
+      return NULL;
+   }
+   const uint8_t* p = w->data + w->pos;
+   w->pos += n;
+   return p;
+}
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+/**
+ * @brief Prepara un cursor para leer los |len| bytes de |data|.
+ */
+void Wire_Reader( Wire* w, const uint8_t* data, size_t len )
+{
+   assert( w && ( data || len == 0 ) );
+
+   // el lector nunca escribe en |data|
+   w->data = ( uint8_t* ) data;
+   w->len = len;
+   w->cap = len;
+   w->pos = 0;
+   w->bad = false;
+}
+
+/**
+ * @brief Prepara un cursor para escribir a lo más |cap| bytes en |data|.
+ */
+void Wire_Writer( Wire* w, uint8_t* data, size_t cap )
+{
+   assert( w && ( data || cap == 0 ) );
+
+   w->data = data;
+   w->len = 0;
+   w->cap = cap;
+   w->pos = 0;
+   w->bad = false;
+}
+
+void Wire_PutU8( Wire* w, uint8_t v )
+{
+   uint8_t* p = put( w, 1 );
+   if( p ) p[ 0 ] = v;
+}
+
+void Wire_PutU16( Wire* w, uint16_t v )
+{
+   uint8_t* p = put( w, 2 );
+   if( p )
+   {
+      p[ 0 ] = ( uint8_t )( v >> 8 );
+      p[ 1 ] = ( uint8_t ) v;
+   }
+}
+
+void Wire_PutU32( Wire* w, uint32_t v )
+{
+   uint8_t* p = put( w, 4 );
+   for( int i = 0; p && i < 4; ++i ) p[ i ] = ( uint8_t )( v >> ( 24 - 8 * i ) );
+}
+
+void Wire_PutU64( Wire* w, uint64_t v )
+{
+   uint8_t* p = put( w, 8 );
+   for( int i = 0; p && i < 8; ++i ) p[ i ] = ( uint8_t )( v >> ( 56 - 8 * i ) );
+}
+
+void Wire_PutBytes( Wire* w, const void* src, size_t n )
+{
+   uint8_t* p = put( w, n );
+   if( p ) memcpy( p, src, n );
+}
+
+/**
+ * @brief Escribe una cadena; las de más de 255 bytes marcan |bad|.
+ */
+void Wire_PutStr( Wire* w, const char* s )
+{
+   size_t n = strlen( s );
+   if( n > UINT8_MAX )
+   {
+      w->bad = true;
+      return;
+   }
+   Wire_PutU8( w, ( uint8_t ) n );
+   Wire_PutBytes( w, s, n );
+}
+
+uint8_t Wire_GetU8( Wire* w )
+{
+   const uint8_t* p = get( w, 1 );
+   return p ? p[ 0 ] : 0;
+}
+
+uint16_t Wire_GetU16( Wire* w )
+{
+   const uint8_t* p = get( w, 2 );
+   return p ? ( uint16_t )( ( p[ 0 ] << 8 ) | p[ 1 ] ) : 0;
+}
+
+uint32_t Wire_GetU32( Wire* w )
+{
+   const uint8_t* p = get( w, 4 );
+   uint32_t v = 0;
+   for( int i = 0; p && i < 4; ++i ) v = ( v << 8 ) | p[ i ];
+   return v;
+}
+
+uint64_t Wire_GetU64( Wire* w )
+{
+   const uint8_t* p = get( w, 8 );
+   uint64_t v = 0;
+   for( int i = 0; p && i < 8; ++i ) v = ( v << 8 ) | p[ i ];
+   return v;
+}
+
+void Wire_GetBytes( Wire* w, void* dst, size_t n )
+{
+   const uint8_t* p = get( w, n );
+   if( p ) memcpy( dst, p, n );
+   else memset( dst, 0, n );
+}
+
+/**
+ * @brief Lee una cadena y le pone fin de cadena; si no cabe en |size| bytes marca |bad|.
+ */
+void Wire_GetStr( Wire* w, char* s, size_t size )
+{
+   assert( size > 0 );
+
+   size_t n = Wire_GetU8( w );
+   if( n >= size )
+   {
+      w->bad = true;
+      n = 0;
+   }
+   Wire_GetBytes( w, s, n );
+   s[ w->bad ? 0 : n ] = '\0';
+}
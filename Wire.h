@@ -0,0 +1,40 @@
+#ifndef  WIRE_INC
+#define  WIRE_INC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Cursor sobre un mensaje del protocolo del servidor (@see Server). Los enteros van
+ * en orden de red (el byte más significativo primero) y las cadenas como un byte de
+ * longitud seguido de sus bytes, sin fin de cadena.
+ *
+ * Leer más allá del final o escribir más de |cap| bytes no hace nada y marca |bad|, así que
+ * quien decodifica un mensaje revisa |bad| una sola vez al final.
+ */
+typedef struct
+{
+  uint8_t* data;
+  size_t   len;         ///< Bytes válidos (al leer) o escritos (al escribir)
+  size_t   cap;         ///< Bytes de |data|
+  size_t   pos;         ///< Siguiente byte por leer
+  bool     bad;         ///< Hubo un desbordamiento
+} Wire;
+
+void Wire_Reader( Wire* w, const uint8_t* data, size_t len );
+void Wire_Writer( Wire* w, uint8_t* data, size_t cap );
+void Wire_PutU8( Wire* w, uint8_t v );
+void Wire_PutU16( Wire* w, uint16_t v );
+void Wire_PutU32( Wire* w, uint32_t v );
+void Wire_PutU64( Wire* w, uint64_t v );
+void Wire_PutBytes( Wire* w, const void* p, size_t n );
+void Wire_PutStr( Wire* w, const char* s );
+uint8_t Wire_GetU8( Wire* w );
+uint16_t Wire_GetU16( Wire* w );
+uint32_t Wire_GetU32( Wire* w );
+uint64_t Wire_GetU64( Wire* w );
+void Wire_GetBytes( Wire* w, void* p, size_t n );
+void Wire_GetStr( Wire* w, char* s, size_t size );
+
+#endif   /* ----- #ifndef WIRE_INC  ----- */
@@ -4,18 +4,229 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/resource.h>
 
 #include "List.h"
 #include "Graph.h"
 #include "Interfaz.h"
 #include "Boleto.h"
+#include "HT_Users.h"
+#include "CHT_Users.h"
+#include "HT_Store.h"
+#include "Auth.h"
+#include "Service.h"
+#include "Batch.h"
+#include "Server.h"
+#include "Loadgen.h"
 
 #define MAX_VERTICES 10
 #define INFINITE 1000000.0
 
+static void report_duplicate( const Users* user, void* ctx )
+{
+  ++*( size_t* ) ctx;
+  printf( "duplicate: %s", user->name );  // el nombre ya trae su '\n'
+}
 
+/**
+ * @brief Mide cuántos inicios de sesión por segundo atiende el grupo de verificación con
+ * 1, 2, 4, ... hilos, y sus latencias p50/p99.
+ *
+ * @param log_n Costo de la KDF (@see Kdf_Scrypt).
+ */
+static void login_bench( unsigned log_n )
+{
+  enum { LOGINS = 64 };
+  static Auth_job jobs[ LOGINS ];
+
+  long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+  for( unsigned w = 1; w <= ( unsigned )( cpus > 0 ? cpus : 1 ); w *= 2 ){
+    Auth_pool* pool = Auth_New( w, AUTH_QUEUE, log_n );
+    Kdf_hash hash;
+    if( !pool || !Auth_Hash( pool, &hash, "abcd" ) ){
+      fprintf( stderr, "Could not start the login pool\n" );
+      if( pool ) Auth_Delete( &pool );
+      return;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime( CLOCK_MONOTONIC, &t0 );
+    for( int i = 0; i < LOGINS; ++i ){
+      jobs[ i ].op = eAuth_VERIFY;
+      jobs[ i ].hash = hash;
+      strcpy( jobs[ i ].password, "abcd" );
+      Auth_Submit( pool, &jobs[ i ] );
+    }
+    for( int i = 0; i < LOGINS; ++i ) Auth_Wait( pool, &jobs[ i ] );
+    clock_gettime( CLOCK_MONOTONIC, &t1 );
+
+    double secs = ( t1.tv_sec - t0.tv_sec ) + ( t1.tv_nsec - t0.tv_nsec ) / 1e9;
+    printf( "%8.1f logins/s  ", LOGINS / secs );
+    Auth_Report( pool, stdout );
+    Auth_Delete( &pool );
+  }
+}
+
+/**
+ * @brief Modo por lotes: ejecuta los comandos de |path| (o de stdin) sin pantallas y
+ * escribe las respuestas en stdout; las cuentas de la corrida van a stderr.
+ *
+ * @return El código de salida del programa.
+ */
+static int batch( Graph* g, const char* path )
+{
+  FILE* in = path ? fopen( path, "r" ) : stdin;
+  Service* svc = in ? Service_Open( g, STORE_DIR ) : NULL;
+  if( !svc ){
+    fprintf( stderr, "Could not start the batch from %s\n", path ? path : "stdin" );
+    if( in && in != stdin ) fclose( in );
+    return 1;
+  }
+  setvbuf( stdout, NULL, _IOFBF, BATCH_BUFFER );
+
+  Batch_stats stats = { 0 };
+  bool ok = Batch_Run( svc, in, stdout, &stats );
+  fprintf( stderr, "%llu commands (%llu failed) in %.3f s: %.0f commands/s\n",
+           (unsigned long long) stats.commands, (unsigned long long) stats.failed, stats.seconds,
+           stats.seconds > 0 ? stats.commands / stats.seconds : 0.0 );
+  Service_Close( &svc );
+  if( in != stdin ) fclose( in );
+  return ok ? 0 : 1;
+}
+
+/**
+ * @brief Sube el límite de archivos abiertos al máximo permitido, para atender (o abrir)
+ * miles de conexiones.
+ */
+static void raise_file_limit( void )
+{
+  struct rlimit lim;
+  if( getrlimit( RLIMIT_NOFILE, &lim ) == 0 && lim.rlim_cur < lim.rlim_max ){
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit( RLIMIT_NOFILE, &lim );
+  }
+}
+
+static Server* servidor = NULL;
+
+static void stop_server( int sig )
+{
+  (void) sig;
+  Server_Stop( servidor );
+}
+
+/**
+ * @brief Modo servidor: atiende el protocolo de Server en |address| hasta recibir SIGINT o
+ * SIGTERM.
+ *
+ * @return El código de salida del programa.
+ */
+static int serve( Graph* g, const char* address, unsigned workers )
+{
+  raise_file_limit();
+  signal( SIGPIPE, SIG_IGN );
+
+  Service* svc = Service_Open( g, STORE_DIR );
+  servidor = svc ? Server_New( svc, address, workers ) : NULL;
+  if( !servidor ){
+    fprintf( stderr, "Could not serve on %s\n", address );
+    if( svc ) Service_Close( &svc );
+    return 1;
+  }
+
+  struct sigaction sa;
+  memset( &sa, 0, sizeof( sa ) );
+  sa.sa_handler = stop_server;
+  sigaction( SIGINT, &sa, NULL );
+  sigaction( SIGTERM, &sa, NULL );
+
+  fprintf( stderr, "Serving on %s with %u workers\n", address, servidor->n_workers );
+  bool ok = Server_Run( servidor );
+  fprintf( stderr, "%llu requests served, at most %zu connections at once\n",
+           (unsigned long long) servidor->served, servidor->peak );
+
+  signal( SIGINT, SIG_DFL );
+  signal( SIGTERM, SIG_DFL );
+  Server_Delete( &servidor );
+  Service_Close( &svc );
+  return ok ? 0 : 1;
+}
+
+/**
+ * @brief Modo generador de carga: mantiene ocupado a un servidor de la misma red y reporta
+ * solicitudes por segundo y latencias.
+ *
+ * @return El código de salida del programa.
+ */
+static int load( Graph* g, const char* address, unsigned connections, double seconds )
+{
+  raise_file_limit();
+  signal( SIGPIPE, SIG_IGN );
+
+  Loadgen_stats stats;
+  if( connections == 0 || seconds <= 0 || !Loadgen_Run( g, address, connections, seconds, &stats ) ){
+    fprintf( stderr, "Could not load %s\n", address );
+    return 1;
+  }
+  printf( "%u connections, %llu requests in %.1f s: %.0f requests/s, p50 %.0f us, p99 %.0f us, %llu errors\n",
+          connections, (unsigned long long) stats.requests, stats.seconds, stats.requests / stats.seconds,
+          stats.p50, stats.p99, (unsigned long long) stats.errors );
+  return stats.errors == 0 ? 0 : 1;
+}
+
+int main( int argc, char* argv[] ) {
+  // ./main --hash-report usuarios.txt: compara las funciones hash de la tabla de usuarios
+  if( argc == 3 && strcmp( argv[1], "--hash-report" ) == 0 ){
+    FILE* keys = fopen( argv[2], "r" );
+    if( !keys || !HT_HashReport( keys, stdout ) ){
+      fprintf( stderr, "Could not read keys from %s\n", argv[2] );
+      return 1;
+    }
+    fclose( keys );
+    return 0;
+  }
+
+  // ./main --import usuarios.csv: migra usuarios (nombre,correo,contraseña,tarjeta)
+  if( argc == 3 && strcmp( argv[1], "--import" ) == 0 ){
+    FILE* in = fopen( argv[2], "r" );
+    User_store* store = in ? Store_Open( STORE_DIR ) : NULL;
+    Auth_pool* auth = store ? Auth_New( 0, AUTH_QUEUE, KDF_LOG_N ) : NULL;
+    if( !auth ){
+      fprintf( stderr, "Could not import users from %s\n", argv[2] );
+      if( store ) Store_Close( &store );
+      if( in ) fclose( in );
+      return 1;
+    }
+    size_t read = 0, dups = 0;
+    size_t imported = Store_Import( store, in, auth, report_duplicate, &dups, &read );
+    printf( "Imported %zu of %zu users (%zu duplicates)\n", imported, read, dups );
+    Auth_Delete( &auth );
+    fclose( in );
+    Store_Close( &store );
+    return 0;
+  }
+
+  // ./main --login-bench [costo]: rendimiento de la verificación de contraseñas
+  if( argc >= 2 && strcmp( argv[1], "--login-bench" ) == 0 ){
+    login_bench( argc >= 3 ? ( unsigned ) atoi( argv[2] ) : KDF_LOG_N );
+    return 0;
+  }
+
+  // ./main --cht-stress [lectores] [segundos]: tabla de usuarios con lectores y escritores a la vez
+  if( argc >= 2 && strcmp( argv[1], "--cht-stress" ) == 0 ){
+    long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    unsigned readers = argc >= 3 ? ( unsigned ) atoi( argv[2] ) : ( unsigned )( cpus > 0 ? cpus : 1 );
+    double seconds = argc >= 4 ? atof( argv[3] ) : 2.0;
+    if( readers == 0 || seconds <= 0 ){
+      fprintf( stderr, "Usage: %s --cht-stress [readers] [seconds]\n", argv[0] );
+      return 1;
+    }
+    return CHT_StressReport( readers, seconds, stdout ) ? 0 : 1;
+  }
 
-int main(void) {
   Graph* grafo = Graph_New(MAX_VERTICES, eGraphType_UNDIRECTED ); 
 
   Graph_AddVertex( grafo, 100, "MEX", "Ciudad de México", "Aeropuerto Internacional Licenciado Benito Juarez",  -6 );
@@ -85,6 +296,28 @@ int main(void) {
 
   Graph_AddWeightedEdge( grafo, 900, 1000, 692 );
 
+  // ./main --batch [comandos.txt]: atiende comandos por líneas (de stdin si no hay archivo)
+  if( argc >= 2 && strcmp( argv[1], "--batch" ) == 0 ){
+    int status = batch( grafo, argc >= 3 ? argv[2] : NULL );
+    Graph_Delete( &grafo );
+    return status;
+  }
+
+  // ./main --serve [dirección] [hilos]: atiende clientes por un socket (@see Server_Address)
+  if( argc >= 2 && strcmp( argv[1], "--serve" ) == 0 ){
+    int status = serve( grafo, argc >= 3 ? argv[2] : SERVER_ADDRESS, argc >= 4 ? (unsigned) atoi( argv[3] ) : 0 );
+    Graph_Delete( &grafo );
+    return status;
+  }
+
+  // ./main --load [dirección] [conexiones] [segundos]: genera carga para --serve
+  if( argc >= 2 && strcmp( argv[1], "--load" ) == 0 ){
+    int status = load( grafo, argc >= 3 ? argv[2] : SERVER_ADDRESS, argc >= 4 ? (unsigned) atoi( argv[3] ) : 1000,
+                       argc >= 5 ? atof( argv[4] ) : 10.0 );
+    Graph_Delete( &grafo );
+    return status;
+  }
+
   menuPrincipal(grafo);
   
   